@@ -41,7 +41,9 @@ typedef enum JBW_StatusCode {
   JBW_INVALID_SIMULATOR_CONFIGURATION,
   JBW_MPI_ERROR,
   JBW_INVALID_SEMAPHORE_ID,
-  JBW_SEMAPHORE_ALREADY_SIGNALED
+  JBW_SEMAPHORE_ALREADY_SIGNALED,
+  JBW_SHARED_MEMORY_ERROR,
+  JBW_PROTOCOL_VERSION_MISMATCH
 } JBW_StatusCode;
 
 // Represents a Jelly Bean World (JBW) API call status.
@@ -69,12 +71,45 @@ typedef enum TurnDirection {
   TurnDirectionRight
 } TurnDirection;
 
+/** Represents the kinds of actions that can be
+ *  submitted in a batch. */
+typedef enum ActionType {
+  ActionTypeMove = 0,
+  ActionTypeTurn,
+  ActionTypeNoOp
+} ActionType;
+
+/** A single agent action, as submitted to
+ *  `simulatorActBatch` or `simulatorEnqueueActions`.
+ *  `direction` and `numSteps`
+ *  are used only by moves, and `turnDirection` only
+ *  by turns. */
+typedef struct AgentAction {
+  ActionType type;
+  Direction direction;
+  TurnDirection turnDirection;
+  unsigned int numSteps;
+} AgentAction;
+
+/** Represents how agents behave during `simulatorAdvance`,
+ *  when they are not controlled by their clients. */
+typedef enum AdvancePolicy {
+  AdvancePolicyNoOp = 0,
+  AdvancePolicyQueuedActions
+} AdvancePolicy;
+
 typedef enum MovementConflictPolicy {
   MovementConflictPolicyNoCollisions = 0,
   MovementConflictPolicyFirstComeFirstServe,
   MovementConflictPolicyRandom
 } MovementConflictPolicy;
 
+typedef enum NotificationPolicy {
+  NotificationPolicyBlock = 0,
+  NotificationPolicyDropOldest,
+  NotificationPolicyCoalesce
+} NotificationPolicy;
+
 typedef enum ActionPolicy {
   ActionPolicyAllowed,
   ActionPolicyDisallowed,
@@ -98,6 +133,24 @@ typedef struct Position {
   int64_t y;
 } Position;
 
+/** Represents where `simulatorAddAgents` places the new agents. */
+typedef enum PlacementPolicy {
+  PlacementPolicyExplicit = 0,
+  PlacementPolicyRandom,
+  PlacementPolicySpread
+} PlacementPolicy;
+
+/** Describes where `simulatorAddAgents` places the new agents.
+ *  `positions` is used by `PlacementPolicyExplicit`, and the
+ *  region between `bottomLeft` and `topRight` (inclusive) is
+ *  used by the other policies. */
+typedef struct AgentPlacement {
+  PlacementPolicy policy;
+  const Position* positions;
+  Position bottomLeft;
+  Position topRight;
+} AgentPlacement;
+
 typedef struct IntensityFunction {
   unsigned int id;
   float* args;
@@ -136,6 +189,10 @@ typedef struct AgentSimulationState {
   float* scent;
   float* vision;
   unsigned int* collectedItems;
+
+  /* `true` in the time step in which the agent performed the last
+     action in its queue, if this was requested when enqueuing */
+  bool actionQueueDrained;
 } AgentSimulationState;
 
 typedef void (*OnStepCallback)(const void*, const AgentSimulationState*, unsigned int);
@@ -167,6 +224,18 @@ typedef struct SimulatorConfig {
   float scentDecay;
   float scentDiffusion;
   unsigned int removedItemLifetime;
+
+  /* Performance Parameters */
+  unsigned int stepThreadCount;
+  bool dedicatedStepThread;
+
+  /* Step Deadline (in milliseconds; 0 disables the deadline) */
+  unsigned int stepDeadline;
+  AgentAction defaultAction;
+
+  /* Asynchronous Step Notifications (0 calls the step callback synchronously) */
+  unsigned int stepNotificationCapacity;
+  NotificationPolicy stepNotificationPolicy;
 } SimulatorConfig;
 
 typedef struct SimulatorInfo {
@@ -208,6 +277,22 @@ typedef struct SimulationMap {
   unsigned int numPatches;
 } SimulationMap;
 
+/** A summary of a square block of patches. `itemCounts`
+ *  has an element for each item type, and `color` is the
+ *  average color of the cells in the block. */
+typedef struct SimulationMapBlock {
+  Position position;
+  unsigned int numPatches;
+  unsigned int* itemCounts;
+  unsigned int numAgents;
+  float* color;
+} SimulationMapBlock;
+
+typedef struct SimulationMapSummary {
+  SimulationMapBlock* blocks;
+  unsigned int numBlocks;
+} SimulationMapSummary;
+
 typedef struct SimulationNewClientInfo {
   void* handle;
   uint64_t simulationTime;
@@ -257,11 +342,20 @@ void simulatorSetStepCallbackData(
   void* simulatorHandle,
   const void* callbackData);
 
+unsigned int simulatorDefaultedAgentCount(
+  void* simulatorHandle);
+
 AgentSimulationState simulatorAddAgent(
   void* simulatorHandle,
   void* clientHandle,
   JBW_Status* status);
 
+AgentSimulationState* simulatorAddAgents(
+  void* simulatorHandle,
+  unsigned int numAgents,
+  const AgentPlacement* placement,
+  JBW_Status* status);
+
 void simulatorRemoveAgent(
   void* simulatorHandle,
   void* clientHandle,
@@ -311,6 +405,29 @@ void simulatorNoOpAgent(
   uint64_t agentId,
   JBW_Status* status);
 
+void simulatorActBatch(
+  void* simulatorHandle,
+  void* clientHandle,
+  const uint64_t* agentIds,
+  const AgentAction* actions,
+  unsigned int numAgents,
+  JBW_Status* agentStatuses,
+  JBW_Status* status);
+
+void simulatorEnqueueActions(
+  void* simulatorHandle,
+  void* clientHandle,
+  uint64_t agentId,
+  const AgentAction* actions,
+  unsigned int numActions,
+  bool notifyWhenDrained,
+  JBW_Status* status);
+
+void simulatorAdvance(
+  void* simulatorHandle,
+  unsigned int numSteps,
+  AdvancePolicy policy);
+
 void simulatorSetActive(
   void* simulatorHandle,
   void* clientHandle,
@@ -333,6 +450,27 @@ const SimulationMap simulatorMap(
   bool getVisionMap,
   JBW_Status* status);
 
+/** Like `simulatorMap`, but only retrieves the patches whose items or agents
+ *  changed after `sinceTime`. Each returned patch contains all of its current
+ *  items and agents. */
+const SimulationMap simulatorMapSince(
+  void* simulatorHandle,
+  void* clientHandle,
+  Position bottomLeftCorner,
+  Position topRightCorner,
+  uint64_t sinceTime,
+  bool getScentMap,
+  bool getVisionMap,
+  JBW_Status* status);
+
+const SimulationMapSummary simulatorMapSummary(
+  void* simulatorHandle,
+  void* clientHandle,
+  Position bottomLeftCorner,
+  Position topRightCorner,
+  unsigned int blockSize,
+  JBW_Status* status);
+
 const AgentIDList simulatorAgentIds(
   void* simulatorHandle,
   void* clientHandle,
@@ -348,6 +486,7 @@ const AgentSimulationState* simulatorAgentStates(
 void* simulationServerStart(
   void* simulatorHandle,
   unsigned int port,
+  const char* localSocketPath,
   unsigned int connectionQueueCapacity,
   unsigned int numWorkers,
   Permissions perms,
@@ -399,6 +538,9 @@ void simulatorDeleteAgentSimulationState(
 void simulatorDeleteSimulationMap(
   SimulationMap map);
 
+void simulatorDeleteSimulationMapSummary(
+  SimulationMapSummary summary);
+
 void simulatorDeleteAgentIDList(
   AgentIDList list);
 
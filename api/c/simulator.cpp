@@ -44,6 +44,8 @@ void JBW_SetJBWStatusFromStatus(JBW_Status* jbw_s, status s) {
     case status::CLIENT_OUT_OF_MEMORY: jbw_s->code = JBW_CLIENT_OUT_OF_MEMORY; break;
     case status::INVALID_SEMAPHORE_ID: jbw_s->code = JBW_INVALID_SEMAPHORE_ID; break;
     case status::SEMAPHORE_ALREADY_SIGNALED: jbw_s->code = JBW_SEMAPHORE_ALREADY_SIGNALED; break;
+    case status::SHARED_MEMORY_ERROR: jbw_s->code = JBW_SHARED_MEMORY_ERROR; break;
+    case status::PROTOCOL_VERSION_MISMATCH: jbw_s->code = JBW_PROTOCOL_VERSION_MISMATCH; break;
   }
 }
 
@@ -52,6 +54,7 @@ constexpr SimulatorInfo EMPTY_SIM_INFO = { 0 };
 constexpr SimulationNewClientInfo EMPTY_NEW_CLIENT_INFO = { 0 };
 constexpr SimulationClientInfo EMPTY_CLIENT_INFO = { 0 };
 constexpr SimulationMap EMPTY_SIM_MAP = { 0 };
+constexpr SimulationMapSummary EMPTY_SIM_MAP_SUMMARY = { 0 };
 constexpr AgentIDList EMPTY_AGENT_ID_LIST = { 0 };
 constexpr SemaphoreList EMPTY_SEMAPHORE_LIST = { 0 };
 
@@ -93,6 +96,68 @@ inline direction to_direction(TurnDirection dir) {
 }
 
 
+inline TurnDirection to_TurnDirection(direction dir) {
+  switch (dir) {
+  case direction::UP:    return TurnDirectionNoChange;
+  case direction::DOWN:  return TurnDirectionReverse;
+  case direction::LEFT:  return TurnDirectionLeft;
+  case direction::RIGHT: return TurnDirectionRight;
+  case direction::COUNT: break;
+  }
+  fprintf(stderr, "to_TurnDirection ERROR: Unrecognized direction.\n");
+  exit(EXIT_FAILURE);
+}
+
+
+inline AgentAction to_AgentAction(const action& src) {
+  AgentAction a;
+  a.direction = DirectionUp;
+  a.turnDirection = TurnDirectionNoChange;
+  a.numSteps = 0;
+  switch (src.type) {
+  case action_type::MOVE:
+    a.type = ActionTypeMove;
+    a.direction = to_Direction(src.dir);
+    a.numSteps = src.num_steps;
+    return a;
+  case action_type::TURN:
+    a.type = ActionTypeTurn;
+    a.turnDirection = to_TurnDirection(src.dir);
+    return a;
+  case action_type::NO_OP:
+    a.type = ActionTypeNoOp;
+    return a;
+  case action_type::COUNT: break;
+  }
+  fprintf(stderr, "to_AgentAction ERROR: Unrecognized action_type.\n");
+  exit(EXIT_FAILURE);
+}
+
+
+inline action to_action(const AgentAction& src) {
+  action a;
+  switch (src.type) {
+  case ActionTypeMove:
+    a.type = action_type::MOVE;
+    a.dir = to_direction(src.direction);
+    a.num_steps = src.numSteps;
+    return a;
+  case ActionTypeTurn:
+    a.type = action_type::TURN;
+    a.dir = to_direction(src.turnDirection);
+    a.num_steps = 0;
+    return a;
+  case ActionTypeNoOp:
+    a.type = action_type::NO_OP;
+    a.dir = direction::UP;
+    a.num_steps = 0;
+    return a;
+  }
+  fprintf(stderr, "to_action ERROR: Unrecognized ActionType.\n");
+  exit(EXIT_FAILURE);
+}
+
+
 inline MovementConflictPolicy to_MovementConflictPolicy(movement_conflict_policy policy) {
   switch (policy) {
   case movement_conflict_policy::NO_COLLISIONS:
@@ -121,6 +186,34 @@ inline movement_conflict_policy to_movement_conflict_policy(MovementConflictPoli
 }
 
 
+inline NotificationPolicy to_NotificationPolicy(notification_policy policy) {
+  switch (policy) {
+  case notification_policy::BLOCK:
+    return NotificationPolicyBlock;
+  case notification_policy::DROP_OLDEST:
+    return NotificationPolicyDropOldest;
+  case notification_policy::COALESCE:
+    return NotificationPolicyCoalesce;
+  }
+  fprintf(stderr, "to_NotificationPolicy ERROR: Unrecognized notification_policy.\n");
+  exit(EXIT_FAILURE);
+}
+
+
+inline notification_policy to_notification_policy(NotificationPolicy policy) {
+  switch (policy) {
+  case NotificationPolicyBlock:
+    return notification_policy::BLOCK;
+  case NotificationPolicyDropOldest:
+    return notification_policy::DROP_OLDEST;
+  case NotificationPolicyCoalesce:
+    return notification_policy::COALESCE;
+  }
+  fprintf(stderr, "to_notification_policy ERROR: Unrecognized NotificationPolicy.\n");
+  exit(EXIT_FAILURE);
+}
+
+
 inline ActionPolicy to_ActionPolicy(action_policy policy) {
   switch (policy) {
   case action_policy::ALLOWED:
@@ -441,6 +534,7 @@ inline void init(
   state.position.y = src.current_position.y;
   state.direction = to_Direction(src.current_direction);
   state.id = agent_id;
+  state.actionQueueDrained = src.action_queue_drained;
 
   state.scent = (float*) malloc(sizeof(float) * config.scent_dimension);
   if (state.scent == nullptr) {
@@ -524,6 +618,12 @@ inline void init(simulator_config& config, const SimulatorConfig& src, JBW_Statu
   config.decay_param = src.scentDecay;
   config.diffusion_param = src.scentDiffusion;
   config.deleted_item_lifetime = src.removedItemLifetime;
+  config.step_thread_count = src.stepThreadCount;
+  config.dedicated_step_thread = src.dedicatedStepThread;
+  config.step_deadline = src.stepDeadline;
+  config.default_action = to_action(src.defaultAction);
+  config.step_notification_capacity = src.stepNotificationCapacity;
+  config.step_notification_policy = to_notification_policy(src.stepNotificationPolicy);
 }
 
 
@@ -575,6 +675,12 @@ inline void init(
   config.scentDecay = src.decay_param;
   config.scentDiffusion = src.diffusion_param;
   config.removedItemLifetime = src.deleted_item_lifetime;
+  config.stepThreadCount = src.step_thread_count;
+  config.dedicatedStepThread = src.dedicated_step_thread;
+  config.stepDeadline = src.step_deadline;
+  config.defaultAction = to_AgentAction(src.default_action);
+  config.stepNotificationCapacity = src.step_notification_capacity;
+  config.stepNotificationPolicy = to_NotificationPolicy(src.step_notification_policy);
 }
 
 
@@ -677,6 +783,56 @@ inline void init(
 }
 
 
+inline void free(SimulationMapBlock& block) {
+  free(block.itemCounts);
+  free(block.color);
+}
+
+
+inline void init(
+  SimulationMapSummary& summary,
+  const array<array<patch_summary>>& blocks,
+  const simulator_config& config,
+  JBW_Status* status
+) {
+  unsigned int block_count = 0;
+  for (const array<patch_summary>& row : blocks)
+    block_count += row.length;
+  unsigned int index = 0;
+  summary.blocks = (SimulationMapBlock*) malloc(
+    max((size_t) 1, sizeof(SimulationMapBlock) * block_count));
+  if (summary.blocks == nullptr) {
+    status->code = JBW_OUT_OF_MEMORY;
+    return;
+  }
+  size_t item_type_count = config.item_types.length;
+  for (const array<patch_summary>& row : blocks) {
+    for (const patch_summary& src : row) {
+      SimulationMapBlock& block = summary.blocks[index];
+      block.itemCounts = (unsigned int*) malloc(max((size_t) 1, sizeof(unsigned int) * item_type_count));
+      block.color = (float*) malloc(max((size_t) 1, sizeof(float) * config.color_dimension));
+      if (block.itemCounts == nullptr || block.color == nullptr) {
+        if (block.itemCounts != nullptr) free(block.itemCounts);
+        if (block.color != nullptr) free(block.color);
+        for (unsigned int i = 0; i < index; i++)
+          free(summary.blocks[i]);
+        free(summary.blocks);
+        status->code = JBW_OUT_OF_MEMORY;
+        return;
+      }
+      block.position.x = src.block_position.x;
+      block.position.y = src.block_position.y;
+      block.numPatches = src.patch_count;
+      block.numAgents = src.agent_count;
+      memcpy(block.itemCounts, src.item_counts, sizeof(unsigned int) * item_type_count);
+      memcpy(block.color, src.color, sizeof(float) * config.color_dimension);
+      index++;
+    }
+  }
+  summary.numBlocks = block_count;
+}
+
+
 /**
  * A struct containing additional state information for the simulator. This
  * information includes a pointer to the `async_server` object, if the
@@ -758,9 +914,11 @@ struct client_data {
     uint64_t semaphore_id;
     AgentSimulationState agent_state;
     array<array<patch_state>>* map;
+    array<array<patch_summary>>* map_summary;
     pair<uint64_t*, size_t> agent_ids;
     agent_state_array agent_states;
     semaphore_array semaphores;
+    pair<status*, size_t> action_statuses;
   } response_data;
 
   /* for synchronization */
@@ -822,20 +980,26 @@ void on_step(
     return;
   }
   const simulator_config& config = sim->get_config();
+  size_t agent_count = 0;
   for (size_t i = 0; i < data.agent_ids.length; i++) {
-    init(agent_states[i], *agents.get(data.agent_ids[i]), config, data.agent_ids[i], &status);
+    bool contains;
+    const agent_state* agent = agents.get(data.agent_ids[i], contains);
+    /* with asynchronous step notifications, `agents` may predate this agent */
+    if (!contains) continue;
+    init(agent_states[agent_count], *agent, config, data.agent_ids[i], &status);
     if (status.code != JBW_OK) {
-      for (size_t j = 0; j < i; j++)
+      for (size_t j = 0; j < agent_count; j++)
         free(agent_states[j]);
       free(agent_states);
       return;
     }
+    agent_count++;
   }
 
   /* invoke callback */
-  data.callback(data.callback_data, agent_states, data.agent_ids.length);
+  data.callback(data.callback_data, agent_states, agent_count);
 
-  for (size_t i = 0; i < data.agent_ids.length; i++)
+  for (size_t i = 0; i < agent_count; i++)
     free(agent_states[i]);
   free(agent_states);
 }
@@ -1078,6 +1242,28 @@ void on_get_map(client<client_data>& c, status response, array<array<patch_state
 }
 
 
+/**
+ * The callback invoked when the client receives a get_map_summary response
+ * from the server. This function moves the result into
+ * `c.data.response_data.map_summary` and wakes up the parent thread (which
+ * should be waiting in the `simulatorMapSummary` function) so that it can
+ * return the response back.
+ *
+ * \param   c        The client that received the response.
+ * \param   response The response from the server, containing information about
+ *                   any errors.
+ * \param   blocks   The rows of `patch_summary` structures containing the
+ *                   summary of each block of patches.
+ */
+void on_get_map_summary(client<client_data>& c, status response, array<array<patch_summary>>* blocks) {
+  std::unique_lock<std::mutex> lck(c.data.lock);
+  c.data.waiting_for_server = false;
+  c.data.response_data.map_summary = blocks;
+  c.data.server_response = response;
+  c.data.cv.notify_one();
+}
+
+
 /**
  * The callback invoked when the client receives a get_agent_ids response from
  * the server. This function moves the result into
@@ -1170,6 +1356,58 @@ void on_is_active(client<client_data>& c, uint64_t agent_id, status response, bo
 }
 
 
+/**
+ * The callback invoked when the client receives an act_batch response from
+ * the server. This function moves the per-agent statuses into
+ * `c.data.response_data.action_statuses` and wakes up the parent thread
+ * (which should be waiting in the `simulatorActBatch` function) so that it
+ * can return the response back.
+ *
+ * \param   c        The client that received the response.
+ * \param   response The response from the server, containing information about
+ *                   any errors.
+ * \param   statuses The status of each submitted action.
+ * \param   count    The length of `statuses`.
+ */
+void on_act_batch(client<client_data>& c, status response, status* statuses, size_t count) {
+  std::unique_lock<std::mutex> lck(c.data.lock);
+  c.data.waiting_for_server = false;
+  c.data.response_data.action_statuses = make_pair(statuses, count);
+  c.data.server_response = response;
+  c.data.cv.notify_one();
+}
+
+
+/**
+ * The callback invoked when the client receives an enqueue_actions response
+ * from the server. This function copies the result into
+ * `c.data.server_response` and wakes up the parent thread (which should be
+ * waiting in the `simulatorEnqueueActions` function) so that it can return
+ * the response.
+ *
+ * \param   c               The client that received the response.
+ * \param   agent_id        The ID of the agent whose actions were enqueued.
+ * \param   response        The response from the server, containing
+ *                          information about any errors.
+ */
+void on_enqueue_actions(client<client_data>& c, uint64_t agent_id, status response) {
+  std::unique_lock<std::mutex> lck(c.data.lock);
+  c.data.waiting_for_server = false;
+  c.data.server_response = response;
+  c.data.cv.notify_one();
+}
+
+/**
+ * The callback invoked when the client receives an enable_shared_observations
+ * response from the server. The C API copies every observation into an
+ * `AgentSimulationState`, so it does not enable shared observations, and this
+ * should not be called.
+ */
+void on_enable_shared_observations(client<client_data>& c, status response) {
+  fprintf(stderr, "WARNING: `on_enable_shared_observations` should not be called.\n");
+}
+
+
 /**
  * The callback invoked when the client receives a step response from the
  * server. This function constructs a list of AgentSimulationState objects
@@ -1331,7 +1569,7 @@ SimulatorInfo simulatorLoad(
   sim_data.semaphore_ids.length = semaphore_id_count;
   fclose(file);
 
-  agent_state** agent_states = (agent_state**) malloc(sizeof(agent_state*) * agent_id_count);
+  const agent_state** agent_states = (const agent_state**) malloc(sizeof(agent_state*) * agent_id_count);
   if (agent_states == nullptr) {
     free(*sim);
     free(sim);
@@ -1339,11 +1577,13 @@ SimulatorInfo simulatorLoad(
     return EMPTY_SIM_INFO;
   }
 
-  sim->get_agent_states(agent_states, sim_data.agent_ids.data, (unsigned int) agent_id_count);
+  const observation_snapshot& snapshot = sim->get_agent_states(
+    agent_states, sim_data.agent_ids.data, (unsigned int) agent_id_count);
 
   const simulator_config& sim_config = sim->get_config();
   auto agents = (AgentSimulationState*) malloc(sizeof(AgentSimulationState) * agent_id_count);
   if (agents == nullptr) {
+    sim->release_snapshot(snapshot);
     free(*sim);
     free(sim);
     free(agent_states);
@@ -1355,6 +1595,7 @@ SimulatorInfo simulatorLoad(
     if (status->code != JBW_OK) {
       for (size_t j = 0; j < i; j++)
         free(agents[j]);
+      sim->release_snapshot(snapshot);
       free(*sim);
       free(sim);
       free(agent_states);
@@ -1362,6 +1603,7 @@ SimulatorInfo simulatorLoad(
       return EMPTY_SIM_INFO;
     }
   }
+  sim->release_snapshot(snapshot);
   free(agent_states);
 
   SimulatorInfo sim_info;
@@ -1396,6 +1638,11 @@ void simulatorSetStepCallbackData(void* simulatorHandle, const void* callbackDat
   sim_data.callback_data = callbackData;
 }
 
+unsigned int simulatorDefaultedAgentCount(void* simulatorHandle) {
+  simulator<simulator_data>* sim = (simulator<simulator_data>*) simulatorHandle;
+  return sim->get_defaulted_agent_count();
+}
+
 AgentSimulationState simulatorAddAgent(
   void* simulatorHandle,
   void* clientHandle,
@@ -1445,6 +1692,75 @@ AgentSimulationState simulatorAddAgent(
 }
 
 
+AgentSimulationState* simulatorAddAgents(
+  void* simulatorHandle,
+  unsigned int numAgents,
+  const AgentPlacement* placement,
+  JBW_Status* status
+) {
+  simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
+  position* positions = nullptr;
+  if (placement->policy == PlacementPolicyExplicit) {
+    positions = (position*) malloc(max((size_t) 1, sizeof(position) * numAgents));
+    if (positions == nullptr) {
+      status->code = JBW_OUT_OF_MEMORY;
+      return nullptr;
+    }
+    for (unsigned int i = 0; i < numAgents; i++)
+      positions[i] = position(placement->positions[i].x, placement->positions[i].y);
+  }
+
+  agent_placement sim_placement;
+  switch (placement->policy) {
+    case PlacementPolicyExplicit: sim_placement.policy = placement_policy::EXPLICIT; break;
+    case PlacementPolicyRandom:   sim_placement.policy = placement_policy::RANDOM; break;
+    case PlacementPolicySpread:   sim_placement.policy = placement_policy::SPREAD; break;
+  }
+  sim_placement.positions = positions;
+  sim_placement.bottom_left = position(placement->bottomLeft.x, placement->bottomLeft.y);
+  sim_placement.top_right = position(placement->topRight.x, placement->topRight.y);
+
+  uint64_t* new_agent_ids = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * numAgents));
+  agent_state** new_agents = (agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * numAgents));
+  AgentSimulationState* new_agent_states = (AgentSimulationState*) malloc(
+    max((size_t) 1, sizeof(AgentSimulationState) * numAgents));
+  if (new_agent_ids == nullptr || new_agents == nullptr || new_agent_states == nullptr) {
+    if (new_agent_ids != nullptr) free(new_agent_ids);
+    if (new_agents != nullptr) free(new_agents);
+    if (new_agent_states != nullptr) free(new_agent_states);
+    if (positions != nullptr) free(positions);
+    status->code = JBW_OUT_OF_MEMORY;
+    return nullptr;
+  }
+
+  auto result = sim_handle->add_agents(numAgents, sim_placement, new_agent_ids, new_agents);
+  if (positions != nullptr) free(positions);
+  if (result != status::OK) {
+    JBW_SetJBWStatusFromStatus(status, result);
+    free(new_agent_ids); free(new_agents); free(new_agent_states);
+    return nullptr;
+  }
+
+  if (!sim_handle->get_data().agent_ids.append(new_agent_ids, numAgents)) {
+    status->code = JBW_OUT_OF_MEMORY;
+    free(new_agent_ids); free(new_agents); free(new_agent_states);
+    return nullptr;
+  }
+  for (unsigned int i = 0; i < numAgents; i++) {
+    std::unique_lock<std::mutex> lock(new_agents[i]->lock);
+    init(new_agent_states[i], *new_agents[i], sim_handle->get_config(), new_agent_ids[i], status);
+    if (status->code != JBW_OK) {
+      for (unsigned int j = 0; j < i; j++)
+        free(new_agent_states[j]);
+      free(new_agent_ids); free(new_agents); free(new_agent_states);
+      return nullptr;
+    }
+  }
+  free(new_agent_ids); free(new_agents);
+  return new_agent_states;
+}
+
+
 void simulatorRemoveAgent(
   void* simulatorHandle,
   void* clientHandle,
@@ -1797,6 +2113,141 @@ void simulatorNoOpAgent(
 }
 
 
+void simulatorActBatch(
+  void* simulatorHandle,
+  void* clientHandle,
+  const uint64_t* agentIds,
+  const AgentAction* actions,
+  unsigned int numAgents,
+  JBW_Status* agentStatuses,
+  JBW_Status* status
+) {
+  action* batch = (action*) malloc(max((size_t) 1, sizeof(action) * numAgents));
+  if (batch == nullptr) {
+    status->code = JBW_OUT_OF_MEMORY;
+    return;
+  }
+  for (unsigned int i = 0; i < numAgents; i++)
+    batch[i] = to_action(actions[i]);
+
+  if (clientHandle == nullptr) {
+    /* the simulation is local, so call act_batch directly */
+    simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
+    jbw::status* statuses = (jbw::status*) malloc(max((size_t) 1, sizeof(jbw::status) * numAgents));
+    if (statuses == nullptr) {
+      free(batch);
+      status->code = JBW_OUT_OF_MEMORY;
+      return;
+    }
+    sim_handle->act_batch(agentIds, batch, numAgents, statuses);
+    for (unsigned int i = 0; i < numAgents; i++) {
+      agentStatuses[i].code = JBW_OK;
+      JBW_SetJBWStatusFromStatus(&agentStatuses[i], statuses[i]);
+    }
+    free(statuses);
+    free(batch);
+  } else {
+    /* this is a client, so send an act_batch message to the server */
+    client<client_data>* client_handle = (client<client_data>*) clientHandle;
+    if (!client_handle->client_running) {
+      free(batch);
+      status->code = JBW_LOST_CONNECTION;
+      return;
+    }
+
+    client_handle->data.waiting_for_server = true;
+    if (!send_act_batch(*client_handle, agentIds, batch, numAgents)) {
+      free(batch);
+      status->code = JBW_MPI_ERROR;
+      return;
+    }
+    free(batch);
+
+    /* wait for response from server */
+    wait_for_server(*client_handle);
+
+    if (client_handle->data.server_response != status::OK) {
+      JBW_SetJBWStatusFromStatus(status, client_handle->data.server_response);
+      return;
+    }
+
+    pair<jbw::status*, size_t>& statuses = client_handle->data.response_data.action_statuses;
+    for (unsigned int i = 0; i < numAgents; i++) {
+      agentStatuses[i].code = JBW_OK;
+      if (i < statuses.value)
+        JBW_SetJBWStatusFromStatus(&agentStatuses[i], statuses.key[i]);
+      else agentStatuses[i].code = JBW_CLIENT_PARSE_MESSAGE_ERROR;
+    }
+    free(statuses.key);
+  }
+}
+
+
+void simulatorEnqueueActions(
+  void* simulatorHandle,
+  void* clientHandle,
+  uint64_t agentId,
+  const AgentAction* actions,
+  unsigned int numActions,
+  bool notifyWhenDrained,
+  JBW_Status* status
+) {
+  action* queue = (action*) malloc(max((size_t) 1, sizeof(action) * numActions));
+  if (queue == nullptr) {
+    status->code = JBW_OUT_OF_MEMORY;
+    return;
+  }
+  for (unsigned int i = 0; i < numActions; i++)
+    queue[i] = to_action(actions[i]);
+
+  if (clientHandle == nullptr) {
+    /* the simulation is local, so call enqueue_actions directly */
+    simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
+    auto result = sim_handle->enqueue_actions(agentId, queue, numActions, notifyWhenDrained);
+    free(queue);
+    if (result != status::OK) {
+      JBW_SetJBWStatusFromStatus(status, result);
+      return;
+    }
+  } else {
+    /* this is a client, so send an enqueue_actions message to the server */
+    client<client_data>* client_handle = (client<client_data>*) clientHandle;
+    if (!client_handle->client_running) {
+      free(queue);
+      status->code = JBW_LOST_CONNECTION;
+      return;
+    }
+
+    client_handle->data.waiting_for_server = true;
+    if (!send_enqueue_actions(*client_handle, agentId, queue, numActions, notifyWhenDrained)) {
+      free(queue);
+      status->code = JBW_MPI_ERROR;
+      return;
+    }
+    free(queue);
+
+    /* wait for response from server */
+    wait_for_server(*client_handle);
+
+    if (client_handle->data.server_response != status::OK) {
+      JBW_SetJBWStatusFromStatus(status, client_handle->data.server_response);
+      return;
+    }
+  }
+}
+
+
+void simulatorAdvance(
+  void* simulatorHandle,
+  unsigned int numSteps,
+  AdvancePolicy policy
+) {
+  simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
+  sim_handle->advance(numSteps, policy == AdvancePolicyQueuedActions
+      ? advance_policy::QUEUED_ACTIONS : advance_policy::NO_OP);
+}
+
+
 void simulatorSetActive(
   void* simulatorHandle,
   void* clientHandle,
@@ -1880,13 +2331,20 @@ bool simulatorIsActive(
 }
 
 
-const SimulationMap simulatorMap(
+/**
+ * Retrieves the map for `simulatorMap` and `simulatorMapSince`. If `since`
+ * is `false`, every patch in the region is retrieved, and otherwise only the
+ * patches that changed after `sinceTime`.
+ */
+inline SimulationMap get_map(
   void* simulatorHandle,
   void* clientHandle,
   Position bottomLeftCorner,
   Position topRightCorner,
   bool getScentMap,
   bool getVisionMap,
+  bool since,
+  uint64_t sinceTime,
   JBW_Status* status
 ) {
   position bottom_left = position(bottomLeftCorner.x, bottomLeftCorner.y);
@@ -1895,18 +2353,19 @@ const SimulationMap simulatorMap(
     /* the simulation is local, so call get_map directly */
     simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
     array<array<patch_state>> patches(16);
+    uint64_t min_modified_time = (since ? sinceTime + 1 : 0);
     jbw::status result;
     if (getScentMap) {
       if (getVisionMap) {
-        result = sim_handle->get_map<true, true>(bottom_left, top_right, patches);
+        result = sim_handle->get_map<true, true>(bottom_left, top_right, patches, min_modified_time);
       } else {
-        result = sim_handle->get_map<true, false>(bottom_left, top_right, patches);
+        result = sim_handle->get_map<true, false>(bottom_left, top_right, patches, min_modified_time);
       }
     } else {
       if (getVisionMap) {
-        result = sim_handle->get_map<false, true>(bottom_left, top_right, patches);
+        result = sim_handle->get_map<false, true>(bottom_left, top_right, patches, min_modified_time);
       } else {
-        result = sim_handle->get_map<false, false>(bottom_left, top_right, patches);
+        result = sim_handle->get_map<false, false>(bottom_left, top_right, patches, min_modified_time);
       }
     }
     if (result != status::OK) {
@@ -1933,7 +2392,10 @@ const SimulationMap simulatorMap(
     }
 
     client_handle->data.waiting_for_server = true;
-    if (!send_get_map(*client_handle, bottom_left, top_right, getScentMap, getVisionMap)) {
+    bool sent = since
+        ? send_get_map_since(*client_handle, bottom_left, top_right, sinceTime, getScentMap, getVisionMap)
+        : send_get_map(*client_handle, bottom_left, top_right, getScentMap, getVisionMap);
+    if (!sent) {
       status->code = JBW_MPI_ERROR;
       return EMPTY_SIM_MAP;
     }
@@ -1960,6 +2422,101 @@ const SimulationMap simulatorMap(
 }
 
 
+const SimulationMap simulatorMap(
+  void* simulatorHandle,
+  void* clientHandle,
+  Position bottomLeftCorner,
+  Position topRightCorner,
+  bool getScentMap,
+  bool getVisionMap,
+  JBW_Status* status
+) {
+  return get_map(simulatorHandle, clientHandle, bottomLeftCorner,
+      topRightCorner, getScentMap, getVisionMap, false, 0, status);
+}
+
+
+const SimulationMap simulatorMapSince(
+  void* simulatorHandle,
+  void* clientHandle,
+  Position bottomLeftCorner,
+  Position topRightCorner,
+  uint64_t sinceTime,
+  bool getScentMap,
+  bool getVisionMap,
+  JBW_Status* status
+) {
+  return get_map(simulatorHandle, clientHandle, bottomLeftCorner,
+      topRightCorner, getScentMap, getVisionMap, true, sinceTime, status);
+}
+
+
+const SimulationMapSummary simulatorMapSummary(
+  void* simulatorHandle,
+  void* clientHandle,
+  Position bottomLeftCorner,
+  Position topRightCorner,
+  unsigned int blockSize,
+  JBW_Status* status
+) {
+  position bottom_left = position(bottomLeftCorner.x, bottomLeftCorner.y);
+  position top_right = position(topRightCorner.x, topRightCorner.y);
+  if (clientHandle == nullptr) {
+    /* the simulation is local, so call get_map_summary directly */
+    simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
+    array<array<patch_summary>> blocks(16);
+    SimulationMapSummary summary = EMPTY_SIM_MAP_SUMMARY;
+    jbw::status result = sim_handle->get_map_summary(bottom_left, top_right, blockSize, blocks);
+    if (result != status::OK) {
+      JBW_SetJBWStatusFromStatus(status, result);
+    } else {
+      init(summary, blocks, sim_handle->get_config(), status);
+      if (status->code != JBW_OK)
+        summary = EMPTY_SIM_MAP_SUMMARY;
+    }
+    for (array<patch_summary>& row : blocks) {
+      for (patch_summary& block : row)
+        free(block);
+      free(row);
+    }
+    return summary;
+  } else {
+    /* this is a client, so send a get_map_summary message to the server */
+    client<client_data>* client_handle = (client<client_data>*) clientHandle;
+    if (!client_handle->client_running) {
+      status->code = JBW_LOST_CONNECTION;
+      return EMPTY_SIM_MAP_SUMMARY;
+    }
+
+    client_handle->data.waiting_for_server = true;
+    if (!send_get_map_summary(*client_handle, bottom_left, top_right, blockSize)) {
+      status->code = JBW_MPI_ERROR;
+      return EMPTY_SIM_MAP_SUMMARY;
+    }
+
+    /* wait for response from server */
+    wait_for_server(*client_handle);
+    if (client_handle->data.server_response != status::OK) {
+      JBW_SetJBWStatusFromStatus(status, client_handle->data.server_response);
+      return EMPTY_SIM_MAP_SUMMARY;
+    }
+    array<array<patch_summary>>& blocks = *client_handle->data.response_data.map_summary;
+    SimulationMapSummary summary;
+    init(summary, blocks, client_handle->config, status);
+    if (status->code != JBW_OK)
+      summary = EMPTY_SIM_MAP_SUMMARY;
+    for (array<patch_summary>& row : blocks) {
+      for (patch_summary& block : row)
+        free(block);
+      free(row);
+    }
+    free(blocks);
+    free(client_handle->data.response_data.map_summary);
+    return summary;
+  }
+}
+
+
 const AgentIDList simulatorAgentIds(
   void* simulatorHandle,
   void* clientHandle,
@@ -2021,21 +2578,19 @@ const AgentSimulationState* simulatorAgentStates(
   if (clientHandle == nullptr) {
     /* the simulation is local, so call get_agent_ids directly */
     simulator<simulator_data>* sim_handle = (simulator<simulator_data>*) simulatorHandle;
-    agent_state** agent_states = (agent_state**) malloc(
+    const agent_state** agent_states = (const agent_state**) malloc(
       max((size_t) 1, sizeof(agent_state*) * numAgents));
     if (agent_states == nullptr) {
       status->code = JBW_OUT_OF_MEMORY;
       return nullptr;
     }
-    sim_handle->get_agent_states(agent_states, agentIds, numAgents);
+    const observation_snapshot& snapshot = sim_handle->get_agent_states(agent_states, agentIds, numAgents);
 
     AgentSimulationState* agent_simulation_states = (AgentSimulationState*) malloc(
       max((size_t) 1, sizeof(AgentSimulationState) * numAgents));
     if (agent_simulation_states == nullptr) {
       status->code = JBW_OUT_OF_MEMORY;
-      for (size_t i = 0; i < numAgents; i++)
-        if (agent_states[i] != nullptr)
-          agent_states[i]->lock.unlock();
+      sim_handle->release_snapshot(snapshot);
       free(agent_states);
       return nullptr;
     }
@@ -2048,15 +2603,15 @@ const AgentSimulationState* simulatorAgentStates(
         if (status->code != JBW_OK) {
           for (size_t j = 0; j < i; j++)
             free(agent_simulation_states[j]);
-          for (size_t j = i; j < numAgents; j++)
-            agent_states[j]->lock.unlock();
+          sim_handle->release_snapshot(snapshot);
           free(agent_simulation_states);
           free(agent_states);
           return nullptr;
         }
-        agent_states[i]->lock.unlock();
       }
     }
+    sim_handle->release_snapshot(snapshot);
+    free(agent_states);
     return agent_simulation_states;
   } else {
     /* this is a client, so send a get_agent_states message to the server */
@@ -2122,6 +2677,7 @@ const AgentSimulationState* simulatorAgentStates(
 void* simulationServerStart(
   void* simulatorHandle,
   unsigned int port,
+  const char* localSocketPath,
   unsigned int connectionQueueCapacity,
   unsigned int numWorkers,
   Permissions perms,
@@ -2131,7 +2687,7 @@ void* simulationServerStart(
   async_server& server = sim_handle->get_data().server;
   if (!init_server(
     server, *sim_handle, (uint16_t) port, connectionQueueCapacity,
-    numWorkers, to_permissions(perms))
+    numWorkers, to_permissions(perms), localSocketPath)
   ) {
     status->code = JBW_MPI_ERROR;
     return nullptr;
@@ -2317,6 +2873,12 @@ void simulatorDeleteSimulationMap(SimulationMap map) {
   free(map.patches);
 }
 
+void simulatorDeleteSimulationMapSummary(SimulationMapSummary summary) {
+  for (unsigned int i = 0; i < summary.numBlocks; i++)
+    free(summary.blocks[i]);
+  free(summary.blocks);
+}
+
 void simulatorDeleteAgentIDList(AgentIDList list) {
   free(list.agentIds);
 }
@@ -16,6 +16,7 @@ from distutils.core import setup, Extension
 from distutils.command.build_ext import build_ext
 from os import environ
 import numpy as np
+import sys
 
 extra_compile_args = {
     'msvc' : ['/W3', '/GT', '/Gy', '/Oi', '/Ox', '/Ot', '/Oy', '/DNDEBUG', '/DUNICODE'],
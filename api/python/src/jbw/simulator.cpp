@@ -138,9 +138,11 @@ struct py_client_data {
         PyObject* agent_state;
         uint64_t semaphore_id;
         array<array<patch_state>>* map;
+        array<array<patch_summary>>* map_summary;
         pair<uint64_t*, size_t> agent_ids;
         agent_state_array agent_states;
         semaphore_array semaphores;
+        pair<status*, size_t> action_statuses;
     } response_data;
 
     /* for synchronization */
@@ -194,6 +196,52 @@ static pair<float*, Py_ssize_t> PyArg_ParseFloatList(PyObject* arg, Py_ssize_t s
     return make_pair(items, len - start);
 }
 
+/* the name of the capsules that keep shared observation slots retained */
+static const char* SHARED_SLOT_CAPSULE_NAME = "jbw.shared_slot";
+
+/**
+ * A slot of shared observations that is retained by the numpy views of it.
+ */
+struct py_shared_slot {
+    shared_mapping* mapping;
+    unsigned int slot;
+};
+
+/**
+ * The destructor of the capsule that is the base object of the views of a
+ * shared observation slot, which releases the slot (and unmaps it, if the
+ * client and every other view are gone) once the last view is deleted.
+ */
+static void release_py_shared_slot(PyObject* capsule) {
+    py_shared_slot* shared_slot = (py_shared_slot*) PyCapsule_GetPointer(capsule, SHARED_SLOT_CAPSULE_NAME);
+    if (shared_slot == NULL) return;
+    release_slot(shared_slot->mapping, shared_slot->slot);
+    free(shared_slot);
+}
+
+/**
+ * Retains the slot with the given `index` of `mapping` and returns a capsule
+ * that releases it when it is deleted.
+ *
+ * \returns The new capsule, if successful; `NULL` otherwise.
+ */
+static PyObject* build_py_shared_slot(shared_mapping& mapping, unsigned int index) {
+    py_shared_slot* shared_slot = (py_shared_slot*) malloc(sizeof(py_shared_slot));
+    if (shared_slot == NULL) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    retain_slot(mapping, index);
+    shared_slot->mapping = &mapping;
+    shared_slot->slot = index;
+    PyObject* capsule = PyCapsule_New(shared_slot, SHARED_SLOT_CAPSULE_NAME, release_py_shared_slot);
+    if (capsule == NULL) {
+        release_slot(&mapping, index);
+        free(shared_slot);
+    }
+    return capsule;
+}
+
 /**
  * Constructs the Python objects `py_position`, `py_scent`, `py_vision`, and
  * `py_items` and stores the state of the given `agent`.
@@ -213,6 +261,14 @@ static pair<float*, Py_ssize_t> PyArg_ParseFloatList(PyObject* arg, Py_ssize_t s
  * \param   py_items    The output numpy array of type uint64 that will contain
  *                      the counts of the collected items. This array is
  *                      parallel to the array of `item_types` in `config`.
+ * \param   mapping     If not `NULL`, the scent and vision of `agent` are in
+ *                      the slot with index `slot` of this shared memory
+ *                      mapping, and `py_scent` and `py_vision` are read-only
+ *                      views of them rather than copies. The views retain
+ *                      the slot, so that the server does not overwrite it,
+ *                      until both of them are deleted.
+ * \param   slot        The index of the slot containing the scent and vision
+ *                      of `agent`, if `mapping` is not `NULL`.
  * \returns `true` if successful; and `false` otherwise. Upon failure,
  *          `py_position`, `py_scent`, `py_vision`, and `py_items` are
  *          uninitialized.
@@ -224,37 +280,54 @@ static inline bool build_py_agent(
         PyObject*& py_direction,
         PyArrayObject*& py_scent,
         PyArrayObject*& py_vision,
-        PyArrayObject*& py_items)
+        PyArrayObject*& py_items,
+        shared_mapping* mapping = NULL,
+        unsigned int slot = 0)
 {
+    bool share_observations = (mapping != NULL);
+    PyObject* py_slot = NULL;
+    if (share_observations) {
+        py_slot = build_py_shared_slot(*mapping, slot);
+        if (py_slot == NULL) return false;
+    }
+
     /* first copy all arrays in 'agent' */
     int64_t* positions = (int64_t*) malloc(sizeof(int64_t) * 2);
     if (positions == NULL) {
-        PyErr_NoMemory();
-        return false;
-    }
-    float* scent = (float*) malloc(sizeof(float) * config.scent_dimension);
-    if (scent == NULL) {
-        PyErr_NoMemory(); free(positions);
+        PyErr_NoMemory(); Py_XDECREF(py_slot);
         return false;
     }
+    float* scent = agent.current_scent;
+    float* vision = agent.current_vision;
     unsigned int vision_size = (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension;
-    float* vision = (float*) malloc(sizeof(float) * vision_size);
-    if (vision == NULL) {
-        PyErr_NoMemory(); free(positions); free(scent);
-        return false;
+    if (!share_observations) {
+        scent = (float*) malloc(sizeof(float) * config.scent_dimension);
+        if (scent == NULL) {
+            PyErr_NoMemory(); free(positions);
+            return false;
+        }
+        vision = (float*) malloc(sizeof(float) * vision_size);
+        if (vision == NULL) {
+            PyErr_NoMemory(); free(positions); free(scent);
+            return false;
+        }
     }
     uint64_t* items = (uint64_t*) malloc(sizeof(uint64_t) * config.item_types.length);
     if (items == NULL) {
-        PyErr_NoMemory(); free(positions); free(scent); free(vision);
+        PyErr_NoMemory(); free(positions);
+        if (!share_observations) { free(scent); free(vision); }
+        Py_XDECREF(py_slot);
         return false;
     }
 
     positions[0] = agent.current_position.x;
     positions[1] = agent.current_position.y;
-    for (unsigned int i = 0; i < config.scent_dimension; i++)
-        scent[i] = agent.current_scent[i];
-    for (unsigned int i = 0; i < vision_size; i++)
-        vision[i] = agent.current_vision[i];
+    if (!share_observations) {
+        for (unsigned int i = 0; i < config.scent_dimension; i++)
+            scent[i] = agent.current_scent[i];
+        for (unsigned int i = 0; i < vision_size; i++)
+            vision[i] = agent.current_vision[i];
+    }
     for (unsigned int i = 0; i < config.item_types.length; i++)
         items[i] = agent.collected_items[i];
 
@@ -271,8 +344,18 @@ static inline bool build_py_agent(
     py_vision = (PyArrayObject*) PyArray_SimpleNewFromData(3, vision_dim, NPY_FLOAT, vision);
     py_items = (PyArrayObject*) PyArray_SimpleNewFromData(1, items_dim, NPY_UINT64, items);
     PyArray_ENABLEFLAGS(py_position, NPY_ARRAY_OWNDATA);
-    PyArray_ENABLEFLAGS(py_scent, NPY_ARRAY_OWNDATA);
-    PyArray_ENABLEFLAGS(py_vision, NPY_ARRAY_OWNDATA);
+    if (share_observations) {
+        /* both views own a reference to the capsule, since
+           `PyArray_SetBaseObject` steals one */
+        PyArray_CLEARFLAGS(py_scent, NPY_ARRAY_WRITEABLE);
+        PyArray_CLEARFLAGS(py_vision, NPY_ARRAY_WRITEABLE);
+        Py_INCREF(py_slot);
+        PyArray_SetBaseObject(py_scent, py_slot);
+        PyArray_SetBaseObject(py_vision, py_slot);
+    } else {
+        PyArray_ENABLEFLAGS(py_scent, NPY_ARRAY_OWNDATA);
+        PyArray_ENABLEFLAGS(py_vision, NPY_ARRAY_OWNDATA);
+    }
     PyArray_ENABLEFLAGS(py_items, NPY_ARRAY_OWNDATA);
     return true;
 }
@@ -285,17 +368,25 @@ static inline bool build_py_agent(
  * \param   agent    The agent whose state to copy into the Python objects.
  * \param   config   The configuration of the simulator containing `agent`.
  * \param   agent_id The ID of `agent` in the simulator.
+ * \param   mapping  If not `NULL`, the scent and vision of `agent` are in the
+ *                   slot with index `slot` of this shared memory mapping, and
+ *                   the scent and vision in the tuple are read-only views of
+ *                   them rather than copies.
+ * \param   slot     The index of the slot containing the scent and vision of
+ *                   `agent`, if `mapping` is not `NULL`.
  * \returns A pointer to the constructed Python tuple, if successful; `NULL`
  *          otherwise.
  */
 static PyObject* build_py_agent(
         const agent_state& agent,
         const simulator_config& config,
-        uint64_t agent_id)
+        uint64_t agent_id,
+        shared_mapping* mapping = NULL,
+        unsigned int slot = 0)
 {
     PyArrayObject* py_position; PyObject* py_direction;
     PyArrayObject* py_scent; PyArrayObject* py_vision; PyArrayObject* py_items;
-    if (!build_py_agent(agent, config, py_position, py_direction, py_scent, py_vision, py_items))
+    if (!build_py_agent(agent, config, py_position, py_direction, py_scent, py_vision, py_items, mapping, slot))
         return NULL;
     PyObject* py_agent_id = PyLong_FromUnsignedLongLong(agent_id);
     PyObject* py_agent = Py_BuildValue("(OOOOOO)", py_position, py_direction, py_scent, py_vision, py_items, py_agent_id);
@@ -328,15 +419,24 @@ void on_step(simulator<py_simulator_data>* sim,
 
     PyGILState_STATE gstate;
     gstate = PyGILState_Ensure(); /* acquire global interpreter lock */
-    PyObject* py_states = PyList_New(data.agent_ids.length);
+    /* with asynchronous step notifications, `agents` may predate some of the agents in `data.agent_ids` */
+    size_t agent_count = 0;
+    for (size_t i = 0; i < data.agent_ids.length; i++)
+        if (agents.table.contains(data.agent_ids[i])) agent_count++;
+    PyObject* py_states = PyList_New(agent_count);
     if (py_states == NULL) {
         fprintf(stderr, "on_step ERROR: PyList_New returned NULL.\n");
         PyGILState_Release(gstate); /* release global interpreter lock */
         return;
     }
     const simulator_config& config = sim->get_config();
-    for (size_t i = 0; i < data.agent_ids.length; i++)
-        PyList_SetItem(py_states, i, build_py_agent(*agents.get(data.agent_ids[i]), config, data.agent_ids[i]));
+    size_t index = 0;
+    for (size_t i = 0; i < data.agent_ids.length; i++) {
+        bool contains;
+        const agent_state* agent = agents.get(data.agent_ids[i], contains);
+        if (!contains) continue;
+        PyList_SetItem(py_states, index++, build_py_agent(*agent, config, data.agent_ids[i]));
+    }
 
     /* call python callback */
     PyObject* args = Py_BuildValue("(O)", py_states);
@@ -621,6 +721,31 @@ void on_get_map(client<py_client_data>& c,
     c.data.cv.notify_one();
 }
 
+/**
+ * The callback invoked when the client receives a get_map_summary response
+ * from the server. This function moves the result into
+ * `c.data.response_data.map_summary` and wakes up the Python thread (which
+ * should be waiting in the `simulator_map_summary` function) so that it can
+ * return the response back to Python.
+ *
+ * \param   c        The client that received the response.
+ * \param   response The response from the server, containing information about
+ *                   any errors.
+ * \param   blocks   An array of array of `patch_summary` structures containing
+ *                   the summary of each block of patches.
+ */
+void on_get_map_summary(client<py_client_data>& c,
+        status response,
+        array<array<patch_summary>>* blocks)
+{
+    check_response(response, "get_map_summary: ");
+    std::unique_lock<std::mutex> lck(c.data.lock);
+    c.data.waiting_for_server = false;
+    c.data.response_data.map_summary = blocks;
+    c.data.server_response = response;
+    c.data.cv.notify_one();
+}
+
 /**
  * The callback invoked when the client receives a get_agent_ids response from
  * the server. This function moves the result into
@@ -694,6 +819,25 @@ void on_set_active(client<py_client_data>& c, uint64_t agent_id, status response
     c.data.cv.notify_one();
 }
 
+/**
+ * The callback invoked when the client receives an enable_shared_observations
+ * response from the server. This function wakes up the Python thread (which
+ * should be waiting in the `simulator_enable_shared_observations` function) so
+ * that it can return the response back to Python.
+ *
+ * \param   c        The client that received the response.
+ * \param   response The response from the server, containing information about
+ *                   any errors.
+ */
+void on_enable_shared_observations(client<py_client_data>& c, status response)
+{
+    check_response(response, "enable_shared_observations: ");
+    std::unique_lock<std::mutex> lck(c.data.lock);
+    c.data.waiting_for_server = false;
+    c.data.server_response = response;
+    c.data.cv.notify_one();
+}
+
 /**
  * The callback invoked when the client receives an is_active response from the
  * server. This function moves the result into `c.data.server_response` and
@@ -717,6 +861,49 @@ void on_is_active(client<py_client_data>& c, uint64_t agent_id, status response,
     c.data.cv.notify_one();
 }
 
+/**
+ * The callback invoked when the client receives an act_batch response from
+ * the server. This function moves the per-agent statuses into
+ * `c.data.response_data.action_statuses` and wakes up the Python thread
+ * (which should be waiting in the `simulator_act_batch` function) so that it
+ * can return the response back to Python.
+ *
+ * \param   c        The client that received the response.
+ * \param   response The response from the server, containing information about
+ *                   any errors.
+ * \param   statuses The status of each submitted action.
+ * \param   count    The length of `statuses`.
+ */
+void on_act_batch(client<py_client_data>& c, status response, status* statuses, size_t count)
+{
+    check_response(response, "act_batch: ");
+    std::unique_lock<std::mutex> lck(c.data.lock);
+    c.data.waiting_for_server = false;
+    c.data.server_response = response;
+    c.data.response_data.action_statuses = make_pair(statuses, count);
+    c.data.cv.notify_one();
+}
+
+/**
+ * The callback invoked when the client receives an enqueue_actions response
+ * from the server. This function copies the result into
+ * `c.data.server_response` and wakes up the Python thread (which should be
+ * waiting in the `simulator_enqueue_actions` function) so that it can return
+ * the response back to Python.
+ *
+ * \param   c               The client that received the response.
+ * \param   agent_id        The ID of the agent whose actions were enqueued.
+ * \param   response        The response from the server, containing
+ *                          information about any errors.
+ */
+void on_enqueue_actions(client<py_client_data>& c, uint64_t agent_id, status response) {
+    check_response(response, "enqueue_actions: ");
+    std::unique_lock<std::mutex> lck(c.data.lock);
+    c.data.waiting_for_server = false;
+    c.data.server_response = response;
+    c.data.cv.notify_one();
+}
+
 /**
  * The callback invoked when the client receives a step response from the
  * server. This function constructs a Python list of agent states governed by
@@ -745,8 +932,12 @@ void on_step(client<py_client_data>& c,
         PyGILState_Release(gstate); /* release global interpreter lock */
         return;
     }
-    for (size_t i = 0; i < agent_ids.length; i++)
-        PyList_SetItem(py_states, i, build_py_agent(agent_states[i], c.config, agent_ids[i]));
+    for (size_t i = 0; i < agent_ids.length; i++) {
+        /* observations received through shared memory are not copied */
+        uint32_t slot = c.observations.slot_of(agent_states[i].current_scent, c.config);
+        shared_mapping* mapping = (slot == NO_SHARED_SLOT) ? NULL : c.observations.mapping;
+        PyList_SetItem(py_states, i, build_py_agent(agent_states[i], c.config, agent_ids[i], mapping, slot));
+    }
 
     /* invoke python callback */
     PyObject* args = Py_BuildValue("(O)", py_states);
@@ -840,6 +1031,7 @@ static inline void import_errors() {
  *                  - (int) The duration of time for which removed items are
  *                    remembered by the simulation in order to compute their
  *                    scent contribution.
+ *                  - (int) The number of threads used to advance time.
  *                  - (function) The function to invoke when the simulator
  *                    advances time.
  *
@@ -873,12 +1065,13 @@ static PyObject* simulator_new(PyObject *self, PyObject *args)
     unsigned int collision_policy;
     PyObject* py_callback;
     if (!PyArg_ParseTuple(
-      args, "IIOOOIIIIIOOIfffIO", &seed, &config.max_steps_per_movement,
+      args, "IIOOOIIIIIOOIfffIIO", &seed, &config.max_steps_per_movement,
       &py_allowed_movement_directions, &py_allowed_turn_directions, &py_no_op_allowed,
       &config.scent_dimension, &config.color_dimension, &config.vision_range,
       &config.patch_size, &config.mcmc_iterations, &py_items, &py_agent_color,
       &collision_policy, &config.agent_field_of_view, &config.decay_param,
-      &config.diffusion_param, &config.deleted_item_lifetime, &py_callback)) {
+      &config.diffusion_param, &config.deleted_item_lifetime,
+      &config.step_thread_count, &py_callback)) {
         fprintf(stderr, "Invalid argument types in the call to 'simulator_c.new'.\n");
         return NULL;
     }
@@ -1114,24 +1307,25 @@ static PyObject* simulator_load(PyObject *self, PyObject *args)
     fclose(file);
 
     /* parse the list of agent IDs from Python */
-    agent_state** agent_states = (agent_state**) malloc(sizeof(agent_state*) * agent_id_count);
+    const agent_state** agent_states = (const agent_state**) malloc(sizeof(agent_state*) * agent_id_count);
     if (agent_states == NULL) {
         PyErr_NoMemory();
         free(*sim); free(sim); fclose(file); return NULL;
     }
 
-    sim->get_agent_states(agent_states, sim_data.agent_ids.data, (unsigned int) agent_id_count);
+    const observation_snapshot& snapshot = sim->get_agent_states(
+            agent_states, sim_data.agent_ids.data, (unsigned int) agent_id_count);
 
     const simulator_config& config = sim->get_config();
     PyObject* py_states = PyList_New((Py_ssize_t) agent_id_count);
     if (py_states == NULL) {
+        sim->release_snapshot(snapshot);
         free(agent_states); free(*sim);
         free(sim); fclose(file); return NULL;
     }
-    for (size_t i = 0; i < agent_id_count; i++) {
+    for (size_t i = 0; i < agent_id_count; i++)
         PyList_SetItem(py_states, (Py_ssize_t) i, build_py_agent(*agent_states[i], config, sim_data.agent_ids[i]));
-        agent_states[i]->lock.unlock();
-    }
+    sim->release_snapshot(snapshot);
     free(agent_states);
 
     import_errors();
@@ -1189,6 +1383,9 @@ inline bool parse_permission(bool& permission,
  *                  - (int) Number of threads to process server messages.
  *                  - A permissions instance describing the default permissions
  *                    of new clients that connect to this server.
+ *                  - (string or None) The path of a Unix domain socket on
+ *                    which the server also listens, for clients on the same
+ *                    host, or None.
  * \returns Handle to the simulator server.
  */
 static PyObject* simulator_start_server(PyObject *self, PyObject *args)
@@ -1198,7 +1395,8 @@ static PyObject* simulator_start_server(PyObject *self, PyObject *args)
     unsigned int connection_queue_capacity;
     unsigned int num_workers;
     PyObject* py_permissions;
-    if (!PyArg_ParseTuple(args, "OIIIO", &py_sim_handle, &port, &connection_queue_capacity, &num_workers, &py_permissions)) {
+    const char* local_socket_path;
+    if (!PyArg_ParseTuple(args, "OIIIOz", &py_sim_handle, &port, &connection_queue_capacity, &num_workers, &py_permissions, &local_socket_path)) {
         fprintf(stderr, "Invalid argument types in the call to 'simulator_c.start_server'.\n");
         return NULL;
     }
@@ -1218,7 +1416,7 @@ static PyObject* simulator_start_server(PyObject *self, PyObject *args)
     simulator<py_simulator_data>* sim_handle =
             (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
     async_server& server = sim_handle->get_data().server;
-    if (!init_server(server, *sim_handle, (uint16_t) port, connection_queue_capacity, num_workers, perms)) {
+    if (!init_server(server, *sim_handle, (uint16_t) port, connection_queue_capacity, num_workers, perms, local_socket_path)) {
         PyErr_SetString(PyExc_RuntimeError, "Unable to initialize MPI server.");
         return NULL;
     }
@@ -1251,7 +1449,8 @@ static PyObject* simulator_stop_server(PyObject *self, PyObject *args)
  *
  * \param   self    Pointer to the Python object calling this method.
  * \param   args    Arguments:
- *                  - (string) The server address.
+ *                  - (string) The server address, or `unix:<path>` to
+ *                    connect through a Unix domain socket.
  *                  - (int) The server port.
  *                  - (function) The Python function to invoke whenever the
  *                    simulator advances time.
@@ -1311,7 +1510,8 @@ static PyObject* simulator_connect_client(PyObject *self, PyObject *args)
  *
  * \param   self    Pointer to the Python object calling this method.
  * \param   args    Arguments:
- *                  - (string) The server address.
+ *                  - (string) The server address, or `unix:<path>` to
+ *                    connect through a Unix domain socket.
  *                  - (int) The server port.
  *                  - (function) The Python function to invoke whenever the
  *                    simulator advances time.
@@ -2088,6 +2288,251 @@ static PyObject* simulator_no_op(PyObject *self, PyObject *args) {
     }
 }
 
+/**
+ * Submits an action for each agent in a batch. If the simulation is local,
+ * the whole batch is applied under a single acquisition of the simulator lock
+ * and the simulator advances at most once. Otherwise, the whole batch is sent
+ * to the server in a single message.
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native simulator object as a PyLong.
+ *                  - Handle to the native client object as a PyLong. If this
+ *                    is None, `act_batch` is directly invoked on the
+ *                    simulator object. Otherwise, the client sends an
+ *                    act_batch message to the server and waits for its
+ *                    response.
+ *                  - (list of ints) A list of agent IDs.
+ *                  - (list of tuples) A list, parallel to the agent IDs, of
+ *                    actions, each encoded as a tuple of three integers: the
+ *                    action type (MOVE = 0, TURN = 1, NO_OP = 2), the
+ *                    direction, and the number of steps.
+ * \returns A Python list of booleans, parallel to the given list of IDs,
+ *          where each element is `True` if the corresponding action was
+ *          successfully queued, and `False` otherwise.
+ */
+static PyObject* simulator_act_batch(PyObject *self, PyObject *args) {
+    PyObject* py_sim_handle;
+    PyObject* py_client_handle;
+    PyObject* py_agent_ids;
+    PyObject* py_actions;
+    if (!PyArg_ParseTuple(args, "OOOO", &py_sim_handle, &py_client_handle, &py_agent_ids, &py_actions))
+        return NULL;
+    if (!PyList_Check(py_agent_ids) || !PyList_Check(py_actions)) {
+        PyErr_SetString(PyExc_TypeError, "'agent_ids' and 'actions' must be lists.\n");
+        return NULL;
+    } else if (PyList_Size(py_agent_ids) != PyList_Size(py_actions)) {
+        PyErr_SetString(PyExc_ValueError, "'agent_ids' and 'actions' must have the same length.\n");
+        return NULL;
+    }
+
+    size_t action_count = (size_t) PyList_Size(py_agent_ids);
+    uint64_t* agent_ids = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * action_count));
+    action* actions = (action*) malloc(max((size_t) 1, sizeof(action) * action_count));
+    if (agent_ids == nullptr || actions == nullptr) {
+        if (agent_ids != nullptr) free(agent_ids);
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (size_t i = 0; i < action_count; i++) {
+        unsigned int type, dir, num_steps;
+        agent_ids[i] = PyLong_AsUnsignedLongLong(PyList_GetItem(py_agent_ids, i));
+        if (!PyArg_ParseTuple(PyList_GetItem(py_actions, i), "III", &type, &dir, &num_steps)) {
+            free(agent_ids); free(actions);
+            return NULL;
+        }
+        actions[i].type = (action_type) type;
+        actions[i].dir = (direction) dir;
+        actions[i].num_steps = num_steps;
+    }
+
+    status* statuses;
+    if (py_client_handle == Py_None) {
+        /* the simulation is local, so call act_batch directly */
+        simulator<py_simulator_data>* sim_handle =
+                (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
+        statuses = (status*) malloc(max((size_t) 1, sizeof(status) * action_count));
+        if (statuses == nullptr) {
+            free(agent_ids); free(actions);
+            PyErr_NoMemory();
+            return NULL;
+        }
+
+        /* release the global interpreter lock */
+        PyThreadState* python_thread = PyEval_SaveThread();
+        sim_handle->act_batch(agent_ids, actions, action_count, statuses);
+
+        /* re-acquire the global interpreter lock */
+        PyEval_RestoreThread(python_thread);
+        free(agent_ids); free(actions);
+    } else {
+        /* this is a client, so send an act_batch message to the server */
+        client<py_client_data>* client_handle =
+                (client<py_client_data>*) PyLong_AsVoidPtr(py_client_handle);
+        if (!client_handle->client_running) {
+            PyErr_SetString(mpi_error, "Connection to the server was lost.");
+            free(agent_ids); free(actions);
+            return NULL;
+        }
+
+        client_handle->data.waiting_for_server = true;
+        if (!send_act_batch(*client_handle, agent_ids, actions, action_count)) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to send act_batch request.");
+            free(agent_ids); free(actions);
+            return NULL;
+        }
+        free(agent_ids); free(actions);
+
+        /* wait for response from server */
+        wait_for_server(*client_handle);
+        if (client_handle->data.server_response != status::OK) {
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+        statuses = client_handle->data.response_data.action_statuses.key;
+        if (client_handle->data.response_data.action_statuses.value != action_count) {
+            PyErr_SetString(mpi_error, "act_batch: Server returned the wrong number of statuses.");
+            free(statuses);
+            return NULL;
+        }
+    }
+
+    PyObject* py_results = PyList_New(action_count);
+    if (py_results == NULL) {
+        fprintf(stderr, "simulator_act_batch ERROR: PyList_New returned NULL.\n");
+        free(statuses);
+        return NULL;
+    }
+    for (size_t i = 0; i < action_count; i++) {
+        PyObject* py_result = ((statuses[i] == status::OK) ? Py_True : Py_False);
+        Py_INCREF(py_result);
+        PyList_SetItem(py_results, i, py_result);
+    }
+    free(statuses);
+    return py_results;
+}
+
+/**
+ * Appends a sequence of actions to the action queue of an agent. The
+ * simulator performs one queued action per turn on behalf of the agent.
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native simulator object as a PyLong.
+ *                  - Handle to the native client object as a PyLong. If this
+ *                    is None, `enqueue_actions` is directly invoked on the
+ *                    simulator object. Otherwise, the client sends an
+ *                    enqueue_actions message to the server and waits for its
+ *                    response.
+ *                  - (int) The ID of the agent.
+ *                  - (list of tuples) The actions to enqueue, each encoded
+ *                    as in `simulator_act_batch`.
+ *                  - (bool) Whether the agent's state should report the time
+ *                    step in which the last queued action is performed.
+ * \returns `True` if the actions were successfully enqueued, and `False`
+ *          otherwise.
+ */
+static PyObject* simulator_enqueue_actions(PyObject *self, PyObject *args) {
+    PyObject* py_sim_handle;
+    PyObject* py_client_handle;
+    unsigned long long agent_id;
+    PyObject* py_actions;
+    int notify_when_drained;
+    if (!PyArg_ParseTuple(args, "OOKOp", &py_sim_handle, &py_client_handle, &agent_id, &py_actions, &notify_when_drained))
+        return NULL;
+    if (!PyList_Check(py_actions)) {
+        PyErr_SetString(PyExc_TypeError, "'actions' must be a list.\n");
+        return NULL;
+    }
+
+    unsigned int action_count = (unsigned int) PyList_Size(py_actions);
+    action* actions = (action*) malloc(max((size_t) 1, sizeof(action) * action_count));
+    if (actions == nullptr) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (unsigned int i = 0; i < action_count; i++) {
+        unsigned int type, dir, num_steps;
+        if (!PyArg_ParseTuple(PyList_GetItem(py_actions, i), "III", &type, &dir, &num_steps)) {
+            free(actions);
+            return NULL;
+        }
+        actions[i].type = (action_type) type;
+        actions[i].dir = (direction) dir;
+        actions[i].num_steps = num_steps;
+    }
+
+    status response;
+    if (py_client_handle == Py_None) {
+        /* the simulation is local, so call enqueue_actions directly */
+        simulator<py_simulator_data>* sim_handle =
+                (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
+
+        /* release the global interpreter lock */
+        PyThreadState* python_thread = PyEval_SaveThread();
+        response = sim_handle->enqueue_actions(agent_id, actions, action_count, notify_when_drained);
+
+        /* re-acquire the global interpreter lock */
+        PyEval_RestoreThread(python_thread);
+        free(actions);
+    } else {
+        /* this is a client, so send an enqueue_actions message to the server */
+        client<py_client_data>* client_handle =
+                (client<py_client_data>*) PyLong_AsVoidPtr(py_client_handle);
+        if (!client_handle->client_running) {
+            PyErr_SetString(mpi_error, "Connection to the server was lost.");
+            free(actions);
+            return NULL;
+        }
+
+        client_handle->data.waiting_for_server = true;
+        if (!send_enqueue_actions(*client_handle, agent_id, actions, action_count, notify_when_drained)) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to send enqueue_actions request.");
+            free(actions);
+            return NULL;
+        }
+        free(actions);
+
+        /* wait for response from server */
+        wait_for_server(*client_handle);
+        response = client_handle->data.server_response;
+    }
+
+    PyObject* result = (response == status::OK ? Py_True : Py_False);
+    Py_INCREF(result);
+    return result;
+}
+
+/**
+ * Advances the simulation by a number of time steps without waiting for
+ * agents to act, computing observations and invoking the step callback only
+ * for the last time step. This is only supported for local simulators.
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native simulator object as a PyLong.
+ *                  - (int) The number of time steps to advance.
+ *                  - (int) The policy for agents that have not acted
+ *                    (NO_OP = 0, QUEUED_ACTIONS = 1).
+ */
+static PyObject* simulator_advance(PyObject *self, PyObject *args) {
+    PyObject* py_sim_handle;
+    unsigned int num_steps, policy;
+    if (!PyArg_ParseTuple(args, "OII", &py_sim_handle, &num_steps, &policy))
+        return NULL;
+    simulator<py_simulator_data>* sim_handle =
+            (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
+
+    /* release the global interpreter lock */
+    PyThreadState* python_thread = PyEval_SaveThread();
+    sim_handle->advance(num_steps, (advance_policy) policy);
+
+    /* re-acquire the global interpreter lock */
+    PyEval_RestoreThread(python_thread);
+    Py_INCREF(Py_None);
+    return Py_None;
+}
+
 /**
  * Constructs a Python list containing tuples, where each tuple contains the
  * state information of a patch in the given hash_map of patches.
@@ -2193,6 +2638,11 @@ static PyObject* build_py_map(
  *                    box containing the patches to retrieve.
  *                  - (tuple of 2 ints) The top-right corner of the bounding
  *                    box containing the patches to retrieve.
+ *                  - (bool) Whether to retrieve the scent of each patch.
+ *                  - (bool) Whether to retrieve the vision of each patch.
+ *                  - (optional int) If given, only the patches that changed
+ *                    after this time are retrieved (see
+ *                    `simulator::get_map_since`).
  * \returns A Python list of tuples, where each tuple contains the state
  *          information of a patch within the bounding box. See `build_py_map`
  *          for details on the contents of each tuple. If an error occurs, None
@@ -2205,30 +2655,38 @@ static PyObject* simulator_map(PyObject *self, PyObject *args) {
     int64_t py_top_right_x, py_top_right_y;
     PyObject* py_get_scent_map;
     PyObject* py_get_vision_map;
-    if (!PyArg_ParseTuple(args, "OO(LL)(LL)OO", &py_sim_handle, &py_client_handle,
+    PyObject* py_since_time = Py_None;
+    if (!PyArg_ParseTuple(args, "OO(LL)(LL)OO|O", &py_sim_handle, &py_client_handle,
             &py_bottom_left_x, &py_bottom_left_y, &py_top_right_x, &py_top_right_y,
-            &py_get_scent_map, &py_get_vision_map))
+            &py_get_scent_map, &py_get_vision_map, &py_since_time))
         return NULL;
     position bottom_left = position(py_bottom_left_x, py_bottom_left_y);
     position top_right = position(py_top_right_x, py_top_right_y);
+    bool since = (py_since_time != Py_None);
+    uint64_t since_time = 0;
+    if (since) {
+        since_time = PyLong_AsUnsignedLongLong(py_since_time);
+        if (PyErr_Occurred()) return NULL;
+    }
 
     if (py_client_handle == Py_None) {
         /* the simulation is local, so call get_map directly */
         simulator<py_simulator_data>* sim_handle =
                 (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
         array<array<patch_state>> patches(32);
+        uint64_t min_modified_time = (since ? since_time + 1 : 0);
         status result;
         if (py_get_scent_map == Py_True) {
             if (py_get_vision_map == Py_True) {
-                result = sim_handle->get_map<true, true>(bottom_left, top_right, patches);
+                result = sim_handle->get_map<true, true>(bottom_left, top_right, patches, min_modified_time);
             } else {
-                result = sim_handle->get_map<true, false>(bottom_left, top_right, patches);
+                result = sim_handle->get_map<true, false>(bottom_left, top_right, patches, min_modified_time);
             }
         } else {
             if (py_get_vision_map == Py_True) {
-                result = sim_handle->get_map<false, true>(bottom_left, top_right, patches);
+                result = sim_handle->get_map<false, true>(bottom_left, top_right, patches, min_modified_time);
             } else {
-                result = sim_handle->get_map<false, false>(bottom_left, top_right, patches);
+                result = sim_handle->get_map<false, false>(bottom_left, top_right, patches, min_modified_time);
             }
         }
         if (result != status::OK) {
@@ -2251,7 +2709,10 @@ static PyObject* simulator_map(PyObject *self, PyObject *args) {
         }
 
         client_handle->data.waiting_for_server = true;
-        if (!send_get_map(*client_handle, bottom_left, top_right, py_get_scent_map == Py_True, py_get_vision_map == Py_True)) {
+        bool sent = since
+            ? send_get_map_since(*client_handle, bottom_left, top_right, since_time, py_get_scent_map == Py_True, py_get_vision_map == Py_True)
+            : send_get_map(*client_handle, bottom_left, top_right, py_get_scent_map == Py_True, py_get_vision_map == Py_True);
+        if (!sent) {
             PyErr_SetString(PyExc_RuntimeError, "Unable to send get_map request.");
             return NULL;
         }
@@ -2273,6 +2734,202 @@ static PyObject* simulator_map(PyObject *self, PyObject *args) {
     }
 }
 
+/**
+ * Constructs a Python list containing tuples, where each tuple contains the
+ * summary of a block of patches in the given array of blocks.
+ *
+ * \param   blocks  An array of rows of `patch_summary` objects.
+ * \param   config  The configuration of the simulator in which the patches
+ *                  reside.
+ * \returns A Python list containing tuples, where each tuple corresponds to a
+ *          block in `blocks`, containing:
+ *          - (tuple of 2 ints) The block position.
+ *          - (int) The number of existing patches in the block.
+ *          - (list of ints) The number of items of each type in the block.
+ *          - (int) The number of agents in the block.
+ *          - (numpy array of floats) The average color of the cells in the
+ *            block, which has shape `(config.color_dimension,)`.
+ */
+static PyObject* build_py_map_summary(
+        const array<array<patch_summary>>& blocks,
+        const simulator_config& config)
+{
+    unsigned int block_count = 0;
+    for (const array<patch_summary>& row : blocks)
+        block_count += row.length;
+
+    unsigned int index = 0;
+    PyObject* list = PyList_New(block_count);
+    for (const array<patch_summary>& row : blocks) {
+        for (const patch_summary& block : row) {
+            PyObject* py_item_counts = PyList_New(config.item_types.length);
+            for (unsigned int i = 0; i < config.item_types.length; i++)
+                PyList_SetItem(py_item_counts, i, PyLong_FromUnsignedLong(block.item_counts[i]));
+
+            float* color = (float*) malloc(sizeof(float) * max(1u, config.color_dimension));
+            memcpy(color, block.color, sizeof(float) * config.color_dimension);
+            npy_intp color_dim[] = {(npy_intp) config.color_dimension};
+            PyArrayObject* py_color = (PyArrayObject*) PyArray_SimpleNewFromData(1, color_dim, NPY_FLOAT, color);
+            PyArray_ENABLEFLAGS(py_color, NPY_ARRAY_OWNDATA);
+
+            PyObject* py_block = Py_BuildValue("((LL)IOIO)",
+                    block.block_position.x, block.block_position.y,
+                    block.patch_count, py_item_counts, block.agent_count, py_color);
+            Py_DECREF(py_item_counts);
+            Py_DECREF(py_color);
+            PyList_SetItem(list, index, py_block);
+            index++;
+        }
+    }
+    return list;
+}
+
+/**
+ * Retrieves summaries of the blocks of patches within the specified bounding
+ * box (see `simulator::get_map_summary`).
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native simulator object as a PyLong.
+ *                  - Handle to the native client object as a PyLong. If this
+ *                    is None, `get_map_summary` is directly invoked on the
+ *                    simulator object. Otherwise, the client sends a
+ *                    get_map_summary message to the server and waits for its
+ *                    response.
+ *                  - (tuple of 2 ints) The bottom-left corner of the bounding
+ *                    box containing the patches to summarize.
+ *                  - (tuple of 2 ints) The top-right corner of the bounding
+ *                    box containing the patches to summarize.
+ *                  - (int) The width of each block, in patches.
+ * \returns A Python list of tuples, where each tuple contains the summary of
+ *          a block. See `build_py_map_summary` for details on the contents of
+ *          each tuple. If an error occurs, None is returned, instead.
+ */
+static PyObject* simulator_map_summary(PyObject *self, PyObject *args) {
+    PyObject* py_sim_handle;
+    PyObject* py_client_handle;
+    int64_t py_bottom_left_x, py_bottom_left_y;
+    int64_t py_top_right_x, py_top_right_y;
+    unsigned int block_size;
+    if (!PyArg_ParseTuple(args, "OO(LL)(LL)I", &py_sim_handle, &py_client_handle,
+            &py_bottom_left_x, &py_bottom_left_y, &py_top_right_x, &py_top_right_y, &block_size))
+        return NULL;
+    position bottom_left = position(py_bottom_left_x, py_bottom_left_y);
+    position top_right = position(py_top_right_x, py_top_right_y);
+
+    if (py_client_handle == Py_None) {
+        /* the simulation is local, so call get_map_summary directly */
+        simulator<py_simulator_data>* sim_handle =
+                (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
+        array<array<patch_summary>> blocks(32);
+        status result = sim_handle->get_map_summary(bottom_left, top_right, block_size, blocks);
+        PyObject* py_blocks = nullptr;
+        if (result == status::OK)
+            py_blocks = build_py_map_summary(blocks, sim_handle->get_config());
+        else PyErr_SetString(PyExc_RuntimeError, "simulator.get_map_summary failed.");
+        for (array<patch_summary>& row : blocks) {
+            for (patch_summary& block : row) free(block);
+            free(row);
+        }
+        return py_blocks;
+    } else {
+        /* this is a client, so send a get_map_summary message to the server */
+        client<py_client_data>* client_handle =
+                (client<py_client_data>*) PyLong_AsVoidPtr(py_client_handle);
+        if (!client_handle->client_running) {
+            PyErr_SetString(mpi_error, "Connection to the server was lost.");
+            return NULL;
+        }
+
+        client_handle->data.waiting_for_server = true;
+        if (!send_get_map_summary(*client_handle, bottom_left, top_right, block_size)) {
+            PyErr_SetString(PyExc_RuntimeError, "Unable to send get_map_summary request.");
+            return NULL;
+        }
+
+        /* wait for response from server */
+        wait_for_server(*client_handle);
+        if (client_handle->data.server_response != status::OK) {
+            Py_INCREF(Py_None);
+            return Py_None;
+        }
+        array<array<patch_summary>>& blocks = *client_handle->data.response_data.map_summary;
+        PyObject* py_blocks = build_py_map_summary(blocks, client_handle->config);
+        for (array<patch_summary>& row : blocks) {
+            for (patch_summary& block : row) free(block);
+            free(row);
+        }
+        free(blocks);
+        free(client_handle->data.response_data.map_summary);
+        return py_blocks;
+    }
+}
+
+/**
+ * Retrieves a grid of the items and agents around each of the given agents
+ * (see `simulator::get_local_maps`). This is only supported for simulators
+ * in this process.
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native simulator object as a PyLong.
+ *                  - Handle to the native client object as a PyLong, which
+ *                    must be None.
+ *                  - (list of ints) The IDs of the agents.
+ *                  - (int) The radius of each grid.
+ *                  - (bool) Whether to rotate each grid so that its agent
+ *                    faces up.
+ * \returns A numpy array of 32-bit ints with shape
+ *          `(len(agent_ids), 2*radius + 1, 2*radius + 1, 2)`, where the last
+ *          dimension contains the type of the item in each cell (or -1 if
+ *          there is none) and the number of agents in each cell.
+ */
+static PyObject* simulator_local_maps(PyObject *self, PyObject *args) {
+    PyObject* py_sim_handle;
+    PyObject* py_client_handle;
+    PyObject* py_agent_ids;
+    unsigned int radius;
+    PyObject* py_egocentric;
+    if (!PyArg_ParseTuple(args, "OOOIO", &py_sim_handle, &py_client_handle, &py_agent_ids, &radius, &py_egocentric))
+        return NULL;
+    if (!PyList_Check(py_agent_ids)) {
+        PyErr_SetString(PyExc_TypeError, "'agent_ids' must be a list.\n");
+        return NULL;
+    } else if (py_client_handle != Py_None) {
+        PyErr_SetString(PyExc_RuntimeError, "local_maps is only supported for simulators in this process.");
+        return NULL;
+    }
+
+    size_t agent_count = (size_t) PyList_Size(py_agent_ids);
+    uint64_t* agent_ids = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * agent_count));
+    if (agent_ids == nullptr) {
+        PyErr_NoMemory();
+        return NULL;
+    }
+    for (size_t i = 0; i < agent_count; i++)
+        agent_ids[i] = PyLong_AsUnsignedLongLong(PyList_GetItem(py_agent_ids, i));
+
+    npy_intp width = (npy_intp) (2*radius + 1);
+    npy_intp dims[] = {(npy_intp) agent_count, width, width, 2};
+    PyArrayObject* py_grids = (PyArrayObject*) PyArray_SimpleNew(4, dims, NPY_INT32);
+    if (py_grids == NULL) {
+        free(agent_ids);
+        return NULL;
+    }
+
+    simulator<py_simulator_data>* sim_handle =
+            (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
+    status result = sim_handle->get_local_maps(agent_ids, (unsigned int) agent_count,
+            radius, py_egocentric == Py_True, (int32_t*) PyArray_DATA(py_grids));
+    free(agent_ids);
+    if (result != status::OK) {
+        Py_DECREF(py_grids);
+        PyErr_SetString(PyExc_ValueError, "simulator.get_local_maps failed.");
+        return NULL;
+    }
+    return (PyObject*) py_grids;
+}
+
 /**
  * Retrieves a list of the IDs of all the agents in the simulation.
  *
@@ -2380,7 +3037,7 @@ static PyObject* simulator_agent_states(PyObject *self, PyObject *args) {
 
     if (py_client_handle == Py_None) {
         /* the simulation is local, so call get_agent_states directly */
-        agent_state** agent_states = (agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * agent_count));
+        const agent_state** agent_states = (const agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * agent_count));
         if (agent_states == nullptr) {
             free(agent_ids);
             PyErr_NoMemory();
@@ -2389,13 +3046,12 @@ static PyObject* simulator_agent_states(PyObject *self, PyObject *args) {
 
         simulator<py_simulator_data>* sim_handle =
                 (simulator<py_simulator_data>*) PyLong_AsVoidPtr(py_sim_handle);
-        sim_handle->get_agent_states(agent_states, agent_ids, agent_count);
+        const observation_snapshot& snapshot = sim_handle->get_agent_states(agent_states, agent_ids, agent_count);
 
         PyObject* py_states = PyList_New(agent_count);
         if (py_states == NULL) {
             fprintf(stderr, "simulator_agent_states ERROR: PyList_New returned NULL.\n");
-            for (size_t i = 0; i < agent_count; i++)
-                if (agent_states[i] != nullptr) agent_states[i]->lock.unlock();
+            sim_handle->release_snapshot(snapshot);
             free(agent_ids); free(agent_states);
             return NULL;
         }
@@ -2406,9 +3062,9 @@ static PyObject* simulator_agent_states(PyObject *self, PyObject *args) {
                 PyList_SetItem(py_states, i, Py_None);
             } else {
                 PyList_SetItem(py_states, i, build_py_agent(*agent_states[i], config, agent_ids[i]));
-                agent_states[i]->lock.unlock();
             }
         }
+        sim_handle->release_snapshot(snapshot);
         free(agent_ids);
         free(agent_states);
         return py_states;
@@ -2600,6 +3256,48 @@ static PyObject* simulator_is_active(PyObject *self, PyObject *args) {
     }
 }
 
+/**
+ * Asks the server to write the scent and vision of the agents of this client
+ * into shared memory, from which they are given to the step callback as
+ * read-only numpy views rather than copies. The client must be connected to
+ * the server through its Unix domain socket on Linux.
+ *
+ * \param   self    Pointer to the Python object calling this method.
+ * \param   args    Arguments:
+ *                  - Handle to the native client object as a PyLong.
+ *                  - The number of steps for which the observations given to
+ *                    the step callback remain valid.
+ *                  - The maximum number of agents whose observations are
+ *                    shared. In steps where the client has more agents, their
+ *                    observations are copied instead.
+ * \returns `True` if the server shares observations with this client; `False`
+ *          otherwise (for example, if the client is connected over TCP).
+ */
+static PyObject* simulator_enable_shared_observations(PyObject *self, PyObject *args) {
+    PyObject* py_client_handle;
+    unsigned int slot_count, agent_capacity;
+    if (!PyArg_ParseTuple(args, "OII", &py_client_handle, &slot_count, &agent_capacity))
+        return NULL;
+
+    client<py_client_data>* client_handle =
+            (client<py_client_data>*) PyLong_AsVoidPtr(py_client_handle);
+    if (!client_handle->client_running) {
+        PyErr_SetString(mpi_error, "Connection to the server was lost.");
+        return NULL;
+    }
+
+    client_handle->data.waiting_for_server = true;
+    if (!send_enable_shared_observations(*client_handle, slot_count, agent_capacity)) {
+        Py_INCREF(Py_False);
+        return Py_False;
+    }
+
+    /* wait for response from server */
+    wait_for_server(*client_handle);
+    PyObject* py_result = (client_handle->data.server_response == status::OK) ? Py_True : Py_False;
+    Py_INCREF(py_result); return py_result;
+}
+
 } /* namespace jbw */
 
 static PyMethodDef SimulatorMethods[] = {
@@ -2624,11 +3322,17 @@ static PyMethodDef SimulatorMethods[] = {
     {"move",  jbw::simulator_move, METH_VARARGS, "Attempts to move the agent in the simulation environment."},
     {"turn",  jbw::simulator_turn, METH_VARARGS, "Attempts to turn the agent in the simulation environment."},
     {"no_op",  jbw::simulator_no_op, METH_VARARGS, "Attempts to instruct the agent to do nothing (a no-op) in the simulation environment."},
+    {"act_batch",  jbw::simulator_act_batch, METH_VARARGS, "Attempts to perform an action for each agent in a batch."},
+    {"enqueue_actions",  jbw::simulator_enqueue_actions, METH_VARARGS, "Appends a sequence of actions to the action queue of an agent."},
+    {"advance",  jbw::simulator_advance, METH_VARARGS, "Advances the simulation by a number of time steps, computing observations only for the last one."},
     {"map",  jbw::simulator_map, METH_VARARGS, "Returns a list of patches within a given bounding box."},
+    {"map_summary",  jbw::simulator_map_summary, METH_VARARGS, "Returns a list of summaries of blocks of patches within a given bounding box."},
+    {"local_maps",  jbw::simulator_local_maps, METH_VARARGS, "Returns a grid of the items and agents around each of the given agents."},
     {"agent_ids",  jbw::simulator_agent_ids, METH_VARARGS, "Returns a list of the IDs of all agents in the simulation environment."},
     {"agent_states",  jbw::simulator_agent_states, METH_VARARGS, "Returns a list of the agent states with the specified IDs in the simulation environment."},
     {"set_active",  jbw::simulator_set_active, METH_VARARGS, "Sets whether the agent is active or inactive."},
     {"is_active",  jbw::simulator_is_active, METH_VARARGS, "Gets whether the agent is active or inactive."},
+    {"enable_shared_observations",  jbw::simulator_enable_shared_observations, METH_VARARGS, "Receives the observations of the agents of a client connected through a Unix domain socket through shared memory."},
     {NULL, NULL, 0, NULL}        /* Sentinel */
 };
 
@@ -23,7 +23,7 @@ import os
 
 from .item import IntensityFunction, InteractionFunction
 
-__all__ = ['MPIError', 'MovementConflictPolicy', 'ActionPolicy', 'SimulatorConfig', 'Simulator']
+__all__ = ['MPIError', 'MovementConflictPolicy', 'ActionPolicy', 'ActionType', 'AdvancePolicy', 'SimulatorConfig', 'Simulator']
 
 
 class MPIError(Exception):
@@ -48,13 +48,28 @@ class ActionPolicy(Enum):
   DISALLOWED = 0
   IGNORED = 0
 
+class ActionType(Enum):
+  """The kinds of actions that can be submitted to `Simulator.act_batch`."""
+
+  MOVE = 0
+  TURN = 1
+  NO_OP = 2
+
+class AdvancePolicy(Enum):
+  """How agents behave during `Simulator.advance`, when they are not
+     controlled by their clients."""
+
+  NO_OP = 0
+  QUEUED_ACTIONS = 1
+
 class SimulatorConfig(object):
   """Represents a configuration for a simulator."""
 
   def __init__(self, max_steps_per_movement, allowed_movement_directions,
       allowed_turn_directions, no_op_allowed, vision_range, patch_size,
       mcmc_num_iter, items, agent_color, collision_policy, agent_field_of_view,
-      decay_param, diffusion_param, deleted_item_lifetime, seed=0):
+      decay_param, diffusion_param, deleted_item_lifetime, seed=0,
+      step_thread_count=1):
     """Creates a new simulator configuration.
 
     Arguments:
@@ -91,6 +106,9 @@ class SimulatorConfig(object):
                                    after they have been removed from the world.
       seed:                        The initial seed for the pseudorandom number
                                    generator.
+      step_thread_count:           Number of threads used to advance the
+                                   simulation at each time step. The results
+                                   do not depend on this value.
     """
     assert len(items) > 0, 'A non-empty list of items must be provided.'
     self.max_steps_per_movement = max_steps_per_movement
@@ -116,6 +134,7 @@ class SimulatorConfig(object):
     self.deleted_item_lifetime = deleted_item_lifetime
     self.agent_field_of_view = agent_field_of_view
     self.seed = seed
+    self.step_thread_count = step_thread_count
 
 
 class Simulator(object):
@@ -129,7 +148,7 @@ class Simulator(object):
   def __init__(
       self, on_step_callback=None, sim_config=None,
       is_server=False, server_address=None, port=54353,
-      default_client_permissions=None,
+      local_socket_path=None, default_client_permissions=None,
       conn_queue_capacity=256, num_workers=8,
 	    on_lost_connection_callback=None, save_frequency=1000,
       save_filepath=None, load_filepath=None, load_time=-1):
@@ -147,8 +166,9 @@ class Simulator(object):
     To construct a new simulator in server mode, `sim_config` must be
     specified, `is_server` must be `True`, `server_address` must be
     unspecified, and `load_filepath` must be unspecified (the latter two
-    arguments are default). The arguments `port`, `conn_queue_capacity`, and
-    `num_workers` may be used to change aspects of the server.
+    arguments are default). The arguments `port`, `local_socket_path`,
+    `conn_queue_capacity`, and `num_workers` may be used to change aspects of
+    the server.
 
     To connect to an existing simulator server (i.e. construct the simulator in
     client mode), `sim_config` must be unspecified, but `server_address` must
@@ -168,8 +188,13 @@ class Simulator(object):
       is_server           Indicates whether this simulation is to be run as a
                           server.
       server_address      (client mode) The address of the simulator server to
-                          connect to.
+                          connect to. This may be 'unix:<path>' to connect to
+                          a server on the same host through its Unix domain
+                          socket, in which case `port` is ignored.
       port                (server mode) The port of the simulator server.
+      local_socket_path   (server mode) If not None, the path of a Unix domain
+                          socket on which the server also listens, which is
+                          faster for clients on the same host.
       default_client_permissions (server mode) The Permissions of new clients
                           that connect to this server. This must not be None if
                           is_server is True.
@@ -240,10 +265,11 @@ class Simulator(object):
         sim_config.color_num_dims, sim_config.vision_range, sim_config.patch_size, sim_config.mcmc_num_iter,
         [(i.name, i.scent, i.color, i.required_item_counts, i.required_item_costs, i.blocks_movement, i.visual_occlusion, i.intensity_fn, i.intensity_fn_args, i.interaction_fns) for i in sim_config.items],
         sim_config.agent_color, sim_config.collision_policy.value, sim_config.agent_field_of_view,
-        sim_config.decay_param, sim_config.diffusion_param, sim_config.deleted_item_lifetime, self._step_callback)
+        sim_config.decay_param, sim_config.diffusion_param, sim_config.deleted_item_lifetime,
+        sim_config.step_thread_count, self._step_callback)
       if is_server:
         self._server_handle = simulator_c.start_server(
-          self._handle, port, conn_queue_capacity, num_workers, default_client_permissions)
+          self._handle, port, conn_queue_capacity, num_workers, default_client_permissions, local_socket_path)
       self._time = 0
     elif server_address != None:
       if load_filepath != None:
@@ -272,7 +298,7 @@ class Simulator(object):
         (agent._position, agent._direction, agent._scent, agent._vision, agent._items) = (position, Direction(direction), scent, vision, items)
       if is_server:
         self._server_handle = simulator_c.start_server(
-          self._handle, port, conn_queue_capacity, num_workers, default_client_permissions)
+          self._handle, port, conn_queue_capacity, num_workers, default_client_permissions, local_socket_path)
 
   def __del__(self):
     """Deletes this simulator and deallocates all
@@ -364,6 +390,111 @@ class Simulator(object):
     """
     return simulator_c.no_op(self._handle, self._client_handle, agent._id)
 
+  def act_batch(self, agents, actions):
+    """Submits an action for each of the specified agents at once.
+
+    This is equivalent to calling `move`, `turn`, or `no_op` for each agent,
+    except that the whole batch is submitted in a single call (and a single
+    message, if this simulator is a client), and the simulator advances at
+    most once, after all actions in the batch have been applied.
+
+    Arguments:
+      agents:  The list of agents intending to act.
+      actions: A list, parallel to `agents`, of tuples
+               `(action_type, direction, num_steps)`, where `action_type` is
+               an `ActionType`, `direction` is the RelativeDirection to move
+               or turn (ignored for no-ops), and `num_steps` is the number of
+               steps to move (ignored for turns and no-ops).
+
+    Returns:
+      A list, parallel to `agents`, where each element is `True` if the
+      corresponding action was successful, and `False` otherwise.
+    """
+    encoded = [(action_type.value,
+                0 if direction is None else direction.value,
+                0 if num_steps is None else num_steps)
+               for (action_type, direction, num_steps) in actions]
+    return simulator_c.act_batch(self._handle, self._client_handle,
+      [agent._id for agent in agents], encoded)
+
+  def enqueue_actions(self, agent, actions, notify_when_drained=False):
+    """Appends a sequence of actions to the action queue of the specified agent.
+
+    The simulator performs one queued action per turn on behalf of the agent,
+    starting with the current turn if the agent has not yet acted, so that a
+    known sequence of actions needs only a single call (and a single message,
+    if this simulator is a client).
+
+    Arguments:
+      agent:               The agent whose actions to enqueue.
+      actions:             A list of tuples `(action_type, direction,
+                           num_steps)`, encoded as in `act_batch`.
+      notify_when_drained: Whether the step response of the turn in which the
+                           last queued action is performed should report that
+                           the queue was drained.
+
+    Returns:
+      `True`, if successful; `False`, otherwise.
+    """
+    encoded = [(action_type.value,
+                0 if direction is None else direction.value,
+                0 if num_steps is None else num_steps)
+               for (action_type, direction, num_steps) in actions]
+    return simulator_c.enqueue_actions(self._handle, self._client_handle,
+      agent._id, encoded, notify_when_drained)
+
+  def advance(self, num_steps, policy=AdvancePolicy.NO_OP):
+    """Advances the simulation by the given number of time steps without
+    waiting for agents to act.
+
+    Agents that have not acted in a time step act according to `policy`.
+    Observations are only computed, and the step callback is only invoked, for
+    the last of these time steps. This is useful for burn-in, and for
+    evaluating scripted agents whose actions were enqueued with
+    `enqueue_actions`. This is only supported for local simulators and
+    servers.
+
+    Arguments:
+      num_steps: The number of time steps to advance.
+      policy:    The AdvancePolicy for agents that have not acted.
+    """
+    if self._client_handle != None:
+      raise RuntimeError("`advance` is not supported by clients.")
+    if num_steps == 0:
+      return
+    # the step callback increments the time once, for the last time step
+    self._time += num_steps - 1
+    simulator_c.advance(self._handle, num_steps, policy.value)
+
+  def enable_shared_observations(self, slot_count=4, agent_capacity=64):
+    """Asks the server to pass the scent and vision of the agents of this
+    client through shared memory rather than the socket.
+
+    The scent and vision of each agent then become read-only numpy views into
+    the shared memory rather than copies. The server does not overwrite a slot
+    while any view into it is alive, and sends the observations of a step
+    inline instead if the next slot is still in use, so views that are kept
+    for longer than a step reduce the benefit but stay valid, even after this
+    Simulator is deleted. This is only supported on Linux, for clients
+    connected to the server through its Unix domain socket (see
+    `local_socket_path`), since the server passes the shared memory to the
+    client over that socket.
+
+    Arguments:
+      slot_count:     The number of steps whose observations are kept.
+      agent_capacity: The maximum number of agents whose observations are
+                      shared. In steps where this client has more agents,
+                      their observations are copied instead.
+
+    Returns:
+      Whether the server shares observations with this client. This is False
+      if the client lacks the `get_agent_states` permission, or if the shared
+      memory could not be created or passed to the client.
+    """
+    if self._client_handle == None:
+      raise RuntimeError("`enable_shared_observations` requires that the Simulator be a client.")
+    return simulator_c.enable_shared_observations(self._client_handle, slot_count, agent_capacity)
+
   def get_agents(self):
     """Retrieves a list of the agents governed by this Simulator. This does not
     include the agents governed by other clients."""
@@ -421,6 +552,62 @@ class Simulator(object):
     """
     return simulator_c.map(self._handle, self._client_handle, bottom_left, top_right, True, False)
 
+  def _map_since(self, bottom_left, top_right, since_time):
+    """Like `_map`, but only returns the patches whose items or agents changed
+    after `since_time`. Each returned patch contains all of its current items
+    and agents, so it replaces any previously retrieved copy of the patch.
+
+    Arguments:
+      bottom_left: A tuple of integers representing the bottom-left corner of
+                   the bounding box containing the patches to retrieve.
+      top_right:   A tuple of integers representing the top_right corner of the
+                   bounding box containing the patches to retrieve.
+      since_time:  Typically, the simulation time at which this region was last
+                   retrieved.
+
+    Returns:
+      A list of tuples, where each tuple contains the state of a changed patch.
+    """
+    return simulator_c.map(self._handle, self._client_handle, bottom_left, top_right, True, False, since_time)
+
+  def _map_summary(self, bottom_left, top_right, block_size):
+    """Returns a list of tuples, each containing a summary of a square block of
+    `block_size` by `block_size` patches in the map: the block position, the
+    number of existing patches in the block, the number of items of each type,
+    the number of agents, and the average color of the cells in the block.
+    This is much cheaper than `_map` for overviews of large regions.
+
+    Arguments:
+      bottom_left: A tuple of integers representing the bottom-left corner of
+                   the bounding box containing the patches to summarize.
+      top_right:   A tuple of integers representing the top_right corner of the
+                   bounding box containing the patches to summarize.
+      block_size:  The width of each block, in patches.
+
+    Returns:
+      A list of tuples, where each tuple contains the summary of a block.
+    """
+    return simulator_c.map_summary(self._handle, self._client_handle, bottom_left, top_right, block_size)
+
+  def _local_maps(self, agents, radius, egocentric=True):
+    """Returns a grid of the items and agents within `radius` of each of the
+    given agents, which may be larger than the vision range and is not
+    occluded. This is only supported for simulators in this process.
+
+    Arguments:
+      agents:     The agents around which to retrieve the grids.
+      radius:     The radius of each grid, so each grid has width 2*radius + 1.
+      egocentric: Whether to rotate each grid so that its agent faces up, as in
+                  the vision of the agent.
+
+    Returns:
+      A numpy array of int32 with shape (len(agents), 2*radius + 1,
+      2*radius + 1, 2). The last dimension contains the type of the item in
+      each cell (or -1 if there is none) and the number of agents in the cell.
+    """
+    agent_ids = [agent._id for agent in agents]
+    return simulator_c.local_maps(self._handle, self._client_handle, agent_ids, radius, egocentric)
+
   def set_active(self, agent, active):
     """Sets whether the given agent is active or inactive.
 
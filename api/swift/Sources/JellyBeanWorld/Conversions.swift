@@ -114,6 +114,10 @@ internal extension Simulator.Configuration {
     self.scentDecay = value.scentDecay
     self.scentDiffusion = value.scentDiffusion
     self.removedItemLifetime = value.removedItemLifetime
+    self.stepThreadCount = value.stepThreadCount
+    self.dedicatedStepThread = value.dedicatedStepThread
+    self.stepDeadline = value.stepDeadline
+    self.stepNotificationCapacity = value.stepNotificationCapacity
   }
 
   @inlinable
@@ -157,7 +161,17 @@ internal extension Simulator.Configuration {
         movementConflictPolicy: moveConflictPolicy.toC(),
         scentDecay: scentDecay,
         scentDiffusion: scentDiffusion,
-        removedItemLifetime: removedItemLifetime),
+        removedItemLifetime: removedItemLifetime,
+        stepThreadCount: stepThreadCount,
+        dedicatedStepThread: dedicatedStepThread,
+        stepDeadline: stepDeadline,
+        defaultAction: AgentAction(
+          type: ActionTypeNoOp,
+          direction: DirectionUp,
+          turnDirection: TurnDirectionNoChange,
+          numSteps: 0),
+        stepNotificationCapacity: stepNotificationCapacity,
+        stepNotificationPolicy: NotificationPolicyBlock),
       deallocate: { () in
         cItems.deallocate()
         cColor.deallocate()
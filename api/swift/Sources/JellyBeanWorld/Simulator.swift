@@ -32,6 +32,8 @@ public enum JellyBeanWorldError: Error {
   case MPIError
   case InvalidSemaphoreID
   case SemaphoreAlreadySignaled
+  case SharedMemoryFailure
+  case ProtocolVersionMismatch
   case UnknownNativeError
 }
 
@@ -54,6 +56,8 @@ internal func checkStatus(_ status: JBW_Status) throws {
   case JBW_MPI_ERROR: throw JellyBeanWorldError.MPIError
   case JBW_INVALID_SEMAPHORE_ID: throw JellyBeanWorldError.InvalidSemaphoreID
   case JBW_SEMAPHORE_ALREADY_SIGNALED: throw JellyBeanWorldError.SemaphoreAlreadySignaled
+  case JBW_SHARED_MEMORY_ERROR: throw JellyBeanWorldError.SharedMemoryFailure
+  case JBW_PROTOCOL_VERSION_MISMATCH: throw JellyBeanWorldError.ProtocolVersionMismatch
   case _: throw JellyBeanWorldError.UnknownNativeError
   }
 }
@@ -160,6 +164,7 @@ public final class Simulator {
       self.serverHandle = simulationServerStart(
         handle,
         config.port,
+        config.localSocketPath,
         config.connectionQueueCapacity,
         config.workerCount,
         // TODO [PERMISSIONS].
@@ -218,6 +223,7 @@ public final class Simulator {
       self.serverHandle = simulationServerStart(
         handle,
         config.port,
+        config.localSocketPath,
         config.connectionQueueCapacity,
         config.workerCount,
         // TODO [PERMISSIONS].
@@ -475,6 +481,23 @@ extension Simulator {
     /// Lifetime of removed items (used by the scent simulation algorithm).
     public let removedItemLifetime: UInt32
 
+    /// Number of threads used to advance the simulation at each time step. The simulation results
+    /// do not depend on this value.
+    public let stepThreadCount: UInt32
+
+    /// Boolean flag that indicates whether the simulation is advanced on a dedicated thread, rather
+    /// than on the thread of whichever action completes each simulation step.
+    public let dedicatedStepThread: Bool
+
+    /// Maximum time (in milliseconds) that each simulation step waits for all agents to act. Agents
+    /// that have not acted by then perform no action. A value of `0` disables the deadline.
+    public let stepDeadline: UInt32
+
+    /// Maximum number of undelivered step notifications. If nonzero, the step callback is invoked
+    /// on a separate thread, and each simulation step waits only while this many are pending. A
+    /// value of `0` invokes the step callback synchronously.
+    public let stepNotificationCapacity: UInt32
+
     public init(
       randomSeed: UInt32,
       maxStepsPerMove: UInt32,
@@ -492,7 +515,11 @@ extension Simulator {
       moveConflictPolicy: MoveConflictPolicy,
       scentDecay: Float,
       scentDiffusion: Float,
-      removedItemLifetime: UInt32
+      removedItemLifetime: UInt32,
+      stepThreadCount: UInt32 = 1,
+      dedicatedStepThread: Bool = false,
+      stepDeadline: UInt32 = 0,
+      stepNotificationCapacity: UInt32 = 0
     ) {
       self.randomSeed = randomSeed
       self.maxStepsPerMove = maxStepsPerMove
@@ -511,6 +538,10 @@ extension Simulator {
       self.scentDecay = scentDecay
       self.scentDiffusion = scentDiffusion
       self.removedItemLifetime = removedItemLifetime
+      self.stepThreadCount = stepThreadCount
+      self.dedicatedStepThread = dedicatedStepThread
+      self.stepDeadline = stepDeadline
+      self.stepNotificationCapacity = stepNotificationCapacity
     }
   }
 }
@@ -528,10 +559,21 @@ extension Simulator {
     ///  from clients.
     public let workerCount: UInt32
 
-    public init(port: UInt32, connectionQueueCapacity: UInt32 = 256, workerCount: UInt32 = 8) {
+    /// Path of a Unix domain socket on which the server also listens, so that clients on the
+    /// same host can connect using the server address `unix:<path>`. This is `nil` if the
+    /// server only listens on `port`.
+    public let localSocketPath: String?
+
+    public init(
+      port: UInt32,
+      connectionQueueCapacity: UInt32 = 256,
+      workerCount: UInt32 = 8,
+      localSocketPath: String? = nil
+    ) {
       self.port = port
       self.connectionQueueCapacity = connectionQueueCapacity
       self.workerCount = workerCount
+      self.localSocketPath = localSocketPath
     }
   }
 }
@@ -539,7 +581,9 @@ extension Simulator {
 extension Simulator {
   /// Simulation client configuration.
   public struct ClientConfiguration {
-    /// Address in which the simulation server is listening.
+    /// Address in which the simulation server is listening. This may be `unix:<path>` to connect
+    /// to a server on the same host through its Unix domain socket, in which case `serverPort` is
+    /// ignored.
     public let serverAddress: String
 
     /// Port in which the simulation server is listening.
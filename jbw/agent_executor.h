@@ -0,0 +1,347 @@
+/**
+ * Copyright 2019, The Jelly Bean World Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#ifndef JBW_AGENT_EXECUTOR_H_
+#define JBW_AGENT_EXECUTOR_H_
+
+#include <core/array.h>
+#include <core/map.h>
+#include <condition_variable>
+#include <mutex>
+#include "mpi.h"
+
+namespace jbw {
+
+using namespace core;
+
+/**
+ * The function that an `agent_executor` calls to resume an agent once the
+ * time step in which it acted has completed. `state` is a copy of the state
+ * of the agent after that time step, which is only valid for the duration of
+ * the call, and `data` is the pointer given when the agent acted. The
+ * continuation typically chooses the next action of the agent and performs it
+ * through the executor, with itself as the continuation.
+ */
+typedef void (*agent_continuation)(uint64_t agent_id,
+		const agent_state& state, uint64_t time, void* data);
+
+/**
+ * Drives many agents from a single thread, without dedicating a thread to
+ * each agent that waits for the time step to advance. Each agent acts through
+ * the executor (for example, with `move`), which records an
+ * `agent_continuation` for the agent. When the simulator completes the time
+ * step, `notify_step` must be called from `on_step`, which copies the new
+ * state of each waiting agent. The thread that calls `run` then invokes the
+ * continuations, outside of any simulator locks, so that they may act again.
+ *
+ * The same executor works with a simulator in this process, where `on_step`
+ * receives a map from agent IDs to agent states, and with a `client`
+ * connected to a simulator server, where `on_step` receives an array of
+ * agent IDs and an array of agent states. On the client side, the action
+ * is only recorded as sent. If the server rejects it, `cancel` should be
+ * called from the corresponding response callback (for example, `on_move`).
+ */
+class agent_executor {
+	struct waiting_agent {
+		uint64_t id;
+		agent_continuation resume;
+		void* data;
+
+		/* the state of the agent after the time step, filled in by `notify_step` */
+		agent_state* state;
+	};
+
+	const simulator_config& config;
+
+	std::mutex lock;
+	std::condition_variable ready_cv;
+
+	/* agents that have acted and are waiting for the time step to complete */
+	array<waiting_agent> waiting;
+
+	/* agents whose time step has completed, which `run` will resume */
+	array<waiting_agent> ready;
+
+	/* the agent_state copies that are not in use, which are reused across time steps */
+	array<agent_state*> free_states;
+
+	uint64_t time;
+	bool stopping;
+
+public:
+	/**
+	 * Constructs an executor for agents in a simulator with the given
+	 * `config`, where `initial_time` is the current simulation time. The
+	 * executor keeps a reference to `config`.
+	 */
+	agent_executor(const simulator_config& config, uint64_t initial_time = 0) :
+		config(config), waiting(16), ready(16), free_states(16), time(initial_time), stopping(false)
+	{ }
+
+	~agent_executor() {
+		for (waiting_agent& agent : ready)
+			release_state(agent.state);
+		for (agent_state* state : free_states) {
+			core::free(*state);
+			core::free(state);
+		}
+	}
+
+	/**
+	 * Records that `resume` should be called with `data` after the next time
+	 * step completes. This is called by the functions below before the agent
+	 * acts, so that a time step that completes during the action is not
+	 * missed. Only one continuation can be recorded for each agent.
+	 */
+	bool await_step(uint64_t agent_id, agent_continuation resume, void* data) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (!waiting.ensure_capacity(waiting.length + 1)) {
+			fprintf(stderr, "agent_executor.await_step ERROR: Out of memory.\n");
+			return false;
+		}
+		waiting_agent& agent = waiting[waiting.length++];
+		agent.id = agent_id;
+		agent.resume = resume;
+		agent.data = data;
+		agent.state = nullptr;
+		return true;
+	}
+
+	/**
+	 * Removes the continuation recorded for the agent with the given ID, if
+	 * it has not yet been resumed. This should be called if the action of the
+	 * agent was rejected.
+	 */
+	void cancel(uint64_t agent_id) {
+		std::unique_lock<std::mutex> guard(lock);
+		for (unsigned int i = 0; i < waiting.length; i++) {
+			if (waiting[i].id != agent_id) continue;
+			waiting[i] = waiting.last();
+			waiting.length--;
+			return;
+		}
+	}
+
+	/**
+	 * Moves the agent in the simulator `sim`, and resumes the agent with
+	 * `resume` once the time step completes.
+	 */
+	template<typename SimulatorData>
+	inline status move(simulator<SimulatorData>& sim, uint64_t agent_id,
+			direction dir, unsigned int num_steps, agent_continuation resume, void* data)
+	{
+		return act(agent_id, resume, data, [&]() { return sim.move(agent_id, dir, num_steps); });
+	}
+
+	/**
+	 * Turns the agent in the simulator `sim`, and resumes the agent with
+	 * `resume` once the time step completes.
+	 */
+	template<typename SimulatorData>
+	inline status turn(simulator<SimulatorData>& sim, uint64_t agent_id,
+			direction dir, agent_continuation resume, void* data)
+	{
+		return act(agent_id, resume, data, [&]() { return sim.turn(agent_id, dir); });
+	}
+
+	/**
+	 * Has the agent in the simulator `sim` do nothing, and resumes the agent
+	 * with `resume` once the time step completes.
+	 */
+	template<typename SimulatorData>
+	inline status do_nothing(simulator<SimulatorData>& sim, uint64_t agent_id,
+			agent_continuation resume, void* data)
+	{
+		return act(agent_id, resume, data, [&]() { return sim.do_nothing(agent_id); });
+	}
+
+	/**
+	 * Sends a `move` message from the client `c`, and resumes the agent with
+	 * `resume` once the server reports that the time step has completed.
+	 */
+	template<typename ClientData>
+	inline bool send_move(client<ClientData>& c, uint64_t agent_id,
+			direction dir, unsigned int num_steps, agent_continuation resume, void* data)
+	{
+		return send(agent_id, resume, data, [&]() { return jbw::send_move(c, agent_id, dir, num_steps); });
+	}
+
+	/**
+	 * Sends a `turn` message from the client `c`, and resumes the agent with
+	 * `resume` once the server reports that the time step has completed.
+	 */
+	template<typename ClientData>
+	inline bool send_turn(client<ClientData>& c, uint64_t agent_id,
+			direction dir, agent_continuation resume, void* data)
+	{
+		return send(agent_id, resume, data, [&]() { return jbw::send_turn(c, agent_id, dir); });
+	}
+
+	/**
+	 * Sends a `do_nothing` message from the client `c`, and resumes the agent
+	 * with `resume` once the server reports that the time step has completed.
+	 */
+	template<typename ClientData>
+	inline bool send_do_nothing(client<ClientData>& c, uint64_t agent_id,
+			agent_continuation resume, void* data)
+	{
+		return send(agent_id, resume, data, [&]() { return jbw::send_do_nothing(c, agent_id); });
+	}
+
+	/**
+	 * Marks every waiting agent as ready to be resumed with its state in
+	 * `agents`. This should be called from
+	 * `on_step(simulator<SimulatorData>*, const hash_map<uint64_t, agent_state*>&, uint64_t)`.
+	 */
+	inline void notify_step(const hash_map<uint64_t, agent_state*>& agents, uint64_t new_time) {
+		mark_ready(new_time, [&](uint64_t agent_id) {
+			bool contains;
+			const agent_state* state = agents.get(agent_id, contains);
+			return contains ? state : nullptr;
+		});
+	}
+
+	/**
+	 * Marks every waiting agent as ready to be resumed with its state in
+	 * `agent_states`, where the state of the agent with ID `agent_ids[i]` is
+	 * `agent_states[i]`. This should be called from
+	 * `on_step(client<ClientData>&, status, const array<uint64_t>&, const agent_state*)`.
+	 */
+	void notify_step(const array<uint64_t>& agent_ids, const agent_state* agent_states) {
+		hash_map<uint64_t, unsigned int> indices((unsigned int) agent_ids.length * RESIZE_THRESHOLD_INVERSE + 1);
+		for (unsigned int i = 0; i < agent_ids.length; i++)
+			indices.put(agent_ids[i], i);
+		mark_ready(time + 1, [&](uint64_t agent_id) {
+			bool contains;
+			unsigned int index = indices.get(agent_id, contains);
+			return contains ? &agent_states[index] : nullptr;
+		});
+	}
+
+	/**
+	 * Resumes agents as their time steps complete, until no agent is waiting
+	 * or `stop` is called. Continuations are called on this thread, without
+	 * holding any locks, so they may act again through this executor.
+	 */
+	void run() {
+		array<waiting_agent> resuming(16);
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			while (!stopping && ready.length == 0 && waiting.length > 0)
+				ready_cv.wait(guard);
+			if (stopping || ready.length == 0) return;
+
+			core::swap(ready, resuming);
+			uint64_t resume_time = time;
+			guard.unlock();
+
+			for (waiting_agent& agent : resuming)
+				agent.resume(agent.id, *agent.state, resume_time, agent.data);
+
+			guard.lock();
+			for (waiting_agent& agent : resuming)
+				release_state(agent.state);
+			resuming.clear();
+		}
+	}
+
+	/* Causes `run` to return once the current continuations have been called. */
+	inline void stop() {
+		std::unique_lock<std::mutex> guard(lock);
+		stopping = true;
+		ready_cv.notify_all();
+	}
+
+private:
+	template<typename Action>
+	inline status act(uint64_t agent_id, agent_continuation resume, void* data, Action action) {
+		if (!await_step(agent_id, resume, data))
+			return status::OUT_OF_MEMORY;
+		status result = action();
+		if (result != status::OK) cancel(agent_id);
+		return result;
+	}
+
+	template<typename Send>
+	inline bool send(uint64_t agent_id, agent_continuation resume, void* data, Send send_message) {
+		if (!await_step(agent_id, resume, data))
+			return false;
+		if (!send_message()) {
+			cancel(agent_id);
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Copies the state of each waiting agent, as given by `get_state`, and
+	 * moves the agent to `ready`. Agents that `get_state` does not know about
+	 * (for example, agents that were removed) are dropped.
+	 */
+	template<typename GetState>
+	void mark_ready(uint64_t new_time, GetState get_state) {
+		std::unique_lock<std::mutex> guard(lock);
+		if (!ready.ensure_capacity(ready.length + waiting.length)) {
+			fprintf(stderr, "agent_executor.mark_ready ERROR: Out of memory.\n");
+			return;
+		}
+		time = new_time;
+		unsigned int i = 0;
+		while (i < waiting.length) {
+			waiting_agent& agent = waiting[i];
+			const agent_state* state = get_state(agent.id);
+			if (state == nullptr) {
+				waiting[i] = waiting.last();
+				waiting.length--;
+				continue;
+			}
+			agent.state = acquire_state();
+			if (agent.state == nullptr) {
+				fprintf(stderr, "agent_executor.mark_ready ERROR: Out of memory.\n");
+				break;
+			}
+			copy_observation(*state, *agent.state, config);
+			ready[ready.length++] = agent;
+			i++;
+		}
+		/* the agents that were not copied keep waiting for the next time step */
+		for (unsigned int j = 0; i + j < waiting.length; j++)
+			waiting[j] = waiting[i + j];
+		waiting.length -= i;
+		ready_cv.notify_all();
+	}
+
+	inline agent_state* acquire_state() {
+		if (free_states.length > 0)
+			return free_states.pop();
+		agent_state* state = (agent_state*) malloc(sizeof(agent_state));
+		if (state == nullptr || !init_copy(*state, config)) {
+			if (state != nullptr) core::free(state);
+			return nullptr;
+		}
+		return state;
+	}
+
+	inline void release_state(agent_state* state) {
+		if (free_states.add(state)) return;
+		core::free(*state);
+		core::free(state);
+	}
+};
+
+} /* namespace jbw */
+
+#endif /* JBW_AGENT_EXECUTOR_H_ */
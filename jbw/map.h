@@ -71,12 +71,20 @@ struct patch
 	 */
 	bool fixed;
 
+	/**
+	 * The last time step at which the items in this patch, or the agents
+	 * in it, changed. This is used to find the patches that changed since a
+	 * given time.
+	 */
+	uint64_t last_modified;
+
 	Data data;
 
 	static inline void move(const patch& src, patch& dst) {
 		core::move(src.items, dst.items);
 		core::move(src.data, dst.data);
 		dst.fixed = src.fixed;
+		dst.last_modified = src.last_modified;
 	}
 
 	static inline void free(patch& p) {
@@ -88,6 +96,7 @@ struct patch
 template<typename Data>
 inline bool init(patch<Data>& new_patch) {
 	new_patch.fixed = false;
+	new_patch.last_modified = 0;
 	if (!init(new_patch.data)) {
 		return false;
 	} else if (!array_init(new_patch.items, 8)) {
@@ -103,6 +112,7 @@ inline bool init(patch<Data>& new_patch,
 		const position item_position_offset)
 {
 	new_patch.fixed = false;
+	new_patch.last_modified = 0;
 	if (!init(new_patch.data)) {
 		return false;
 	} else if (!array_init(new_patch.items, src_items.capacity)) {
@@ -121,6 +131,22 @@ inline bool init(patch<Data>& new_patch,
 
 template<typename Data, typename Stream, typename... DataReader>
 bool read(patch<Data>& p, Stream& in, DataReader&&... reader) {
+	if (!read(p.fixed, in) || !read(p.last_modified, in) || !read(p.items, in)) {
+		return false;
+	} else if (!read(p.data, in, std::forward<DataReader>(reader)...)) {
+		free(p.items);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Reads the given patch `p` from the input stream `in`, as written before
+ * patches recorded the time at which they were last modified.
+ */
+template<typename Data, typename Stream, typename... DataReader>
+bool read_without_modification_time(patch<Data>& p, Stream& in, DataReader&&... reader) {
+	p.last_modified = 0;
 	if (!read(p.fixed, in) || !read(p.items, in)) {
 		return false;
 	} else if (!read(p.data, in, std::forward<DataReader>(reader)...)) {
@@ -133,6 +159,7 @@ bool read(patch<Data>& p, Stream& in, DataReader&&... reader) {
 template<typename Data, typename Stream, typename... DataWriter>
 bool write(const patch<Data>& p, Stream& out, DataWriter&&... writer) {
 	return write(p.fixed, out)
+		&& write(p.last_modified, out)
 		&& write(p.items, out)
 		&& write(p.data, out, std::forward<DataWriter>(writer)...);
 }
@@ -230,16 +257,26 @@ struct map
 	unsigned int n;
 	unsigned int mcmc_iterations;
 
+	/* log2(n) if `n` is a power of two, in which case the patch coordinate
+	   math uses shifts and masks instead of division; otherwise -1 */
+	int n_shift;
+
 	std::minstd_rand rng;
 	uint_fast32_t initial_seed;
 	gibbs_field_cache<ItemType> cache;
 
+	/* the time with which patches are stamped when they are created or
+	   resampled, which the simulator sets to the time of the time step that
+	   will first include the change */
+	uint64_t modification_time;
+
 	typedef patch<PerPatchData> patch_type;
 	typedef ItemType item_type;
 
 public:
 	map(unsigned int n, unsigned int mcmc_iterations, const ItemType* item_types, unsigned int item_type_count, uint_fast32_t seed) :
-		patches(32), n(n), mcmc_iterations(mcmc_iterations), rng(seed), initial_seed(seed), cache(item_types, item_type_count, n)
+		patches(32), n(n), mcmc_iterations(mcmc_iterations), n_shift(power_of_two_shift(n)),
+		rng(seed), initial_seed(seed), cache(item_types, item_type_count, n), modification_time(0)
 	{ }
 
 	map(unsigned int n, unsigned int mcmc_iterations, const ItemType* item_types, unsigned int item_type_count) :
@@ -593,6 +630,8 @@ public:
 				cache, patch_positions, neighborhoods, num_patches_to_sample, n);
 		for (unsigned int i = 0; i < mcmc_iterations; i++)
 			field.sample(rng);
+		for (unsigned int k = 0; k < num_patches_to_sample; k++)
+			neighborhoods[k].bottom_left_neighborhood[0]->last_modified = modification_time;
 
 		/* set the core four patches to fixed */
 		i = row_index;
@@ -665,8 +704,27 @@ public:
 		world.rng.~linear_congruential_engine();
 	}
 
+	static inline int power_of_two_shift(unsigned int n) {
+		if (n == 0 || (n & (n - 1)) != 0)
+			return -1;
+		int shift = 0;
+		while ((1u << shift) != n) shift++;
+		return shift;
+	}
+
 private:
+	/* Returns `a` divided by `2^n_shift`, rounded toward negative infinity.
+	   Right shifts of negative signed values are implementation-defined, so
+	   `a` is offset by 2^63 into an unsigned value, shifted, and the shifted
+	   offset is subtracted back out. */
+	inline int64_t floored_shift(int64_t a) const {
+		constexpr uint64_t bias = ((uint64_t) 1) << 63;
+		return (int64_t) (((uint64_t) a + bias) >> n_shift) - (int64_t) (bias >> n_shift);
+	}
+
 	inline int64_t floored_div(int64_t a, unsigned int b) const {
+		if (n_shift >= 0 && b == n)
+			return floored_shift(a);
 		lldiv_t result = lldiv(a, b);
 		if (a < 0 && result.rem != 0)
 			result.quot--;
@@ -674,7 +732,13 @@ private:
 	}
 
 	inline lldiv_t floored_div_with_remainder(int64_t a, unsigned int b) const {
-		lldiv_t result = lldiv(a, b);
+		lldiv_t result;
+		if (n_shift >= 0 && b == n) {
+			result.quot = floored_shift(a);
+			result.rem = (int64_t) ((uint64_t) a & (uint64_t) (n - 1));
+			return result;
+		}
+		result = lldiv(a, b);
 		if (a < 0 && result.rem != 0) {
 			result.quot--;
 			result.rem += b;
@@ -699,6 +763,7 @@ private:
 			/* there are no patches so initialize an empty patch */
 			if (!init(p)) return false;
 		}
+		p.last_modified = modification_time;
 		return true;
 	}
 
@@ -834,8 +899,10 @@ inline bool init(map<PerPatchData, ItemType>& world, unsigned int n,
 	if (!array_map_init(world.patches, 32))
 		return false;
 	world.n = n;
+	world.n_shift = map<PerPatchData, ItemType>::power_of_two_shift(n);
 	world.mcmc_iterations = mcmc_iterations;
 	world.initial_seed = seed;
+	world.modification_time = 0;
 	if (!init(world.cache, item_types, item_type_count, n)) {
 		free(world.patches);
 		return false;
@@ -858,10 +925,16 @@ inline bool init(map<PerPatchData, ItemType>& world, unsigned int n,
 	return init(world, n, mcmc_iterations, item_types, item_type_count, seed);
 }
 
+/**
+ * Reads the given map `world` from the input stream `in`. If
+ * `has_modification_times` is `false`, the patches in `in` were written before
+ * they recorded the time at which they were last modified.
+ */
 template<typename PerPatchData, typename ItemType, typename Stream, typename PatchReader>
 bool read(map<PerPatchData, ItemType>& world, Stream& in,
 		const ItemType* item_types, unsigned int item_type_count,
-		PatchReader& patch_reader = default_scribe())
+		PatchReader& patch_reader = default_scribe(),
+		bool has_modification_times = true)
 {
 	/* read PRNG state into a char* buffer */
 	size_t length;
@@ -880,6 +953,8 @@ bool read(map<PerPatchData, ItemType>& world, Stream& in,
 	 || !read(row_count, in)
 	 || !array_map_init(world.patches, ((size_t) 1) << (core::log2(row_count == 0 ? 1 : row_count) + 1)))
 		return false;
+	world.n_shift = map<PerPatchData, ItemType>::power_of_two_shift(world.n);
+	world.modification_time = 0;
 
 	if (!read(world.patches.keys, in, row_count)) {
 		free(world.patches);
@@ -911,7 +986,10 @@ bool read(map<PerPatchData, ItemType>& world, Stream& in,
 			return false;
 		}
 		for (size_t j = 0; j < column_count; j++) {
-			if (!read(row.values[j], in, patch_reader)) {
+			if (has_modification_times
+			  ? !read(row.values[j], in, patch_reader)
+			  : !read_without_modification_time(row.values[j], in, patch_reader))
+			{
 				for (auto row : world.patches) {
 					for (auto entry : row.value)
 						free(entry.value);
@@ -22,12 +22,24 @@
 
 #include <signal.h>
 
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 namespace jbw {
 
 using namespace core;
 
 constexpr uint64_t NEW_CLIENT_REQUEST = 0;
 
+/* Every connection begins with `MPI_PROTOCOL_MAGIC` followed by the protocol
+   version of the client, and the server rejects any client whose version
+   differs from its own. Increment `MPI_PROTOCOL_VERSION` whenever the wire
+   encoding of any message changes. */
+constexpr uint32_t MPI_PROTOCOL_MAGIC = 0x4A42574D;
+constexpr uint32_t MPI_PROTOCOL_VERSION = 2;
+
 enum class message_type : uint64_t {
 	ADD_AGENT = 0,
 	ADD_AGENT_RESPONSE,
@@ -58,7 +70,17 @@ enum class message_type : uint64_t {
 	SET_ACTIVE_RESPONSE,
 	IS_ACTIVE,
 	IS_ACTIVE_RESPONSE,
-	STEP_RESPONSE
+	STEP_RESPONSE,
+	ACT_BATCH,
+	ACT_BATCH_RESPONSE,
+	ENQUEUE_ACTIONS,
+	ENQUEUE_ACTIONS_RESPONSE,
+	GET_MAP_SINCE,
+	GET_MAP_SUMMARY,
+	GET_MAP_SUMMARY_RESPONSE,
+	ENABLE_SHARED_OBSERVATIONS,
+	ENABLE_SHARED_OBSERVATIONS_RESPONSE,
+	SHARED_STEP_RESPONSE
 };
 
 /**
@@ -97,10 +119,15 @@ inline bool print(const message_type& type, Stream& out) {
 	case message_type::TURN:             return core::print("TURN", out);
 	case message_type::DO_NOTHING:       return core::print("DO_NOTHING", out);
 	case message_type::GET_MAP:          return core::print("GET_MAP", out);
+	case message_type::GET_MAP_SINCE:    return core::print("GET_MAP_SINCE", out);
+	case message_type::GET_MAP_SUMMARY:  return core::print("GET_MAP_SUMMARY", out);
 	case message_type::GET_AGENT_IDS:    return core::print("GET_AGENT_IDS", out);
 	case message_type::GET_AGENT_STATES: return core::print("GET_AGENT_STATES", out);
 	case message_type::SET_ACTIVE:       return core::print("SET_ACTIVE", out);
 	case message_type::IS_ACTIVE:        return core::print("IS_ACTIVE", out);
+	case message_type::ACT_BATCH:        return core::print("ACT_BATCH", out);
+	case message_type::ENQUEUE_ACTIONS:  return core::print("ENQUEUE_ACTIONS", out);
+	case message_type::ENABLE_SHARED_OBSERVATIONS: return core::print("ENABLE_SHARED_OBSERVATIONS", out);
 
 	case message_type::ADD_AGENT_RESPONSE:        return core::print("ADD_AGENT_RESPONSE", out);
 	case message_type::REMOVE_AGENT_RESPONSE:     return core::print("REMOVE_AGENT_RESPONSE", out);
@@ -112,11 +139,16 @@ inline bool print(const message_type& type, Stream& out) {
 	case message_type::TURN_RESPONSE:             return core::print("TURN_RESPONSE", out);
 	case message_type::DO_NOTHING_RESPONSE:       return core::print("DO_NOTHING_RESPONSE", out);
 	case message_type::GET_MAP_RESPONSE:          return core::print("GET_MAP_RESPONSE", out);
+	case message_type::GET_MAP_SUMMARY_RESPONSE:  return core::print("GET_MAP_SUMMARY_RESPONSE", out);
 	case message_type::GET_AGENT_IDS_RESPONSE:    return core::print("GET_AGENT_IDS_RESPONSE", out);
 	case message_type::GET_AGENT_STATES_RESPONSE: return core::print("GET_AGENT_STATES_RESPONSE", out);
 	case message_type::SET_ACTIVE_RESPONSE:       return core::print("SET_ACTIVE_RESPONSE", out);
 	case message_type::IS_ACTIVE_RESPONSE:        return core::print("IS_ACTIVE_RESPONSE", out);
 	case message_type::STEP_RESPONSE:             return core::print("STEP_RESPONSE", out);
+	case message_type::ACT_BATCH_RESPONSE:        return core::print("ACT_BATCH_RESPONSE", out);
+	case message_type::ENQUEUE_ACTIONS_RESPONSE:  return core::print("ENQUEUE_ACTIONS_RESPONSE", out);
+	case message_type::ENABLE_SHARED_OBSERVATIONS_RESPONSE: return core::print("ENABLE_SHARED_OBSERVATIONS_RESPONSE", out);
+	case message_type::SHARED_STEP_RESPONSE: return core::print("SHARED_STEP_RESPONSE", out);
 	}
 	fprintf(stderr, "print ERROR: Unrecognized message_type.\n");
 	return false;
@@ -195,21 +227,295 @@ bool write(const permissions& perms, Stream& out) {
 		&& write(perms.get_semaphores, out);
 }
 
+/* the slot index in a step response whose observations are sent inline */
+constexpr uint32_t NO_SHARED_SLOT = UINT32_MAX;
+
+/* the state of a slot that the server may write into, which is also the state
+   of every slot in a newly created (zero-filled) memory file */
+constexpr uint32_t SHARED_SLOT_FREE = 0;
+
+/* the state of a slot from when the server writes into it until the client,
+   and every view of it, releases it */
+constexpr uint32_t SHARED_SLOT_WRITTEN = 1;
+
+/**
+ * A mapping of an anonymous memory file, which begins with the states of
+ * its `slot_count` slots followed by the slots themselves. The mapping is
+ * reference counted, so that views of a slot can outlive the
+ * `shared_observations` that mapped it, and it is unmapped once the last
+ * reference is released. The states are shared with the other process, and
+ * the references to each slot are local to this one.
+ */
+struct shared_mapping {
+	std::atomic<uint32_t>* slot_states;
+	float* data;
+	size_t size;
+	unsigned int slot_count;
+	std::atomic<unsigned int> references;
+	std::atomic<unsigned int>* slot_references;
+};
+
+inline void retain(shared_mapping& mapping) {
+	mapping.references++;
+}
+
+/**
+ * Releases a reference to `mapping`, and unmaps and frees it if this was the
+ * last reference.
+ */
+inline void release(shared_mapping* mapping) {
+	if (--mapping->references != 0)
+		return;
+#if !defined(_WIN32)
+	munmap(mapping->slot_states, mapping->size);
+#endif
+	free(mapping->slot_references);
+	free(mapping);
+}
+
+/**
+ * Retains the slot with the given `index` of `mapping`, so that the server
+ * does not overwrite its observations (it sends them inline instead) until
+ * the slot is released with `release_slot`. The slot must have been written
+ * by the server, and this also retains `mapping` itself.
+ */
+inline void retain_slot(shared_mapping& mapping, unsigned int index) {
+	retain(mapping);
+	mapping.slot_references[index]++;
+}
+
+/**
+ * Releases the slot with the given `index` of `mapping`, which the server may
+ * write into again once every reference to it is released.
+ */
+inline void release_slot(shared_mapping* mapping, unsigned int index) {
+	if (--mapping->slot_references[index] == 0)
+		mapping->slot_states[index].store(SHARED_SLOT_FREE, std::memory_order_release);
+	release(mapping);
+}
+
+/**
+ * A ring of slots in an anonymous memory file, through which a server passes
+ * the scent and vision of the agents of a client connected through a Unix
+ * domain socket, rather than writing them into every step response. The
+ * server creates the file, seals its size, and passes it to the client over
+ * the socket, so neither the client nor any other process can shrink it
+ * under the server or map it by name. Each slot holds the
+ * observations of up to `agent_capacity` agents, and each step is written
+ * into the next slot, as long as the client has released it. Otherwise, the
+ * observations of that step are sent inline.
+ */
+struct shared_observations {
+	shared_mapping* mapping;
+	unsigned int slot_count;
+	unsigned int agent_capacity;
+	unsigned int next_slot;
+
+	static inline void free(shared_observations& observations) {
+		observations.unmap();
+	}
+
+	inline bool is_mapped() const {
+		return mapping != nullptr;
+	}
+
+	/* returns `true` if `ptr` points into the mapped slots */
+	inline bool contains(const float* ptr) const {
+		return mapping != nullptr && ptr >= mapping->data
+			&& (const char*) ptr < (const char*) mapping->slot_states + mapping->size;
+	}
+
+	/* returns the observations of the first agent in the slot with the given `index` */
+	inline float* slot(unsigned int index, const simulator_config& config) const {
+		return mapping->data + (size_t) index * agent_capacity * observation_size(config);
+	}
+
+	/* returns the index of the slot containing `ptr`, or `NO_SHARED_SLOT` if
+	   `ptr` does not point into the mapped slots */
+	inline uint32_t slot_of(const float* ptr, const simulator_config& config) const {
+		if (!contains(ptr)) return NO_SHARED_SLOT;
+		return (uint32_t) ((size_t) (ptr - mapping->data) / ((size_t) agent_capacity * observation_size(config)));
+	}
+
+	/* returns `true` if the client has released the slot with the given `index` */
+	inline bool is_free(unsigned int index) const {
+		return mapping->slot_states[index].load(std::memory_order_acquire) == SHARED_SLOT_FREE;
+	}
+
+	inline void set_written(unsigned int index) {
+		mapping->slot_states[index].store(SHARED_SLOT_WRITTEN, std::memory_order_relaxed);
+	}
+
+	/* the number of floats in the scent and vision of one agent */
+	static inline size_t observation_size(const simulator_config& config) {
+		return config.scent_dimension + (size_t) (2*config.vision_range + 1)
+				* (2*config.vision_range + 1) * config.color_dimension;
+	}
+
+	/* computes the size of the mapping of `slot_count` slots of `agent_capacity`
+	   agents, returning `false` if the dimensions are invalid */
+	static inline bool mapping_size(unsigned int slot_count, unsigned int agent_capacity,
+			const simulator_config& config, size_t& size)
+	{
+		size_t observation_size = shared_observations::observation_size(config);
+		if (slot_count == 0 || agent_capacity == 0 || observation_size == 0
+		 || (size_t) agent_capacity * observation_size > SIZE_MAX / sizeof(float) / slot_count - 1)
+			return false;
+		/* the slot states are the same size as a float, so the slots stay aligned */
+		static_assert(sizeof(std::atomic<uint32_t>) == sizeof(float), "Unexpected size of slot states.");
+		size = sizeof(float) * slot_count * (agent_capacity * observation_size + 1);
+		return true;
+	}
+
+	/* releases this reference to the mapping, which stays mapped while any
+	   slot is retained */
+	inline void unmap() {
+		if (mapping != nullptr)
+			release(mapping);
+		mapping = nullptr;
+	}
+};
+
+inline void init(shared_observations& observations) {
+	observations.mapping = nullptr;
+	observations.slot_count = 0;
+	observations.agent_capacity = 0;
+	observations.next_slot = 0;
+}
+
+#if !defined(_WIN32)
+/* maps `size` bytes of the memory file `fd` into `observations`, which must be unmapped */
+inline bool map_shared_observations(shared_observations& observations, int fd,
+		size_t size, unsigned int slot_count, unsigned int agent_capacity)
+{
+	shared_mapping* mapping = (shared_mapping*) malloc(sizeof(shared_mapping));
+	if (mapping == nullptr) {
+		fprintf(stderr, "map_shared_observations ERROR: Out of memory.\n");
+		return false;
+	}
+	mapping->slot_references = (std::atomic<unsigned int>*) malloc(sizeof(std::atomic<unsigned int>) * slot_count);
+	if (mapping->slot_references == nullptr) {
+		fprintf(stderr, "map_shared_observations ERROR: Out of memory.\n");
+		free(mapping);
+		return false;
+	}
+
+	void* data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (data == MAP_FAILED) {
+		perror("map_shared_observations ERROR: Unable to map memory file");
+		free(mapping->slot_references); free(mapping);
+		return false;
+	}
+
+	/* `ftruncate` zero-fills the file, so every slot starts out free */
+	mapping->slot_states = (std::atomic<uint32_t>*) data;
+	mapping->data = (float*) data + slot_count;
+	mapping->size = size;
+	mapping->slot_count = slot_count;
+	new (&mapping->references) std::atomic<unsigned int>(1);
+	for (unsigned int i = 0; i < slot_count; i++)
+		new (&mapping->slot_references[i]) std::atomic<unsigned int>(0);
+
+	observations.mapping = mapping;
+	observations.slot_count = slot_count;
+	observations.agent_capacity = agent_capacity;
+	observations.next_slot = 0;
+	return true;
+}
+#endif
+
+/**
+ * Creates an anonymous memory file with room for the states of `slot_count`
+ * slots followed by the slots, each of which holds `agent_capacity` agents,
+ * seals its size, and maps it into `observations`, which must be unmapped.
+ * On success, `fd` is the descriptor of the file, which the caller passes to
+ * the client and then closes. This is only supported on Linux.
+ */
+inline bool create(shared_observations& observations,
+		unsigned int slot_count, unsigned int agent_capacity,
+		const simulator_config& config, int& fd)
+{
+	size_t size;
+	if (!shared_observations::mapping_size(slot_count, agent_capacity, config, size)) {
+		fprintf(stderr, "create ERROR: Invalid shared observation slot dimensions.\n");
+		return false;
+	}
+
+#if defined(__linux__)
+	fd = memfd_create("jbw-observations", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd == -1) {
+		perror("create ERROR: Unable to create memory file");
+		return false;
+	} else if (ftruncate(fd, (off_t) size) != 0) {
+		perror("create ERROR: Unable to resize memory file");
+		::close(fd); return false;
+	} else if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0) {
+		perror("create ERROR: Unable to seal memory file");
+		::close(fd); return false;
+	} else if (!map_shared_observations(observations, fd, size, slot_count, agent_capacity)) {
+		::close(fd); return false;
+	}
+	return true;
+#else
+	fprintf(stderr, "create ERROR: Shared observations are only supported on Linux.\n");
+	return false;
+#endif
+}
+
+/**
+ * Maps the memory file `fd`, which was created by the server with `create`
+ * and passed over the connection, into `observations`, which must be
+ * unmapped. The file must be sealed against shrinking and at least as large
+ * as `slot_count` slots of `agent_capacity` agents. The caller still owns
+ * `fd`, which may be closed once this returns.
+ */
+inline bool init(shared_observations& observations, int fd,
+		unsigned int slot_count, unsigned int agent_capacity,
+		const simulator_config& config)
+{
+	size_t size;
+	if (!shared_observations::mapping_size(slot_count, agent_capacity, config, size)) {
+		fprintf(stderr, "init ERROR: Invalid shared observation slot dimensions.\n");
+		return false;
+	}
+
+#if defined(__linux__)
+	struct stat file_status;
+	int seals = fcntl(fd, F_GET_SEALS);
+	if (seals == -1 || (seals & F_SEAL_SHRINK) == 0) {
+		fprintf(stderr, "init ERROR: The memory file is not sealed against shrinking.\n");
+		return false;
+	} else if (fstat(fd, &file_status) != 0 || (size_t) file_status.st_size < size) {
+		fprintf(stderr, "init ERROR: The memory file is smaller than the requested slots.\n");
+		return false;
+	}
+	return map_shared_observations(observations, fd, size, slot_count, agent_capacity);
+#else
+	fprintf(stderr, "init ERROR: Shared observations are only supported on Linux.\n");
+	return false;
+#endif
+}
+
 struct client_state {
 	std::mutex lock;
 	array<uint64_t> agent_ids;
 	array<uint64_t> semaphore_ids;
 	permissions perms;
 
+	/* the observation slots shared with this client, if it enabled them */
+	shared_observations observations;
+
 	static inline void free(client_state& cstate) {
 		cstate.lock.~mutex();
 		core::free(cstate.agent_ids);
 		core::free(cstate.semaphore_ids);
+		core::free(cstate.observations);
 	}
 };
 
 inline bool init(client_state& cstate, const permissions& perms) {
 	cstate.perms = perms;
+	init(cstate.observations);
 	if (!array_init(cstate.agent_ids, 8)) {
 		return false;
 	} else if (!array_init(cstate.semaphore_ids, 4)) {
@@ -225,6 +531,9 @@ bool read(client_state& cstate, Stream& in) {
 	if (!read(cstate.perms, in)
 	 || !read(cstate.agent_ids, in)
 	 || !read(cstate.semaphore_ids, in)) return false;
+	/* shared observations are not saved, since the client must enable them
+	   again when it reconnects */
+	init(cstate.observations);
 	new (&cstate.lock) std::mutex();
 	return true;
 }
@@ -443,6 +752,33 @@ inline bool send_message(socket_type& socket, const void* data, unsigned int len
 	return send(socket.handle, (const char*) data, length, 0) != 0;
 }
 
+#if !defined(_WIN32)
+/**
+ * Writes the bytes in `data` of length `length` to the Unix domain socket in
+ * `socket`, passing a duplicate of the file descriptor `fd` with them.
+ */
+inline bool send_message(socket_type& socket, const void* data, unsigned int length, int fd) {
+	iovec iov = { (void*) data, length };
+	union {
+		cmsghdr header;
+		char buffer[CMSG_SPACE(sizeof(int))];
+	} control;
+	memset(&control, 0, sizeof(control));
+	msghdr message;
+	memset(&message, 0, sizeof(message));
+	message.msg_iov = &iov;
+	message.msg_iovlen = 1;
+	message.msg_control = control.buffer;
+	message.msg_controllen = sizeof(control.buffer);
+	cmsghdr* cmsg = CMSG_FIRSTHDR(&message);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	return sendmsg(socket.handle, &message, 0) == (long) length;
+}
+#endif
+
 inline client_state* acquire_client_lock(
 		server_state& state, uint64_t client_id)
 {
@@ -1053,12 +1389,18 @@ inline bool receive_do_nothing(
 	return success;
 }
 
-/* Precondition: `state.client_states_lock` must be held by the calling thread. */
+/**
+ * Handles both `GET_MAP` and `GET_MAP_SINCE` messages, where the latter is
+ * followed by the time after which the requested patches must have changed.
+ * Both are answered with a `GET_MAP_RESPONSE`.
+ *
+ * Precondition: `state.client_states_lock` must be held by the calling thread.
+ */
 template<typename Stream, typename SimulatorData>
 inline bool receive_get_map(
 		Stream& in, socket_type& connection,
 		server_state& state, uint64_t client_id,
-		simulator<SimulatorData>& sim)
+		simulator<SimulatorData>& sim, bool since)
 {
 	bool contains;
 	client_state* cstate = state.client_states.get(client_id, contains);
@@ -1071,10 +1413,13 @@ inline bool receive_get_map(
 
 	position bottom_left, top_right;
 	bool get_scent_map, get_vision_map;
+	uint64_t since_time = 0;
 	status response;
 	array<array<patch_state>> patches(32);
 	bool success = true;
-	if (!read(bottom_left, in) || !read(top_right, in) || !read(get_scent_map, in) || !read(get_vision_map, in)) {
+	if (!read(bottom_left, in) || !read(top_right, in) || !read(get_scent_map, in) || !read(get_vision_map, in)
+	 || (since && !read(since_time, in)))
+	{
 		response = status::SERVER_PARSE_MESSAGE_ERROR;
 		success = false;
 	} else if (!cstate->perms.get_map) {
@@ -1088,17 +1433,18 @@ inline bool receive_get_map(
 		cstate->lock.unlock();
 		cstate = nullptr;
 
+		uint64_t min_modified_time = (since ? since_time + 1 : 0);
 		if (get_scent_map) {
 			if (get_vision_map) {
-				response = sim.template get_map<true, true>(bottom_left, top_right, patches);
+				response = sim.template get_map<true, true>(bottom_left, top_right, patches, min_modified_time);
 			} else {
-				response = sim.template get_map<true, false>(bottom_left, top_right, patches);
+				response = sim.template get_map<true, false>(bottom_left, top_right, patches, min_modified_time);
 			}
 		} else {
 			if (get_vision_map) {
-				response = sim.template get_map<false, true>(bottom_left, top_right, patches);
+				response = sim.template get_map<false, true>(bottom_left, top_right, patches, min_modified_time);
 			} else {
-				response = sim.template get_map<false, false>(bottom_left, top_right, patches);
+				response = sim.template get_map<false, false>(bottom_left, top_right, patches, min_modified_time);
 			}
 		}
 		if (response != status::OK) {
@@ -1141,6 +1487,75 @@ inline bool receive_get_map(
 	return success;
 }
 
+/* Precondition: `state.client_states_lock` must be held by the calling thread. */
+template<typename Stream, typename SimulatorData>
+inline bool receive_get_map_summary(
+		Stream& in, socket_type& connection,
+		server_state& state, uint64_t client_id,
+		simulator<SimulatorData>& sim)
+{
+	bool contains;
+	client_state* cstate = state.client_states.get(client_id, contains);
+	if (!contains) {
+		state.client_states_lock.unlock();
+		return true; /* the client was already destroyed */
+	}
+	cstate->lock.lock();
+	state.client_states_lock.unlock();
+
+	position bottom_left, top_right;
+	unsigned int block_size;
+	status response;
+	array<array<patch_summary>> blocks(32);
+	bool success = true;
+	if (!read(bottom_left, in) || !read(top_right, in) || !read(block_size, in)) {
+		response = status::SERVER_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else if (!cstate->perms.get_map) {
+		/* the client has no permission for this operation */
+		response = status::PERMISSION_ERROR;
+	} else {
+		/* we have to unlock this to avoid deadlock (see `receive_get_map`) */
+		cstate->lock.unlock();
+		cstate = nullptr;
+
+		response = sim.get_map_summary(bottom_left, top_right, block_size, blocks);
+		if (response != status::OK) {
+			for (array<patch_summary>& row : blocks) {
+				for (patch_summary& block : row) free(block);
+				free(row);
+			}
+			blocks.clear();
+			if (response == status::OUT_OF_MEMORY)
+				response = status::SERVER_OUT_OF_MEMORY;
+		}
+	}
+
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(response) + sizeof(size_t));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	success &= write(message_type::GET_MAP_SUMMARY_RESPONSE, out) && write(response, out)
+			&& (response != status::OK || write(blocks, out, sim.get_config()));
+	for (array<patch_summary>& row : blocks) {
+		for (patch_summary& block : row) free(block);
+		free(row);
+	}
+	if (!success) {
+		if (cstate != nullptr)
+			cstate->lock.unlock();
+		return false;
+	}
+
+	if (cstate == nullptr) {
+		cstate = acquire_client_lock(state, client_id);
+		if (cstate == nullptr)
+			/* the client was destroyed while we didn't have the client lock */
+			return true;
+	}
+	success = send_message(connection, mem_stream.buffer, mem_stream.position);
+	cstate->lock.unlock();
+	return success;
+}
+
 /* Precondition: `state.client_states_lock` must be held by the calling thread. */
 template<typename Stream, typename SimulatorData>
 inline bool receive_get_agent_ids(
@@ -1203,7 +1618,7 @@ inline bool receive_get_agent_ids(
 template<typename Stream>
 inline bool send_agent_states(
 	Stream& out, uint64_t* agent_ids,
-	agent_state** agent_states,
+	const agent_state** agent_states,
 	size_t& agent_state_count,
 	const simulator_config& config)
 {
@@ -1218,21 +1633,13 @@ inline bool send_agent_states(
 
 	if (!write(agent_state_count, out)
 	 || !write(agent_ids, out, agent_state_count))
-	{
-		for (unsigned int i = 0; i < old_agent_state_count; i++)
-			if (agent_states[i] != nullptr) agent_states[i]->lock.unlock();
 		return false;
-	}
 
 	/* send the requested agent states to the client */
 	for (unsigned int i = 0; i < old_agent_state_count; i++) {
 		if (agent_states[i] == nullptr) continue;
-		if (!write(*agent_states[i], out, config)) {
-			for (unsigned int j = i; j < old_agent_state_count; j++)
-				if (agent_states[j] != nullptr) agent_states[j]->lock.unlock();
+		if (!write(*agent_states[i], out, config))
 			return false;
-		}
-		agent_states[i]->lock.unlock();
 	}
 	return true;
 }
@@ -1255,7 +1662,8 @@ inline bool receive_get_agent_states(
 
 	status response;
 	uint64_t* agent_ids = nullptr;
-	agent_state** agent_states = nullptr;
+	const agent_state** agent_states = nullptr;
+	const observation_snapshot* snapshot = nullptr;
 	size_t agent_state_count = 0;
 	bool success = true;
 	if (!read(agent_state_count, in)) {
@@ -1263,7 +1671,7 @@ inline bool receive_get_agent_states(
 		success = false;
 	} else {
 		agent_ids = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * agent_state_count));
-		agent_states = (agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * agent_state_count));
+		agent_states = (const agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * agent_state_count));
 		if (agent_ids == nullptr || agent_states == nullptr) {
 			if (agent_ids != nullptr) free(agent_ids);
 			response = status::SERVER_OUT_OF_MEMORY;
@@ -1296,7 +1704,7 @@ inline bool receive_get_agent_states(
 			}
 
 			if (response == status::OK)
-				sim.get_agent_states(agent_states, agent_ids, (unsigned int) agent_state_count);
+				snapshot = &sim.get_agent_states(agent_states, agent_ids, (unsigned int) agent_state_count);
 		}
 	}
 
@@ -1304,6 +1712,8 @@ inline bool receive_get_agent_states(
 	fixed_width_stream<memory_stream> out(mem_stream);
 	success &= write(message_type::GET_AGENT_STATES_RESPONSE, out) && write(response, out)
 			&& (response != status::OK || send_agent_states(out, agent_ids, agent_states, agent_state_count, sim.get_config()));
+	if (snapshot != nullptr)
+		sim.release_snapshot(*snapshot);
 	if (response == status::OK) {
 		free(agent_ids);
 		free(agent_states);
@@ -1446,14 +1856,236 @@ inline bool receive_is_active(
 	return success;
 }
 
+/* Precondition: `state.client_states_lock` must be held by the calling thread. */
+template<typename Stream, typename SimulatorData>
+inline bool receive_act_batch(
+		Stream& in, socket_type& connection,
+		server_state& state, uint64_t client_id,
+		simulator<SimulatorData>& sim)
+{
+	bool contains;
+	client_state* cstate = state.client_states.get(client_id, contains);
+	if (!contains) {
+		state.client_states_lock.unlock();
+		return true; /* the client was already destroyed */
+	}
+	cstate->lock.lock();
+	state.client_states_lock.unlock();
+
+	status response;
+	size_t action_count = 0;
+	uint64_t* agent_ids = nullptr;
+	action* actions = nullptr;
+	status* statuses = nullptr;
+	status* owned_statuses = nullptr;
+	bool success = true;
+	if (!read(action_count, in)) {
+		response = status::SERVER_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else {
+		agent_ids = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * action_count));
+		actions = (action*) malloc(max((size_t) 1, sizeof(action) * action_count));
+		statuses = (status*) malloc(max((size_t) 1, sizeof(status) * action_count));
+		owned_statuses = (status*) malloc(max((size_t) 1, sizeof(status) * action_count));
+		if (agent_ids == nullptr || actions == nullptr || statuses == nullptr || owned_statuses == nullptr) {
+			response = status::SERVER_OUT_OF_MEMORY;
+			success = false;
+		} else if (!read(agent_ids, in, action_count) || !read(actions, in, action_count)) {
+			response = status::SERVER_PARSE_MESSAGE_ERROR;
+			success = false;
+		} else {
+			/* move the actions of agents owned by this client to the front,
+			   preserving their order, and mark the remaining ones as invalid */
+			size_t owned_count = 0;
+			for (size_t i = 0; i < action_count; i++) {
+				if (agent_ids[i] == 0 || !cstate->agent_ids.contains(agent_ids[i])) {
+					statuses[i] = status::INVALID_AGENT_ID;
+				} else {
+					statuses[i] = status::OK;
+					agent_ids[owned_count] = agent_ids[i];
+					actions[owned_count] = actions[i];
+					owned_count++;
+				}
+			}
+
+			/* We have to unlock this to avoid deadlock since other simulator
+			   functions (i.e. `move`, `turn`, `do_nothing`) can cause the
+			   simulator to step. This calls `send_step_response` which needs the
+			   client_state locks. */
+			cstate->lock.unlock();
+			cstate = nullptr;
+
+			sim.act_batch(agent_ids, actions, owned_count, owned_statuses);
+
+			size_t next_owned = 0;
+			for (size_t i = 0; i < action_count; i++) {
+				if (statuses[i] != status::OK) continue;
+				statuses[i] = owned_statuses[next_owned++];
+				if (statuses[i] == status::OUT_OF_MEMORY)
+					statuses[i] = status::SERVER_OUT_OF_MEMORY;
+			}
+			response = status::OK;
+		}
+	}
+
+	memory_stream mem_stream = memory_stream((unsigned int) (sizeof(message_type) + sizeof(response) + sizeof(action_count) + sizeof(status) * action_count));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	success &= write(message_type::ACT_BATCH_RESPONSE, out) && write(response, out)
+			&& (response != status::OK || (write(action_count, out) && write(statuses, out, action_count)));
+	if (agent_ids != nullptr) free(agent_ids);
+	if (actions != nullptr) free(actions);
+	if (statuses != nullptr) free(statuses);
+	if (owned_statuses != nullptr) free(owned_statuses);
+	if (!success) {
+		if (cstate != nullptr)
+			cstate->lock.unlock();
+		return false;
+	}
+
+	if (cstate == nullptr) {
+		cstate = acquire_client_lock(state, client_id);
+		if (cstate == nullptr)
+			/* the client was destroyed while we didn't have the client lock */
+			return true;
+	}
+	success = send_message(connection, mem_stream.buffer, mem_stream.position);
+	cstate->lock.unlock();
+	return success;
+}
+
+/* Precondition: `state.client_states_lock` must be held by the calling thread. */
+template<typename Stream, typename SimulatorData>
+inline bool receive_enqueue_actions(
+		Stream& in, socket_type& connection,
+		server_state& state, uint64_t client_id,
+		simulator<SimulatorData>& sim)
+{
+	bool contains;
+	client_state* cstate = state.client_states.get(client_id, contains);
+	if (!contains) {
+		state.client_states_lock.unlock();
+		return true; /* the client was already destroyed */
+	}
+	cstate->lock.lock();
+	state.client_states_lock.unlock();
+
+	uint64_t agent_id = UINT64_MAX;
+	unsigned int action_count = 0;
+	action* actions = nullptr;
+	bool notify_when_drained;
+	status response;
+	bool success = true;
+	if (!read(agent_id, in) || !read(action_count, in)) {
+		response = status::SERVER_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else {
+		actions = (action*) malloc(max((size_t) 1, sizeof(action) * action_count));
+		if (actions == nullptr) {
+			response = status::SERVER_OUT_OF_MEMORY;
+			success = false;
+		} else if (!read(actions, in, action_count) || !read(notify_when_drained, in)) {
+			response = status::SERVER_PARSE_MESSAGE_ERROR;
+			success = false;
+		} else if (agent_id == 0 || !cstate->agent_ids.contains(agent_id)) {
+			response = status::INVALID_AGENT_ID;
+		} else {
+			/* We have to unlock this to avoid deadlock since other simulator
+			   functions (i.e. `move`, `turn`, `do_nothing`) can cause the
+			   simulator to step. This calls `send_step_response` which needs the
+			   client_state locks. */
+			cstate->lock.unlock();
+			cstate = nullptr;
+
+			response = sim.enqueue_actions(agent_id, actions, action_count, notify_when_drained);
+			if (response == status::OUT_OF_MEMORY)
+				response = status::SERVER_OUT_OF_MEMORY;
+		}
+	}
+	if (actions != nullptr) free(actions);
+
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(agent_id) + sizeof(response));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	success &= write(message_type::ENQUEUE_ACTIONS_RESPONSE, out)
+			&& write(agent_id, out) && write(response, out);
+	if (!success) {
+		if (cstate != nullptr)
+			cstate->lock.unlock();
+		return false;
+	}
+
+	if (cstate == nullptr) {
+		cstate = acquire_client_lock(state, client_id);
+		if (cstate == nullptr)
+			/* the client was destroyed while we didn't have the client lock */
+			return true;
+	}
+	success = send_message(connection, mem_stream.buffer, mem_stream.position);
+	cstate->lock.unlock();
+	return success;
+}
+
+/* Precondition: `state.client_states_lock` must be held by the calling thread. */
+template<typename Stream, typename SimulatorData>
+inline bool receive_enable_shared_observations(
+		Stream& in, socket_type& connection,
+		server_state& state, uint64_t client_id,
+		simulator<SimulatorData>& sim)
+{
+	bool contains;
+	client_state* cstate = state.client_states.get(client_id, contains);
+	if (!contains) {
+		state.client_states_lock.unlock();
+		return true; /* the client was already destroyed */
+	}
+	cstate->lock.lock();
+	state.client_states_lock.unlock();
+
+	unsigned int slot_count, agent_capacity;
+	status response = status::OK;
+	bool success = true;
+	int fd = -1;
+	if (!read(slot_count, in) || !read(agent_capacity, in)) {
+		response = status::SERVER_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else if (!cstate->perms.get_agent_states) {
+		/* the shared observations are the scent and vision in the agent states */
+		response = status::PERMISSION_ERROR;
+	} else if (!is_local_connection(connection)) {
+		/* the memory file can only be passed over a Unix domain socket */
+		response = status::SHARED_MEMORY_ERROR;
+	} else {
+		/* the observations of any earlier slots are no longer written */
+		free(cstate->observations);
+		if (!create(cstate->observations, slot_count, agent_capacity, sim.get_config(), fd))
+			response = status::SHARED_MEMORY_ERROR;
+	}
+
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(response) + sizeof(slot_count) + sizeof(agent_capacity));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	success &= write(message_type::ENABLE_SHARED_OBSERVATIONS_RESPONSE, out) && write(response, out);
+#if !defined(_WIN32)
+	if (response == status::OK) {
+		/* the client maps the memory file that is passed with the response */
+		success &= write(slot_count, out) && write(agent_capacity, out)
+				&& send_message(connection, mem_stream.buffer, mem_stream.position, fd);
+		::close(fd);
+		cstate->lock.unlock();
+		return success;
+	}
+#endif
+	success &= send_message(connection, mem_stream.buffer, mem_stream.position);
+	cstate->lock.unlock();
+	return success;
+}
+
 template<typename SimulatorData>
-void server_process_message(socket_type& connection,
+void server_process_message(socket_type& connection, buffered_socket& input,
 		hash_map<socket_type, client_info>& connections,
 		std::mutex& connection_set_lock,
 		simulator<SimulatorData>& sim, server_state& state)
 {
 	message_type type;
-	fixed_width_stream<socket_type> in(connection);
+	fixed_width_stream<buffered_socket> in(input);
 	connection_set_lock.lock();
 	uint64_t client_id = connections.get(connection).id;
 	connection_set_lock.unlock();
@@ -1484,7 +2116,11 @@ void server_process_message(socket_type& connection,
 		case message_type::DO_NOTHING:
 			receive_do_nothing(in, connection, state, client_id, sim); return;
 		case message_type::GET_MAP:
-			receive_get_map(in, connection, state, client_id, sim); return;
+			receive_get_map(in, connection, state, client_id, sim, false); return;
+		case message_type::GET_MAP_SINCE:
+			receive_get_map(in, connection, state, client_id, sim, true); return;
+		case message_type::GET_MAP_SUMMARY:
+			receive_get_map_summary(in, connection, state, client_id, sim); return;
 		case message_type::GET_AGENT_IDS:
 			receive_get_agent_ids(in, connection, state, client_id, sim); return;
 		case message_type::GET_AGENT_STATES:
@@ -1493,6 +2129,12 @@ void server_process_message(socket_type& connection,
 			receive_set_active(in, connection, state, client_id, sim); return;
 		case message_type::IS_ACTIVE:
 			receive_is_active(in, connection, state, client_id, sim); return;
+		case message_type::ACT_BATCH:
+			receive_act_batch(in, connection, state, client_id, sim); return;
+		case message_type::ENQUEUE_ACTIONS:
+			receive_enqueue_actions(in, connection, state, client_id, sim); return;
+		case message_type::ENABLE_SHARED_OBSERVATIONS:
+			receive_enable_shared_observations(in, connection, state, client_id, sim); return;
 
 		case message_type::ADD_AGENT_RESPONSE:
 		case message_type::REMOVE_AGENT_RESPONSE:
@@ -1504,11 +2146,16 @@ void server_process_message(socket_type& connection,
 		case message_type::TURN_RESPONSE:
 		case message_type::DO_NOTHING_RESPONSE:
 		case message_type::GET_MAP_RESPONSE:
+		case message_type::GET_MAP_SUMMARY_RESPONSE:
 		case message_type::GET_AGENT_IDS_RESPONSE:
 		case message_type::GET_AGENT_STATES_RESPONSE:
 		case message_type::SET_ACTIVE_RESPONSE:
 		case message_type::IS_ACTIVE_RESPONSE:
 		case message_type::STEP_RESPONSE:
+		case message_type::ACT_BATCH_RESPONSE:
+		case message_type::ENQUEUE_ACTIONS_RESPONSE:
+		case message_type::ENABLE_SHARED_OBSERVATIONS_RESPONSE:
+		case message_type::SHARED_STEP_RESPONSE:
 			break;
 	}
 	state.client_states_lock.unlock();
@@ -1520,9 +2167,22 @@ inline bool process_new_connection(
 		socket_type& connection, client_info& new_client,
 		simulator<SimulatorData>& sim, server_state& state)
 {
+	/* check that the client speaks the same version of the protocol */
+	uint32_t magic, version;
+	fixed_width_stream<socket_type> in(connection);
+	if (!read(magic, in) || magic != MPI_PROTOCOL_MAGIC
+	 || !read(version, in) || version != MPI_PROTOCOL_VERSION)
+	{
+		fprintf(stderr, "process_new_connection ERROR: Client does not speak protocol version %u.\n", MPI_PROTOCOL_VERSION);
+		memory_stream mem_stream = memory_stream(sizeof(status));
+		fixed_width_stream<memory_stream> out(mem_stream);
+		write(status::PROTOCOL_VERSION_MISMATCH, out);
+		send_message(connection, mem_stream.buffer, mem_stream.position);
+		return false;
+	}
+
 	/* read the client ID or `NEW_CLIENT_REQUEST` */
 	uint64_t client_id;
-	fixed_width_stream<socket_type> in(connection);
 	if (!read(client_id, in)) {
 		fprintf(stderr, "process_new_connection ERROR: Failed to read agent_count.\n");
 		memory_stream mem_stream = memory_stream(sizeof(status));
@@ -1588,6 +2248,9 @@ inline bool process_new_connection(
 		state.client_states_lock.unlock();
 		new_client.id = client_id;
 
+		/* the reconnecting client must enable shared observations again */
+		free(cstate.observations);
+
 		/* respond to the client */
 		memory_stream mem_stream = memory_stream(sizeof(status) + sizeof(unsigned int) + sizeof(sim.time) + sizeof(simulator_config));
 		fixed_width_stream<memory_stream> out(mem_stream);
@@ -1602,14 +2265,16 @@ inline bool process_new_connection(
 			return false;
 		}
 
-		agent_state** agent_states = (agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * cstate.agent_ids.length));
-		sim.get_agent_states(agent_states, cstate.agent_ids.data, (unsigned int) cstate.agent_ids.length);
+		const agent_state** agent_states = (const agent_state**) malloc(max((size_t) 1, sizeof(agent_state*) * cstate.agent_ids.length));
+		const observation_snapshot& snapshot = sim.get_agent_states(agent_states, cstate.agent_ids.data, (unsigned int) cstate.agent_ids.length);
 
 		if (!send_agent_states(out, cstate.agent_ids.data, agent_states, cstate.agent_ids.length, config)) {
+			sim.release_snapshot(snapshot);
 			cstate.lock.unlock();
 			fprintf(stderr, "process_new_connection ERROR: Error sending agent states.\n");
 			free(agent_states); return false;
 		}
+		sim.release_snapshot(snapshot);
 		free(agent_states);
 		cstate.lock.unlock();
 
@@ -1659,14 +2324,9 @@ inline bool send_step_response(
 		cstate->lock.lock();
 		server.state.client_states_lock.unlock();
 		const array<uint64_t>& agent_ids = cstate->agent_ids;
-		memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(unsigned int) +
+		memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(unsigned int) + sizeof(uint32_t) +
 				(unsigned int) agent_ids.length * (sizeof(uint64_t) + sizeof(agent_state)));
 		fixed_width_stream<memory_stream> out(mem_stream);
-		if (!write(message_type::STEP_RESPONSE, out)) {
-			cstate->lock.unlock();
-			success = false;
-			continue;
-		}
 
 		array<pair<uint64_t, const agent_state*>> agent_states(max((size_t) 1, agent_ids.length));
 		for (uint64_t agent_id : agent_ids) {
@@ -1677,19 +2337,51 @@ inline bool send_step_response(
 			agent_states[agent_states.length++] = {agent_id, agent_ptr};
 		}
 
+		/* if the client shares observation slots with the server, the agents
+		   fit, and the client has released the next slot, their scent and
+		   vision are copied into that slot rather than written into the
+		   response (otherwise, they are written inline, and the next step
+		   tries the same slot again) */
+		shared_observations& observations = cstate->observations;
+		uint32_t slot = NO_SHARED_SLOT;
+		float* shared = nullptr;
+		if (observations.is_mapped() && agent_states.length <= observations.agent_capacity
+		 && observations.is_free(observations.next_slot))
+		{
+			slot = observations.next_slot;
+			shared = observations.slot(slot, config);
+			observations.next_slot = (slot + 1) % observations.slot_count;
+		}
+
+		/* only clients that enabled shared observations receive the slot index */
 		bool client_success = true;
-		if (!write(agent_states.length, out)) {
-			client_success = false;
+		if (slot == NO_SHARED_SLOT) {
+			client_success = write(message_type::STEP_RESPONSE, out) && write(agent_states.length, out);
 		} else {
+			client_success = write(message_type::SHARED_STEP_RESPONSE, out)
+					&& write(agent_states.length, out) && write(slot, out);
+		}
+		if (client_success) {
 			for (const auto& entry : agent_states) {
-				if (!write(entry.key, out)
-				 || !write(*entry.value, out, config))
-				{
+				if (!write(entry.key, out)) {
 					client_success = false;
 					break;
+				} else if (shared == nullptr) {
+					client_success = write(*entry.value, out, config);
+				} else {
+					memcpy(shared, entry.value->current_scent, sizeof(float) * config.scent_dimension);
+					shared += config.scent_dimension;
+					size_t vision_size = shared_observations::observation_size(config) - config.scent_dimension;
+					memcpy(shared, entry.value->current_vision, sizeof(float) * vision_size);
+					shared += vision_size;
+					client_success = write_without_observations(*entry.value, out, config);
 				}
+				if (!client_success) break;
 			}
 		}
+		/* the client releases the slot once it, and every view of it, is done with it */
+		if (client_success && slot != NO_SHARED_SLOT)
+			observations.set_written(slot);
 		cstate->lock.unlock();
 		if (!client_success || !write_extra_data(out, std::forward<ExtraData>(extra_data)...)) {
 			success = false;
@@ -1713,12 +2405,16 @@ inline bool send_step_response(
  * \param worker_count The number of worker threads to dispatch. They are
  * 		tasked with processing incoming message from clients.
  * \param default_client_permissions The permissions of new clients.
+ * \param local_socket_path If not null, the server also listens on a Unix
+ * 		domain socket at this path, to which clients on the same host may
+ * 		connect with the address `unix:<path>`.
  * \returns `true` if successful; `false` otherwise.
  */
 template<typename SimulatorData>
 bool init_server(async_server& new_server, simulator<SimulatorData>& sim,
 		uint16_t server_port, unsigned int connection_queue_capacity,
-		unsigned int worker_count, const permissions& default_client_permissions)
+		unsigned int worker_count, const permissions& default_client_permissions,
+		const char* local_socket_path = nullptr)
 {
 #if !defined(_WIN32)
 	signal(SIGPIPE, SIG_IGN);
@@ -1726,7 +2422,7 @@ bool init_server(async_server& new_server, simulator<SimulatorData>& sim,
 
 	std::condition_variable cv; std::mutex lock;
 	auto dispatch = [&]() {
-		run_server(new_server.server_socket, server_port, connection_queue_capacity,
+		run_server(new_server.server_socket, server_port, local_socket_path, connection_queue_capacity,
 				worker_count, new_server.status, cv, lock, new_server.client_connections,
 				new_server.connection_set_lock, server_process_message<SimulatorData>,
 				process_new_connection<SimulatorData>, sim, new_server.state);
@@ -1762,12 +2458,16 @@ bool init_server(async_server& new_server, simulator<SimulatorData>& sim,
  * \param worker_count The number of worker threads to dispatch. They are
  * 		tasked with processing incoming message from clients.
  * \param default_client_permissions The permissions of new clients.
+ * \param local_socket_path If not null, the server also listens on a Unix
+ * 		domain socket at this path, to which clients on the same host may
+ * 		connect with the address `unix:<path>`.
  * \returns `true` if successful; `false` otherwise.
  */
 template<typename SimulatorData>
 inline bool init_server(sync_server& new_server, simulator<SimulatorData>& sim,
 		uint16_t server_port, unsigned int connection_queue_capacity,
-		unsigned int worker_count, uint64_t default_client_permissions)
+		unsigned int worker_count, uint64_t default_client_permissions,
+		const char* local_socket_path = nullptr)
 {
 #if !defined(_WIN32)
 	signal(SIGPIPE, SIG_IGN);
@@ -1778,7 +2478,7 @@ inline bool init_server(sync_server& new_server, simulator<SimulatorData>& sim,
 	new_server.state.default_client_permissions = default_client_permissions;
 	std::condition_variable cv; std::mutex lock;
 	return run_server(
-			server_socket, server_port, connection_queue_capacity,
+			server_socket, server_port, local_socket_path, connection_queue_capacity,
 			worker_count, dummy, cv, lock, new_server.client_connections,
 			new_server.connection_set_lock, server_process_message<SimulatorData>,
 			process_new_connection<SimulatorData>, sim, new_server.state);
@@ -1813,10 +2513,14 @@ struct client {
 	simulator_config config;
 	ClientData data;
 
+	/* the observation slots shared with the server, if they were enabled */
+	shared_observations observations;
+
 	static inline void free(client<ClientData>& c) {
 		c.response_listener.~thread();
 		core::free(c.config);
 		core::free(c.data);
+		core::free(c.observations);
 	}
 };
 
@@ -1831,6 +2535,7 @@ inline bool init(client<ClientData>& new_client) {
 		free(new_client.config);
 		return false;
 	}
+	init(new_client.observations);
 	new (&new_client.response_listener) std::thread();
 	return true;
 }
@@ -2031,6 +2736,50 @@ bool send_get_map(ClientType& c, position bottom_left, position top_right, bool
 		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
 }
 
+/**
+ * Sends a `get_map_since` message to the server from the client `c`, which
+ * retrieves only the patches that changed after `since_time` (see
+ * `simulator::get_map_since`). Once the server responds, the function
+ * `on_get_map` will be invoked, as with `send_get_map`.
+ *
+ * \param since_time Typically, the simulation time at which the client last
+ * 		retrieved this region.
+ * \returns `true` if the sending is successful; `false` otherwise.
+ */
+template<typename ClientType>
+bool send_get_map_since(ClientType& c, position bottom_left, position top_right,
+		uint64_t since_time, bool get_scent_map, bool get_vision_map)
+{
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + 2 * sizeof(position)
+			+ sizeof(get_scent_map) + sizeof(get_vision_map) + sizeof(since_time));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	return write(message_type::GET_MAP_SINCE, out)
+		&& write(bottom_left, out) && write(top_right, out)
+		&& write(get_scent_map, out) && write(get_vision_map, out)
+		&& write(since_time, out)
+		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
+}
+
+/**
+ * Sends a `get_map_summary` message to the server from the client `c`, which
+ * retrieves summaries of blocks of `block_size` by `block_size` patches (see
+ * `simulator::get_map_summary`). Once the server responds, the function
+ * `on_get_map_summary(ClientType&, status, array<array<patch_summary>>*)`
+ * will be invoked, where the third argument is uninitialized if the status
+ * is not OK. Memory ownership of the array is passed to `on_get_map_summary`.
+ *
+ * \returns `true` if the sending is successful; `false` otherwise.
+ */
+template<typename ClientType>
+bool send_get_map_summary(ClientType& c, position bottom_left, position top_right, unsigned int block_size) {
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + 2 * sizeof(position) + sizeof(block_size));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	return write(message_type::GET_MAP_SUMMARY, out)
+		&& write(bottom_left, out) && write(top_right, out)
+		&& write(block_size, out)
+		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
+}
+
 /**
  * Sends an `get_agent_ids` message to the server from the client `c`. Once the
  * server responds, the function
@@ -2111,13 +2860,108 @@ bool send_is_active(ClientType& c, uint64_t agent_id) {
 		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
 }
 
+/**
+ * Sends an `act_batch` message to the server from the client `c`, submitting
+ * the action `actions[i]` for the agent `agent_ids[i]`, for every `i` less
+ * than `action_count`. Once the server responds, the function
+ * `on_act_batch(ClientType&, status, status*, size_t)` will be invoked, where
+ * the first argument is `c`, the second is the response (OK if the batch was
+ * processed, and a different value if an error occurred), the third is the
+ * array of per-agent statuses, parallel to `agent_ids`, and the fourth is its
+ * length.
+ *
+ * \returns `true` if the sending is successful; `false` otherwise.
+ */
+template<typename ClientType>
+bool send_act_batch(ClientType& c, const uint64_t* agent_ids,
+		const action* actions, size_t action_count)
+{
+	memory_stream mem_stream = memory_stream((unsigned int) (sizeof(message_type) + sizeof(action_count) + (sizeof(uint64_t) + sizeof(action)) * action_count));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	return write(message_type::ACT_BATCH, out)
+		&& write(action_count, out)
+		&& write(agent_ids, out, action_count)
+		&& write(actions, out, action_count)
+		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
+}
+
+/**
+ * Sends an `enqueue_actions` message to the server from the client `c`,
+ * appending the given `actions` to the action queue of the agent with ID
+ * `agent_id`. The server performs one queued action per turn on behalf of the
+ * agent. If `notify_when_drained` is `true`, `agent_state::action_queue_drained`
+ * is set in the step response of the turn in which the last queued action is
+ * performed. Once the server responds to this message, the function
+ * `on_enqueue_actions(ClientType&, uint64_t, status)` will be invoked, where
+ * the first argument is `c`, the second is `agent_id`, and the third is the
+ * response: OK if successful, and a different value if an error occurred.
+ *
+ * \returns `true` if the sending is successful; `false` otherwise.
+ */
 template<typename ClientType>
-inline bool receive_add_agent_response(ClientType& c) {
+bool send_enqueue_actions(ClientType& c, uint64_t agent_id,
+		const action* actions, unsigned int action_count,
+		bool notify_when_drained)
+{
+	memory_stream mem_stream = memory_stream((unsigned int) (sizeof(message_type) + sizeof(agent_id) + sizeof(action_count) + sizeof(action) * action_count + sizeof(notify_when_drained)));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	return write(message_type::ENQUEUE_ACTIONS, out)
+		&& write(agent_id, out)
+		&& write(action_count, out)
+		&& write(actions, out, action_count)
+		&& write(notify_when_drained, out)
+		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
+}
+
+/**
+ * Sends an `enable_shared_observations` message to the server from the client
+ * `c`, which must be connected through a Unix domain socket (see
+ * `connect_client`). This asks the server to create a memory file with
+ * `slot_count` slots, each of which can hold the scent and vision of
+ * `agent_capacity` agents, and to pass it to the client, which maps it once
+ * it receives the response. Once the server responds, the function
+ * `on_enable_shared_observations(ClientType&, status)` will be invoked, where
+ * the first argument is `c` and the second is the response: OK if
+ * successful, PERMISSION_ERROR if the client may not get agent states, and
+ * SHARED_MEMORY_ERROR if the memory file could not be created, passed, or
+ * mapped (for example, if the client is connected over TCP, or if the server
+ * is not running on Linux).
+ *
+ * After this, whenever the client has at most `agent_capacity` agents and
+ * the next slot is free, the server writes their scent and vision into that
+ * slot rather than into the step response, and the `current_scent` and
+ * `current_vision` of the agent states given to `on_step` point into the
+ * slot. The slot is released once `on_step` returns, unless `on_step`
+ * retains it with `retain_slot`, in which case the server sends the
+ * observations of later steps inline rather than overwriting the slot until
+ * it is released with `release_slot`. Shared observations cannot be enabled
+ * more than once per connection.
+ *
+ * \returns `true` if the sending is successful; `false` otherwise.
+ */
+template<typename ClientType>
+bool send_enable_shared_observations(ClientType& c,
+		unsigned int slot_count, unsigned int agent_capacity)
+{
+	if (c.observations.is_mapped()) {
+		fprintf(stderr, "send_enable_shared_observations ERROR: Shared observations are already enabled.\n");
+		return false;
+	}
+
+	memory_stream mem_stream = memory_stream(sizeof(message_type) + sizeof(slot_count) + sizeof(agent_capacity));
+	fixed_width_stream<memory_stream> out(mem_stream);
+	return write(message_type::ENABLE_SHARED_OBSERVATIONS, out)
+		&& write(slot_count, out) && write(agent_capacity, out)
+		&& send_message(c.connection, mem_stream.buffer, mem_stream.position);
+}
+
+template<typename ClientType>
+inline bool receive_add_agent_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = UINT64_MAX;
 	bool success = true;
 	agent_state& state = *((agent_state*) alloca(sizeof(agent_state)));
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2133,11 +2977,11 @@ inline bool receive_add_agent_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_remove_agent_response(ClientType& c) {
+inline bool receive_remove_agent_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2147,11 +2991,11 @@ inline bool receive_remove_agent_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_add_semaphore_response(ClientType& c) {
+inline bool receive_add_semaphore_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t semaphore_id = UINT64_MAX;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2164,11 +3008,11 @@ inline bool receive_add_semaphore_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_remove_semaphore_response(ClientType& c) {
+inline bool receive_remove_semaphore_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t semaphore_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(semaphore_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2178,11 +3022,11 @@ inline bool receive_remove_semaphore_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_signal_semaphore_response(ClientType& c) {
+inline bool receive_signal_semaphore_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t semaphore_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(semaphore_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2192,11 +3036,11 @@ inline bool receive_signal_semaphore_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_get_semaphores_response(ClientType& c) {
+inline bool receive_get_semaphores_response(ClientType& c, buffered_socket& input) {
 	status response;
 	bool success = true;
 	size_t semaphore_count = 0;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in) || !read(semaphore_count, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2220,11 +3064,11 @@ inline bool receive_get_semaphores_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_move_response(ClientType& c) {
+inline bool receive_move_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2234,11 +3078,11 @@ inline bool receive_move_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_turn_response(ClientType& c) {
+inline bool receive_turn_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2248,11 +3092,11 @@ inline bool receive_turn_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_do_nothing_response(ClientType& c) {
+inline bool receive_do_nothing_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2262,11 +3106,11 @@ inline bool receive_do_nothing_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_get_map_response(ClientType& c) {
+inline bool receive_get_map_response(ClientType& c, buffered_socket& input) {
 	status response;
 	bool success = true;
 	array<array<patch_state>>* patches = NULL;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2287,12 +3131,37 @@ inline bool receive_get_map_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_get_agent_ids_response(ClientType& c) {
+inline bool receive_get_map_summary_response(ClientType& c, buffered_socket& input) {
+	status response;
+	bool success = true;
+	array<array<patch_summary>>* blocks = NULL;
+	fixed_width_stream<buffered_socket> in(input);
+	if (!read(response, in)) {
+		response = status::CLIENT_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else if (response == status::OK) {
+		blocks = (array<array<patch_summary>>*) malloc(sizeof(array<array<patch_summary>>));
+		if (blocks == NULL) {
+			fprintf(stderr, "receive_get_map_summary_response ERROR: Out of memory.\n");
+			response = status::CLIENT_OUT_OF_MEMORY;
+			success = false;
+		} else if (!read(*blocks, in, c.config)) {
+			response = status::CLIENT_PARSE_MESSAGE_ERROR;
+			free(blocks); success = false;
+		}
+	}
+	/* ownership of `blocks` is passed to the callee */
+	on_get_map_summary(c, response, blocks);
+	return success;
+}
+
+template<typename ClientType>
+inline bool receive_get_agent_ids_response(ClientType& c, buffered_socket& input) {
 	status response;
 	bool success = true;
 	size_t agent_count = 0;
 	uint64_t* agent_ids = nullptr;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in) || !read(agent_count, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2346,13 +3215,13 @@ inline status read_agent_states(
 }
 
 template<typename ClientType>
-inline bool receive_get_agent_states_response(ClientType& c) {
+inline bool receive_get_agent_states_response(ClientType& c, buffered_socket& input) {
 	status response;
 	bool success = true;
 	size_t agent_count = 0;
 	uint64_t* agent_ids = nullptr;
 	agent_state* agent_states = nullptr;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2367,11 +3236,11 @@ inline bool receive_get_agent_states_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_set_active_response(ClientType& c) {
+inline bool receive_set_active_response(ClientType& c, buffered_socket& input) {
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2381,12 +3250,12 @@ inline bool receive_set_active_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_is_active_response(ClientType& c) {
+inline bool receive_is_active_response(ClientType& c, buffered_socket& input) {
 	bool active = false;
 	status response;
 	uint64_t agent_id = 0;
 	bool success = true;
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	if (!read(agent_id, in) || !read(response, in)) {
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		success = false;
@@ -2399,17 +3268,111 @@ inline bool receive_is_active_response(ClientType& c) {
 }
 
 template<typename ClientType>
-inline bool receive_step_response(ClientType& c) {
+inline bool receive_act_batch_response(ClientType& c, buffered_socket& input) {
+	status response;
+	bool success = true;
+	size_t action_count = 0;
+	status* statuses = nullptr;
+	fixed_width_stream<buffered_socket> in(input);
+	if (!read(response, in)) {
+		response = status::CLIENT_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else if (response == status::OK) {
+		if (!read(action_count, in)) {
+			response = status::CLIENT_PARSE_MESSAGE_ERROR;
+			success = false;
+		} else {
+			statuses = (status*) malloc(max((size_t) 1, sizeof(status) * action_count));
+			if (statuses == nullptr) {
+				response = status::CLIENT_OUT_OF_MEMORY;
+				action_count = 0; success = false;
+			} else if (!read(statuses, in, action_count)) {
+				response = status::CLIENT_PARSE_MESSAGE_ERROR;
+				free(statuses); statuses = nullptr;
+				action_count = 0; success = false;
+			}
+		}
+	}
+	/* ownership of `statuses` is passed to the callee */
+	on_act_batch(c, response, statuses, action_count);
+	return success;
+}
+
+template<typename ClientType>
+inline bool receive_enqueue_actions_response(ClientType& c, buffered_socket& input) {
+	status response;
+	uint64_t agent_id = 0;
+	bool success = true;
+	fixed_width_stream<buffered_socket> in(input);
+	if (!read(agent_id, in) || !read(response, in)) {
+		response = status::CLIENT_PARSE_MESSAGE_ERROR;
+		success = false;
+	}
+	on_enqueue_actions(c, agent_id, response);
+	return success;
+}
+
+template<typename ClientType>
+inline bool receive_enable_shared_observations_response(ClientType& c, buffered_socket& input) {
+	status response;
+	unsigned int slot_count, agent_capacity;
+	bool success = true;
+	fixed_width_stream<buffered_socket> in(input);
+	if (!read(response, in)) {
+		response = status::CLIENT_PARSE_MESSAGE_ERROR;
+		success = false;
+	} else if (response == status::OK) {
+#if defined(_WIN32)
+		response = status::SHARED_MEMORY_ERROR;
+#else
+		/* the memory file is passed with the response */
+		int fd = input.received_fd;
+		input.received_fd = -1;
+		if (!read(slot_count, in) || !read(agent_capacity, in)) {
+			response = status::CLIENT_PARSE_MESSAGE_ERROR;
+			success = false;
+		} else if (fd == -1) {
+			fprintf(stderr, "receive_enable_shared_observations_response ERROR: The server did not pass a memory file.\n");
+			response = status::SHARED_MEMORY_ERROR;
+		} else if (!init(c.observations, fd, slot_count, agent_capacity, c.config)) {
+			response = status::SHARED_MEMORY_ERROR;
+		}
+		if (fd != -1) ::close(fd);
+#endif
+	}
+	on_enable_shared_observations(c, response);
+	return success;
+}
+
+template<typename ClientType>
+inline bool receive_step_response(ClientType& c, buffered_socket& input, bool has_slot) {
 	bool success = true;
 	status response = status::OK;
 	array<uint64_t>& agent_ids = *((array<uint64_t>*) alloca(sizeof(array<uint64_t>)));
 
-	fixed_width_stream<socket_type> in(c.connection);
+	fixed_width_stream<buffered_socket> in(input);
 	agent_state* agents = nullptr;
-	if (!read(agent_ids.length, in)) {
+	uint32_t slot = NO_SHARED_SLOT;
+	shared_mapping* mapping = nullptr;
+	float* shared = nullptr;
+	const size_t observation_size = shared_observations::observation_size(c.config);
+	if (!read(agent_ids.length, in) || (has_slot && !read(slot, in))) {
+		response = status::CLIENT_PARSE_MESSAGE_ERROR;
+		agent_ids.data = nullptr; success = false;
+	} else if (slot != NO_SHARED_SLOT && (!c.observations.is_mapped()
+			|| slot >= c.observations.slot_count || agent_ids.length > c.observations.agent_capacity))
+	{
+		fprintf(stderr, "receive_step_response ERROR: Invalid shared observation slot.\n");
 		response = status::CLIENT_PARSE_MESSAGE_ERROR;
 		agent_ids.data = nullptr; success = false;
 	} else {
+		if (slot != NO_SHARED_SLOT) {
+			/* the slot is retained until `on_step` returns, so that the server
+			   does not overwrite it in the meantime */
+			mapping = c.observations.mapping;
+			retain_slot(*mapping, slot);
+			shared = c.observations.slot(slot, c.config);
+		}
 		agent_ids.data = (uint64_t*) malloc(max((size_t) 1, sizeof(uint64_t) * agent_ids.length));
 		agents = (agent_state*) malloc(max((size_t) 1, sizeof(agent_state) * agent_ids.length));
 		if (agents == nullptr || agent_ids.data == nullptr) {
@@ -2420,10 +3383,19 @@ inline bool receive_step_response(ClientType& c) {
 		} else {
 			agent_ids.capacity = agent_ids.length;
 			for (unsigned int i = 0; i < agent_ids.length; i++) {
+				float* scent = (shared == nullptr) ? nullptr : shared + i * observation_size;
 				if (!read(agent_ids[i], in)
-				 || !read(agents[i], in, c.config))
+				 || (shared == nullptr && !read(agents[i], in, c.config))
+				 || (shared != nullptr && !read_without_observations(agents[i], in,
+						c.config, scent, scent + c.config.scent_dimension)))
 				{
-					for (unsigned int j = 0; j < i; j++) free(agents[j]);
+					for (unsigned int j = 0; j < i; j++) {
+						if (shared != nullptr) {
+							agents[j].current_scent = nullptr;
+							agents[j].current_vision = nullptr;
+						}
+						free(agents[j]);
+					}
 					response = status::CLIENT_PARSE_MESSAGE_ERROR;
 					free(agents); free(agent_ids); agents = nullptr;
 					success = false; break;
@@ -2434,19 +3406,29 @@ inline bool receive_step_response(ClientType& c) {
 
 	on_step(c, response, (const array<uint64_t>&) agent_ids, (const agent_state*) agents);
 	if (agent_ids.data != NULL) {
-		for (unsigned int i = 0; i < agent_ids.length; i++)
+		for (unsigned int i = 0; i < agent_ids.length; i++) {
+			/* the shared observations are owned by `mapping` */
+			if (shared != nullptr) {
+				agents[i].current_scent = nullptr;
+				agents[i].current_vision = nullptr;
+			}
 			free(agents[i]);
+		}
 		free(agent_ids);
 	}
 	if (agents != NULL) free(agents);
+	if (mapping != nullptr) release_slot(mapping, slot);
 	return success;
 }
 
 template<typename ClientType>
 void run_response_listener(ClientType& c) {
+	buffered_socket input(c.connection);
 	while (c.client_running) {
 		message_type type;
-		while (true) {
+		/* responses that were already received into the buffer are processed
+		   without waiting on the socket, since `select` would not report them */
+		while (!input.has_buffered_data()) {
 			wait_result result = wait_for_socket(c.connection, 0, 100000);
 			if (!c.client_running) {
 				return; /* stop_client was called */
@@ -2460,7 +3442,7 @@ void run_response_listener(ClientType& c) {
 			}
 		}
 
-		bool success = read(type, c.connection);
+		bool success = read(type, input);
 		if (!c.client_running) {
 			return; /* stop_client was called */
 		} else if (!success) {
@@ -2469,35 +3451,45 @@ void run_response_listener(ClientType& c) {
 		}
 		switch (type) {
 		case message_type::ADD_AGENT_RESPONSE:
-			receive_add_agent_response(c); continue;
+			receive_add_agent_response(c, input); continue;
 		case message_type::REMOVE_AGENT_RESPONSE:
-			receive_remove_agent_response(c); continue;
+			receive_remove_agent_response(c, input); continue;
 		case message_type::ADD_SEMAPHORE_RESPONSE:
-			receive_add_semaphore_response(c); continue;
+			receive_add_semaphore_response(c, input); continue;
 		case message_type::REMOVE_SEMAPHORE_RESPONSE:
-			receive_remove_semaphore_response(c); continue;
+			receive_remove_semaphore_response(c, input); continue;
 		case message_type::SIGNAL_SEMAPHORE_RESPONSE:
-			receive_signal_semaphore_response(c); continue;
+			receive_signal_semaphore_response(c, input); continue;
 		case message_type::GET_SEMAPHORES_RESPONSE:
-			receive_get_semaphores_response(c); continue;
+			receive_get_semaphores_response(c, input); continue;
 		case message_type::MOVE_RESPONSE:
-			receive_move_response(c); continue;
+			receive_move_response(c, input); continue;
 		case message_type::TURN_RESPONSE:
-			receive_turn_response(c); continue;
+			receive_turn_response(c, input); continue;
 		case message_type::DO_NOTHING_RESPONSE:
-			receive_do_nothing_response(c); continue;
+			receive_do_nothing_response(c, input); continue;
 		case message_type::GET_MAP_RESPONSE:
-			receive_get_map_response(c); continue;
+			receive_get_map_response(c, input); continue;
+		case message_type::GET_MAP_SUMMARY_RESPONSE:
+			receive_get_map_summary_response(c, input); continue;
 		case message_type::GET_AGENT_IDS_RESPONSE:
-			receive_get_agent_ids_response(c); continue;
+			receive_get_agent_ids_response(c, input); continue;
 		case message_type::GET_AGENT_STATES_RESPONSE:
-			receive_get_agent_states_response(c); continue;
+			receive_get_agent_states_response(c, input); continue;
 		case message_type::SET_ACTIVE_RESPONSE:
-			receive_set_active_response(c); continue;
+			receive_set_active_response(c, input); continue;
 		case message_type::IS_ACTIVE_RESPONSE:
-			receive_is_active_response(c); continue;
+			receive_is_active_response(c, input); continue;
 		case message_type::STEP_RESPONSE:
-			receive_step_response(c); continue;
+			receive_step_response(c, input, false); continue;
+		case message_type::SHARED_STEP_RESPONSE:
+			receive_step_response(c, input, true); continue;
+		case message_type::ACT_BATCH_RESPONSE:
+			receive_act_batch_response(c, input); continue;
+		case message_type::ENQUEUE_ACTIONS_RESPONSE:
+			receive_enqueue_actions_response(c, input); continue;
+		case message_type::ENABLE_SHARED_OBSERVATIONS_RESPONSE:
+			receive_enable_shared_observations_response(c, input); continue;
 
 		case message_type::ADD_AGENT:
 		case message_type::REMOVE_AGENT:
@@ -2510,10 +3502,15 @@ void run_response_listener(ClientType& c) {
 		case message_type::TURN:
 		case message_type::DO_NOTHING:
 		case message_type::GET_MAP:
+		case message_type::GET_MAP_SINCE:
+		case message_type::GET_MAP_SUMMARY:
 		case message_type::GET_AGENT_IDS:
 		case message_type::GET_AGENT_STATES:
 		case message_type::SET_ACTIVE:
 		case message_type::IS_ACTIVE:
+		case message_type::ACT_BATCH:
+		case message_type::ENQUEUE_ACTIONS:
+		case message_type::ENABLE_SHARED_OBSERVATIONS:
 			break;
 		}
 		fprintf(stderr, "run_response_listener ERROR: Received invalid message type from server %" PRId64 ".\n", (uint64_t) type);
@@ -2528,7 +3525,8 @@ void run_response_listener(ClientType& c) {
  *
  * \param new_client The client with which to attempt the connection.
  * \param server_address A null-terminated string containing the server
- * 		address.
+ * 		address, or `unix:<path>` to connect to the Unix domain socket at
+ * 		`<path>`, in which case the port is ignored.
  * \param server_port A null-terminated string containing the server port.
  * \returns The simulator time if successful; `UINT64_MAX` otherwise.
  */
@@ -2546,10 +3544,12 @@ uint64_t connect_client(client<ClientData>& new_client,
 	{
 		new_client.connection = connection;
 
-		/* send the client ID */
-		memory_stream mem_stream = memory_stream(sizeof(uint64_t));
+		/* send the protocol version and the client ID */
+		memory_stream mem_stream = memory_stream(2 * sizeof(uint32_t) + sizeof(uint64_t));
 		fixed_width_stream<memory_stream> out(mem_stream);
-		if (!write(NEW_CLIENT_REQUEST, out)
+		if (!write(MPI_PROTOCOL_MAGIC, out)
+		 || !write(MPI_PROTOCOL_VERSION, out)
+		 || !write(NEW_CLIENT_REQUEST, out)
 		 || !send_message(connection, mem_stream.buffer, mem_stream.position))
 		{
 			fprintf(stderr, "connect_client ERROR: Error connecting new client.\n");
@@ -2563,6 +3563,13 @@ uint64_t connect_client(client<ClientData>& new_client,
 			fprintf(stderr, "connect_client ERROR: Error receiving response from server.\n");
 			stop_client(new_client); return false;
 		}
+		if (response == status::PROTOCOL_VERSION_MISMATCH) {
+			fprintf(stderr, "connect_client ERROR: Server does not speak protocol version %u.\n", MPI_PROTOCOL_VERSION);
+			stop_client(new_client); return false;
+		} else if (response != status::OK) {
+			fprintf(stderr, "connect_client ERROR: Server rejected the connection.\n");
+			stop_client(new_client); return false;
+		}
 
 		/* read the simulator time and configuration */
 		simulator_config& config = *((simulator_config*) alloca(sizeof(simulator_config)));
@@ -2598,7 +3605,8 @@ uint64_t connect_client(client<ClientData>& new_client,
  * \param existing_client The client with which to attempt the connection.
  * \param client_id The ID of the client.
  * \param server_address A null-terminated string containing the server
- * 		address.
+ * 		address, or `unix:<path>` to connect to the Unix domain socket at
+ * 		`<path>`, in which case the port is ignored.
  * \param server_port A null-terminated string containing the server port.
  * \param agent_ids An array of agent IDs governed by this client, of length
  * 		`agent_count`.
@@ -2624,10 +3632,12 @@ uint64_t reconnect_client(
 	{
 		existing_client.connection = connection;
 
-		/* send the client ID */
-		memory_stream mem_stream = memory_stream(sizeof(uint64_t));
+		/* send the protocol version and the client ID */
+		memory_stream mem_stream = memory_stream(2 * sizeof(uint32_t) + sizeof(uint64_t));
 		fixed_width_stream<memory_stream> out(mem_stream);
-		if (!write(client_id, out)
+		if (!write(MPI_PROTOCOL_MAGIC, out)
+		 || !write(MPI_PROTOCOL_VERSION, out)
+		 || !write(client_id, out)
 		 || !send_message(connection, mem_stream.buffer, mem_stream.position))
 		{
 			fprintf(stderr, "reconnect_client ERROR: Error requesting agent states.\n");
@@ -2641,6 +3651,13 @@ uint64_t reconnect_client(
 			fprintf(stderr, "reconnect_client ERROR: Error receiving response from server.\n");
 			remove_client(existing_client); return false;
 		}
+		if (response == status::PROTOCOL_VERSION_MISMATCH) {
+			fprintf(stderr, "reconnect_client ERROR: Server does not speak protocol version %u.\n", MPI_PROTOCOL_VERSION);
+			remove_client(existing_client); return false;
+		} else if (response != status::OK) {
+			fprintf(stderr, "reconnect_client ERROR: Server rejected the connection.\n");
+			remove_client(existing_client); return false;
+		}
 
 		/* read the simulator time and configuration */
 		size_t s_semaphore_count;
@@ -2693,7 +3710,8 @@ uint64_t reconnect_client(
  *
  * \param new_client The client with which to attempt the connection.
  * \param server_address A null-terminated string containing the server
- * 		address.
+ * 		address, or `unix:<path>` to connect to the Unix domain socket at
+ * 		`<path>`, in which case the port is ignored.
  * \param server_port The server port.
  * \param client_id The ID assigned to this new client by the server.
  * \param agent_count The lengths of `agent_ids` and `agent_states`.
@@ -2721,7 +3739,8 @@ uint64_t connect_client(client<ClientData>& new_client,
  * \param existing_client The client with which to attempt the connection.
  * \param client_id The ID of the client.
  * \param server_address A null-terminated string containing the server
- * 		address.
+ * 		address, or `unix:<path>` to connect to the Unix domain socket at
+ * 		`<path>`, in which case the port is ignored.
  * \param server_port The server port.
  * \param agent_ids An array of agent IDs governed by this client, of length
  * 		`agent_count`.
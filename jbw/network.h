@@ -21,6 +21,7 @@
 #include <core/map.h>
 #include <stdio.h>
 #include <thread>
+#include <atomic>
 #include <condition_variable>
 
 #if defined(_WIN32) /* on Windows */
@@ -31,14 +32,19 @@ typedef int socklen_t;
 #elif __APPLE__ /* on Mac */
 #include <sys/event.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
 #include <sys/time.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
 
 #else /* on Linux */
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
 #include <netdb.h>
 #include <unistd.h>
 #include <netinet/tcp.h>
@@ -46,6 +52,7 @@ typedef int socklen_t;
 
 
 #define EVENT_QUEUE_CAPACITY 1024
+#define SOCKET_BUFFER_CAPACITY 16384
 
 
 /** A structure with no contents. */
@@ -151,7 +158,7 @@ struct socket_listener {
 		return true;
 	}
 
-	inline bool update_socket(socket_type& socket) {
+	inline bool update_socket(unsigned int worker_id, socket_type& socket) {
 		OVERLAPPED* overlapped = (OVERLAPPED*) calloc(1, sizeof(OVERLAPPED));
 		DWORD bytes_received = 0;
 		DWORD flags = MSG_PEEK;
@@ -170,7 +177,7 @@ struct socket_listener {
 		return true;
 	}
 
-	inline bool remove_socket(socket_type& socket) const { return true; }
+	inline bool remove_socket(unsigned int worker_id, socket_type& socket) const { return true; }
 
 	template<typename AcceptedConnectionCallback, typename... CallbackArgs>
 	inline bool accept(socket_type& server_socket, AcceptedConnectionCallback callback, CallbackArgs&&... callback_args)
@@ -216,7 +223,7 @@ struct socket_listener {
 	}
 
 	template<typename IsRunningFunction>
-	inline bool listen(socket_type& connection, IsRunningFunction is_running) {
+	inline bool listen(unsigned int worker_id, socket_type& connection, IsRunningFunction is_running) {
 		ULONG_PTR completion_key = NULL;
 		DWORD bytes_transferred;
 		OVERLAPPED* overlapped;
@@ -260,7 +267,9 @@ struct socket_listener {
 		const char* error_message = "socket_listener.add_socket ERROR: Failed to listen to socket")
 	{
 		struct kevent new_event;
-		EV_SET(&new_event, socket.handle, EVFILT_READ, EV_ADD | (!ServerSocket ? EV_ONESHOT : 0), 0, 0, NULL);
+		/* server sockets are marked with a non-null `udata`, since there may
+		   be more than one (for example, a TCP and a Unix domain socket) */
+		EV_SET(&new_event, socket.handle, EVFILT_READ, EV_ADD | (!ServerSocket ? EV_ONESHOT : 0), 0, 0, ServerSocket ? this : NULL);
 		if (kevent(listener, &new_event, 1, NULL, 0, NULL) == -1) {
 			if (errno == EBADF)
 				return true; /* server is shutting down */
@@ -273,11 +282,11 @@ struct socket_listener {
 	inline bool add_server_socket(socket_type& socket) { return add_socket<true>(socket); }
 	inline bool add_client_socket(socket_type& socket) { return add_socket<false>(socket); }
 
-	inline bool update_socket(socket_type& socket) {
+	inline bool update_socket(unsigned int worker_id, socket_type& socket) {
 		return add_socket<false>(socket, "socket_listener.update_socket ERROR: Failed to modify listen event");
 	}
 
-	inline bool remove_socket(socket_type& socket) const {
+	inline bool remove_socket(unsigned int worker_id, socket_type& socket) const {
 		return true;
 	}
 
@@ -292,11 +301,11 @@ struct socket_listener {
 		for (int i = 0; i < event_count; i++) {
 			socket_type socket = (int) events[i].ident;
 
-			if (socket == server_socket) {
-				/* there's a new connection on the server socket */
+			if (events[i].udata != NULL) {
+				/* there's a new connection on a server socket */
 				sockaddr_storage client_address;
 				socklen_t address_size = sizeof(client_address);
-				socket_type connection = ::accept(server_socket.handle, (sockaddr*) &client_address, &address_size);
+				socket_type connection = ::accept(socket.handle, (sockaddr*) &client_address, &address_size);
 				if (!connection.is_valid()) {
 					if (errno == EINVAL)
 						return true; /* the server is shutting down */
@@ -320,7 +329,7 @@ struct socket_listener {
 	}
 
 	template<typename IsRunningFunction>
-	inline bool listen(socket_type& connection, IsRunningFunction is_running) {
+	inline bool listen(unsigned int worker_id, socket_type& connection, IsRunningFunction is_running) {
 		std::unique_lock<std::mutex> lck(event_queue_lock);
 		while (event_queue.length == 0 && is_running())
 			cv.wait(lck);
@@ -335,44 +344,84 @@ struct socket_listener {
 	}
 
 #else /* on Linux */
+	/* Each worker waits on its own epoll instance, which holds only the
+	   connections assigned to that worker, so events go directly from the
+	   kernel to the worker that owns the connection. */
+	struct worker_listener {
+		int listener;
+		epoll_event events[EVENT_QUEUE_CAPACITY];
+		int event_count;
+		int next_event;
+		std::atomic<unsigned int> connection_count;
+
+		worker_listener() : listener(-1), event_count(0), next_event(0), connection_count(0) { }
+	};
+
+	/* the epoll instance for the server socket, used by `accept` */
 	int listener;
 	epoll_event events[EVENT_QUEUE_CAPACITY];
-	array<socket_type> event_queue;
-	std::condition_variable cv;
-	std::mutex event_queue_lock;
+	worker_listener* workers;
+	unsigned int worker_count;
 
-	socket_listener() : event_queue(EVENT_QUEUE_CAPACITY) { }
+	/* an eventfd in every worker's epoll instance, which is signaled by
+	   `free` to wake the workers when the server is stopping */
+	int wakeup;
 
-	template<bool ServerSocket>
-	inline bool add_socket(socket_type& socket) {
+	socket_listener() : listener(-1), workers(nullptr), worker_count(0), wakeup(-1) { }
+
+	~socket_listener() {
+		if (workers != nullptr) {
+			for (unsigned int i = 0; i < worker_count; i++)
+				if (workers[i].listener != -1) ::close(workers[i].listener);
+			delete[] workers;
+		}
+		if (wakeup != -1) ::close(wakeup);
+		if (listener != -1) ::close(listener);
+	}
+
+	inline bool add_socket(int epoll, int fd, uint32_t events) {
 		epoll_event new_event = {};
-		new_event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP | (!ServerSocket ? EPOLLONESHOT : 0);
-		new_event.data.fd = socket.handle;
-		if (epoll_ctl(listener, EPOLL_CTL_ADD, socket.handle, &new_event) == -1) {
+		new_event.events = events;
+		new_event.data.fd = fd;
+		if (epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &new_event) == -1) {
 			listener_error("socket_listener.add_socket ERROR: Failed to listen to socket");
 			return false;
 		}
 		return true;
 	}
 
-	inline bool add_server_socket(socket_type& socket) { return add_socket<true>(socket); }
-	inline bool add_client_socket(socket_type& socket) { return add_socket<false>(socket); }
+	inline bool add_server_socket(socket_type& socket) {
+		return add_socket(listener, socket.handle, EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP);
+	}
+
+	/* assigns the connection to the worker with the fewest connections */
+	inline bool add_client_socket(socket_type& socket) {
+		unsigned int worker_id = 0;
+		for (unsigned int i = 1; i < worker_count; i++)
+			if (workers[i].connection_count < workers[worker_id].connection_count) worker_id = i;
+		if (!add_socket(workers[worker_id].listener, socket.handle, EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP | EPOLLONESHOT))
+			return false;
+		workers[worker_id].connection_count++;
+		return true;
+	}
 
-	inline bool update_socket(socket_type& socket) {
+	inline bool update_socket(unsigned int worker_id, socket_type& socket) {
 		epoll_event new_event = {};
 		new_event.events = EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP | EPOLLONESHOT;
 		new_event.data.fd = socket.handle;
-		if (epoll_ctl(listener, EPOLL_CTL_MOD, socket.handle, &new_event) == -1) {
+		if (epoll_ctl(workers[worker_id].listener, EPOLL_CTL_MOD, socket.handle, &new_event) == -1) {
 			if (errno == EBADF)
 				return true; /* server is shutting down */
 			listener_error("socket_listener.update_socket ERROR: Failed to modify listen event");
+			workers[worker_id].connection_count--;
 			shutdown(socket.handle, 2); return false;
 		}
 		return true;
 	}
 
-	inline bool remove_socket(socket_type& socket) {
-		if (epoll_ctl(listener, EPOLL_CTL_DEL, socket.handle, NULL) == -1) {
+	inline bool remove_socket(unsigned int worker_id, socket_type& socket) {
+		workers[worker_id].connection_count--;
+		if (epoll_ctl(workers[worker_id].listener, EPOLL_CTL_DEL, socket.handle, NULL) == -1) {
 			listener_error("socket_listener.remove_socket ERROR: Failed to remove listen event");
 			return false;
 		}
@@ -388,53 +437,60 @@ struct socket_listener {
 		}
 
 		for (int i = 0; i < event_count; i++) {
-			socket_type socket = events[i].data.fd;
-
-			if (socket == server_socket) {
-				/* there's a new connection on the server socket */
-				sockaddr_storage client_address;
-				socklen_t address_size = sizeof(client_address);
-				socket_type connection = ::accept(server_socket.handle, (sockaddr*) &client_address, &address_size);
-				if (!connection.is_valid()) {
-					if (errno == EINVAL)
-						return true; /* the server is shutting down */
-					perror("socket_listener.accept ERROR: Error establishing connection with client");
-					return false;
-				}
-
-				if (!add_client_socket(connection)) {
-					shutdown(connection.handle, 2); continue;
-				}
+			/* there's a new connection on one of the server sockets */
+			sockaddr_storage client_address;
+			socklen_t address_size = sizeof(client_address);
+			socket_type connection = ::accept(events[i].data.fd, (sockaddr*) &client_address, &address_size);
+			if (!connection.is_valid()) {
+				if (errno == EINVAL)
+					return true; /* the server is shutting down */
+				perror("socket_listener.accept ERROR: Error establishing connection with client");
+				return false;
+			}
 
-				callback(connection, std::forward<CallbackArgs>(callback_args)...);
-			} else {
-				/* there is an event on a client connection */
-				std::unique_lock<std::mutex> lck(event_queue_lock);
-				event_queue.add(socket);
-				cv.notify_one();
+			if (!add_client_socket(connection)) {
+				shutdown(connection.handle, 2); continue;
 			}
+
+			callback(connection, std::forward<CallbackArgs>(callback_args)...);
 		}
 		return true;
 	}
 
 	template<typename IsRunningFunction>
-	inline bool listen(socket_type& connection, IsRunningFunction is_running) {
-		std::unique_lock<std::mutex> lck(event_queue_lock);
-		while (event_queue.length == 0 && is_running())
-			cv.wait(lck);
-		if (is_running())
-			connection = event_queue.pop();
+	inline bool listen(unsigned int worker_id, socket_type& connection, IsRunningFunction is_running) {
+		worker_listener& worker = workers[worker_id];
+		while (is_running()) {
+			if (worker.next_event < worker.event_count) {
+				int fd = worker.events[worker.next_event++].data.fd;
+				if (fd == wakeup) continue;
+				connection = fd;
+				return true;
+			}
+
+			int event_count = epoll_wait(worker.listener, worker.events, EVENT_QUEUE_CAPACITY, -1);
+			if (event_count == -1) {
+				if (errno == EINTR) continue;
+				listener_error("socket_listener.listen ERROR: Error listening for incoming network activity");
+				return false;
+			}
+			worker.event_count = event_count;
+			worker.next_event = 0;
+		}
 		return true;
 	}
 
+	/* wakes the workers; the epoll instances are closed by the destructor,
+	   once the workers have returned */
 	static inline void free(socket_listener& listener, unsigned int thread_count) {
-		listener.cv.notify_all();
-		::close(listener.listener);
+		uint64_t value = 1;
+		if (::write(listener.wakeup, &value, sizeof(value)) == -1)
+			listener_error("socket_listener.free ERROR: Failed to wake worker threads");
 	}
 #endif
 };
 
-inline bool init(socket_listener& listener) {
+inline bool init(socket_listener& listener, unsigned int worker_count) {
 #if defined(_WIN32)
 	listener.buffer_wrapper.buf = listener.buffer;
 	listener.buffer_wrapper.len = 4;
@@ -445,7 +501,15 @@ inline bool init(socket_listener& listener) {
 	bool success = (listener.listener != -1);
 #else
 	listener.listener = epoll_create1(0);
-	bool success = (listener.listener != -1);
+	listener.wakeup = eventfd(0, 0);
+	listener.workers = new socket_listener::worker_listener[worker_count];
+	listener.worker_count = worker_count;
+	bool success = (listener.listener != -1 && listener.wakeup != -1);
+	for (unsigned int i = 0; success && i < worker_count; i++) {
+		listener.workers[i].listener = epoll_create1(0);
+		success = (listener.workers[i].listener != -1
+				&& listener.add_socket(listener.workers[i].listener, listener.wakeup, EPOLLIN));
+	}
 #endif
 	if (!success) {
 		listener_error("init ERROR: Unable to initialize socket listener");
@@ -512,6 +576,140 @@ inline bool read(T* values, socket_type& in, unsigned int length)
 	return (recv(in.handle, (char*) values, sizeof(T) * length, MSG_WAITALL) > 0);
 }
 
+/**
+ * An input stream over a socket that receives as many bytes as are available,
+ * up to `SOCKET_BUFFER_CAPACITY`, with each call to `recv`, and serves
+ * subsequent reads from its buffer. This avoids a system call for every value
+ * read from a message. Since the buffer may hold the beginning of the next
+ * message, the owner of the stream must continue reading until
+ * `has_buffered_data` returns `false` before it waits on the socket again.
+ */
+struct buffered_socket {
+	socket_type socket;
+	unsigned int position;
+	unsigned int length;
+
+	/* the number of calls to `recv` made by this stream */
+	size_t recv_count;
+
+#if !defined(_WIN32)
+	/* the last file descriptor passed over the socket with `SCM_RIGHTS`, or
+	   -1 if there is none; the owner of the stream may take it by resetting
+	   this to -1, and otherwise it is closed when the next one arrives or
+	   when the stream is destroyed */
+	int received_fd;
+#endif
+
+	char buffer[SOCKET_BUFFER_CAPACITY];
+
+#if defined(_WIN32)
+	buffered_socket(const socket_type& socket) :
+		socket(socket), position(0), length(0), recv_count(0) { }
+#else
+	buffered_socket(const socket_type& socket) :
+		socket(socket), position(0), length(0), recv_count(0), received_fd(-1) { }
+
+	~buffered_socket() {
+		if (received_fd != -1)
+			::close(received_fd);
+	}
+#endif
+
+	inline bool has_buffered_data() const {
+		return position < length;
+	}
+
+	/**
+	 * Receives up to `size` bytes into `dst`, along with any file descriptor
+	 * passed with them, which is stored in `received_fd`.
+	 */
+	long receive(char* dst, size_t size, int flags) {
+		recv_count++;
+#if defined(_WIN32)
+		return recv(socket.handle, dst, (int) size, flags);
+#else
+		iovec data = { dst, size };
+		union {
+			cmsghdr header;
+			char buffer[CMSG_SPACE(sizeof(int))];
+		} control;
+		msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = &data;
+		message.msg_iovlen = 1;
+		message.msg_control = control.buffer;
+		message.msg_controllen = sizeof(control.buffer);
+		long received = recvmsg(socket.handle, &message, flags);
+		for (cmsghdr* cmsg = CMSG_FIRSTHDR(&message); received > 0 && cmsg != nullptr; cmsg = CMSG_NXTHDR(&message, cmsg)) {
+			if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS
+			 || cmsg->cmsg_len != CMSG_LEN(sizeof(int)))
+				continue;
+			if (received_fd != -1)
+				::close(received_fd);
+			memcpy(&received_fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+		return received;
+#endif
+	}
+
+	/**
+	 * Reads `size` bytes into `dst`, receiving more data from the socket if
+	 * the buffer does not contain enough. Reads at least as large as the
+	 * buffer are received directly into `dst`.
+	 */
+	bool read(char* dst, size_t size) {
+		size_t available = length - position;
+		if (size <= available) {
+			memcpy(dst, buffer + position, size);
+			position += (unsigned int) size;
+			return true;
+		}
+
+		memcpy(dst, buffer + position, available);
+		dst += available; size -= available;
+		position = 0; length = 0;
+		if (size >= SOCKET_BUFFER_CAPACITY) {
+			/* `recvmsg` may return early where a file descriptor was passed */
+			while (size > 0) {
+				long received = receive(dst, size, MSG_WAITALL);
+				if (received <= 0) return false;
+				dst += received; size -= (size_t) received;
+			}
+			return true;
+		}
+
+		while (size > 0) {
+			long received = receive(buffer, SOCKET_BUFFER_CAPACITY, 0);
+			if (received <= 0) return false;
+			length = (unsigned int) received;
+			position = (unsigned int) min(size, (size_t) length);
+			memcpy(dst, buffer, position);
+			dst += position; size -= position;
+		}
+		return true;
+	}
+};
+
+/**
+ * Reads `sizeof(T)` bytes from `in` and writes them to the memory referenced
+ * by `value`. This function does not perform endianness transformations.
+ * \tparam T satisfies [is_fundamental](http://en.cppreference.com/w/cpp/types/is_fundamental).
+ */
+template<typename T, typename std::enable_if<std::is_fundamental<T>::value>::type* = nullptr>
+inline bool read(T& value, buffered_socket& in) {
+	return in.read((char*) &value, sizeof(T));
+}
+
+/**
+ * Reads `length` elements from `in` and writes them to the native array
+ * `values`. This function does not perform endianness transformations.
+ * \tparam T satisfies [is_fundamental](http://en.cppreference.com/w/cpp/types/is_fundamental).
+ */
+template<typename T, typename std::enable_if<std::is_fundamental<T>::value>::type* = nullptr>
+inline bool read(T* values, buffered_socket& in, unsigned int length) {
+	return in.read((char*) values, sizeof(T) * length);
+}
+
 inline void network_error(const char* message) {
 #if defined(_WIN32)
 	errno = WSAGetLastError();
@@ -526,20 +724,21 @@ enum class server_status {
 };
 
 template<typename ConnectionData, typename ProcessMessageCallback, typename... CallbackArgs>
-void run_worker(socket_listener& listener, hash_map<socket_type, ConnectionData>& connections,
+void run_worker(socket_listener& listener, unsigned int worker_id,
+		hash_map<socket_type, ConnectionData>& connections,
 		std::mutex& connection_set_lock, server_status& status,
 		ProcessMessageCallback process_message, CallbackArgs&&... callback_args)
 {
 	while (status != server_status::STOPPING) {
 		socket_type connection;
-		if (!listener.listen(connection, [&]() { return status != server_status::STOPPING; }))
+		if (!listener.listen(worker_id, connection, [&]() { return status != server_status::STOPPING; }))
 			continue;
 		if (status == server_status::STOPPING) return;
 
 		uint8_t next;
 		if (recv(connection.handle, (char*)&next, sizeof(next), MSG_PEEK) <= 0) {
 			/* the other end of the socket was closed by the client */
-			listener.remove_socket(connection);
+			listener.remove_socket(worker_id, connection);
 			connection_set_lock.lock();
 			bool contains; unsigned int index;
 			free(connections.get(connection, contains, index));
@@ -547,11 +746,16 @@ void run_worker(socket_listener& listener, hash_map<socket_type, ConnectionData>
 			connection_set_lock.unlock();
 			shutdown(connection.handle, 2);
 		} else {
-			/* there is a data waiting to be read, so read it */
-			process_message(connection, connections, connection_set_lock, std::forward<CallbackArgs>(callback_args)...);
+			/* there is a data waiting to be read, so read it, along with any
+			   messages that were received into the buffer with it, since the
+			   listener will not report them once the socket is rearmed */
+			buffered_socket in(connection);
+			do {
+				process_message(connection, in, connections, connection_set_lock, std::forward<CallbackArgs>(callback_args)...);
+			} while (in.has_buffered_data());
 
 			/* continue listening on this socket */
-			if (!listener.update_socket(connection)) {
+			if (!listener.update_socket(worker_id, connection)) {
 				connection_set_lock.lock();
 				bool contains; unsigned int index;
 				free(connections.get(connection, contains, index));
@@ -564,24 +768,24 @@ void run_worker(socket_listener& listener, hash_map<socket_type, ConnectionData>
 }
 
 template<typename ConnectionData, typename ProcessMessageCallback>
-inline std::thread start_worker(socket_listener& listener,
+inline std::thread start_worker(socket_listener& listener, unsigned int worker_id,
 		hash_map<socket_type, ConnectionData>& connections,
 		std::mutex& connection_set_lock, server_status& status,
 		ProcessMessageCallback process_message)
 {
 	return std::thread(run_worker<ConnectionData, ProcessMessageCallback>,
-			std::ref(listener), std::ref(connections), std::ref(connection_set_lock),
+			std::ref(listener), worker_id, std::ref(connections), std::ref(connection_set_lock),
 			std::ref(status), process_message);
 }
 
 template<typename ConnectionData, typename ProcessMessageCallback, typename... CallbackArgs>
-inline std::thread start_worker(socket_listener& listener,
+inline std::thread start_worker(socket_listener& listener, unsigned int worker_id,
 		hash_map<socket_type, ConnectionData>& connections,
 		std::mutex& connection_set_lock, server_status& status,
 		ProcessMessageCallback process_message, CallbackArgs&&... callback_args)
 {
 	return std::thread(run_worker<ConnectionData, ProcessMessageCallback, CallbackArgs...>,
-			std::ref(listener), std::ref(connections), std::ref(connection_set_lock),
+			std::ref(listener), worker_id, std::ref(connections), std::ref(connection_set_lock),
 			std::ref(status), process_message, std::ref(std::forward<CallbackArgs>(callback_args))...);
 }
 
@@ -626,9 +830,100 @@ inline void cleanup_server(server_status& status,
 	cleanup_server<Success>(status, init_cv, init_lock);
 }
 
+/* the prefix of client addresses that refer to a Unix domain socket path */
+#define LOCAL_ADDRESS_PREFIX "unix:"
+
+inline bool is_local_address(const char* address) {
+	return strncmp(address, LOCAL_ADDRESS_PREFIX, sizeof(LOCAL_ADDRESS_PREFIX) - 1) == 0;
+}
+
+/* returns `true` if `connection` was made through a Unix domain socket */
+inline bool is_local_connection(const socket_type& connection) {
+#if defined(_WIN32)
+	return false;
+#else
+	sockaddr_storage address;
+	socklen_t length = sizeof(address);
+	return getsockname(connection.handle, (sockaddr*) &address, &length) == 0
+		&& address.ss_family == AF_UNIX;
+#endif
+}
+
+#if !defined(_WIN32)
+inline bool init_local_address(sockaddr_un& address, const char* path, const char* function_name) {
+	size_t length = strlen(path);
+	if (length >= sizeof(address.sun_path)) {
+		fprintf(stderr, "%s ERROR: The Unix domain socket path '%s' is too long.\n", function_name, path);
+		return false;
+	}
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	memcpy(address.sun_path, path, length + 1);
+	return true;
+}
+#endif
+
+/**
+ * Opens a Unix domain socket at `path` in `sock` and listens on it. A socket
+ * file left at `path` by a server that is no longer running is removed. If a
+ * server is still listening at `path`, or `path` is any other kind of file,
+ * it is left alone, and this function fails.
+ */
+inline bool listen_local(socket_type& sock, const char* path, unsigned int connection_queue_capacity) {
+#if defined(_WIN32)
+	fprintf(stderr, "run_server ERROR: Unix domain sockets are not supported on Windows.\n");
+	return false;
+#else
+	sockaddr_un address;
+	if (!init_local_address(address, path, "run_server"))
+		return false;
+
+	sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (!sock.is_valid()) {
+		network_error("run_server ERROR: Unable to open Unix domain socket");
+		return false;
+	}
+
+	/* only remove a socket file if nothing accepts connections on it */
+	struct stat file_status;
+	if (lstat(path, &file_status) == 0 && S_ISSOCK(file_status.st_mode)) {
+		int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (probe == -1) {
+			network_error("run_server ERROR: Unable to open Unix domain socket");
+			::close(sock.handle); sock = socket_type::EMPTY_SOCKET; return false;
+		} else if (connect(probe, (sockaddr*) &address, sizeof(address)) == 0) {
+			fprintf(stderr, "run_server ERROR: Another server is listening at '%s'.\n", path);
+			::close(probe); ::close(sock.handle); sock = socket_type::EMPTY_SOCKET; return false;
+		} else if (errno == ECONNREFUSED) {
+			unlink(path);
+		}
+		::close(probe);
+	}
+
+	if (bind(sock.handle, (sockaddr*) &address, sizeof(address)) != 0) {
+		network_error("run_server ERROR: Unable to bind to Unix domain socket");
+		::close(sock.handle); sock = socket_type::EMPTY_SOCKET; return false;
+	} else if (listen(sock.handle, connection_queue_capacity) != 0) {
+		network_error("run_server ERROR: Unable to listen to Unix domain socket");
+		::close(sock.handle); unlink(path); sock = socket_type::EMPTY_SOCKET; return false;
+	}
+	return true;
+#endif
+}
+
+/* closes the Unix domain socket opened by `listen_local`, and removes its file */
+inline void close_local(socket_type& sock, const char* path) {
+#if !defined(_WIN32)
+	if (!sock.is_valid()) return;
+	shutdown(sock.handle, 2);
+	::close(sock.handle);
+	unlink(path);
+#endif
+}
+
 template<typename ConnectionData = empty_data, typename ProcessMessageCallback,
 	typename NewConnectionCallback, typename... CallbackArgs>
-bool run_server(socket_type& sock, uint16_t server_port,
+bool run_server(socket_type& sock, uint16_t server_port, const char* local_socket_path,
 		unsigned int connection_queue_capacity, unsigned int worker_count,
 		server_status& status, std::condition_variable& init_cv, std::mutex& init_lock,
 		hash_map<socket_type, ConnectionData>& connections, std::mutex& connection_set_lock,
@@ -674,14 +969,24 @@ bool run_server(socket_type& sock, uint16_t server_port,
 		cleanup_server<false>(status, init_cv, init_lock, sock); return false;
 	}
 
+	/* optionally, also listen on a Unix domain socket for clients on this host */
+	socket_type local_sock = socket_type::EMPTY_SOCKET;
+	if (local_socket_path != nullptr && !listen_local(local_sock, local_socket_path, connection_queue_capacity)) {
+		cleanup_server<false>(status, init_cv, init_lock, sock); return false;
+	}
+
 	socket_listener listener;
-	if (!init(listener)) {
+	if (!init(listener, worker_count)) {
 		network_error("run_server ERROR: Failed to initialize socket listener");
+		close_local(local_sock, local_socket_path);
 		cleanup_server<false>(status, init_cv, init_lock, sock); return false;
 	}
 
-	if (!listener.add_server_socket(sock)) {
+	if (!listener.add_server_socket(sock)
+	 || (local_sock.is_valid() && !listener.add_server_socket(local_sock)))
+	{
 		core::free(listener, worker_count);
+		close_local(local_sock, local_socket_path);
 		cleanup_server<false>(status, init_cv, init_lock, sock);
 		return false;
 	}
@@ -689,7 +994,7 @@ bool run_server(socket_type& sock, uint16_t server_port,
 	/* make the thread pool */
 	std::thread* workers = new std::thread[worker_count];
 	for (unsigned int i = 0; i < worker_count; i++)
-		workers[i] = start_worker(listener, connections, connection_set_lock, status, process_message, std::forward<CallbackArgs>(callback_args)...);
+		workers[i] = start_worker(listener, i, connections, connection_set_lock, status, process_message, std::forward<CallbackArgs>(callback_args)...);
 
 	/* notify that the server has successfully started */
 	std::unique_lock<std::mutex> lock(init_lock);
@@ -712,6 +1017,7 @@ bool run_server(socket_type& sock, uint16_t server_port,
 	}
 	for (auto connection : connections)
 		shutdown(connection.key.handle, 2);
+	close_local(local_sock, local_socket_path);
 	cleanup_server<true>(status, init_cv, init_lock, sock);
 	delete[] workers;
 	return true;
@@ -730,6 +1036,30 @@ bool run_client(
 	}
 #endif
 
+	if (is_local_address(server_address)) {
+		/* connect to the Unix domain socket at the given path; the port is ignored */
+#if defined(_WIN32)
+		fprintf(stderr, "run_client ERROR: Unix domain sockets are not supported on Windows.\n");
+		return false;
+#else
+		const char* path = server_address + sizeof(LOCAL_ADDRESS_PREFIX) - 1;
+		sockaddr_un address;
+		if (!init_local_address(address, path, "run_client"))
+			return false;
+
+		socket_type sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		if (!sock.is_valid()) {
+			network_error("run_client ERROR: Unable to open socket");
+			return false;
+		} else if (connect(sock.handle, (sockaddr*) &address, sizeof(address)) != 0) {
+			network_error("run_client ERROR: Unable to connect");
+			::close(sock.handle); return false;
+		}
+		process_connection(sock);
+		return true;
+#endif
+	}
+
 	addrinfo hints;
 	memset(&hints, 0, sizeof(hints));
 	hints.ai_family = AF_UNSPEC;
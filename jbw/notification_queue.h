@@ -0,0 +1,227 @@
+/**
+ * Copyright 2019, The Jelly Bean World Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#ifndef JBW_NOTIFICATION_QUEUE_H_
+#define JBW_NOTIFICATION_QUEUE_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+namespace jbw {
+
+/**
+ * A bounded single-producer single-consumer ring of reusable slots of type
+ * `T`. The producer reserves a slot with `try_reserve` or `reserve`, fills it
+ * in place, and publishes it with `commit`. The consumer claims the oldest
+ * published slot with `begin_pop` and returns it with `end_pop`. The positions
+ * of both ends are atomic, so neither side takes a lock to push or pop; the
+ * mutex is only used to put a thread to sleep when it has nothing to do.
+ *
+ * The producer may also discard published slots that the consumer has not yet
+ * claimed, using `drop_oldest` or `drop_all`, which is how callers implement
+ * backpressure policies other than blocking.
+ *
+ * Since discarding slots moves the head of the ring past the slot that the
+ * consumer may still be reading, the ring holds the indices of slots rather
+ * than the slots themselves, and the consumer announces the slot it is about
+ * to read in `claimed`. The producer only reserves a slot that is neither
+ * published nor claimed.
+ */
+template<typename T>
+class notification_queue {
+	static constexpr unsigned int NO_SLOT = UINT32_MAX;
+
+	/* one more slot than `capacity`, so that a slot that is neither
+	   published nor claimed always exists when the ring is not full */
+	T* slots;
+	unsigned int slot_count;
+	unsigned int capacity;
+
+	/* `ring[i % capacity]` is the index in `slots` of the `i`-th published
+	   slot, for each `i` in [`head`, `tail`) */
+	std::atomic<unsigned int>* ring;
+
+	/* index of the oldest published slot that has not been claimed */
+	std::atomic<uint64_t> head;
+	/* index of the next slot to be published; only written by the producer */
+	std::atomic<uint64_t> tail;
+	std::atomic<bool> closed;
+
+	/* the index in `slots` of the slot that the consumer is reading, or
+	   `NO_SLOT`; only written by the consumer */
+	std::atomic<unsigned int> claimed;
+
+	/* the index in `slots` of the slot returned by the last reservation, and
+	   scratch space for finding it; only used by the producer */
+	unsigned int reserved;
+	bool* in_use;
+
+	std::mutex wait_lock;
+	std::condition_variable wait_cv;
+
+public:
+	/**
+	 * Constructs a queue that holds at most `capacity` published slots that
+	 * have not yet been claimed by the consumer. `capacity` must be positive.
+	 */
+	notification_queue(unsigned int capacity) :
+		slot_count(capacity + 1), capacity(capacity), head(0), tail(0),
+		closed(false), claimed(NO_SLOT), reserved(NO_SLOT)
+	{
+		slots = new T[slot_count];
+		ring = new std::atomic<unsigned int>[capacity];
+		for (unsigned int i = 0; i < capacity; i++)
+			ring[i] = NO_SLOT;
+		in_use = new bool[slot_count];
+	}
+
+	~notification_queue() {
+		delete[] slots;
+		delete[] ring;
+		delete[] in_use;
+	}
+
+	/**
+	 * Returns the slot into which the next notification should be written,
+	 * or `nullptr` if the queue is full.
+	 */
+	inline T* try_reserve() {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		uint64_t h = head.load();
+		if (t - h >= capacity)
+			return nullptr;
+
+		/* the consumer only ever moves `head` forward, and announces a claim
+		   before taking its slot out of [`head`, `tail`), so any slot that
+		   is not marked here is neither published nor claimed */
+		for (unsigned int i = 0; i < slot_count; i++)
+			in_use[i] = false;
+		for (uint64_t i = h; i < t; i++)
+			in_use[ring[i % capacity].load()] = true;
+		unsigned int c = claimed.load();
+		if (c != NO_SLOT) in_use[c] = true;
+
+		for (unsigned int i = 0; i < slot_count; i++) {
+			if (!in_use[i]) {
+				reserved = i;
+				return &slots[i];
+			}
+		}
+		return nullptr;
+	}
+
+	/**
+	 * Returns the slot into which the next notification should be written,
+	 * waiting until the consumer makes room if the queue is full. Returns
+	 * `nullptr` if the queue is closed while waiting.
+	 */
+	T* reserve() {
+		T* slot = try_reserve();
+		if (slot != nullptr) return slot;
+
+		std::unique_lock<std::mutex> guard(wait_lock);
+		while ((slot = try_reserve()) == nullptr) {
+			if (closed.load()) return nullptr;
+			wait_cv.wait(guard);
+		}
+		return slot;
+	}
+
+	/**
+	 * Publishes the slot most recently returned by `try_reserve` or `reserve`.
+	 */
+	inline void commit() {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		ring[t % capacity].store(reserved);
+		tail.store(t + 1);
+		std::unique_lock<std::mutex> guard(wait_lock);
+		wait_cv.notify_all();
+	}
+
+	/**
+	 * Discards the oldest published slot that has not been claimed by the
+	 * consumer. Returns `false` if there was no such slot.
+	 */
+	inline bool drop_oldest() {
+		uint64_t h = head.load();
+		if (h == tail.load(std::memory_order_relaxed))
+			return false;
+		/* if this fails, the consumer claimed the slot first, which also makes room */
+		head.compare_exchange_strong(h, h + 1);
+		return true;
+	}
+
+	/**
+	 * Discards every published slot that has not been claimed by the consumer.
+	 */
+	inline void drop_all() {
+		uint64_t t = tail.load(std::memory_order_relaxed);
+		uint64_t h = head.load();
+		while (h != t && !head.compare_exchange_weak(h, t)) { }
+	}
+
+	/**
+	 * Claims the oldest published slot, waiting until one is available. Once
+	 * the queue is closed, the remaining slots are still returned, after
+	 * which this function returns `nullptr`. Only one thread may call this.
+	 */
+	T* begin_pop() {
+		while (true) {
+			uint64_t h = head.load();
+			if (h != tail.load()) {
+				/* announce the claim before taking the slot out of the ring,
+				   since the producer may concurrently discard it */
+				unsigned int index = ring[h % capacity].load();
+				claimed.store(index);
+				if (head.compare_exchange_weak(h, h + 1))
+					return &slots[index];
+				claimed.store(NO_SLOT);
+				continue;
+			}
+
+			std::unique_lock<std::mutex> guard(wait_lock);
+			if (head.load() != tail.load()) continue;
+			if (closed.load()) return nullptr;
+			wait_cv.wait(guard);
+		}
+	}
+
+	/**
+	 * Returns the slot claimed by the last call to `begin_pop`, so that the
+	 * producer may reuse it.
+	 */
+	inline void end_pop() {
+		claimed.store(NO_SLOT);
+		std::unique_lock<std::mutex> guard(wait_lock);
+		wait_cv.notify_all();
+	}
+
+	/**
+	 * Wakes any waiting threads and causes `reserve` and `begin_pop` to
+	 * return `nullptr` rather than wait.
+	 */
+	inline void close() {
+		std::unique_lock<std::mutex> guard(wait_lock);
+		closed = true;
+		wait_cv.notify_all();
+	}
+};
+
+} /* namespace jbw */
+
+#endif /* JBW_NOTIFICATION_QUEUE_H_ */
@@ -22,11 +22,16 @@
 #include <core/array.h>
 #include <core/utility.h>
 #include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <math.h>
 #include <mutex>
+#include <thread>
 #include "map.h"
 #include "diffusion.h"
 #include "status.h"
+#include "thread_pool.h"
+#include "notification_queue.h"
 
 namespace jbw {
 
@@ -103,6 +108,40 @@ inline bool write(const movement_conflict_policy& policy, Stream& out) {
     return write((uint8_t) policy, out);
 }
 
+/**
+ * An enum representing what the simulator does when a time step completes
+ * while the queue of step notifications that have not yet been delivered to
+ * `on_step` is full (see `simulator_config::step_notification_capacity`).
+ */
+enum class notification_policy : uint8_t {
+    /* wait until the oldest notification has been delivered */
+    BLOCK = 0,
+    /* discard the oldest notification that has not been delivered */
+    DROP_OLDEST = 1,
+    /* discard every notification that has not been delivered, so that
+       `on_step` only observes the most recent time step */
+    COALESCE = 2
+};
+
+/**
+ * Reads the given notification_policy `policy` from the stream `in`.
+ */
+template<typename Stream>
+inline bool read(notification_policy& policy, Stream& in) {
+    uint8_t c;
+    if (!read(c, in)) return false;
+    policy = (notification_policy) c;
+    return true;
+}
+
+/**
+ * Writes the given notification_policy `policy` to the stream `out`.
+ */
+template<typename Stream>
+inline bool write(const notification_policy& policy, Stream& out) {
+    return write((uint8_t) policy, out);
+}
+
 template<typename FunctionType>
 struct energy_function {
     FunctionType fn;
@@ -425,6 +464,62 @@ inline bool write(const action_policy& type, Stream& out) {
     return write((action_policy_type) type, out);
 }
 
+/** The kinds of actions that an agent can take in a single time step. */
+enum class action_type : uint8_t { MOVE = 0, TURN = 1, NO_OP = 2, COUNT };
+
+/**
+ * Reads the given action_type `type` from the input stream `in`.
+ */
+template<typename Stream>
+inline bool read(action_type& type, Stream& in) {
+    uint8_t c;
+    if (!read(c, in)) return false;
+    type = (action_type) c;
+    return true;
+}
+
+/**
+ * Writes the given action_type `type` to the output stream `out`.
+ */
+template<typename Stream>
+inline bool write(const action_type& type, Stream& out) {
+    return write((uint8_t) type, out);
+}
+
+/**
+ * A single agent action, as submitted to `simulator::act_batch` or
+ * `simulator::enqueue_actions`. For
+ * `action_type::MOVE`, `dir` is the direction of motion and `num_steps` is
+ * the number of steps to take. For `action_type::TURN`, `dir` is the direction
+ * to turn and `num_steps` is ignored. Both fields are ignored for
+ * `action_type::NO_OP`.
+ */
+struct action {
+    action_type type;
+    direction dir;
+    unsigned int num_steps;
+};
+
+/**
+ * Reads the given action `a` from the input stream `in`.
+ */
+template<typename Stream>
+inline bool read(action& a, Stream& in) {
+    return read(a.type, in)
+        && read(a.dir, in)
+        && read(a.num_steps, in);
+}
+
+/**
+ * Writes the given action `a` to the output stream `out`.
+ */
+template<typename Stream>
+inline bool write(const action& a, Stream& out) {
+    return write(a.type, out)
+        && write(a.dir, out)
+        && write(a.num_steps, out);
+}
+
 /**
  * Represents the configuration of a simulator. 
  */
@@ -450,7 +545,49 @@ struct simulator_config {
     float decay_param, diffusion_param;
     unsigned int deleted_item_lifetime;
 
-    simulator_config() : item_types(8), agent_color(NULL) { }
+    /**
+     * The number of threads used to advance the simulation at each time step.
+     * This only affects the performance of this process, and not the
+     * simulation itself, so it is not read or written with the rest of the
+     * config, and it is 1 in any config that is read.
+     */
+    unsigned int step_thread_count;
+
+    /**
+     * If `true`, the simulation is advanced on a dedicated thread, rather
+     * than on the thread of whichever action completes the time step.
+     */
+    bool dedicated_step_thread;
+
+    /**
+     * If nonzero, the maximum time (in milliseconds) that the simulator waits
+     * for all agents to act and all semaphores to be signaled in each time
+     * step. When it expires, every active agent that has not yet acted is
+     * given `default_action`, every semaphore is signaled, and the time step
+     * completes. This implies that the simulation is advanced on a dedicated
+     * thread, as with `dedicated_step_thread`.
+     */
+    unsigned int step_deadline;
+    action default_action;
+
+    /**
+     * If nonzero, `on_step` is not called by the thread that advances the
+     * simulation. Instead, a copy of the agent states is pushed onto a queue
+     * of at most this many undelivered notifications, and a separate thread
+     * calls `on_step` for each, without holding any simulator locks.
+     * `step_notification_policy` determines what happens when the queue is
+     * full. Note that with `notification_policy::BLOCK`, `on_step` must not
+     * wait for the simulator to advance.
+     */
+    unsigned int step_notification_capacity;
+    notification_policy step_notification_policy;
+
+    simulator_config() : item_types(8), agent_color(NULL), step_thread_count(1), dedicated_step_thread(false), step_deadline(0),
+            step_notification_capacity(0), step_notification_policy(notification_policy::BLOCK) {
+        default_action.type = action_type::NO_OP;
+        default_action.dir = direction::UP;
+        default_action.num_steps = 0;
+    }
 
     simulator_config(const simulator_config& src) : item_types(src.item_types.length) {
         if (!init_helper(src))
@@ -478,6 +615,14 @@ struct simulator_config {
         core::swap(first.decay_param, second.decay_param);
         core::swap(first.diffusion_param, second.diffusion_param);
         core::swap(first.deleted_item_lifetime, second.deleted_item_lifetime);
+        core::swap(first.step_thread_count, second.step_thread_count);
+        core::swap(first.dedicated_step_thread, second.dedicated_step_thread);
+        core::swap(first.step_deadline, second.step_deadline);
+        core::swap(first.default_action.type, second.default_action.type);
+        core::swap(first.default_action.dir, second.default_action.dir);
+        core::swap(first.default_action.num_steps, second.default_action.num_steps);
+        core::swap(first.step_notification_capacity, second.step_notification_capacity);
+        core::swap(first.step_notification_policy, second.step_notification_policy);
     }
 
     static inline void free(simulator_config& config) {
@@ -522,6 +667,12 @@ private:
         decay_param = src.decay_param;
         diffusion_param = src.diffusion_param;
         deleted_item_lifetime = src.deleted_item_lifetime;
+        step_thread_count = src.step_thread_count;
+        dedicated_step_thread = src.dedicated_step_thread;
+        step_deadline = src.step_deadline;
+        default_action = src.default_action;
+        step_notification_capacity = src.step_notification_capacity;
+        step_notification_policy = src.step_notification_policy;
         return true;
     }
 
@@ -537,20 +688,62 @@ private:
 
 /**
  * Initializes the given simulator_config with a NULL `agent_color`,
- * `intensity_fn_args`, `interaction_fn_args`, and an empty `item_types`. This
- * function does not initialize any other fields.
+ * `intensity_fn_args`, `interaction_fn_args`, an empty `item_types`, and a
+ * single-threaded `step_thread_count` with no `dedicated_step_thread`, no
+ * `step_deadline`, and synchronous step notifications. This function does not
+ * initialize any other fields.
  */
 inline bool init(simulator_config& config) {
     config.agent_color = NULL;
+    config.step_thread_count = 1;
+    config.dedicated_step_thread = false;
+    config.step_deadline = 0;
+    config.default_action.type = action_type::NO_OP;
+    config.default_action.dir = direction::UP;
+    config.default_action.num_steps = 0;
+    config.step_notification_capacity = 0;
+    config.step_notification_policy = notification_policy::BLOCK;
     return array_init(config.item_types, 8);
 }
 
+/**
+ * Returns `true` if the given action `a` is permitted by the movement, turn,
+ * and no-op policies of `config`.
+ */
+inline bool is_action_allowed(const action& a, const simulator_config& config) {
+    switch (a.type) {
+    case action_type::MOVE:
+        return a.dir < direction::COUNT && a.num_steps <= config.max_steps_per_movement
+            && config.allowed_movement_directions[(size_t) a.dir] != action_policy::DISALLOWED;
+    case action_type::TURN:
+        return a.dir < direction::COUNT
+            && config.allowed_rotations[(size_t) a.dir] != action_policy::DISALLOWED;
+    case action_type::NO_OP:
+        return config.no_op_allowed;
+    case action_type::COUNT: break;
+    }
+    return false;
+}
+
+/**
+ * Returns `true` unless `config` has a `step_deadline` and its
+ * `default_action` is not permitted by its own action policies.
+ */
+inline bool is_default_action_valid(const simulator_config& config) {
+    if (config.step_deadline == 0 || is_action_allowed(config.default_action, config))
+        return true;
+    fprintf(stderr, "simulator_config ERROR: `default_action` is not allowed by the action policies.\n");
+    return false;
+}
+
 /**
  * Initializes the given simulator_config `config` by copying from `src`.
  */
 inline bool init(simulator_config& config, const simulator_config& src)
 {
-    if (!array_init(config.item_types, src.item_types.length)) {
+    if (!is_default_action_valid(src)) {
+        return false;
+    } else if (!array_init(config.item_types, src.item_types.length)) {
         return false;
     } else if (!config.init_helper(src)) {
         free(config.item_types); return false;
@@ -559,12 +752,54 @@ inline bool init(simulator_config& config, const simulator_config& src)
 }
 
 /**
- * Reads the given simulator_config `config` from the input stream `in`.
+ * Every simulator written by `write(const simulator&, Stream&)` begins with
+ * `SIMULATOR_SAVE_MAGIC` followed by the version of its format. Saves written
+ * before the format was versioned begin directly with the simulator_config,
+ * and they are read as version 0. Each change to the format adds the version
+ * that introduced it below, and `SIMULATOR_SAVE_VERSION` is the latest one.
+ */
+constexpr uint32_t SIMULATOR_SAVE_MAGIC = 0x4A425753;
+
+/* the requested moves are stored as an array with their arrival order,
+   rather than as a hash_map from each target position to its agents */
+constexpr uint32_t SAVE_VERSION_REQUESTED_MOVE_ARRAY = 1;
+
+/* the config stores `dedicated_step_thread` */
+constexpr uint32_t SAVE_VERSION_DEDICATED_STEP_THREAD = 2;
+
+/* the config stores `step_deadline` and `default_action` */
+constexpr uint32_t SAVE_VERSION_STEP_DEADLINE = 3;
+
+/* each agent stores `action_queue_drained`, and the queued actions of every
+   agent are stored after the requested moves */
+constexpr uint32_t SAVE_VERSION_ACTION_QUEUES = 4;
+
+/* the config stores `step_notification_capacity` and `step_notification_policy` */
+constexpr uint32_t SAVE_VERSION_STEP_NOTIFICATIONS = 5;
+
+/* each patch stores `last_modified` */
+constexpr uint32_t SAVE_VERSION_PATCH_MODIFICATION_TIMES = 6;
+
+constexpr uint32_t SIMULATOR_SAVE_VERSION = SAVE_VERSION_PATCH_MODIFICATION_TIMES;
+
+/**
+ * Reads every field of the given simulator_config `config` after
+ * `max_steps_per_movement` from the input stream `in`, in the given format
+ * `version`. Fields that are not present in `version` are set to their
+ * defaults.
  */
 template<typename Stream>
-bool read(simulator_config& config, Stream& in) {
-    if (!read(config.max_steps_per_movement, in)
-     || !read(config.scent_dimension, in)
+bool read_config_fields(simulator_config& config, Stream& in, unsigned int version) {
+    config.step_thread_count = 1;
+    config.dedicated_step_thread = false;
+    config.step_deadline = 0;
+    config.default_action.type = action_type::NO_OP;
+    config.default_action.dir = direction::UP;
+    config.default_action.num_steps = 0;
+    config.step_notification_capacity = 0;
+    config.step_notification_policy = notification_policy::BLOCK;
+
+    if (!read(config.scent_dimension, in)
      || !read(config.color_dimension, in)
      || !read(config.vision_range, in)
      || !read(config.allowed_movement_directions, in)
@@ -595,7 +830,16 @@ bool read(simulator_config& config, Stream& in) {
      || !read(config.collision_policy, in)
      || !read(config.decay_param, in)
      || !read(config.diffusion_param, in)
-     || !read(config.deleted_item_lifetime, in)) {
+     || !read(config.deleted_item_lifetime, in)
+     || (version >= SAVE_VERSION_DEDICATED_STEP_THREAD && !read(config.dedicated_step_thread, in))
+     || (version >= SAVE_VERSION_STEP_DEADLINE && (
+        !read(config.step_deadline, in)
+     || !read(config.default_action, in)))
+     || (version >= SAVE_VERSION_STEP_NOTIFICATIONS && (
+        !read(config.step_notification_capacity, in)
+     || !read(config.step_notification_policy, in)))
+     || !is_default_action_valid(config))
+    {
         for (item_properties& properties : config.item_types)
             free(properties, (unsigned int) config.item_types.length);
         free(config.agent_color); free(config.item_types); return false;
@@ -603,6 +847,15 @@ bool read(simulator_config& config, Stream& in) {
     return true;
 }
 
+/**
+ * Reads the given simulator_config `config` from the input stream `in`.
+ */
+template<typename Stream>
+inline bool read(simulator_config& config, Stream& in, unsigned int version = SIMULATOR_SAVE_VERSION) {
+    return read(config.max_steps_per_movement, in)
+        && read_config_fields(config, in, version);
+}
+
 /**
  * Writes the given simulator_config `config` to the output stream `out`.
  */
@@ -624,26 +877,48 @@ bool write(const simulator_config& config, Stream& out) {
         && write(config.collision_policy, out)
         && write(config.decay_param, out)
         && write(config.diffusion_param, out)
-        && write(config.deleted_item_lifetime, out);
+        && write(config.deleted_item_lifetime, out)
+        && write(config.dedicated_step_thread, out)
+        && write(config.step_deadline, out)
+        && write(config.default_action, out)
+        && write(config.step_notification_capacity, out)
+        && write(config.step_notification_policy, out);
 }
 
 /**
  * A structure that is used to store additional state information in the map
  * structure. So far, this structure stores an array of agents that inhabit the
- * associated patch, as well as a lock for accessing this array.
+ * associated patch, as well as a lock for accessing this array. Each agent
+ * records its index in this array in `agent_state::patch_index`, so the
+ * order of the agents is not preserved when one is removed.
  */
 struct patch_data {
     std::mutex patch_lock;
     array<agent_state*> agents;
 
+    /* the number of uncollected items of each type in the patch, which is
+       counted by `simulator::get_map_summary` when first needed, and counted
+       again once the patch changes; `nullptr` if not yet counted */
+    unsigned int* item_counts;
+
+    /* the simulation time at which `item_counts` was counted */
+    uint64_t item_counts_time;
+
+    inline bool add_agent(agent_state& agent);
+    inline void remove_agent(agent_state& agent);
+
     static inline void move(const patch_data& src, patch_data& dst) {
         core::move(src.agents, dst.agents);
+        dst.item_counts = src.item_counts;
+        dst.item_counts_time = src.item_counts_time;
         src.patch_lock.~mutex();
         new (&dst.patch_lock) std::mutex();
     }
 
     static inline void free(patch_data& data) {
         core::free(data.agents);
+        if (data.item_counts != nullptr)
+            core::free(data.item_counts);
         data.patch_lock.~mutex();
     }
 };
@@ -654,6 +929,8 @@ struct patch_data {
 inline bool init(patch_data& data) {
     if (!array_init(data.agents, 4))
         return false;
+    data.item_counts = nullptr;
+    data.item_counts_time = 0;
     new (&data.patch_lock) std::mutex();
     return true;
 }
@@ -675,8 +952,11 @@ bool read(patch_data& data, Stream& in,
             free(data.agents); return false;
         }
         data.agents[i] = agents.get(id);
+        data.agents[i]->patch_index = i;
     }
     data.agents.length = agent_count;
+    data.item_counts = nullptr;
+    data.item_counts_time = 0;
     new (&data.patch_lock) std::mutex();
     return true;
 }
@@ -695,12 +975,43 @@ bool write(const patch_data& data, Stream& out,
     return true;
 }
 
+/**
+ * The observation dimensions with which the perception code is compiled.
+ * Each template parameter that is nonzero fixes the corresponding dimension
+ * at compile time, so that the loops over it can be unrolled, while a zero
+ * parameter means the dimension is read from the simulator_config at
+ * runtime. `generic_observation_kernel` handles every configuration.
+ */
+template<unsigned int ScentDimension, unsigned int ColorDimension, unsigned int VisionRange>
+struct observation_kernel {
+    static inline unsigned int scent_dimension(const simulator_config& config) {
+        return (ScentDimension == 0) ? config.scent_dimension : ScentDimension;
+    }
+
+    static inline unsigned int color_dimension(const simulator_config& config) {
+        return (ColorDimension == 0) ? config.color_dimension : ColorDimension;
+    }
+
+    static inline unsigned int vision_range(const simulator_config& config) {
+        return (VisionRange == 0) ? config.vision_range : VisionRange;
+    }
+
+    /* Returns `true` if this kernel can be used for the given configuration. */
+    static inline bool supports(const simulator_config& config) {
+        return (ScentDimension == 0 || ScentDimension == config.scent_dimension)
+            && (ColorDimension == 0 || ColorDimension == config.color_dimension)
+            && (VisionRange == 0 || VisionRange == config.vision_range);
+    }
+};
+
+typedef observation_kernel<0, 0, 0> generic_observation_kernel;
+
 inline void add_scent(float* dst, const float* scent, unsigned int scent_dimension, float value) {
     for (unsigned int i = 0; i < scent_dimension; i++)
         dst[i] += scent[i] * value;
 }
 
-template<typename T>
+template<typename Kernel = generic_observation_kernel, typename T>
 void compute_scent_contribution(
         const diffusion<T>& scent_model, const item& item,
         position pos, uint64_t current_time,
@@ -716,12 +1027,12 @@ void compute_scent_contribution(
         unsigned int creation_t = config.deleted_item_lifetime - 1;
         if (item.creation_time > 0)
             creation_t = min(creation_t, (unsigned int) (current_time - item.creation_time));
-        add_scent(dst, config.item_types[item.item_type].scent, config.scent_dimension,
+        add_scent(dst, config.item_types[item.item_type].scent, Kernel::scent_dimension(config),
                 (float) scent_model.get_value(creation_t, (int) relative_position.x, (int) relative_position.y));
 
         if (item.deletion_time > 0) {
             unsigned int deletion_t = (unsigned int) (current_time - item.deletion_time);
-            add_scent(dst, config.item_types[item.item_type].scent, config.scent_dimension,
+            add_scent(dst, config.item_types[item.item_type].scent, Kernel::scent_dimension(config),
                 (float) -scent_model.get_value(deletion_t, (int) relative_position.x, (int) relative_position.y));
         }
     }
@@ -770,6 +1081,41 @@ struct agent_state {
     /** Number of items of each type in the agent's storage. */
     unsigned int* collected_items;
 
+    /**
+     * Actions queued by `simulator::enqueue_actions`, which the simulator
+     * performs on behalf of the agent, one per turn. `queued_actions` has
+     * capacity `queued_action_capacity` (it is NULL if the capacity is 0),
+     * and the actions that remain to be performed are at the indices
+     * [`next_queued_action`, `queued_action_count`).
+     */
+    action* queued_actions;
+    unsigned int queued_action_count;
+    unsigned int queued_action_capacity;
+    unsigned int next_queued_action;
+
+    /**
+     * If this is `true`, `action_queue_drained` is set when the last queued
+     * action is performed.
+     */
+    bool notify_when_queue_drained;
+
+    /**
+     * `true` during the turn in which the last queued action was performed,
+     * if `notify_when_queue_drained` was set. This is included in the step
+     * response sent to clients, so that they can resume control of the agent.
+     */
+    bool action_queue_drained;
+
+    /**
+     * The index of this agent in the `agents` array of the patch that
+     * contains it, which makes removing the agent from the patch a
+     * constant-time operation.
+     */
+    unsigned int patch_index;
+
+    /* The index of this agent in the simulator's `agent_table`. */
+    unsigned int table_index;
+
     /**
      * Lock used by the simulator to prevent simultaneous updates
      * to an agent's state.
@@ -778,7 +1124,8 @@ struct agent_state {
 
     inline void add_color(
             position relative_position, unsigned int vision_range,
-            const float* color, unsigned int color_dimension)
+            const float* color, unsigned int color_dimension,
+            float scale = 1.0f)
     {
         switch (current_direction) {
         case direction::UP: break;
@@ -798,7 +1145,7 @@ struct agent_state {
         unsigned int y = (unsigned int) (relative_position.y + vision_range);
         unsigned int offset = (x*(2*vision_range + 1) + y) * color_dimension;
         for (unsigned int i = 0; i < color_dimension; i++)
-            current_vision[offset + i] += color[i];
+            current_vision[offset + i] += scale * color[i];
     }
 
     inline void occlude_color(
@@ -826,17 +1173,26 @@ struct agent_state {
             current_vision[offset + i] = current_vision[offset + i] * (1.0f - occlusion);
     }
 
-    template<typename T>
+    /**
+     * Recomputes the scent and vision of this agent from the items and agents
+     * in the given neighborhood, deleting any items that are too old.
+     * `Kernel` is an `observation_kernel` that supports `config`.
+     */
+    template<typename Kernel = generic_observation_kernel, typename T>
     inline void update_state(
             patch<patch_data>* neighborhood[4],
             const diffusion<T>& scent_model,
             const simulator_config& config,
             uint64_t current_time)
     {
+        const unsigned int scent_dimension = Kernel::scent_dimension(config);
+        const unsigned int color_dimension = Kernel::color_dimension(config);
+        const unsigned int vision_range = Kernel::vision_range(config);
+
         /* first zero out both current scent and vision */
-        for (unsigned int i = 0; i < config.scent_dimension; i++)
+        for (unsigned int i = 0; i < scent_dimension; i++)
             current_scent[i] = 0.0f;
-        for (unsigned int i = 0; i < (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension; i++)
+        for (unsigned int i = 0; i < (2*vision_range + 1) * (2*vision_range + 1) * color_dimension; i++)
             current_vision[i] = 0.0f;
 
         array<item> visual_field_items(16);
@@ -851,18 +1207,18 @@ struct agent_state {
                     neighborhood[i]->items.remove(j); j--; continue;
                 }
 
-                compute_scent_contribution(scent_model, item, current_position, current_time, config, current_scent);
+                compute_scent_contribution<Kernel>(scent_model, item, current_position, current_time, config, current_scent);
 
                 /* if the item is in the visual field, add its color to the appropriate pixel */
                 position relative_position = item.location - current_position;
                 if (item.deletion_time == 0
-                 && (unsigned int) abs(relative_position.x) <= config.vision_range
-                 && (unsigned int) abs(relative_position.y) <= config.vision_range) {
+                 && (unsigned int) abs(relative_position.x) <= vision_range
+                 && (unsigned int) abs(relative_position.y) <= vision_range) {
                     visual_field_items.add(item);
                     add_color(
-                        relative_position, config.vision_range,
+                        relative_position, vision_range,
                         config.item_types[item.item_type].color,
-                        config.color_dimension);
+                        color_dimension);
                  }
             }
 
@@ -872,48 +1228,21 @@ struct agent_state {
                 position relative_position = agent->current_position - current_position;
 
                 /* if the neighbor is in the visual field, add its color to the appropriate pixel */
-                if ((unsigned int) abs(relative_position.x) <= config.vision_range
-                 && (unsigned int) abs(relative_position.y) <= config.vision_range) {
+                if ((unsigned int) abs(relative_position.x) <= vision_range
+                 && (unsigned int) abs(relative_position.y) <= vision_range) {
                     add_color(
-                        relative_position, config.vision_range,
-                        config.agent_color, config.color_dimension);
+                        relative_position, vision_range,
+                        config.agent_color, color_dimension);
                 }
             }
         }
 
         /* Compute the agent's field of view. */
-        float fov_left_angle = 0.0f;
-        float fov_right_angle = 0.0f;
-        switch (current_direction) {
-        case direction::UP:
-            fov_left_angle = ((float) M_PI + config.agent_field_of_view) / 2;
-            fov_right_angle = ((float) M_PI - config.agent_field_of_view) / 2;
-            break;
-        case direction::DOWN:
-            fov_left_angle = -((float) M_PI - config.agent_field_of_view) / 2;
-            fov_right_angle = -((float) M_PI + config.agent_field_of_view) / 2;
-            break;
-        case direction::LEFT:
-            fov_left_angle = -((float) M_PI) + config.agent_field_of_view / 2;
-            fov_right_angle = (float) M_PI - config.agent_field_of_view / 2;
-            break;
-        case direction::RIGHT:
-            fov_left_angle = config.agent_field_of_view / 2;
-            fov_right_angle = -config.agent_field_of_view / 2;
-            break;
-        case direction::COUNT: return;
-        }
-
-        auto circle_tangent_angles = [](float x, float y, float& left_angle, float& right_angle) {
-            const float dd = sqrt(x * x + y * y);
-            const float a = asin(0.5f / dd);
-            const float b = atan2(y, x);
-            left_angle = b + a;
-            right_angle = b - a;
-        };
+        float fov_left_angle, fov_right_angle;
+        if (!field_of_view(fov_left_angle, fov_right_angle, config)) return;
 
         /* Apply visual occlusion. */
-        int64_t V = (int64_t) config.vision_range;
+        int64_t V = (int64_t) vision_range;
         for (int64_t i = -V; i <= V; i++) {
             const float cell_x = (float) i;
             for (int64_t j = -V; j <= V; j++) {
@@ -923,46 +1252,80 @@ struct agent_state {
                 const float distance = (float) relative_position.squared_length();
                 float cell_left_angle, cell_right_angle;
                 circle_tangent_angles(cell_x, cell_y, cell_left_angle, cell_right_angle);
-                const float cell_angle = abs(cell_left_angle - cell_right_angle);
 
                 /* Check if this cell is outside the agent's field of view. */
                 if (config.agent_field_of_view < 2 * M_PI - 1e-3f) {
-                    float overlap = angle_overlap(
-                        fov_left_angle, fov_right_angle,
-                        cell_left_angle, cell_right_angle);
-                    const float occlusion = 1.0f - min(1.0f, overlap / cell_angle);
+                    const float occlusion = field_of_view_occlusion(
+                        fov_left_angle, fov_right_angle, cell_left_angle, cell_right_angle);
                     occlude_color(
-                        relative_position, config.vision_range,
-                        config.color_dimension, occlusion);
+                        relative_position, vision_range,
+                        color_dimension, occlusion);
                     if (occlusion == 1.0f) continue;
                 }
 
                 /* Check if this cell is occluded by any items. */
-                float occlusion = 0.0f;
-                for (item& item : visual_field_items) {
-                    const position relative_location = item.location - current_position;
-                    if (relative_location.x == 0 && relative_location.y == 0) continue;
-                    float item_distance = (float) relative_location.squared_length();
-                    if (item_distance + 1.0f > distance) continue;
-
-                    const float x = (float) relative_location.x;
-                    const float y = (float) relative_location.y;
-                    float left_angle, right_angle;
-                    circle_tangent_angles(x, y, left_angle, right_angle);
-
-                    float overlap = angle_overlap(
-                        left_angle, right_angle,
-                        cell_left_angle, cell_right_angle);
-                    const float scaling_factor = max(0.0f, min(1.0f, overlap / cell_angle));
-                    occlusion += config.item_types[item.item_type].visual_occlusion * scaling_factor;
-                }
+                float occlusion = item_occlusion(visual_field_items,
+                        distance, cell_left_angle, cell_right_angle, config);
                 if (occlusion > 0.0f) {
                     occlude_color(
-                        relative_position, config.vision_range,
-                        config.color_dimension, min(1.0f, occlusion));
+                        relative_position, vision_range,
+                        color_dimension, min(1.0f, occlusion));
+                }
+            }
+        }
+    }
+
+    /**
+     * Adds `sign` times the color of another agent at `other_position` to the
+     * visual field of this agent, after applying the same occlusion as
+     * `update_state`. Agents do not contribute to scent or occlude anything,
+     * so calling this with `sign` equal to 1 (or -1) when an agent is added
+     * to (or removed from) the world has the same effect as recomputing this
+     * agent's state with `update_state`, up to rounding.
+     */
+    inline void update_agent_color(
+            patch<patch_data>* neighborhood[4],
+            position other_position, float sign,
+            const simulator_config& config)
+    {
+        position relative_position = other_position - current_position;
+        if ((unsigned int) abs(relative_position.x) > config.vision_range
+         || (unsigned int) abs(relative_position.y) > config.vision_range)
+            return;
+
+        float visibility = 1.0f;
+        if (relative_position.x != 0 || relative_position.y != 0) {
+            float fov_left_angle, fov_right_angle;
+            if (!field_of_view(fov_left_angle, fov_right_angle, config)) return;
+
+            float cell_left_angle, cell_right_angle;
+            circle_tangent_angles((float) relative_position.x, (float) relative_position.y, cell_left_angle, cell_right_angle);
+            if (config.agent_field_of_view < 2 * M_PI - 1e-3f) {
+                const float occlusion = field_of_view_occlusion(
+                    fov_left_angle, fov_right_angle, cell_left_angle, cell_right_angle);
+                visibility = 1.0f - occlusion;
+            }
+
+            if (visibility > 0.0f) {
+                array<item> visual_field_items(16);
+                for (unsigned int i = 0; i < 4; i++) {
+                    for (const item& item : neighborhood[i]->items) {
+                        position item_position = item.location - current_position;
+                        if (item.deletion_time == 0
+                         && (unsigned int) abs(item_position.x) <= config.vision_range
+                         && (unsigned int) abs(item_position.y) <= config.vision_range)
+                            visual_field_items.add(item);
+                    }
                 }
+                const float occlusion = item_occlusion(visual_field_items,
+                        (float) relative_position.squared_length(),
+                        cell_left_angle, cell_right_angle, config);
+                visibility *= 1.0f - min(1.0f, occlusion);
             }
         }
+
+        add_color(relative_position, config.vision_range,
+                config.agent_color, config.color_dimension, sign * visibility);
     }
 
     /** Frees all allocated memory associated with this agent state. */
@@ -970,9 +1333,64 @@ struct agent_state {
         core::free(agent.current_scent);
         core::free(agent.current_vision);
         core::free(agent.collected_items);
+        if (agent.queued_actions != NULL)
+            core::free(agent.queued_actions);
         agent.lock.~mutex();
     }
 
+    /** Returns `true` if there are queued actions that remain to be performed. */
+    inline bool has_queued_actions() const {
+        return next_queued_action < queued_action_count;
+    }
+
+    /**
+     * Appends the given `actions` to the end of the queue of actions to be
+     * performed by this agent.
+     */
+    inline bool enqueue_actions(const action* actions, unsigned int count)
+    {
+        if (next_queued_action > 0) {
+            /* move the remaining actions to the front of the queue */
+            queued_action_count -= next_queued_action;
+            memmove(queued_actions, queued_actions + next_queued_action, sizeof(action) * queued_action_count);
+            next_queued_action = 0;
+        }
+
+        if (queued_action_count + count > queued_action_capacity) {
+            unsigned int new_capacity = max(queued_action_count + count, 2 * queued_action_capacity);
+            action* new_actions = (action*) realloc(queued_actions, sizeof(action) * new_capacity);
+            if (new_actions == NULL) {
+                fprintf(stderr, "agent_state.enqueue_actions ERROR: Out of memory.\n");
+                return false;
+            }
+            queued_actions = new_actions;
+            queued_action_capacity = new_capacity;
+        }
+        for (unsigned int i = 0; i < count; i++)
+            queued_actions[queued_action_count++] = actions[i];
+        return true;
+    }
+
+    /**
+     * Removes and returns the action at the front of the queue. If this
+     * empties the queue, `action_queue_drained` is set according to
+     * `notify_when_queue_drained`.
+     *
+     * Precondition: `has_queued_actions()` is `true`.
+     */
+    inline action dequeue_action()
+    {
+        action a = queued_actions[next_queued_action++];
+        if (next_queued_action == queued_action_count) {
+            next_queued_action = 0;
+            queued_action_count = 0;
+            if (notify_when_queue_drained)
+                action_queue_drained = true;
+            notify_when_queue_drained = false;
+        }
+        return a;
+    }
+
     /** Removes this agent from the world and frees all allocated memory. */
     template<typename T>
     inline static void free(agent_state& agent,
@@ -984,18 +1402,18 @@ struct agent_state {
         patch<patch_data>* neighborhood[4]; position patch_positions[4];
         unsigned int index = world.get_fixed_neighborhood(agent.current_position, neighborhood, patch_positions);
         neighborhood[index]->data.patch_lock.lock();
-        unsigned j = neighborhood[index]->data.agents.index_of(&agent);
-        neighborhood[index]->data.agents.remove(j);
+        neighborhood[index]->data.remove_agent(agent);
+        neighborhood[index]->last_modified = world.modification_time;
         neighborhood[index]->data.patch_lock.unlock();
 
-        /* update the scent and vision of nearby agents */
+        /* remove this agent from the vision of nearby agents */
         for (unsigned int i = 0; i < 4; i++) {
             for (agent_state* neighbor : neighborhood[i]->data.agents) {
                 if (neighbor == &agent) continue;
 
                 patch<patch_data>* other_neighborhood[4];
                 world.get_fixed_neighborhood(neighbor->current_position, other_neighborhood, patch_positions);
-                neighbor->update_state(other_neighborhood, scent_model, config, current_time);
+                neighbor->update_agent_color(other_neighborhood, agent.current_position, -1.0f, config);
             }
         }
 
@@ -1003,6 +1421,84 @@ struct agent_state {
     }
 
 private:
+    /**
+     * Computes the angles of the left and right edges of this agent's field
+     * of view. Returns `false` if the agent's direction is invalid.
+     */
+    inline bool field_of_view(float& left_angle, float& right_angle, const simulator_config& config) const {
+        switch (current_direction) {
+        case direction::UP:
+            left_angle = ((float) M_PI + config.agent_field_of_view) / 2;
+            right_angle = ((float) M_PI - config.agent_field_of_view) / 2;
+            return true;
+        case direction::DOWN:
+            left_angle = -((float) M_PI - config.agent_field_of_view) / 2;
+            right_angle = -((float) M_PI + config.agent_field_of_view) / 2;
+            return true;
+        case direction::LEFT:
+            left_angle = -((float) M_PI) + config.agent_field_of_view / 2;
+            right_angle = (float) M_PI - config.agent_field_of_view / 2;
+            return true;
+        case direction::RIGHT:
+            left_angle = config.agent_field_of_view / 2;
+            right_angle = -config.agent_field_of_view / 2;
+            return true;
+        case direction::COUNT: break;
+        }
+        return false;
+    }
+
+    static inline void circle_tangent_angles(float x, float y, float& left_angle, float& right_angle) {
+        const float dd = sqrt(x * x + y * y);
+        const float a = asin(0.5f / dd);
+        const float b = atan2(y, x);
+        left_angle = b + a;
+        right_angle = b - a;
+    }
+
+    /* Returns the fraction of the given cell that lies outside the field of view. */
+    static inline float field_of_view_occlusion(
+            float fov_left_angle, float fov_right_angle,
+            float cell_left_angle, float cell_right_angle)
+    {
+        const float cell_angle = abs(cell_left_angle - cell_right_angle);
+        float overlap = angle_overlap(
+            fov_left_angle, fov_right_angle,
+            cell_left_angle, cell_right_angle);
+        return 1.0f - min(1.0f, overlap / cell_angle);
+    }
+
+    /**
+     * Returns the total occlusion of the given cell, at squared distance
+     * `distance` from this agent, by the items in `visual_field_items` that
+     * are closer to the agent. The result is not clamped to 1.
+     */
+    inline float item_occlusion(const array<item>& visual_field_items,
+            float distance, float cell_left_angle, float cell_right_angle,
+            const simulator_config& config) const
+    {
+        const float cell_angle = abs(cell_left_angle - cell_right_angle);
+        float occlusion = 0.0f;
+        for (const item& item : visual_field_items) {
+            const position relative_location = item.location - current_position;
+            if (relative_location.x == 0 && relative_location.y == 0) continue;
+            float item_distance = (float) relative_location.squared_length();
+            if (item_distance + 1.0f > distance) continue;
+
+            const float x = (float) relative_location.x;
+            const float y = (float) relative_location.y;
+            float left_angle, right_angle;
+            circle_tangent_angles(x, y, left_angle, right_angle);
+
+            float overlap = angle_overlap(
+                left_angle, right_angle,
+                cell_left_angle, cell_right_angle);
+            const float scaling_factor = max(0.0f, min(1.0f, overlap / cell_angle));
+            occlusion += config.item_types[item.item_type].visual_occlusion * scaling_factor;
+        }
+        return occlusion;
+    }
+
     static inline float angle_overlap(float al, float ar, float bl, float br) {
         al = al < 0 ? 2 * (float) M_PI + al : al;
         ar = ar < 0 ? 2 * (float) M_PI + ar : ar;
@@ -1027,27 +1523,39 @@ private:
 };
 
 /**
- * Initializes an agent's state in the provided world.
- *
- * \param   agent_state     Agent state to initialize.
- * \param   world           Map of the world in which the agent is initialized.
- * \param   scent_model     The scent diffusion model.
- * \param   config          The configuration for this simulation.
- * \param   current_time    The current simulation time.
- *
- * \tparam  T               The arithmetic type for the scent diffusion model.
+ * Appends `agent` to the agents in this patch.
  */
-template<typename T>
-inline status init(
-        agent_state& agent,
-        map<patch_data, item_properties>& world,
-        const diffusion<T>& scent_model,
-        const simulator_config& config,
-        uint64_t& current_time)
+inline bool patch_data::add_agent(agent_state& agent) {
+    if (!agents.ensure_capacity(agents.length + 1))
+        return false;
+    agent.patch_index = (unsigned int) agents.length;
+    agents[agents.length++] = &agent;
+    return true;
+}
+
+/**
+ * Removes `agent` from the agents in this patch, by moving the last agent
+ * into its place.
+ */
+inline void patch_data::remove_agent(agent_state& agent) {
+    agent_state* last = agents.pop();
+    if (last != &agent) {
+        agents[agent.patch_index] = last;
+        last->patch_index = agent.patch_index;
+    }
+}
+
+/**
+ * Initializes the given agent_state `agent` at `start_position`, facing up,
+ * without adding it to any world. Its scent and vision are left
+ * uninitialized.
+ */
+inline status init(agent_state& agent,
+        position start_position, const simulator_config& config)
 {
-    agent.current_position = {0, 0};
+    agent.current_position = start_position;
     agent.current_direction = direction::UP;
-    agent.requested_position = {0, 0};
+    agent.requested_position = start_position;
     agent.requested_direction = direction::UP;
     agent.current_scent = (float*) malloc(sizeof(float) * config.scent_dimension);
     if (agent.current_scent == NULL) {
@@ -1068,7 +1576,38 @@ inline status init(
 
     agent.agent_acted = false;
     agent.agent_active = true;
+    agent.queued_actions = NULL;
+    agent.queued_action_count = 0;
+    agent.queued_action_capacity = 0;
+    agent.next_queued_action = 0;
+    agent.notify_when_queue_drained = false;
+    agent.action_queue_drained = false;
     new (&agent.lock) std::mutex();
+    return status::OK;
+}
+
+/**
+ * Initializes an agent's state in the provided world.
+ *
+ * \param   agent_state     Agent state to initialize.
+ * \param   world           Map of the world in which the agent is initialized.
+ * \param   scent_model     The scent diffusion model.
+ * \param   config          The configuration for this simulation.
+ * \param   current_time    The current simulation time.
+ *
+ * \tparam  T               The arithmetic type for the scent diffusion model.
+ */
+template<typename T>
+inline status init(
+        agent_state& agent,
+        map<patch_data, item_properties>& world,
+        const diffusion<T>& scent_model,
+        const simulator_config& config,
+        uint64_t& current_time)
+{
+    status init_status = init(agent, position(0, 0), config);
+    if (init_status != status::OK)
+        return init_status;
 
     patch<patch_data>* neighborhood[4]; position patch_positions[4];
     world.mcmc_iterations *= 10; /* TODO: should this be configurable? */
@@ -1091,30 +1630,39 @@ inline status init(
             }
         }
     }
-    neighborhood[index]->data.agents.add(&agent);
+    if (!neighborhood[index]->data.add_agent(agent)) {
+        fprintf(stderr, "init ERROR: Insufficient memory for patch_data.agents.\n");
+        free(agent.current_scent); free(agent.current_vision);
+        free(agent.collected_items); agent.lock.~mutex();
+        neighborhood[index]->data.patch_lock.unlock();
+        return status::OUT_OF_MEMORY;
+    }
+    neighborhood[index]->last_modified = world.modification_time;
     neighborhood[index]->data.patch_lock.unlock();
 
     /* initialize the scent and vision of the current agent */
     agent.update_state(neighborhood, scent_model, config, current_time);
 
-    /* update the scent and vision of nearby agents */
+    /* add this agent to the vision of nearby agents */
     for (unsigned int i = 0; i < 4; i++) {
         for (agent_state* neighbor : neighborhood[i]->data.agents) {
             if (neighbor == &agent) continue;
             patch<patch_data>* other_neighborhood[4];
             world.get_fixed_neighborhood(
                 neighbor->current_position, other_neighborhood, patch_positions);
-            neighbor->update_state(other_neighborhood, scent_model, config, current_time);
+            neighbor->update_agent_color(other_neighborhood, agent.current_position, 1.0f, config);
         }
     }
     return status::OK;
 }
 
 /**
- * Reads the given agent_state `agent` from the input stream `in`. 
+ * Reads the given agent_state `agent` from the input stream `in`, in the
+ * given simulator save format `version`.
  */
 template<typename Stream>
-inline bool read(agent_state& agent, Stream& in, const simulator_config& config)
+inline bool read(agent_state& agent, Stream& in, const simulator_config& config,
+        unsigned int version = SIMULATOR_SAVE_VERSION)
 {
     agent.current_scent = (float*) malloc(sizeof(float) * config.scent_dimension);
     if (agent.current_scent == NULL) {
@@ -1132,6 +1680,14 @@ inline bool read(agent_state& agent, Stream& in, const simulator_config& config)
         fprintf(stderr, "read ERROR: Insufficient memory for agent_state.collected_items.\n");
         free(agent.current_scent); free(agent.current_vision); return false;
     }
+    /* the action queue is not part of this representation, since it is
+       included in every step response; see `read_action_queues` */
+    agent.queued_actions = NULL;
+    agent.queued_action_count = 0;
+    agent.queued_action_capacity = 0;
+    agent.next_queued_action = 0;
+    agent.notify_when_queue_drained = false;
+    agent.action_queue_drained = false;
     new (&agent.lock) std::mutex();
 
     if (!read(agent.current_position, in)
@@ -1142,7 +1698,8 @@ inline bool read(agent_state& agent, Stream& in, const simulator_config& config)
      || !read(agent.agent_active, in)
      || !read(agent.requested_position, in)
      || !read(agent.requested_direction, in)
-     || !read(agent.collected_items, in, (unsigned int) config.item_types.length))
+     || !read(agent.collected_items, in, (unsigned int) config.item_types.length)
+     || (version >= SAVE_VERSION_ACTION_QUEUES && !read(agent.action_queue_drained, in)))
     {
          free(agent.current_scent); free(agent.current_vision);
          free(agent.collected_items); return false;
@@ -1164,18 +1721,130 @@ inline bool write(const agent_state& agent, Stream& out, const simulator_config&
         && write(agent.agent_active, out)
         && write(agent.requested_position, out)
         && write(agent.requested_direction, out)
-        && write(agent.collected_items, out, (unsigned int) config.item_types.length);
+        && write(agent.collected_items, out, (unsigned int) config.item_types.length)
+        && write(agent.action_queue_drained, out);
 }
 
 /**
- * This structure contains full information about a patch. This is more than we
- * need for simulation, but it is useful for visualization.
+ * Reads the given agent_state `agent` from the input stream `in`, as written
+ * by `write_without_observations`. Rather than allocating its own scent and
+ * vision, `agent` points to the given `scent` and `vision`, which are owned
+ * by the caller, and so `agent.current_scent` and `agent.current_vision` must
+ * be set to `NULL` before `agent` is freed.
  */
-struct patch_state {
-    position patch_position;
-    bool fixed;
-    float* scent;
-    float* vision;
+template<typename Stream>
+inline bool read_without_observations(agent_state& agent, Stream& in,
+        const simulator_config& config, float* scent, float* vision)
+{
+    agent.current_scent = scent;
+    agent.current_vision = vision;
+    agent.collected_items = (unsigned int*) malloc(sizeof(unsigned int) * config.item_types.length);
+    if (agent.collected_items == NULL) {
+        fprintf(stderr, "read_without_observations ERROR: Insufficient memory for agent_state.collected_items.\n");
+        return false;
+    }
+    agent.queued_actions = NULL;
+    agent.queued_action_count = 0;
+    agent.queued_action_capacity = 0;
+    agent.next_queued_action = 0;
+    agent.notify_when_queue_drained = false;
+    new (&agent.lock) std::mutex();
+
+    if (!read(agent.current_position, in)
+     || !read(agent.current_direction, in)
+     || !read(agent.agent_acted, in)
+     || !read(agent.agent_active, in)
+     || !read(agent.requested_position, in)
+     || !read(agent.requested_direction, in)
+     || !read(agent.collected_items, in, (unsigned int) config.item_types.length)
+     || !read(agent.action_queue_drained, in))
+    {
+        free(agent.collected_items);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the given agent_state `agent` to the output stream `out`, without
+ * its scent and vision, which the caller passes to the reader separately.
+ */
+template<typename Stream>
+inline bool write_without_observations(const agent_state& agent, Stream& out, const simulator_config& config)
+{
+    return write(agent.current_position, out)
+        && write(agent.current_direction, out)
+        && write(agent.agent_acted, out)
+        && write(agent.agent_active, out)
+        && write(agent.requested_position, out)
+        && write(agent.requested_direction, out)
+        && write(agent.collected_items, out, (unsigned int) config.item_types.length)
+        && write(agent.action_queue_drained, out);
+}
+
+/**
+ * Initializes `agent` as a copy of another agent's state, with buffers for
+ * its scent, vision, and collected items under the given `config`. The copy
+ * is filled in by `copy_observation`. It is not part of any world, and it
+ * has no action queue.
+ */
+inline bool init_copy(agent_state& agent, const simulator_config& config)
+{
+    agent.current_scent = (float*) malloc(sizeof(float) * config.scent_dimension);
+    if (agent.current_scent == NULL) {
+        fprintf(stderr, "init_copy ERROR: Insufficient memory for agent_state.current_scent.\n");
+        return false;
+    }
+    agent.current_vision = (float*) malloc(sizeof(float)
+        * (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension);
+    if (agent.current_vision == NULL) {
+        fprintf(stderr, "init_copy ERROR: Insufficient memory for agent_state.current_vision.\n");
+        free(agent.current_scent); return false;
+    }
+    agent.collected_items = (unsigned int*) malloc(max((size_t) 1, sizeof(unsigned int) * config.item_types.length));
+    if (agent.collected_items == NULL) {
+        fprintf(stderr, "init_copy ERROR: Insufficient memory for agent_state.collected_items.\n");
+        free(agent.current_scent); free(agent.current_vision); return false;
+    }
+    agent.queued_actions = NULL;
+    agent.queued_action_count = 0;
+    agent.queued_action_capacity = 0;
+    agent.next_queued_action = 0;
+    agent.notify_when_queue_drained = false;
+    new (&agent.lock) std::mutex();
+    return true;
+}
+
+/**
+ * Copies the state of `src` that is visible to clients (that is, the state
+ * written by `write(const agent_state&, Stream&, const simulator_config&)`)
+ * into `dst`, which was initialized by `init_copy`.
+ */
+inline void copy_observation(const agent_state& src,
+        agent_state& dst, const simulator_config& config)
+{
+    dst.current_position = src.current_position;
+    dst.current_direction = src.current_direction;
+    memcpy(dst.current_scent, src.current_scent, sizeof(float) * config.scent_dimension);
+    memcpy(dst.current_vision, src.current_vision, sizeof(float)
+        * (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension);
+    dst.agent_acted = src.agent_acted;
+    dst.agent_active = src.agent_active;
+    dst.requested_position = src.requested_position;
+    dst.requested_direction = src.requested_direction;
+    memcpy(dst.collected_items, src.collected_items, sizeof(unsigned int) * config.item_types.length);
+    dst.action_queue_drained = src.action_queue_drained;
+}
+
+/**
+ * This structure contains full information about a patch. This is more than we
+ * need for simulation, but it is useful for visualization.
+ */
+struct patch_state {
+    position patch_position;
+    bool fixed;
+    float* scent;
+    float* vision;
     item* items;
     unsigned int item_count;
     position* agent_positions;
@@ -1323,14 +1992,429 @@ bool write(const patch_state& patch, Stream& out, const simulator_config& config
         && write(patch.agent_directions, out, patch.agent_count);
 }
 
-void* alloc_position_keys(size_t n, size_t element_size) {
-    position* keys = (position*) malloc(sizeof(position) * n);
-    if (keys == NULL) return NULL;
-    for (unsigned int i = 0; i < n; i++)
-        position::set_empty(keys[i]);
-    return (void*) keys;
+/**
+ * A summary of a square block of patches, as retrieved by
+ * `simulator::get_map_summary`. Unlike `patch_state`, its size does not
+ * depend on the number of items in the block, which makes it suitable for
+ * overviews of large regions.
+ */
+struct patch_summary {
+    /* the position of the block, which contains the patches whose positions,
+       divided by the block size and rounded down, are equal to this */
+    position block_position;
+
+    /* the number of patches in the block that exist */
+    unsigned int patch_count;
+
+    /* the number of uncollected items of each type in the block */
+    unsigned int* item_counts;
+
+    /* the number of agents in the block */
+    unsigned int agent_count;
+
+    /* the average color of the cells in the existing patches of the block,
+       which has `color_dimension` elements */
+    float* color;
+
+    static inline void move(const patch_summary& src, patch_summary& dst) {
+        core::move(src.block_position, dst.block_position);
+        core::move(src.patch_count, dst.patch_count);
+        core::move(src.item_counts, dst.item_counts);
+        core::move(src.agent_count, dst.agent_count);
+        core::move(src.color, dst.color);
+    }
+
+    static inline void free(patch_summary& summary) {
+        core::free(summary.item_counts);
+        core::free(summary.color);
+    }
+};
+
+/**
+ * Initializes the given patch_summary `summary` to an empty block, where all
+ * counts and colors are zero.
+ */
+inline bool init(patch_summary& summary, const position& block_position,
+        unsigned int item_type_count, unsigned int color_dimension)
+{
+    summary.block_position = block_position;
+    summary.patch_count = 0;
+    summary.agent_count = 0;
+    summary.item_counts = (unsigned int*) calloc(max(1u, item_type_count), sizeof(unsigned int));
+    if (summary.item_counts == nullptr) {
+        fprintf(stderr, "init ERROR: Insufficient memory for patch_summary.item_counts.\n");
+        return false;
+    }
+    summary.color = (float*) calloc(max(1u, color_dimension), sizeof(float));
+    if (summary.color == nullptr) {
+        fprintf(stderr, "init ERROR: Insufficient memory for patch_summary.color.\n");
+        core::free(summary.item_counts); return false;
+    }
+    return true;
+}
+
+/**
+ * Reads the given patch_summary `summary` from the input stream `in`.
+ */
+template<typename Stream>
+bool read(patch_summary& summary, Stream& in, const simulator_config& config) {
+    position block_position;
+    if (!read(block_position, in)
+     || !init(summary, block_position, (unsigned int) config.item_types.length, config.color_dimension))
+        return false;
+    if (!read(summary.patch_count, in)
+     || !read(summary.item_counts, in, (unsigned int) config.item_types.length)
+     || !read(summary.agent_count, in)
+     || !read(summary.color, in, config.color_dimension))
+    {
+        core::free(summary);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the given patch_summary `summary` to the output stream `out`.
+ */
+template<typename Stream>
+bool write(const patch_summary& summary, Stream& out, const simulator_config& config) {
+    return write(summary.block_position, out)
+        && write(summary.patch_count, out)
+        && write(summary.item_counts, out, (unsigned int) config.item_types.length)
+        && write(summary.agent_count, out)
+        && write(summary.color, out, config.color_dimension);
+}
+
+/**
+ * A request by an agent to occupy the position `target` in the next time
+ * step. The simulator stores these in a flat array that is sorted at each
+ * time step, so that the requests for any given position are contiguous.
+ */
+struct requested_move {
+    /* The position the agent requested to occupy. */
+    position target;
+
+    /* The agent that made the request. */
+    agent_state* agent;
+
+    /* The index of this request in arrival order within the time step. */
+    unsigned int order;
+
+    /* `true` if the agent requested to stay at its current position. */
+    bool stays;
+
+    /**
+     * Requests are ordered by their target position. Requests for the same
+     * position are ordered so that an agent staying in place comes first,
+     * followed by the remaining agents in the order they requested.
+     */
+    inline bool operator < (const requested_move& other) const {
+        if (target != other.target) return target < other.target;
+        else if (stays != other.stays) return stays;
+        else return order < other.order;
+    }
+
+    static inline void move(const requested_move& src, requested_move& dst) {
+        dst.target = src.target;
+        dst.agent = src.agent;
+        dst.order = src.order;
+        dst.stays = src.stays;
+    }
+
+    static inline void swap(requested_move& first, requested_move& second) {
+        position::swap(first.target, second.target);
+        core::swap(first.agent, second.agent);
+        core::swap(first.order, second.order);
+        core::swap(first.stays, second.stays);
+    }
+};
+
+/**
+ * The agents in a simulator, stored as parallel arrays so that each time step
+ * can sweep them linearly. `states[i]` is the state of the agent with ID
+ * `ids[i]`, and its `agent_state::table_index` is `i`. The per-agent states
+ * remain separate allocations (they own the perception buffers), but the
+ * fields read by the whole-population sweeps are mirrored here:
+ * `positions[i]` is the `current_position` of `states[i]`, and is kept in
+ * sync by `set_position`. Removing an agent moves the last agent into its
+ * place.
+ */
+struct agent_table {
+    array<agent_state*> states;
+    array<uint64_t> ids;
+    array<position> positions;
+
+    agent_table(size_t initial_capacity) :
+        states(initial_capacity), ids(initial_capacity), positions(initial_capacity) { }
+
+    inline size_t length() const {
+        return states.length;
+    }
+
+    inline bool ensure_capacity(size_t new_length) {
+        return states.ensure_capacity(new_length)
+            && ids.ensure_capacity(new_length)
+            && positions.ensure_capacity(new_length);
+    }
+
+    /* Precondition: `ensure_capacity(length() + 1)` has succeeded. */
+    inline void add(uint64_t id, agent_state* agent) {
+        agent->table_index = (unsigned int) states.length;
+        states[states.length++] = agent;
+        ids[ids.length++] = id;
+        positions[positions.length++] = agent->current_position;
+    }
+
+    inline void remove(agent_state& agent) {
+        unsigned int index = agent.table_index;
+        agent_state* last = states.pop();
+        uint64_t last_id = ids.pop();
+        position last_position = positions.pop();
+        if (last != &agent) {
+            states[index] = last;
+            ids[index] = last_id;
+            positions[index] = last_position;
+            last->table_index = index;
+        }
+    }
+
+    /* Moves `agent` to `new_position`, keeping `positions` in sync. */
+    inline void set_position(agent_state& agent, const position& new_position) {
+        agent.current_position = new_position;
+        positions[agent.table_index] = new_position;
+    }
+
+    inline agent_state** begin() {
+        return states.data;
+    }
+
+    inline agent_state** end() {
+        return states.data + states.length;
+    }
+
+    static inline void free(agent_table& table) {
+        core::free(table.states);
+        core::free(table.ids);
+        core::free(table.positions);
+    }
+};
+
+inline bool init(agent_table& table, size_t initial_capacity) {
+    if (!array_init(table.states, initial_capacity)) {
+        return false;
+    } else if (!array_init(table.ids, initial_capacity)) {
+        free(table.states); return false;
+    } else if (!array_init(table.positions, initial_capacity)) {
+        free(table.states); free(table.ids); return false;
+    }
+    return true;
 }
 
+/**
+ * An agent in an observation_snapshot, which keeps these sorted by `id`.
+ */
+struct published_agent {
+    uint64_t id;
+    agent_state* state;
+
+    inline bool operator < (const published_agent& other) const {
+        return id < other.id;
+    }
+
+    static inline void move(const published_agent& src, published_agent& dst) {
+        dst.id = src.id;
+        dst.state = src.state;
+    }
+
+    static inline void swap(published_agent& first, published_agent& second) {
+        core::swap(first.id, second.id);
+        core::swap(first.state, second.state);
+    }
+};
+
+/**
+ * A copy of the states of all agents in a simulator, as they were at the end
+ * of a time step, or after agents were added or removed. See
+ * `snapshot_pool` and `simulator::acquire_snapshot`.
+ */
+struct observation_snapshot {
+    /* The agents in this snapshot, sorted by ID. */
+    array<published_agent> agents;
+
+    /**
+     * The agent_state copies owned by this snapshot. These are reused across
+     * time steps, and `agents` refers to the first `agents.length` of them.
+     */
+    array<agent_state*> copies;
+
+    /* The number of readers that are currently using this snapshot. */
+    mutable std::atomic<unsigned int> reader_count;
+
+    /* The simulation time when this snapshot was published. */
+    uint64_t time;
+
+    observation_snapshot() : agents(16), copies(16), reader_count(0), time(0) { }
+
+    ~observation_snapshot() {
+        for (agent_state* copy : copies) {
+            core::free(*copy);
+            core::free(copy);
+        }
+    }
+
+    /**
+     * Returns the copy of the state of the agent with the given ID, or
+     * `nullptr` if there is no such agent in this snapshot.
+     */
+    inline const agent_state* get(uint64_t agent_id) const {
+        unsigned int start = 0, end = (unsigned int) agents.length;
+        while (start < end) {
+            unsigned int mid = start + (end - start) / 2;
+            if (agents[mid].id < agent_id) start = mid + 1;
+            else end = mid;
+        }
+        if (start == agents.length || agents[start].id != agent_id)
+            return nullptr;
+        return agents[start].state;
+    }
+};
+
+/**
+ * The snapshots of the agent states in a simulator. Readers only use the
+ * `published` snapshot, and they do not take any locks. The simulator
+ * publishes each new snapshot, while holding its lock, into a snapshot that
+ * is neither published nor in use by any reader: usually the other of the
+ * two `buffers`, or a spare one if a reader still holds on to that.
+ */
+struct snapshot_pool {
+    observation_snapshot buffers[2];
+
+    /* The `buffers` followed by any spare snapshots. */
+    array<observation_snapshot*> snapshots;
+
+    std::atomic<observation_snapshot*> published;
+
+    snapshot_pool() : snapshots(4), published(&buffers[0]) {
+        snapshots[0] = &buffers[0];
+        snapshots[1] = &buffers[1];
+        snapshots.length = 2;
+    }
+
+    ~snapshot_pool() {
+        for (size_t i = 2; i < snapshots.length; i++) {
+            snapshots[i]->~observation_snapshot();
+            core::free(snapshots[i]);
+        }
+    }
+
+    /**
+     * Returns the published snapshot, which does not change until it is
+     * passed to `release`. This never blocks.
+     */
+    inline const observation_snapshot& acquire() {
+        while (true) {
+            observation_snapshot* snapshot = published.load();
+            snapshot->reader_count++;
+
+            /* make sure the snapshot was not replaced (and possibly reused)
+               before we registered as a reader */
+            if (published.load() == snapshot)
+                return *snapshot;
+            snapshot->reader_count--;
+        }
+    }
+
+    inline void release(const observation_snapshot& snapshot) {
+        snapshot.reader_count--;
+    }
+
+    /**
+     * Returns a snapshot into which the next one may be written, allocating
+     * a spare snapshot if every other one is in use, or `nullptr` if this
+     * runs out of memory. A reader may briefly register with the returned
+     * snapshot, but it will find that it is not published and move on.
+     */
+    inline observation_snapshot* next() {
+        observation_snapshot* current = published.load();
+        for (observation_snapshot* snapshot : snapshots)
+            if (snapshot != current && snapshot->reader_count.load() == 0)
+                return snapshot;
+
+        if (!snapshots.ensure_capacity(snapshots.length + 1))
+            return nullptr;
+        observation_snapshot* spare = (observation_snapshot*) malloc(sizeof(observation_snapshot));
+        if (spare == nullptr) return nullptr;
+        new (spare) observation_snapshot();
+        snapshots[snapshots.length++] = spare;
+        return spare;
+    }
+};
+
+/**
+ * The state of the agents at the end of a time step, which is queued for
+ * delivery to `on_step` when `simulator_config::step_notification_capacity`
+ * is nonzero.
+ */
+struct step_notification {
+    uint64_t time;
+
+    /* A map from agent IDs to the copies in `copies`, passed to `on_step`. */
+    hash_map<uint64_t, agent_state*> agents;
+
+    /**
+     * The agent_state copies owned by this notification. These are reused
+     * across time steps, like those in `observation_snapshot`.
+     */
+    array<agent_state*> copies;
+
+    step_notification() : time(0), agents(32), copies(16) { }
+
+    ~step_notification() {
+        for (agent_state* copy : copies) {
+            core::free(*copy);
+            core::free(copy);
+        }
+    }
+};
+
+/**
+ * An enum representing where `simulator::add_agents` places the new agents.
+ */
+enum class placement_policy : uint8_t {
+    /* Each agent is placed at the corresponding position in `agent_placement::positions`. */
+    EXPLICIT = 0,
+
+    /* Agents are placed at random cells in the region that are not occupied by other agents. */
+    RANDOM = 1,
+
+    /* Agents are placed on an evenly spaced grid that covers the region. */
+    SPREAD = 2
+};
+
+/**
+ * Describes where `simulator::add_agents` places the new agents. The region
+ * is the rectangle with corners `bottom_left` and `top_right` (inclusive),
+ * and it is ignored by `placement_policy::EXPLICIT`.
+ */
+struct agent_placement {
+    placement_policy policy;
+    const position* positions;
+    position bottom_left;
+    position top_right;
+};
+
+/**
+ * An enum representing how agents act during `simulator::advance`, when they
+ * are not controlled by their clients.
+ */
+enum class advance_policy : uint8_t {
+    /* Agents that have not acted do nothing. Action queues are left as is. */
+    NO_OP = 0,
+
+    /* Agents perform their queued actions, and do nothing once their queues are empty. */
+    QUEUED_ACTIONS = 1
+};
+
 /**
  * Simulator that forms the core of our experimentation framework.
  *
@@ -1350,6 +2434,9 @@ class simulator {
     /* Agents managed by this simulator. */
     hash_map<uint64_t, agent_state*> agents;
 
+    /* The same agents, stored densely for the sweeps in each time step. */
+    agent_table dense_agents;
+
     /* Semaphores in this simulator. */
     hash_map<uint64_t, bool> semaphores;
 
@@ -1359,38 +2446,101 @@ class simulator {
     /* Lock for the agent and semaphore tables, used to prevent simultaneous updates. */
     std::mutex simulator_lock;
 
-    /* A map from positions to a list of agents that request to move there. */
-    hash_map<position, array<agent_state*>> requested_moves;
+    /**
+     * The positions requested by agents during the current time step. This
+     * array is reused across time steps, and it is sorted by target position
+     * when the simulation is advanced. Withdrawn requests are swapped with the
+     * last element, so the arrival order is kept in `requested_move::order`.
+     */
+    array<requested_move> requested_moves;
+
+    /* The number of moves requested so far in the current time step. */
+    unsigned int requested_move_count;
+
+    /* Scratch space for propagating blocked moves in `step`. */
+    array<position> blocked_positions;
 
-    /* Lock for the requested_moves map, used to prevent simultaneous updates. */
+    /* Lock for the requested_moves array, used to prevent simultaneous updates. */
     std::mutex requested_move_lock;
 
     /**
-     * Counter for how many agents have acted and how many semaphores have
-     * signaled during each time step. This counter is used to force the
-     * simulator to wait until all agents have acted and all semaphores have
-     * signaled, before advancing the simulation time step.
+     * Worker threads for the parallel phases of `step`, or `nullptr` if
+     * `config.step_thread_count` is at most 1.
      */
-    unsigned int acted_agent_count;
+    thread_pool* step_pool;
 
     /**
-     * The number of active agents and semaphores in the simulation. The
-     * simulation only waits for agents with `agent_active` set to `true`
-     * before advancing time.
+     * Scratch space for the parallel perception phase of `step`: the
+     * positions of the four patches in the neighborhood of each agent in
+     * `dense_agents`.
      */
-    unsigned int active_agent_count;
+    array<position> perception_patch_positions;
 
-    /* For storing additional state in the simulation. */
-    SimulatorData data;
+    /**
+     * The instantiation of `perceive_with` for the observation dimensions in
+     * `config`, which is chosen when the simulator is constructed.
+     */
+    typedef void (simulator::*perceive_function)(agent_state* const*, size_t);
+    perceive_function perceive_kernel;
 
-    typedef patch<patch_data> patch_type;
+    /**
+     * The thread that advances the simulation, if
+     * `config.dedicated_step_thread` is `true`. It waits on `step_cv`, which
+     * is signaled (with `simulator_lock` held) when a time step is complete.
+     */
+    std::thread step_thread;
+    std::condition_variable step_cv;
+    bool step_requested;
+    bool step_thread_stopping;
 
-public:
     /**
-     * Constructs a new simulator with the given simulator_config `conf` and
-     * SimulatorData `data`, calling the copy constructor for `data`.
+     * The number of agents that were given `config.default_action` because
+     * they had not acted by the deadline of the most recent time step.
      */
-    simulator(const simulator_config& conf,
+    unsigned int defaulted_agent_count;
+
+    /**
+     * Copies of the agent states for readers that do not take any locks,
+     * which are published by every function that changes them while holding
+     * `simulator_lock`.
+     */
+    snapshot_pool snapshots;
+
+    /**
+     * Copies of the agent states at the end of recent time steps that have
+     * not yet been delivered to `on_step` by `notification_thread`, or
+     * `nullptr` if `config.step_notification_capacity` is zero, in which case
+     * `step` calls `on_step` directly.
+     */
+    notification_queue<step_notification>* notifications;
+    std::thread notification_thread;
+
+    /**
+     * Counter for how many agents have acted and how many semaphores have
+     * signaled during each time step. This counter is used to force the
+     * simulator to wait until all agents have acted and all semaphores have
+     * signaled, before advancing the simulation time step.
+     */
+    unsigned int acted_agent_count;
+
+    /**
+     * The number of active agents and semaphores in the simulation. The
+     * simulation only waits for agents with `agent_active` set to `true`
+     * before advancing time.
+     */
+    unsigned int active_agent_count;
+
+    /* For storing additional state in the simulation. */
+    SimulatorData data;
+
+    typedef patch<patch_data> patch_type;
+
+public:
+    /**
+     * Constructs a new simulator with the given simulator_config `conf` and
+     * SimulatorData `data`, calling the copy constructor for `data`.
+     */
+    simulator(const simulator_config& conf,
             const SimulatorData& data,
             uint_fast32_t seed) :
         config(conf),
@@ -1398,14 +2548,22 @@ public:
             config.mcmc_iterations,
             config.item_types.data,
             (unsigned int) config.item_types.length, seed),
-        agents(32), semaphores(8), id_counter(1), requested_moves(32, alloc_position_keys),
-        acted_agent_count(0), active_agent_count(0), data(data), time(0)
+        agents(32), dense_agents(32), semaphores(8), id_counter(1), requested_moves(64), requested_move_count(0), blocked_positions(16),
+        step_pool(make_step_pool(config)), perception_patch_positions(128),
+        perceive_kernel(select_perceive_kernel(config)),
+        step_requested(false), step_thread_stopping(false), defaulted_agent_count(0),
+        notifications(make_notification_queue(config)), acted_agent_count(0), active_agent_count(0), data(data), time(0)
     {
         if (!init(scent_model, (double) config.diffusion_param,
                 (double) config.decay_param, config.patch_size, config.deleted_item_lifetime)) {
             fprintf(stderr, "simulator ERROR: Unable to initialize scent_model.\n");
             exit(EXIT_FAILURE);
+        } else if (!is_default_action_valid(config)) {
+            exit(EXIT_FAILURE);
         }
+        world.modification_time = time + 1;
+        start_step_thread();
+        start_notification_thread();
     }
 
     /**
@@ -1432,7 +2590,7 @@ public:
      */
     inline status add_agent(uint64_t& new_agent_id, agent_state*& new_agent) {
         simulator_lock.lock();
-        if (!agents.check_size()) {
+        if (!agents.check_size() || !dense_agents.ensure_capacity(dense_agents.length() + 1)) {
             simulator_lock.unlock();
             fprintf(stderr, "simulator.add_agent ERROR: Failed to expand agent table.\n");
             return status::OUT_OF_MEMORY;
@@ -1455,12 +2613,107 @@ public:
         agents.table.keys[bucket] = id_counter;
         agents.values[bucket] = new_agent;
         agents.table.size++;
+        dense_agents.add(id_counter, new_agent);
         active_agent_count++;
         id_counter++;
+        publish_snapshot();
         simulator_lock.unlock();
         return status::OK;
     }
 
+    /**
+     * Adds `count` new agents to this simulator, at the positions given by
+     * `placement`. The neighborhoods of all the new agents are generated
+     * before any of them is added, and the perception of the new agents is
+     * computed once, after all of them have been added.
+     * Upon success, `new_agent_ids` and `new_agents` (which must each have
+     * room for `count` elements) contain the IDs of the new agents and
+     * pointers to their states. Either all of the agents are added, or none
+     * of them are.
+     */
+    status add_agents(unsigned int count, const agent_placement& placement,
+            uint64_t* new_agent_ids, agent_state** new_agents)
+    {
+        if (count == 0) return status::OK;
+        array<position> positions(count);
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        if (!agents.check_size(agents.table.size + count)
+         || !dense_agents.ensure_capacity(dense_agents.length() + count))
+        {
+            fprintf(stderr, "simulator.add_agents ERROR: Failed to expand agent table.\n");
+            return status::OUT_OF_MEMORY;
+        }
+
+        status result = place_agents(count, placement, positions);
+        if (result != status::OK)
+            return result;
+
+        for (unsigned int i = 0; i < count; i++) {
+            new_agents[i] = (agent_state*) malloc(sizeof(agent_state));
+            if (new_agents[i] == nullptr) {
+                fprintf(stderr, "simulator.add_agents ERROR: Out of memory.\n");
+                result = status::OUT_OF_MEMORY;
+            } else {
+                result = init(*new_agents[i], positions[i], config);
+                if (result != status::OK) core::free(new_agents[i]);
+            }
+            if (result != status::OK) {
+                for (unsigned int j = 0; j < i; j++) {
+                    core::free(*new_agents[j]);
+                    core::free(new_agents[j]);
+                }
+                return result;
+            }
+        }
+
+        /* the neighborhoods were fixed by `place_agents`, so this only finds them */
+        for (unsigned int i = 0; i < count; i++) {
+            agent_state* agent = new_agents[i];
+            patch_type* neighborhood[4]; position patch_positions[4];
+            unsigned int index = world.get_fixed_neighborhood(
+                agent->current_position, neighborhood, patch_positions);
+            if (!neighborhood[index]->data.add_agent(*agent)) {
+                fprintf(stderr, "simulator.add_agents ERROR: Insufficient memory for patch_data.agents.\n");
+                for (unsigned int j = 0; j < count; j++) {
+                    if (j < i) remove_from_patch(*new_agents[j]);
+                    core::free(*new_agents[j]);
+                    core::free(new_agents[j]);
+                }
+                return status::OUT_OF_MEMORY;
+            }
+            neighborhood[index]->last_modified = world.modification_time;
+        }
+
+        size_t first_new_index = dense_agents.length();
+        for (unsigned int i = 0; i < count; i++) {
+            new_agent_ids[i] = id_counter;
+            agents.put(id_counter, new_agents[i]);
+            dense_agents.add(id_counter, new_agents[i]);
+            id_counter++;
+        }
+        active_agent_count += count;
+
+        /* compute the perception of the new agents, and add them to the vision of existing agents nearby */
+        perceive(new_agents, count);
+        for (unsigned int i = 0; i < count; i++) {
+            patch_type* neighborhood[4]; position patch_positions[4];
+            world.get_fixed_neighborhood(
+                new_agents[i]->current_position, neighborhood, patch_positions);
+            for (unsigned int j = 0; j < 4; j++) {
+                for (agent_state* neighbor : neighborhood[j]->data.agents) {
+                    if (neighbor->table_index >= first_new_index) continue;
+                    patch_type* other_neighborhood[4];
+                    world.get_fixed_neighborhood(
+                        neighbor->current_position, other_neighborhood, patch_positions);
+                    neighbor->update_agent_color(other_neighborhood, new_agents[i]->current_position, 1.0f, config);
+                }
+            }
+        }
+
+        publish_snapshot();
+        return status::OK;
+    }
+
     /**
      * Removes the given agent from this simulator.
      *
@@ -1475,6 +2728,7 @@ public:
             return status::INVALID_AGENT_ID;
         }
         agents.remove_at(bucket);
+        dense_agents.remove(*agent);
         agent->lock.lock();
         if (agent->agent_acted) {
             unrequest_position(*agent);
@@ -1485,9 +2739,10 @@ public:
         agent->lock.unlock();
         core::free(*agent, world, scent_model, config, time);
         core::free(agent);
+        publish_snapshot();
 
         if (acted_agent_count == active_agent_count)
-            step(); /* advance the simulation by one time step */
+            request_step(); /* advance the simulation by one time step */
         simulator_lock.unlock();
 
         return status::OK;
@@ -1535,7 +2790,7 @@ public:
         --active_agent_count;
 
         if (acted_agent_count == active_agent_count)
-            step(); /* advance the simulation by one time step */
+            request_step(); /* advance the simulation by one time step */
         simulator_lock.unlock();
 
         return status::OK;
@@ -1559,7 +2814,7 @@ public:
         }
         signaled = true;
         if (++acted_agent_count == active_agent_count)
-            step(); /* advance the simulation by one time step */
+            request_step(); /* advance the simulation by one time step */
         simulator_lock.unlock();
         return status::OK;
     }
@@ -1577,26 +2832,21 @@ public:
         }
         agent_state& agent = *agent_ptr;
         agent.lock.lock();
-        simulator_lock.unlock();
-
         if (agent.agent_active && !active) {
             agent.agent_active = false;
             agent.lock.unlock();
-
-            simulator_lock.lock();
+            publish_snapshot();
             if (acted_agent_count == --active_agent_count)
-                step(); /* advance the simulation by one time step */
-            simulator_lock.unlock();
+                request_step(); /* advance the simulation by one time step */
         } else if (!agent.agent_active && active) {
             agent.agent_active = true;
             agent.lock.unlock();
-
-            simulator_lock.lock();
             active_agent_count++;
-            simulator_lock.unlock();
+            publish_snapshot();
         } else {
             agent.lock.unlock();
         }
+        simulator_lock.unlock();
         return status::OK;
     }
 
@@ -1627,8 +2877,7 @@ public:
      */
     inline status move(uint64_t agent_id, direction dir, unsigned int num_steps)
     {
-        if (num_steps > config.max_steps_per_movement
-         || config.allowed_movement_directions[(size_t) dir] == action_policy::DISALLOWED)
+        if (!is_move_allowed(dir, num_steps))
             return status::PERMISSION_ERROR;
 
         bool contains;
@@ -1639,53 +2888,24 @@ public:
             return status::INVALID_AGENT_ID;
         }
         agent.lock.lock();
-        simulator_lock.unlock();
-
         if (agent.agent_acted) {
             agent.lock.unlock();
+            simulator_lock.unlock();
             return status::AGENT_ALREADY_ACTED;
         }
         agent.agent_acted = true;
-
-        agent.requested_position = agent.current_position;
-        agent.requested_direction = agent.current_direction;
-        if (config.allowed_movement_directions[(size_t) dir] != action_policy::IGNORED) {
-            position diff(0, 0);
-            switch (dir) {
-            case direction::UP   : diff.x = 0; diff.y = num_steps; break;
-            case direction::DOWN : diff.x = 0; diff.y = -((int64_t) num_steps); break;
-            case direction::LEFT : diff.x = -((int64_t) num_steps); diff.y = 0; break;
-            case direction::RIGHT: diff.x = num_steps; diff.y = 0; break;
-            case direction::COUNT: break;
-            }
-
-            switch (agent.current_direction) {
-            case direction::UP: break;
-            case direction::DOWN: diff.x *= -1; diff.y *= -1; break;
-            case direction::LEFT:
-                core::swap(diff.x, diff.y);
-                diff.x *= -1; break;
-            case direction::RIGHT:
-                core::swap(diff.x, diff.y);
-                diff.y *= -1; break;
-            case direction::COUNT: break;
-            }
-
-            agent.requested_position += diff;
-        }
+        set_requested_move(agent, dir, num_steps);
 
         /* add the agent's move to the list of requested moves */
         request_position(agent);
 
-        if (agent.agent_active) {
-            agent.lock.unlock();
-            simulator_lock.lock();
-            if (++acted_agent_count == active_agent_count)
-                step(); /* advance the simulation by one time step */
-            simulator_lock.unlock();
-        } else {
-            agent.lock.unlock();
-        }
+        /* count the action before releasing the simulator lock, so that the
+           counters are always consistent with the agents' `agent_acted` flags */
+        bool agent_active = agent.agent_active;
+        agent.lock.unlock();
+        if (agent_active && ++acted_agent_count == active_agent_count)
+            request_step(); /* advance the simulation by one time step */
+        simulator_lock.unlock();
         return status::OK;
     }
 
@@ -1702,7 +2922,7 @@ public:
      */
     inline status turn(uint64_t agent_id, direction dir)
     {
-        if (config.allowed_rotations[(size_t) dir] == action_policy::DISALLOWED)
+        if (!is_turn_allowed(dir))
             return status::PERMISSION_ERROR;
 
         bool contains;
@@ -1713,54 +2933,22 @@ public:
             return status::INVALID_AGENT_ID;
         }
         agent.lock.lock();
-        simulator_lock.unlock();
-
         if (agent.agent_acted) {
             agent.lock.unlock();
+            simulator_lock.unlock();
             return status::AGENT_ALREADY_ACTED;
         }
         agent.agent_acted = true;
-
-        agent.requested_position = agent.current_position;
-        agent.requested_direction = agent.current_direction;
-
-        if (config.allowed_rotations[(size_t) dir] != action_policy::IGNORED) {
-            switch (dir) {
-            case direction::UP: break;
-            case direction::DOWN:
-                if (agent.current_direction == direction::UP) agent.requested_direction = direction::DOWN;
-                else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::UP;
-                else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::RIGHT;
-                else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::LEFT;
-                break;
-            case direction::LEFT:
-                if (agent.current_direction == direction::UP) agent.requested_direction = direction::LEFT;
-                else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::RIGHT;
-                else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::DOWN;
-                else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::UP;
-                break;
-            case direction::RIGHT:
-                if (agent.current_direction == direction::UP) agent.requested_direction = direction::RIGHT;
-                else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::LEFT;
-                else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::UP;
-                else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::DOWN;
-                break;
-            case direction::COUNT: break;
-            }
-        }
+        set_requested_turn(agent, dir);
 
         /* add the agent's move to the list of requested moves */
         request_position(agent);
 
-        if (agent.agent_active) {
-            agent.lock.unlock();
-            simulator_lock.lock();
-            if (++acted_agent_count == active_agent_count)
-                step(); /* advance the simulation by one time step */
-            simulator_lock.unlock();
-        } else {
-            agent.lock.unlock();
-        }
+        bool agent_active = agent.agent_active;
+        agent.lock.unlock();
+        if (agent_active && ++acted_agent_count == active_agent_count)
+            request_step(); /* advance the simulation by one time step */
+        simulator_lock.unlock();
         return status::OK;
     }
 
@@ -1781,10 +2969,9 @@ public:
             return status::INVALID_AGENT_ID;
         }
         agent.lock.lock();
-        simulator_lock.unlock();
-
         if (agent.agent_acted) {
             agent.lock.unlock();
+            simulator_lock.unlock();
             return status::AGENT_ALREADY_ACTED;
         }
         agent.agent_acted = true;
@@ -1795,41 +2982,210 @@ public:
         /* add the agent's move to the list of requested moves */
         request_position(agent);
 
-        if (agent.agent_active) {
+        bool agent_active = agent.agent_active;
+        agent.lock.unlock();
+        if (agent_active && ++acted_agent_count == active_agent_count)
+            request_step(); /* advance the simulation by one time step */
+        simulator_lock.unlock();
+        return status::OK;
+    }
+
+    /**
+     * Submits an action for each agent in a batch, acquiring the simulator
+     * lock only once. Each action is validated and applied exactly as if it
+     * were submitted through `move`, `turn`, or `do_nothing`, except that the
+     * simulation advances at most once, after the whole batch has been
+     * applied. This means an agent may appear at most once in a batch; any
+     * repeated occurrence fails with `status::AGENT_ALREADY_ACTED`.
+     *
+     * \param   agent_ids   The IDs of the agents that are acting.
+     * \param   actions     The action for each agent, parallel to `agent_ids`.
+     * \param   n           The length of `agent_ids`, `actions`, and
+     *                      `statuses`.
+     * \param   statuses    The output array in which the result of each
+     *                      action is stored, parallel to `agent_ids`.
+     */
+    inline void act_batch(const uint64_t* agent_ids,
+            const action* actions, size_t n, status* statuses)
+    {
+        unsigned int acted_count = 0;
+        simulator_lock.lock();
+        for (size_t i = 0; i < n; i++) {
+            const action& a = actions[i];
+            if (!is_action_allowed(a)) {
+                statuses[i] = status::PERMISSION_ERROR;
+                continue;
+            }
+
+            bool contains;
+            agent_state* agent_ptr = agents.get(agent_ids[i], contains);
+            if (!contains) {
+                statuses[i] = status::INVALID_AGENT_ID;
+                continue;
+            }
+            agent_state& agent = *agent_ptr;
+            agent.lock.lock();
+            if (agent.agent_acted) {
+                agent.lock.unlock();
+                statuses[i] = status::AGENT_ALREADY_ACTED;
+                continue;
+            }
+            agent.agent_acted = true;
+            set_requested_action(agent, a);
+
+            /* add the agent's move to the list of requested moves */
+            request_position(agent);
+
+            if (agent.agent_active)
+                acted_count++;
             agent.lock.unlock();
-            simulator_lock.lock();
-            if (++acted_agent_count == active_agent_count)
-                step(); /* advance the simulation by one time step */
+            statuses[i] = status::OK;
+        }
+
+        if (acted_count > 0) {
+            acted_agent_count += acted_count;
+            if (acted_agent_count == active_agent_count)
+                request_step(); /* advance the simulation by one time step */
+        }
+        simulator_lock.unlock();
+    }
+
+    /**
+     * Appends the given actions to the action queue of the agent with the
+     * given ID. The simulator performs the queued actions on behalf of the
+     * agent, one per turn, beginning with the current turn if the agent has
+     * not yet acted in it. While the agent has queued actions, any action it
+     * submits through `move`, `turn`, `do_nothing`, or `act_batch` fails with
+     * `status::AGENT_ALREADY_ACTED`.
+     *
+     * \param   agent_id            ID of the agent.
+     * \param   actions             The actions to append to the queue.
+     * \param   count               The length of `actions`.
+     * \param   notify_when_drained If `true`, `agent_state::action_queue_drained`
+     *                              is set during the turn in which the last
+     *                              queued action is performed, so that the
+     *                              `on_step` callback can report it.
+     */
+    inline status enqueue_actions(uint64_t agent_id,
+            const action* actions, unsigned int count,
+            bool notify_when_drained)
+    {
+        for (unsigned int i = 0; i < count; i++)
+            if (!is_action_allowed(actions[i])) return status::PERMISSION_ERROR;
+
+        bool contains;
+        simulator_lock.lock();
+        agent_state& agent = *agents.get(agent_id, contains);
+        if (!contains) {
             simulator_lock.unlock();
-        } else {
+            return status::INVALID_AGENT_ID;
+        }
+        agent.lock.lock();
+        if (!agent.enqueue_actions(actions, count)) {
+            agent.lock.unlock();
+            simulator_lock.unlock();
+            return status::OUT_OF_MEMORY;
+        }
+        if (count > 0)
+            agent.notify_when_queue_drained = notify_when_drained;
+
+        if (agent.agent_acted || !agent.has_queued_actions()) {
             agent.lock.unlock();
+            simulator_lock.unlock();
+            return status::OK;
         }
+        perform_queued_action(agent);
+
+        bool agent_active = agent.agent_active;
+        agent.lock.unlock();
+        if (agent_active && ++acted_agent_count == active_agent_count)
+            request_step(); /* advance the simulation by one time step */
+        simulator_lock.unlock();
         return status::OK;
     }
 
+    /**
+     * Advances the simulation by `n` time steps without waiting for agents
+     * to act. Agents that have not acted in a time step act according to
+     * `policy`. Observations are only computed, and `on_step` is only
+     * invoked, for the last of these time steps, which makes this suitable
+     * for burn-in and for evaluating scripted agents. Semaphores are ignored.
+     *
+     * \param   n       The number of time steps to advance.
+     * \param   policy  How agents that have not acted behave.
+     */
+    inline void advance(unsigned int n, advance_policy policy)
+    {
+        if (n == 0) return;
+        simulator_lock.lock();
+        for (unsigned int i = 0; i < n; i++) {
+            if (policy == advance_policy::QUEUED_ACTIONS) {
+                for (agent_state* agent_ptr : dense_agents) {
+                    agent_state& agent = *agent_ptr;
+                    agent.lock.lock();
+                    if (!agent.agent_acted && agent.has_queued_actions())
+                        perform_queued_action(agent);
+                    agent.lock.unlock();
+                }
+            }
+
+            if (i + 1 < n) {
+                /* skip perception and the step callback */
+                apply_requested_moves();
+                for (agent_state* agent : dense_agents)
+                    agent->lock.unlock();
+                requested_moves.clear();
+                requested_move_count = 0;
+                requested_move_lock.unlock();
+                for (auto entry : semaphores)
+                    entry.value = false;
+            } else {
+                /* keep stepping while queued actions complete the next time step */
+                while (step()) { }
+            }
+        }
+        simulator_lock.unlock();
+    }
+
     /**
      * Retrieves an array of pointers to agent_state structures, storing them
      * in `states`, which is parallel to the specified `agent_ids` array, and
      * has length `agent_count`. For any invalid agent ID, the corresponding
-     * agent_state is set to nullptr.
+     * agent_state is set to nullptr. The states are copies from a snapshot
+     * (see `acquire_snapshot`), and so this function does not take any locks.
      *
-     * NOTE: This function will lock each non-null agent in `states`. The
-     *       caller must unlock them afterwards.
+     * NOTE: The states remain valid until the returned snapshot is passed to
+     *       `release_snapshot`, which the caller must do afterwards.
      *
      * \param      states The output array of agent_state pointers.
      * \param   agent_ids The array of agent IDs whose states to retrieve.
      * \param agent_count The length of `states` and `agent_ids`.
      */
-    inline void get_agent_states(agent_state** states,
-            uint64_t* agent_ids, unsigned int agent_count)
+    inline const observation_snapshot& get_agent_states(const agent_state** states,
+            const uint64_t* agent_ids, unsigned int agent_count)
     {
-        std::unique_lock<std::mutex> lock(simulator_lock);
-        for (unsigned int i = 0; i < agent_count; i++) {
-            bool contains;
-            states[i] = agents.get(agent_ids[i], contains);
-            if (contains) states[i]->lock.lock();
-            else states[i] = nullptr;
-        }
+        const observation_snapshot& snapshot = acquire_snapshot();
+        for (unsigned int i = 0; i < agent_count; i++)
+            states[i] = snapshot.get(agent_ids[i]);
+        return snapshot;
+    }
+
+    /**
+     * Returns a snapshot of the agent states as of the end of the most recent
+     * time step, or the most recent change to the set of agents. The
+     * simulator publishes these itself, and so this function does not take
+     * any locks or wait for the simulation. The returned snapshot does not
+     * change until it is passed to `release_snapshot`. A reader that holds on
+     * to a snapshot only costs the simulator a spare copy of the agent
+     * states.
+     */
+    inline const observation_snapshot& acquire_snapshot() {
+        return snapshots.acquire();
+    }
+
+    /* Releases a snapshot returned by `acquire_snapshot` or `get_agent_states`. */
+    inline void release_snapshot(const observation_snapshot& snapshot) {
+        snapshots.release(snapshot);
     }
 
     /**
@@ -1849,6 +3205,147 @@ public:
         return status::OK;
     }
 
+    /**
+     * Writes a grid of the items and agents around each of the given agents
+     * into `grids`, which must have room for
+     * `agent_count * (2*radius + 1) * (2*radius + 1) * 2` elements. Unlike
+     * the vision of the agents, the grids may be larger than the vision range,
+     * and nothing is occluded. The grid of the agent with ID `agent_ids[i]`
+     * starts at `grids + i * (2*radius + 1) * (2*radius + 1) * 2`, and the cell
+     * at offset `(x, y)` from the agent (where `-radius <= x, y <= radius`)
+     * contains two values at `((x + radius) * (2*radius + 1) + y + radius) * 2`:
+     * the type of the uncollected item in the cell, or -1 if there is none,
+     * followed by the number of agents in the cell. Cells in patches that
+     * have not been generated are empty.
+     *
+     * If `egocentric` is `true`, the grids are rotated so that each agent
+     * faces up, as in its vision. Otherwise, they are aligned with the world.
+     *
+     * The grids of different agents are filled in parallel if
+     * `step_thread_count` is greater than 1. The simulator lock is held
+     * throughout, so that all grids reflect the same time step.
+     */
+    status get_local_maps(const uint64_t* agent_ids, unsigned int agent_count,
+            unsigned int radius, bool egocentric, int32_t* grids)
+    {
+        array<const agent_state*> states(max(1u, agent_count));
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        for (unsigned int i = 0; i < agent_count; i++) {
+            bool contains;
+            agent_state* agent = agents.get(agent_ids[i], contains);
+            if (!contains) return status::INVALID_AGENT_ID;
+            states[states.length++] = agent;
+        }
+
+        const size_t grid_size = (size_t) (2*radius + 1) * (2*radius + 1) * 2;
+        auto fill = [&](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++)
+                fill_local_map(*states[i], radius, egocentric, grids + i * grid_size);
+        };
+        if (step_pool == nullptr) fill(0, agent_count);
+        else step_pool->parallel_for(agent_count, 16, fill);
+        return status::OK;
+    }
+
+    /**
+     * The distance (in each coordinate) beyond which two agents cannot
+     * observe or collide with each other within a single time step.
+     */
+    inline unsigned int interaction_radius() const {
+        return config.vision_range + 2 * config.max_steps_per_movement;
+    }
+
+    /**
+     * Partitions the agents in this simulation into clusters that do not
+     * interact within a time step. Two agents are in the same cluster if
+     * there is a chain of agents between them in which each consecutive pair
+     * is within `interaction_radius` of each other in both coordinates.
+     * Agents in different clusters may only influence each other through the
+     * scent of the items they collect.
+     *
+     * \param        agent_ids The array that will be populated with agent IDs,
+     *                         grouped by cluster.
+     * \param   cluster_starts The array that will be populated with the index
+     *                         into `agent_ids` of the first agent of each
+     *                         cluster, followed by the total number of agents,
+     *                         so that cluster `i` is the range
+     *                         [`cluster_starts[i]`, `cluster_starts[i + 1]`).
+     */
+    status get_interaction_clusters(array<uint64_t>& agent_ids, array<unsigned int>& cluster_starts)
+    {
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        unsigned int agent_count = (unsigned int) dense_agents.length();
+        if (!agent_ids.ensure_capacity(agent_ids.length + agent_count)
+         || !cluster_starts.ensure_capacity(cluster_starts.length + agent_count + 1))
+            return status::OUT_OF_MEMORY;
+
+        /* bucket the agents into cells as wide as the interaction radius, so
+           that interacting agents are in the same or adjacent cells */
+        unsigned int cell_width = interaction_radius() + 1;
+        array<unsigned int> parent(max(1u, agent_count));
+        array<unsigned int> next_in_cell(max(1u, agent_count));
+        hash_map<position, unsigned int> cells(agent_count * RESIZE_THRESHOLD_INVERSE + 1);
+        for (unsigned int i = 0; i < agent_count; i++) {
+            parent[i] = i;
+            position cell = cell_position(dense_agents.positions[i], cell_width);
+            bool contains; unsigned int bucket;
+            unsigned int& head = cells.get(cell, contains, bucket);
+            if (!contains) {
+                cells.table.keys[bucket] = cell;
+                cells.values[bucket] = i;
+                cells.table.size++;
+                next_in_cell[i] = agent_count;
+            } else {
+                next_in_cell[i] = head;
+                head = i;
+            }
+        }
+        parent.length = agent_count;
+
+        /* join the agents within the interaction radius of each other */
+        const int64_t radius = (int64_t) interaction_radius();
+        for (unsigned int i = 0; i < agent_count; i++) {
+            const position& location = dense_agents.positions[i];
+            position cell = cell_position(location, cell_width);
+            for (int64_t dx = -1; dx <= 1; dx++) {
+                for (int64_t dy = -1; dy <= 1; dy++) {
+                    bool contains;
+                    unsigned int j = cells.get(position(cell.x + dx, cell.y + dy), contains);
+                    if (!contains) continue;
+                    for (; j < agent_count; j = next_in_cell[j]) {
+                        if (j <= i) continue;
+                        const position& other = dense_agents.positions[j];
+                        if (other.x - location.x <= radius && location.x - other.x <= radius
+                         && other.y - location.y <= radius && location.y - other.y <= radius)
+                            join_clusters(parent, i, j);
+                    }
+                }
+            }
+        }
+
+        /* count the agents in each cluster, indexing clusters by their roots */
+        array<unsigned int>& cluster_sizes = next_in_cell;
+        for (unsigned int i = 0; i < agent_count; i++)
+            cluster_sizes[i] = 0;
+        for (unsigned int i = 0; i < agent_count; i++)
+            cluster_sizes[find_cluster(parent, i)]++;
+
+        unsigned int offset = (unsigned int) agent_ids.length;
+        for (unsigned int i = 0; i < agent_count; i++) {
+            if (cluster_sizes[i] == 0) continue;
+            cluster_starts[cluster_starts.length++] = offset;
+            unsigned int size = cluster_sizes[i];
+            cluster_sizes[i] = offset;
+            offset += size;
+        }
+        cluster_starts[cluster_starts.length++] = offset;
+
+        for (unsigned int i = 0; i < agent_count; i++)
+            agent_ids[cluster_sizes[find_cluster(parent, i)]++] = dense_agents.ids[i];
+        agent_ids.length += agent_count;
+        return status::OK;
+    }
+
     /**
      * Retrieves an array of all semaphore IDs in the simulation as well as
      * whether or not they've been signaled during this turn.
@@ -1871,6 +3368,11 @@ public:
      * by `bottom_left_corner` and `top_right_corner`. The patches are stored
      * in the map `patches`.
      *
+     * The simulator lock is only held while the items and agents of the
+     * patches are copied (see `copy_map_region`), so the returned map is a
+     * consistent view as of the last completed time step, and the scent and
+     * vision are computed without blocking agents or the step.
+     *
      * \param bottom_left_corner The bottom-left corner of the bounding box in
      *      which to retrieve the map patches.
      * \param top_right_corner The top-right corner of the bounding box in
@@ -1879,316 +3381,1465 @@ public:
      *      will contain the state of the retrieved patches. Each inner array
      *      represents a row of patches that all share the same `y` value in
      *      their patch positions;
+     * \param min_modified_time If positive, only the patches whose items or
+     *      agents changed at or after this time are retrieved (see
+     *      `get_map_since`).
      */
     template<bool GetScentMap, bool GetVisionMap>
     status get_map(
             position bottom_left_corner,
             position top_right_corner,
-            array<array<patch_state>>& patches)
+            array<array<patch_state>>& patches,
+            uint64_t min_modified_time = 0)
     {
         position bottom_left_patch_position, top_right_patch_position;
         world.world_to_patch_coordinates(bottom_left_corner, bottom_left_patch_position);
         world.world_to_patch_coordinates(top_right_corner, top_right_patch_position);
 
-        simulator_lock.lock();
+        /* the returned patches, and the patches in their neighborhoods that contribute to their scent */
+        const position min_patch = bottom_left_patch_position - position(1, 1);
+        const position max_patch = top_right_patch_position;
+        array<map_patch_copy> copies(32);
+        uint64_t map_time;
+        /* the scent of a patch depends on its neighbors, which must be copied even if they didn't change */
+        status result = copy_map_region(min_patch - position(1, 1), max_patch + position(1, 1),
+                copies, map_time, GetScentMap ? 0 : min_modified_time);
+        if (result != status::OK) {
+            free_map_copies(copies);
+            return result;
+        }
 
-        status result = status::OK;
-        apply_contiguous(world.patches, bottom_left_patch_position.y - 1,
-            (unsigned int) (top_right_patch_position.y - bottom_left_patch_position.y + 2),
-            [&](const array_map<int64_t, patch_type>& row, int64_t y)
-        {
-            if (!patches.ensure_capacity(patches.length + 1)) {
-                result = status::OUT_OF_MEMORY;
-                return false;
-            }
-            array<patch_state>& current_row = patches[patches.length];
-            if (!array_init(current_row, 16)) {
-                result = status::OUT_OF_MEMORY;
-                return false;
-            }
-            patches.length++;
+        array<patch_state>* current_row = nullptr;
+        for (const map_patch_copy& patch : copies) {
+            const position& patch_position = patch.patch_position;
+            if (patch_position.x < min_patch.x || patch_position.x > max_patch.x
+             || patch_position.y < min_patch.y || patch_position.y > max_patch.y
+             || patch.last_modified < min_modified_time)
+                continue;
 
-            apply_contiguous(row, bottom_left_patch_position.x - 1,
-                (unsigned int) (top_right_patch_position.x - bottom_left_patch_position.x + 2),
-                [&](const patch_type& patch, int64_t x)
-            {
-                if (!current_row.ensure_capacity(current_row.length + 1)) {
+            if (current_row == nullptr || current_row->data[0].patch_position.y != patch_position.y) {
+                if (!patches.ensure_capacity(patches.length + 1)) {
                     result = status::OUT_OF_MEMORY;
-                    return false;
+                    break;
                 }
-                patch_state& state = current_row[current_row.length];
-                if (!init<GetScentMap, GetVisionMap>(state, config.patch_size,
-                    config.scent_dimension, config.color_dimension,
-                    (unsigned int) patch.items.length,
-                    (unsigned int) patch.data.agents.length))
-                {
+                current_row = &patches[patches.length];
+                if (!array_init(*current_row, 16)) {
                     result = status::OUT_OF_MEMORY;
-                    return false;
+                    break;
                 }
-                current_row.length++;
-
-                state.patch_position = position(x, y);
-                state.item_count = 0;
-                state.fixed = patch.fixed;
-                for (unsigned int i = 0; i < patch.items.length; i++) {
-                    if (patch.items[i].deletion_time == 0) {
-                        state.items[state.item_count] = patch.items[i];
-                        state.item_count++;
-                    }
+                patches.length++;
+            }
+
+            if (!current_row->ensure_capacity(current_row->length + 1)) {
+                result = status::OUT_OF_MEMORY;
+                break;
+            }
+            patch_state& state = (*current_row)[current_row->length];
+            if (!init<GetScentMap, GetVisionMap>(state, config.patch_size,
+                config.scent_dimension, config.color_dimension,
+                (unsigned int) patch.items.length,
+                (unsigned int) patch.agent_positions.length))
+            {
+                result = status::OUT_OF_MEMORY;
+                break;
+            }
+            current_row->length++;
+
+            state.patch_position = patch_position;
+            state.item_count = 0;
+            state.fixed = patch.fixed;
+            for (const item& item : patch.items) {
+                if (item.deletion_time == 0) {
+                    state.items[state.item_count] = item;
+                    state.item_count++;
+                }
+            }
+
+            for (unsigned int i = 0; i < patch.agent_positions.length; i++) {
+                state.agent_positions[i] = patch.agent_positions[i];
+                state.agent_directions[i] = patch.agent_directions[i];
+            }
+
+            /* consider all patches in the neighborhood of 'patch' */
+            position patch_world_position = patch_position * config.patch_size;
+            if (GetScentMap) {
+                compute_patch_scent(patch_position, map_time, state.scent,
+                    [&](const position& neighbor_position) { return find_map_copy(copies, neighbor_position); });
+            }
+
+            if (GetVisionMap) {
+                for (const item& item : patch.items) {
+                    if (item.deletion_time != 0) continue;
+                    position relative_position = item.location - patch_world_position;
+                    float* pixel = state.vision + ((relative_position.x*config.patch_size + relative_position.y)*config.color_dimension);
+                    for (unsigned int i = 0; i < config.color_dimension; i++)
+                        pixel[i] += config.item_types[item.item_type].color[i];
+                }
+
+                for (const position& agent_position : patch.agent_positions) {
+                    position relative_position = agent_position - patch_world_position;
+                    float* pixel = state.vision + ((relative_position.x*config.patch_size + relative_position.y)*config.color_dimension);
+                    for (unsigned int i = 0; i < config.color_dimension; i++)
+                        pixel[i] += config.agent_color[i];
+                }
+            }
+        }
+
+        if (current_row != nullptr && current_row->length == 0) {
+            core::free(*current_row);
+            patches.length--;
+        }
+        free_map_copies(copies);
+        return result;
+    }
+
+    /**
+     * Retrieves the patches within the bounding box defined by
+     * `bottom_left_corner` and `top_right_corner` whose items or agents
+     * changed after `since_time`, in the same form as `get_map`. Patches that
+     * were created or resampled, in which an item was collected, or which an
+     * agent entered, left, moved, or turned in, are considered changed.
+     *
+     * Changes made between time steps, such as adding or removing agents,
+     * belong to the next time step, so they are returned when `since_time` is
+     * the current time, even if the client retrieved the map at that time
+     * before the change was made.
+     *
+     * Each returned patch contains all of its current items and agents, so a
+     * client that keeps a copy of the map replaces its copies of the returned
+     * patches; item creations and deletions are the differences between the
+     * two. Note that the scent of a patch changes at every time step, even if
+     * the patch does not, so the scent of patches that are not returned
+     * becomes stale.
+     *
+     * \param since_time Typically, the simulation time at which the client
+     *      last retrieved this region.
+     */
+    template<bool GetScentMap, bool GetVisionMap>
+    inline status get_map_since(
+            position bottom_left_corner,
+            position top_right_corner,
+            uint64_t since_time,
+            array<array<patch_state>>& patches)
+    {
+        return get_map<GetScentMap, GetVisionMap>(
+            bottom_left_corner, top_right_corner, patches, since_time + 1);
+    }
+
+    /**
+     * Retrieves summaries of the patches within the bounding box defined by
+     * `bottom_left_corner` and `top_right_corner`, where the patches are
+     * grouped into square blocks of `block_size` by `block_size` patches (a
+     * `block_size` of 0 is treated as 1). Each block contains the number of
+     * items of each type and the number of agents in its patches, as well as
+     * the average color of its cells, so the blocks form a downsampled color
+     * raster of the region. Blocks that contain no existing patches are
+     * omitted.
+     *
+     * The item counts of each patch are cached in its `patch_data`, and are
+     * only counted again once the patch changes, so the cost of this function
+     * scales with the number of patches, rather than with the number of items.
+     *
+     * \param blocks The output array of arrays of patch_summary structures.
+     *      Each inner array represents a row of blocks that all share the same
+     *      `y` value in their block positions.
+     */
+    status get_map_summary(
+            position bottom_left_corner,
+            position top_right_corner,
+            unsigned int block_size,
+            array<array<patch_summary>>& blocks)
+    {
+        if (block_size == 0) block_size = 1;
+        position bottom_left_patch_position, top_right_patch_position;
+        world.world_to_patch_coordinates(bottom_left_corner, bottom_left_patch_position);
+        world.world_to_patch_coordinates(top_right_corner, top_right_patch_position);
+
+        const unsigned int item_type_count = (unsigned int) config.item_types.length;
+        const int64_t min_block_x = cell_position(bottom_left_patch_position, block_size).x;
+        const int64_t max_block_x = cell_position(top_right_patch_position, block_size).x;
+        const unsigned int row_width = (unsigned int) (max_block_x - min_block_x + 1);
+
+        /* each row of blocks is filled in densely, and the empty blocks are removed once it is complete */
+        status result = status::OK;
+        array<patch_summary>* current_row = nullptr;
+        int64_t current_block_y = 0;
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        apply_contiguous(world.patches, bottom_left_patch_position.y,
+            (unsigned int) (top_right_patch_position.y - bottom_left_patch_position.y + 1),
+            [&](const array_map<int64_t, patch_type>& row, int64_t y)
+        {
+            int64_t block_y = cell_position(position(0, y), block_size).y;
+            if (current_row == nullptr || current_block_y != block_y) {
+                if (current_row != nullptr)
+                    remove_empty_blocks(blocks);
+                if (!blocks.ensure_capacity(blocks.length + 1)
+                 || !array_init(blocks[blocks.length], row_width))
+                {
+                    result = status::OUT_OF_MEMORY;
+                    return false;
+                }
+                current_row = &blocks[blocks.length++];
+                current_block_y = block_y;
+                for (unsigned int i = 0; i < row_width; i++) {
+                    if (!init((*current_row)[i], position(min_block_x + i, block_y), item_type_count, config.color_dimension)) {
+                        result = status::OUT_OF_MEMORY;
+                        return false;
+                    }
+                    current_row->length++;
+                }
+            }
+
+            return apply_contiguous(row, bottom_left_patch_position.x,
+                (unsigned int) (top_right_patch_position.x - bottom_left_patch_position.x + 1),
+                [&](patch_type& patch, int64_t x)
+            {
+                if (!count_items(patch)) {
+                    result = status::OUT_OF_MEMORY;
+                    return false;
                 }
+                patch_summary& block = (*current_row)[(unsigned int) (cell_position(position(x, y), block_size).x - min_block_x)];
+                block.patch_count++;
+                for (unsigned int i = 0; i < item_type_count; i++)
+                    block.item_counts[i] += patch.data.item_counts[i];
+                block.agent_count += (unsigned int) patch.data.agents.length;
+                return true;
+            });
+        });
+        lock.unlock();
+
+        if (current_row != nullptr)
+            remove_empty_blocks(blocks);
+        if (result != status::OK)
+            return result;
+
+        /* the counts determine the colors, so these are computed without the lock */
+        const float cells_per_patch = (float) (config.patch_size * config.patch_size);
+        for (array<patch_summary>& row : blocks) {
+            for (patch_summary& block : row) {
+                for (unsigned int i = 0; i < item_type_count; i++) {
+                    if (block.item_counts[i] == 0) continue;
+                    for (unsigned int j = 0; j < config.color_dimension; j++)
+                        block.color[j] += block.item_counts[i] * config.item_types[i].color[j];
+                }
+                for (unsigned int j = 0; j < config.color_dimension; j++) {
+                    block.color[j] += block.agent_count * config.agent_color[j];
+                    block.color[j] /= block.patch_count * cells_per_patch;
+                }
+            }
+        }
+        return status::OK;
+    }
+
+    /**
+     * Returns a SimulatorData reference associated with this simulator.
+     */
+    inline SimulatorData& get_data() {
+        return data;
+    }
+
+    /**
+     * Returns a SimulatorData reference associated with this simulator.
+     */
+    inline const SimulatorData& get_data() const {
+        return data;
+    }
+
+    /**
+     * Returns the simulator configuration used to construct this simulator.
+     */
+    inline const simulator_config& get_config() const {
+        return config;
+    }
+
+    /**
+     * Returns the number of agents that were given
+     * `simulator_config::default_action` because they had not acted by the
+     * `simulator_config::step_deadline` of the most recent time step.
+     */
+    inline unsigned int get_defaulted_agent_count() const {
+        return defaulted_agent_count;
+    }
+
+    inline map<patch_data, item_properties>& get_world() {
+        return world;
+    }
+
+    inline const diffusion<double>& get_scent_model() const {
+        return scent_model;
+    }
+
+    static inline void free(simulator& s) {
+        s.free_helper();
+        core::free(s.agents);
+        core::free(s.semaphores);
+        core::free(s.requested_moves);
+        core::free(s.blocked_positions);
+        core::free(s.dense_agents);
+        core::free(s.perception_patch_positions);
+        core::free(s.config);
+        core::free(s.scent_model);
+        core::free(s.world);
+        core::free(s.data);
+        s.step_thread.~thread();
+        s.step_cv.~condition_variable();
+        s.snapshots.~snapshot_pool();
+        s.simulator_lock.~mutex();
+        s.requested_move_lock.~mutex();
+    }
+
+private:
+    /**
+     * Advances the simulation by one time step, either on this thread or, if
+     * `config.dedicated_step_thread` is `true`, on the step thread, in which
+     * case this function returns without waiting for the step to complete.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline void request_step() {
+        if (!step_thread.joinable()) {
+            /* keep stepping while queued actions complete the next time step */
+            while (step()) { }
+        } else {
+            step_requested = true;
+            step_cv.notify_one();
+        }
+    }
+
+    /* Starts the step thread, if the configuration calls for one. */
+    inline void start_step_thread() {
+        if (!config.dedicated_step_thread && config.step_deadline == 0)
+            return;
+        step_thread = std::thread(&simulator::run_step_thread, this);
+    }
+
+    /**
+     * Starts the thread that delivers queued step notifications to
+     * `on_step`, if the configuration calls for one.
+     */
+    inline void start_notification_thread() {
+        if (notifications == nullptr) return;
+        notification_thread = std::thread(&simulator::run_notification_thread, this);
+    }
+
+    inline void run_notification_thread() {
+        step_notification* notification;
+        while ((notification = notifications->begin_pop()) != nullptr) {
+            on_step((simulator<SimulatorData>*) this,
+                    (const hash_map<uint64_t, agent_state*>&) notification->agents, notification->time);
+            notifications->end_pop();
+        }
+    }
+
+    /**
+     * Stops the notification thread, after it finishes delivering the current
+     * notification, if any. The remaining queued notifications are discarded.
+     */
+    inline void stop_notification_thread() {
+        if (notifications == nullptr) return;
+        notifications->drop_all();
+        notifications->close();
+        if (notification_thread.joinable())
+            notification_thread.join();
+        delete notifications;
+        notifications = nullptr;
+    }
+
+    static inline notification_queue<step_notification>* make_notification_queue(const simulator_config& config) {
+        if (config.step_notification_capacity == 0) return nullptr;
+        return new notification_queue<step_notification>(config.step_notification_capacity);
+    }
+
+    /**
+     * Copies the state of every agent into the next slot of `notifications`,
+     * first making room in accordance with `config.step_notification_policy`.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline void push_notification() {
+        step_notification* notification;
+        switch (config.step_notification_policy) {
+        case notification_policy::DROP_OLDEST:
+            while ((notification = notifications->try_reserve()) == nullptr)
+                notifications->drop_oldest();
+            break;
+        case notification_policy::COALESCE:
+            notifications->drop_all();
+            notification = notifications->try_reserve();
+            break;
+        case notification_policy::BLOCK:
+        default:
+            notification = notifications->reserve();
+            break;
+        }
+        if (notification == nullptr) return;
+
+        size_t agent_count = dense_agents.length();
+        if (!notification->copies.ensure_capacity(agent_count)
+         || !notification->agents.check_size(agent_count))
+        {
+            fprintf(stderr, "simulator.push_notification ERROR: Out of memory.\n");
+            return;
+        }
+        while (notification->copies.length < agent_count) {
+            agent_state* copy = (agent_state*) malloc(sizeof(agent_state));
+            if (copy == nullptr || !init_copy(*copy, config)) {
+                if (copy != nullptr) core::free(copy);
+                fprintf(stderr, "simulator.push_notification ERROR: Out of memory.\n");
+                return;
+            }
+            notification->copies[notification->copies.length++] = copy;
+        }
+
+        notification->time = time;
+        notification->agents.clear();
+        for (unsigned int i = 0; i < agent_count; i++) {
+            agent_state* copy = notification->copies[i];
+            copy_observation(*dense_agents.states[i], *copy, config);
+            notification->agents.put(dense_agents.ids[i], copy);
+        }
+        notifications->commit();
+    }
+
+    inline void run_step_thread() {
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        std::chrono::milliseconds step_deadline(config.step_deadline);
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + step_deadline;
+        unsigned int defaulted_count = 0;
+        while (true) {
+            while (!step_requested && !step_thread_stopping) {
+                if (config.step_deadline == 0) {
+                    step_cv.wait(lock);
+                } else if (step_cv.wait_until(lock, deadline) == std::cv_status::timeout
+                        && !step_requested && !step_thread_stopping)
+                {
+                    if (active_agent_count == 0) {
+                        /* there is nothing to wait for, so there is no time step to complete */
+                        deadline = std::chrono::steady_clock::now() + step_deadline;
+                        continue;
+                    }
+                    /* the deadline expired, so complete the time step without the remaining agents */
+                    defaulted_count = apply_default_actions();
+                    step_requested = true;
+                }
+            }
+            if (!step_requested) return;
+
+            step_requested = false;
+            defaulted_agent_count = defaulted_count;
+            defaulted_count = 0;
+            if (step()) step_requested = true;
+            deadline = std::chrono::steady_clock::now() + step_deadline;
+        }
+    }
+
+    /**
+     * Gives `config.default_action` to every active agent that has not yet
+     * acted in the current time step, and signals every semaphore that has
+     * not yet been signaled. Returns the number of agents that were given the
+     * default action.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline unsigned int apply_default_actions() {
+        unsigned int defaulted_count = 0;
+        for (agent_state* agent_ptr : dense_agents) {
+            agent_state& agent = *agent_ptr;
+            agent.lock.lock();
+            if (agent.agent_active && !agent.agent_acted) {
+                agent.agent_acted = true;
+                set_requested_action(agent, config.default_action);
+                request_position(agent);
+                acted_agent_count++;
+                defaulted_count++;
+            }
+            agent.lock.unlock();
+        }
+        for (auto entry : semaphores) {
+            if (entry.value) continue;
+            entry.value = true;
+            acted_agent_count++;
+        }
+        return defaulted_count;
+    }
+
+    /* Stops the step thread, after completing any pending time step. */
+    inline void stop_step_thread() {
+        if (!step_thread.joinable()) return;
+        simulator_lock.lock();
+        step_thread_stopping = true;
+        step_cv.notify_one();
+        simulator_lock.unlock();
+        step_thread.join();
+    }
+
+    /**
+     * Advances the simulation by one time step, and then performs the next
+     * queued action of each agent that has any. Returns `true` if these
+     * actions complete the next time step, in which case the caller should
+     * step again.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline bool step()
+    {
+        apply_requested_moves();
+
+        /* compute new scent and vision for each agent */
+        update_agent_scent_and_vision();
+
+        /* changes made before the next time step are stamped with its time,
+           so that they are newer than the map at the current time */
+        world.modification_time = time + 1;
+
+        /* reset the requested moves */
+        requested_moves.clear();
+        requested_move_count = 0;
+        requested_move_lock.unlock();
+
+        /* reset all semaphores to their non-signaled state */
+        for (auto entry : semaphores)
+            entry.value = false;
+
+        publish_snapshot();
+
+        /* Invoke the step callback function for each agent. */
+        if (notifications == nullptr)
+            on_step((simulator<SimulatorData>*) this, (const hash_map<uint64_t, agent_state*>&) agents, time);
+        else push_notification();
+
+        return perform_queued_actions();
+    }
+
+    /**
+     * Resolves the requested moves in accordance with the collision policy,
+     * moves the agents whose requests were granted, and increments the
+     * simulation time. Of the agents that request the same position, an agent
+     * that stays there wins, and otherwise the first to request it (or, under
+     * the RANDOM policy, one drawn uniformly at random) wins. The agents that
+     * lose, and those blocked by items, stay at their current positions, and
+     * so no other agent may move into those positions either. Agents in a
+     * chain or a cycle all move. Under the RANDOM policy, one number is drawn
+     * per position requested by a moving agent, in order of position.
+     *
+     * Precondition: The mutex is locked. This function does not release the
+     *               mutex, and it returns with `requested_move_lock` and every
+     *               agent lock held.
+     */
+    inline void apply_requested_moves()
+    {
+        requested_move_lock.lock();
+        for (requested_move& request : requested_moves)
+            request.stays = (request.agent->current_position == request.target);
+
+        /* group the requests by target position; the first request in each group is the one that is granted */
+        if (requested_moves.length > 1)
+            sort(requested_moves);
+
+        blocked_positions.clear();
+        for (unsigned int start = 0, end; start < requested_moves.length; start = end) {
+            const position target = requested_moves[start].target;
+            end = start + 1;
+            while (end < requested_moves.length && requested_moves[end].target == target)
+                end++;
+
+            if (config.collision_policy == movement_conflict_policy::RANDOM && !requested_moves[start].stays) {
+                unsigned int result = sample_uniform(end - start);
+                requested_move::swap(requested_moves[start], requested_moves[start + result]);
+            }
+
+            /* agents that lost the conflict stay at their current positions */
+            for (unsigned int i = start + 1; i < end; i++)
+                blocked_positions.add(requested_moves[i].agent->current_position);
+
+            /* check for items that block movement */
+            patch_type* neighborhood[4]; position patch_positions[4];
+            unsigned int index = world.get_fixed_neighborhood(
+                target, neighborhood, patch_positions);
+            patch_type& current_patch = *neighborhood[index];
+            for (const item& item : current_patch.items) {
+                if (item.location == target && item.deletion_time == 0 && config.item_types[item.item_type].blocks_movement) {
+                    /* there is an item at our new position that blocks movement */
+                    blocked_positions.add(requested_moves[start].agent->current_position);
+                    requested_moves[start].agent = NULL; /* prevent any agent from moving here */
+                    break;
+                }
+            }
+        }
+
+        /* need to ensure agents don't move into positions where other agents failed to move */
+        while (blocked_positions.length > 0) {
+            position blocked = blocked_positions.pop();
+            unsigned int i = first_requested_move(blocked);
+            if (i == requested_moves.length || requested_moves[i].target != blocked || requested_moves[i].agent == NULL)
+                continue;
+            blocked_positions.add(requested_moves[i].agent->current_position);
+            requested_moves[i].agent = NULL; /* prevent any agent from moving here */
+        }
+
+        time++;
+        world.modification_time = time;
+        acted_agent_count = 0;
+        for (agent_state* agent : dense_agents) {
+            agent->lock.lock();
+            if (!agent->agent_acted) continue;
+
+            if (agent->current_direction != agent->requested_direction) {
+                agent->current_direction = agent->requested_direction;
+                position patch_position;
+                world.world_to_patch_coordinates(agent->current_position, patch_position);
+                world.get_existing_patch(patch_position).last_modified = time;
+            }
+            if (config.collision_policy == movement_conflict_policy::NO_COLLISIONS)
+                apply_requested_move(*agent);
+            agent->agent_acted = false;
+        }
+
+        /* move the agents whose requests were granted, in accordance with the collision policy */
+        for (unsigned int i = 0; i < requested_moves.length; i++) {
+            if (i > 0 && requested_moves[i].target == requested_moves[i - 1].target) continue;
+            if (requested_moves[i].agent != NULL)
+                apply_requested_move(*requested_moves[i].agent);
+        }
+
+#if !defined(NDEBUG)
+        /* check for collisions, if there aren't supposed to be any */
+        if (config.collision_policy != movement_conflict_policy::NO_COLLISIONS) {
+            for (unsigned int i = 0; i < dense_agents.length(); i++) {
+                for (unsigned int j = i + 1; j < dense_agents.length(); j++) {
+                    if (dense_agents.positions[i] == dense_agents.positions[j])
+                        fprintf(stderr, "simulator.step WARNING: Agents %" PRIu64 " and %" PRIu64 " are at the same position.\n",
+                                dense_agents.ids[i], dense_agents.ids[j]);
+                }
+            }
+        }
+#endif
+    }
+
+    /**
+     * Copies the current agent states into a snapshot that no reader is
+     * using, and then publishes it. If this runs out of memory, the previous
+     * snapshot remains published.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline void publish_snapshot() {
+        observation_snapshot* next = snapshots.next();
+        if (next == nullptr) {
+            fprintf(stderr, "simulator.publish_snapshot ERROR: Out of memory.\n");
+            return;
+        }
+        observation_snapshot& snapshot = *next;
+
+        size_t agent_count = dense_agents.length();
+        if (!snapshot.agents.ensure_capacity(agent_count)
+         || !snapshot.copies.ensure_capacity(agent_count))
+        {
+            fprintf(stderr, "simulator.publish_snapshot ERROR: Out of memory.\n");
+            return;
+        }
+        while (snapshot.copies.length < agent_count) {
+            agent_state* copy = (agent_state*) malloc(sizeof(agent_state));
+            if (copy == nullptr || !init_copy(*copy, config)) {
+                if (copy != nullptr) core::free(copy);
+                fprintf(stderr, "simulator.publish_snapshot ERROR: Out of memory.\n");
+                return;
+            }
+            snapshot.copies[snapshot.copies.length++] = copy;
+        }
+
+        snapshot.agents.clear();
+        for (unsigned int i = 0; i < agent_count; i++) {
+            agent_state* copy = snapshot.copies[i];
+            copy_observation(*dense_agents.states[i], *copy, config);
+            snapshot.agents[snapshot.agents.length++] = {dense_agents.ids[i], copy};
+        }
+        if (snapshot.agents.length > 1)
+            sort(snapshot.agents);
+        snapshot.time = time;
+        snapshots.published.store(next);
+    }
+
+    /**
+     * Performs the next queued action of every agent that has any, and clears
+     * `agent_state::action_queue_drained`, which has been reported by the
+     * preceding call to `on_step`. Returns `true` if at least one active
+     * agent acted and the current time step is now complete.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    inline bool perform_queued_actions() {
+        unsigned int acted_count = 0;
+        for (agent_state* agent_ptr : dense_agents) {
+            agent_state& agent = *agent_ptr;
+            agent.lock.lock();
+            agent.action_queue_drained = false;
+            if (agent.has_queued_actions()) {
+                perform_queued_action(agent);
+                if (agent.agent_active) acted_count++;
+            }
+            agent.lock.unlock();
+        }
+        if (acted_count == 0) return false;
+        acted_agent_count += acted_count;
+        return acted_agent_count == active_agent_count;
+    }
+
+    /**
+     * Performs the action at the front of the agent's queue.
+     *
+     * Precondition: The agent's lock is held, the agent has not yet acted,
+     *               and `agent.has_queued_actions()` is `true`.
+     */
+    inline void perform_queued_action(agent_state& agent) {
+        agent.agent_acted = true;
+        set_requested_action(agent, agent.dequeue_action());
+
+        /* add the agent's move to the list of requested moves */
+        request_position(agent);
+    }
+
+    /* Precondition: This thread has all agent locks, which it will release. */
+    inline void update_agent_scent_and_vision() {
+        perceive(dense_agents.states.data, dense_agents.length());
+        for (agent_state* agent : dense_agents)
+            agent->lock.unlock();
+    }
+
+    /**
+     * Computes the scent and vision of the given `count` agents, dividing the
+     * work among the threads in `step_pool`, if there is one.
+     */
+    inline void perceive(agent_state* const* perceiving, size_t count) {
+        (this->*perceive_kernel)(perceiving, count);
+    }
+
+    /**
+     * Returns the most specialized instantiation of `perceive_with` that
+     * supports the observation dimensions in `config`. Any configuration
+     * without a specialized kernel uses `generic_observation_kernel`.
+     */
+    static inline perceive_function select_perceive_kernel(const simulator_config& config) {
+        if (observation_kernel<3, 3, 5>::supports(config))
+            return &simulator::perceive_with<observation_kernel<3, 3, 5>>;
+        else if (observation_kernel<3, 3, 10>::supports(config))
+            return &simulator::perceive_with<observation_kernel<3, 3, 10>>;
+        else if (observation_kernel<3, 3, 0>::supports(config))
+            return &simulator::perceive_with<observation_kernel<3, 3, 0>>;
+        return &simulator::perceive_with<generic_observation_kernel>;
+    }
+
+    template<typename Kernel>
+    void perceive_with(agent_state* const* perceiving, size_t count) {
+        if (step_pool == nullptr
+         || !perception_patch_positions.ensure_capacity(4 * count))
+        {
+            for (size_t i = 0; i < count; i++) {
+                patch_type* neighborhood[4]; position patch_positions[4];
+                world.get_fixed_neighborhood(
+                    perceiving[i]->current_position, neighborhood, patch_positions);
+                perceiving[i]->update_state<Kernel>(neighborhood, scent_model, config, time);
+            }
+            return;
+        }
+
+        /* fixing a neighborhood may generate new patches, and `update_state`
+           deletes expired items from the patches it visits, so both are done
+           here in the same order as the single-threaded loop above */
+        for (size_t i = 0; i < count; i++) {
+            patch_type* neighborhood[4];
+            position* patch_positions = perception_patch_positions.data + 4 * i;
+            world.get_fixed_neighborhood(
+                perceiving[i]->current_position, neighborhood, patch_positions);
+            for (unsigned int j = 0; j < 4; j++)
+                remove_expired_items(*neighborhood[j]);
+        }
+
+        /* the remaining work only reads the world, so it is divided among the workers */
+        auto update = [&](size_t start, size_t end) {
+            for (size_t i = start; i < end; i++) {
+                const position* patch_positions = perception_patch_positions.data + 4 * i;
+                patch_type* neighborhood[4];
+                for (unsigned int j = 0; j < 4; j++)
+                    neighborhood[j] = &world.get_existing_patch(patch_positions[j]);
+                perceiving[i]->update_state<Kernel>(neighborhood, scent_model, config, time);
+            }
+        };
+        step_pool->parallel_for(count, 16, update);
+    }
+
+    /**
+     * Stores in `free_cells` every cell in the region of `placement`, which
+     * has the given `width` and `height`, that is neither in `occupied` nor
+     * occupied by an existing agent.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    status list_free_cells(const agent_placement& placement,
+            uint64_t width, uint64_t height,
+            const hash_set<position>& occupied, array<position>& free_cells)
+    {
+        if (width * height > std::numeric_limits<unsigned int>::max()) {
+            fprintf(stderr, "simulator.list_free_cells ERROR: The placement region is too large to list its free cells.\n");
+            return status::AGENT_ALREADY_EXISTS;
+        }
+
+        hash_set<position> taken(max(16u, (unsigned int) dense_agents.length() * RESIZE_THRESHOLD_INVERSE));
+        for (unsigned int i = 0; i < dense_agents.length(); i++) {
+            const position& pos = dense_agents.states[i]->current_position;
+            if (pos.x >= placement.bottom_left.x && pos.x <= placement.top_right.x
+             && pos.y >= placement.bottom_left.y && pos.y <= placement.top_right.y
+             && !taken.add(pos))
+            {
+                fprintf(stderr, "simulator.list_free_cells ERROR: Out of memory.\n");
+                return status::OUT_OF_MEMORY;
+            }
+        }
+
+        if (!free_cells.ensure_capacity((size_t) (width * height))) {
+            fprintf(stderr, "simulator.list_free_cells ERROR: Out of memory.\n");
+            return status::OUT_OF_MEMORY;
+        }
+        free_cells.clear();
+        for (int64_t y = placement.bottom_left.y; y <= placement.top_right.y; y++) {
+            for (int64_t x = placement.bottom_left.x; x <= placement.top_right.x; x++) {
+                position pos(x, y);
+                if (!occupied.contains(pos) && !taken.contains(pos))
+                    free_cells[free_cells.length++] = pos;
+            }
+        }
+        return status::OK;
+    }
+
+    /**
+     * Computes the positions of `count` new agents according to `placement`,
+     * storing them in `positions`, and fixes the neighborhood of each
+     * position. Unless agents are allowed to collide, the positions are
+     * distinct and not occupied by any existing agent.
+     *
+     * Precondition: The mutex is locked. This function does not release the mutex.
+     */
+    status place_agents(unsigned int count,
+            const agent_placement& placement, array<position>& positions)
+    {
+        const bool check_collisions = (config.collision_policy != movement_conflict_policy::NO_COLLISIONS);
+        uint64_t width = 0, height = 0;
+        if (placement.policy != placement_policy::EXPLICIT) {
+            if (placement.bottom_left.x <= placement.top_right.x && placement.bottom_left.y <= placement.top_right.y) {
+                width = (uint64_t) (placement.top_right.x - placement.bottom_left.x) + 1;
+                height = (uint64_t) (placement.top_right.y - placement.bottom_left.y) + 1;
+            }
+            if (width * height == 0 || (check_collisions && width * height < count)) {
+                fprintf(stderr, "simulator.place_agents ERROR: The placement region does not have room for %u agents.\n", count);
+                return status::AGENT_ALREADY_EXISTS;
+            }
+        }
+
+        auto fix_neighborhood = [&](const position& pos, patch_type** neighborhood) {
+            world.mcmc_iterations *= 10; /* TODO: should this be configurable? */
+            position patch_positions[4];
+            unsigned int index = world.get_fixed_neighborhood(pos, neighborhood, patch_positions);
+            world.mcmc_iterations /= 10;
+            return index;
+        };
+
+        /* once random draws fail to find a free cell, the remaining agents
+           are drawn from a list of the free cells in the region, without
+           replacement, as in a partial Fisher-Yates shuffle */
+        array<position> free_cells(1);
+        bool free_cells_listed = false;
+        auto draw_free_cell = [&](position& pos) {
+            if (free_cells.length == 0) return false;
+            unsigned int index = sample_uniform((unsigned int) free_cells.length);
+            pos = free_cells[index];
+            free_cells[index] = free_cells[--free_cells.length];
+            patch_type* neighborhood[4];
+            fix_neighborhood(pos, neighborhood);
+            return true;
+        };
+
+        hash_set<position> occupied(max(16u, count * RESIZE_THRESHOLD_INVERSE));
+        for (unsigned int i = 0; i < count; i++) {
+            position& pos = positions[i];
+            unsigned int attempts = (placement.policy == placement_policy::RANDOM) ? 64 : 1;
+            bool found = false;
+            if (free_cells_listed) attempts = 0;
+            for (unsigned int attempt = 0; attempt < attempts && !found; attempt++) {
+                switch (placement.policy) {
+                case placement_policy::EXPLICIT:
+                    pos = placement.positions[i]; break;
+                case placement_policy::RANDOM:
+                    pos.x = placement.bottom_left.x + (int64_t) sample_uniform((unsigned int) min(width, (uint64_t) std::numeric_limits<unsigned int>::max()));
+                    pos.y = placement.bottom_left.y + (int64_t) sample_uniform((unsigned int) min(height, (uint64_t) std::numeric_limits<unsigned int>::max()));
+                    break;
+                case placement_policy::SPREAD:
+                    pos = spread_position(i, count, placement.bottom_left, width, height); break;
+                }
+
+                patch_type* neighborhood[4];
+                unsigned int index = fix_neighborhood(pos, neighborhood);
+
+                found = true;
+                if (!check_collisions) break;
+                if (occupied.contains(pos)) {
+                    found = false; continue;
+                }
+                for (const agent_state* neighbor : neighborhood[index]->data.agents) {
+                    if (neighbor->current_position == pos) {
+                        found = false; break;
+                    }
+                }
+            }
+
+            if (!found && placement.policy == placement_policy::RANDOM && check_collisions) {
+                if (!free_cells_listed) {
+                    status result = list_free_cells(placement, width, height, occupied, free_cells);
+                    if (result != status::OK) return result;
+                    free_cells_listed = true;
+                }
+                found = draw_free_cell(pos);
+                if (!found) {
+                    fprintf(stderr, "simulator.place_agents ERROR: The placement region does not have room for %u agents.\n", count);
+                    return status::AGENT_ALREADY_EXISTS;
+                }
+            }
+
+            if (!found) {
+                FILE* out = stderr;
+                core::print("simulator.place_agents ERROR: An agent already occupies position ", out);
+                print(pos, out); core::print(".\n", out);
+                return status::AGENT_ALREADY_EXISTS;
+            } else if (check_collisions && !occupied.add(pos)) {
+                fprintf(stderr, "simulator.place_agents ERROR: Out of memory.\n");
+                return status::OUT_OF_MEMORY;
+            }
+        }
+        positions.length = count;
+        return status::OK;
+    }
+
+    /**
+     * A copy of the contents of a patch, made by `copy_map_region` so that
+     * `get_map` can compute the scent and vision of the patch without
+     * holding the simulator lock.
+     */
+    struct map_patch_copy {
+        position patch_position;
+        bool fixed;
+        uint64_t last_modified;
+        array<item> items;
+        array<position> agent_positions;
+        array<direction> agent_directions;
+
+        static inline void free(map_patch_copy& patch) {
+            core::free(patch.items);
+            core::free(patch.agent_positions);
+            core::free(patch.agent_directions);
+        }
+    };
+
+    /**
+     * Copies the existing patches whose positions are within the given
+     * bounds (inclusive), and that were last modified at or after
+     * `min_modified_time`, into `copies`, in row-major order, and stores the
+     * current time in `copy_time`. The simulator lock is held only for the
+     * duration of this function, and since the lock is also held for the
+     * whole of `step`, the copies are consistent with each other.
+     */
+    status copy_map_region(const position& min_patch, const position& max_patch,
+            array<map_patch_copy>& copies, uint64_t& copy_time, uint64_t min_modified_time = 0)
+    {
+        std::unique_lock<std::mutex> lock(simulator_lock);
+        copy_time = time;
+
+        status result = status::OK;
+        apply_contiguous(world.patches, min_patch.y,
+            (unsigned int) (max_patch.y - min_patch.y + 1),
+            [&](const array_map<int64_t, patch_type>& row, int64_t y)
+        {
+            return apply_contiguous(row, min_patch.x,
+                (unsigned int) (max_patch.x - min_patch.x + 1),
+                [&](const patch_type& patch, int64_t x)
+            {
+                if (patch.last_modified < min_modified_time)
+                    return true;
+                if (!copies.ensure_capacity(copies.length + 1)) {
+                    result = status::OUT_OF_MEMORY;
+                    return false;
+                }
+                map_patch_copy& copy = copies[copies.length];
+                size_t agent_count = patch.data.agents.length;
+                if (!array_init(copy.items, max((size_t) 1, patch.items.length))) {
+                    result = status::OUT_OF_MEMORY;
+                    return false;
+                } else if (!array_init(copy.agent_positions, max((size_t) 1, agent_count))) {
+                    core::free(copy.items);
+                    result = status::OUT_OF_MEMORY;
+                    return false;
+                } else if (!array_init(copy.agent_directions, max((size_t) 1, agent_count))) {
+                    core::free(copy.items); core::free(copy.agent_positions);
+                    result = status::OUT_OF_MEMORY;
+                    return false;
+                }
+                copies.length++;
+
+                copy.patch_position = position(x, y);
+                copy.fixed = patch.fixed;
+                copy.last_modified = patch.last_modified;
+                for (const item& item : patch.items)
+                    copy.items[copy.items.length++] = item;
+                for (const agent_state* agent : patch.data.agents) {
+                    copy.agent_positions[copy.agent_positions.length++] = agent->current_position;
+                    copy.agent_directions[copy.agent_directions.length++] = agent->current_direction;
+                }
+                return true;
+            });
+        });
+        return result;
+    }
+
+    /**
+     * Returns the copy of the patch at `patch_position` in `copies`, which is
+     * in row-major order, or `nullptr` if there is no such copy.
+     */
+    static inline const map_patch_copy* find_map_copy(
+            const array<map_patch_copy>& copies, const position& patch_position)
+    {
+        size_t start = 0, end = copies.length;
+        while (start < end) {
+            size_t mid = start + (end - start) / 2;
+            const position& current = copies[mid].patch_position;
+            if (current.y < patch_position.y || (current.y == patch_position.y && current.x < patch_position.x))
+                start = mid + 1;
+            else end = mid;
+        }
+        if (start == copies.length || copies[start].patch_position != patch_position)
+            return nullptr;
+        return &copies[start];
+    }
+
+    static inline void free_map_copies(array<map_patch_copy>& copies) {
+        for (map_patch_copy& copy : copies)
+            core::free(copy);
+        copies.clear();
+    }
+
+    /**
+     * Fills the grid of the given agent for `get_local_maps`. This only reads
+     * the world, so it may be called for different agents concurrently.
+     *
+     * Precondition: The simulator lock is held.
+     */
+    inline void fill_local_map(const agent_state& agent,
+            unsigned int radius, bool egocentric, int32_t* grid)
+    {
+        const unsigned int width = 2*radius + 1;
+        for (unsigned int i = 0; i < width * width; i++) {
+            grid[2*i] = -1;
+            grid[2*i + 1] = 0;
+        }
+
+        const direction facing = egocentric ? agent.current_direction : direction::UP;
+        auto get_cell = [&](const position& location) -> int32_t* {
+            position relative_position = location - agent.current_position;
+            if (relative_position.x < -(int64_t) radius || relative_position.x > (int64_t) radius
+             || relative_position.y < -(int64_t) radius || relative_position.y > (int64_t) radius)
+                return nullptr;
+            /* rotate in the same way as `agent_state::add_color` */
+            switch (facing) {
+            case direction::UP: break;
+            case direction::DOWN:
+                relative_position.x *= -1;
+                relative_position.y *= -1;
+                break;
+            case direction::LEFT:
+                core::swap(relative_position.x, relative_position.y);
+                relative_position.y *= -1; break;
+            case direction::RIGHT:
+                core::swap(relative_position.x, relative_position.y);
+                relative_position.x *= -1; break;
+            case direction::COUNT: break;
+            }
+            unsigned int x = (unsigned int) (relative_position.x + radius);
+            unsigned int y = (unsigned int) (relative_position.y + radius);
+            return grid + (x*width + y) * 2;
+        };
+
+        position min_patch, max_patch;
+        world.world_to_patch_coordinates(agent.current_position - position((int64_t) radius, (int64_t) radius), min_patch);
+        world.world_to_patch_coordinates(agent.current_position + position((int64_t) radius, (int64_t) radius), max_patch);
+        apply_contiguous(world.patches, min_patch.y, (unsigned int) (max_patch.y - min_patch.y + 1),
+            [&](const array_map<int64_t, patch_type>& row, int64_t y)
+        {
+            return apply_contiguous(row, min_patch.x, (unsigned int) (max_patch.x - min_patch.x + 1),
+                [&](const patch_type& patch, int64_t x)
+            {
+                for (const item& item : patch.items) {
+                    if (item.deletion_time != 0) continue;
+                    int32_t* cell = get_cell(item.location);
+                    if (cell != nullptr) cell[0] = (int32_t) item.item_type;
+                }
+                for (const agent_state* other : patch.data.agents) {
+                    int32_t* cell = get_cell(other->current_position);
+                    if (cell != nullptr) cell[1]++;
+                }
+                return true;
+            });
+        });
+    }
+
+    /**
+     * Counts the uncollected items of each type in `patch` into
+     * `patch.data.item_counts`, unless they were counted after the patch last
+     * changed. A patch may change more than once in a time step, so counts
+     * made in the same time step as the last change are never reused.
+     *
+     * Precondition: The simulator lock is held.
+     */
+    inline bool count_items(patch_type& patch) {
+        patch_data& data = patch.data;
+        if (data.item_counts != nullptr && patch.last_modified < data.item_counts_time)
+            return true;
+
+        if (data.item_counts == nullptr) {
+            data.item_counts = (unsigned int*) malloc(max((size_t) 1, sizeof(unsigned int) * config.item_types.length));
+            if (data.item_counts == nullptr) {
+                fprintf(stderr, "simulator.count_items ERROR: Insufficient memory for patch_data.item_counts.\n");
+                return false;
+            }
+        }
+        for (unsigned int i = 0; i < config.item_types.length; i++)
+            data.item_counts[i] = 0;
+        for (const item& item : patch.items)
+            if (item.deletion_time == 0) data.item_counts[item.item_type]++;
+        data.item_counts_time = time;
+        return true;
+    }
 
-                for (unsigned int i = 0; i < patch.data.agents.length; i++) {
-                    state.agent_positions[i] = patch.data.agents[i]->current_position;
-                    state.agent_directions[i] = patch.data.agents[i]->current_direction;
-                }
+    /**
+     * Removes the blocks that contain no patches from the last row in
+     * `blocks`, and removes the row itself if it is then empty.
+     */
+    static inline void remove_empty_blocks(array<array<patch_summary>>& blocks) {
+        array<patch_summary>& row = blocks.last();
+        unsigned int kept = 0;
+        for (unsigned int i = 0; i < row.length; i++) {
+            if (row[i].patch_count == 0) {
+                core::free(row[i]);
+            } else {
+                if (kept != i) core::move(row[i], row[kept]);
+                kept++;
+            }
+        }
+        row.length = kept;
+        if (kept == 0) {
+            core::free(row);
+            blocks.length--;
+        }
+    }
 
-                /* consider all patches in the neighborhood of 'patch' */
-                position patch_world_position = position(x, y) * config.patch_size;
-                if (GetScentMap) {
-                    for (unsigned int a = 0; a < config.patch_size; a++) {
-                        for (unsigned int b = 0; b < config.patch_size; b++) {
-                            position current_position = patch_world_position + position(a, b);
-                            patch_type* neighborhood[4]; position patch_positions[4];
-                            unsigned int patch_count = world.get_neighborhood(current_position, neighborhood, patch_positions);
-                            for (unsigned int i = 0; i < patch_count; i++) {
-                                /* iterate over neighboring items, and add their contributions to scent and vision */
-                                for (unsigned int j = 0; j < neighborhood[i]->items.length; j++) {
-                                    const item& item = neighborhood[i]->items[j];
-
-                                    /* check if the item is too old; if so, ignore it */
-                                    if (item.deletion_time > 0 && time >= item.deletion_time + config.deleted_item_lifetime)
-                                        continue;
-
-                                    compute_scent_contribution(scent_model, item, current_position, time,
-                                            config, state.scent + ((a*config.patch_size + b)*config.scent_dimension));
+    /**
+     * Adds the scent at every cell of the patch at `patch_position` to
+     * `scent`, which is laid out as in
+     * `patch_state::scent`. Every cell in the same quadrant of the patch has
+     * the same neighborhood of four patches, so the neighborhood is retrieved
+     * once per quadrant, and each item contributes to the cells within the
+     * scent radius of it. The contributions to each cell are added in the
+     * same order as `compute_scent_contribution` would for each cell, so the
+     * result is identical.
+     *
+     * `get_patch(patch_position)` returns a pointer to a structure with the
+     * `items` of the patch at the given position, or `nullptr` if there is no
+     * such patch, and `current_time` is the time at which the scent is
+     * computed.
+     */
+    template<typename GetPatch>
+    void compute_patch_scent(const position& patch_position,
+            uint64_t current_time, float* scent, GetPatch get_patch) const
+    {
+        const position patch_world_position = patch_position * config.patch_size;
+        const unsigned int n = config.patch_size;
+        const unsigned int half = n / 2;
+        const unsigned int quadrant_starts[] = {0, half, n};
+        const int64_t radius = (int64_t) scent_model.radius;
+        for (unsigned int qa = 0; qa < 2; qa++) {
+            for (unsigned int qb = 0; qb < 2; qb++) {
+                const int64_t a_start = quadrant_starts[qa], a_end = quadrant_starts[qa + 1];
+                const int64_t b_start = quadrant_starts[qb], b_end = quadrant_starts[qb + 1];
+                if (a_start == a_end || b_start == b_end) continue;
+
+                /* visit the neighborhood in the same order as `map::get_neighborhood` */
+                const int64_t min_x = patch_position.x - (qa == 0 ? 1 : 0);
+                const int64_t min_y = patch_position.y - (qb == 0 ? 1 : 0);
+                for (unsigned int i = 0; i < 4; i++) {
+                    const auto* neighbor = get_patch(position(min_x + (i % 2), min_y + (i / 2)));
+                    if (neighbor == nullptr) continue;
+                    for (const item& item : neighbor->items) {
+                        /* check if the item is too old; if so, ignore it */
+                        if (item.deletion_time > 0 && current_time >= item.deletion_time + config.deleted_item_lifetime)
+                            continue;
+
+                        /* find the cells of this quadrant within the scent radius of the item */
+                        position offset = item.location - patch_world_position;
+                        int64_t a_min = max(a_start, offset.x - radius + 1);
+                        int64_t a_max = min(a_end, offset.x + radius);
+                        int64_t b_min = max(b_start, offset.y - radius + 1);
+                        int64_t b_max = min(b_end, offset.y + radius);
+                        if (a_min >= a_max || b_min >= b_max) continue;
+
+                        unsigned int creation_t = config.deleted_item_lifetime - 1;
+                        if (item.creation_time > 0)
+                            creation_t = min(creation_t, (unsigned int) (current_time - item.creation_time));
+                        unsigned int deletion_t = (item.deletion_time > 0) ? (unsigned int) (current_time - item.deletion_time) : 0;
+                        const float* item_scent = config.item_types[item.item_type].scent;
+
+                        for (int64_t a = a_min; a < a_max; a++) {
+                            int dx = (int) (offset.x - a);
+                            for (int64_t b = b_min; b < b_max; b++) {
+                                int dy = (int) (offset.y - b);
+                                float* dst = scent + ((a*n + b)*config.scent_dimension);
+                                add_scent(dst, item_scent, config.scent_dimension,
+                                        (float) scent_model.get_value(creation_t, dx, dy));
+                                if (item.deletion_time > 0) {
+                                    add_scent(dst, item_scent, config.scent_dimension,
+                                            (float) -scent_model.get_value(deletion_t, dx, dy));
                                 }
                             }
                         }
                     }
                 }
+            }
+        }
+    }
 
-                if (GetVisionMap) {
-                    for (const item& item : patch.items) {
-                        if (item.deletion_time != 0) continue;
-                        position relative_position = item.location - patch_world_position;
-                        float* pixel = state.vision + ((relative_position.x*config.patch_size + relative_position.y)*config.color_dimension);
-                        for (unsigned int i = 0; i < config.color_dimension; i++)
-                            pixel[i] += config.item_types[item.item_type].color[i];
-                    }
-
-                    for (const agent_state* agent : patch.data.agents) {
-                        position relative_position = agent->current_position - patch_world_position;
-                        float* pixel = state.vision + ((relative_position.x*config.patch_size + relative_position.y)*config.color_dimension);
-                        for (unsigned int i = 0; i < config.color_dimension; i++)
-                            pixel[i] += config.agent_color[i];
-                    }
-                }
-
-                return true;
-            });
+    /* Returns the cell of width `cell_width` that contains `location`. */
+    static inline position cell_position(const position& location, unsigned int cell_width) {
+        int64_t x = location.x / (int64_t) cell_width;
+        int64_t y = location.y / (int64_t) cell_width;
+        if (location.x % (int64_t) cell_width < 0) x--;
+        if (location.y % (int64_t) cell_width < 0) y--;
+        return position(x, y);
+    }
 
-            if (current_row.length == 0) {
-                core::free(current_row);
-                patches.length--;
-            }
-            return true;
-        });
+    /* Returns the root of the cluster containing `i`, compressing the path to it. */
+    static inline unsigned int find_cluster(array<unsigned int>& parent, unsigned int i) {
+        while (parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    }
 
-        simulator_lock.unlock();
-        return result;
+    static inline void join_clusters(array<unsigned int>& parent, unsigned int i, unsigned int j) {
+        unsigned int root_i = find_cluster(parent, i);
+        unsigned int root_j = find_cluster(parent, j);
+        if (root_i < root_j) parent[root_j] = root_i;
+        else if (root_j < root_i) parent[root_i] = root_j;
     }
 
     /**
-     * Returns a SimulatorData reference associated with this simulator.
+     * Returns the position of the `i`-th of `count` agents placed on an evenly
+     * spaced grid over the `width` by `height` region with the given
+     * `bottom_left` corner. The grid has roughly the same aspect ratio as the
+     * region, and each agent is at the center of its grid cell.
      */
-    inline SimulatorData& get_data() {
-        return data;
+    static inline position spread_position(unsigned int i, unsigned int count,
+            position bottom_left, uint64_t width, uint64_t height)
+    {
+        uint64_t columns = (uint64_t) ceil(sqrt((double) count * width / height));
+        columns = max((uint64_t) 1, min(columns, (uint64_t) count));
+        uint64_t rows = (count + columns - 1) / columns;
+        uint64_t row = i / columns, column = i % columns;
+        return position(
+            bottom_left.x + (int64_t) (((2 * column + 1) * width) / (2 * columns)),
+            bottom_left.y + (int64_t) (((2 * row + 1) * height) / (2 * rows)));
     }
 
-    /**
-     * Returns a SimulatorData reference associated with this simulator.
-     */
-    inline const SimulatorData& get_data() const {
-        return data;
+    /* Removes the given agent from the agent list of the patch that contains it. */
+    inline void remove_from_patch(agent_state& agent) {
+        position patch_position;
+        world.world_to_patch_coordinates(agent.current_position, patch_position);
+        world.get_existing_patch(patch_position).data.remove_agent(agent);
     }
 
     /**
-     * Returns the simulator configuration used to construct this simulator.
+     * Deletes the items in the given patch that were removed long enough ago
+     * that they no longer contribute to the scent, in the same order as
+     * `agent_state::update_state`.
      */
-    inline const simulator_config& get_config() const {
-        return config;
-    }
-
-    inline map<patch_data, item_properties>& get_world() {
-        return world;
+    inline void remove_expired_items(patch_type& p) {
+        for (unsigned int j = 0; j < p.items.length; j++) {
+            const item& item = p.items[j];
+            if (item.deletion_time > 0 && time >= item.deletion_time + config.deleted_item_lifetime) {
+                p.items.remove(j); j--;
+            }
+        }
     }
 
-    static inline void free(simulator& s) {
-        s.free_helper();
-        core::free(s.agents);
-        core::free(s.semaphores);
-        core::free(s.requested_moves);
-        core::free(s.config);
-        core::free(s.scent_model);
-        core::free(s.world);
-        core::free(s.data);
-        s.simulator_lock.~mutex();
-        s.requested_move_lock.~mutex();
+    static inline thread_pool* make_step_pool(const simulator_config& config) {
+        if (config.step_thread_count <= 1) return nullptr;
+        return new thread_pool(config.step_thread_count);
     }
 
-private:
-    /* Precondition: The mutex is locked. This function does not release the mutex. */
-    inline void step()
+    /**
+     * Moves the given agent to its requested position, collecting any items
+     * there, and updates the agent lists of the affected patches.
+     *
+     * Precondition: The agent's lock is held.
+     */
+    inline void apply_requested_move(agent_state& agent)
     {
-        requested_move_lock.lock();
-        if (config.collision_policy == movement_conflict_policy::RANDOM) {
-            for (auto entry : requested_moves) {
-                array<agent_state*>& conflicts = entry.value;
-                if (conflicts[0]->current_position == entry.key) continue; /* give preference to agents that don't move */
-                unsigned int result = sample_uniform((unsigned int)conflicts.length);
-                core::swap(conflicts[0], conflicts[result]);
-            }
-        }
+        position old_patch_position;
+        world.world_to_patch_coordinates(agent.current_position, old_patch_position);
+        bool moved = (agent.current_position != agent.requested_position);
+        dense_agents.set_position(agent, agent.requested_position);
+
+        /* delete any items that are automatically picked up at this cell */
+        patch_type* neighborhood[4]; position patch_positions[4];
+        unsigned int index = world.get_fixed_neighborhood(
+            agent.current_position, neighborhood, patch_positions);
+        patch_type& current_patch = *neighborhood[index];
+        if (moved) current_patch.last_modified = time;
+        for (item& item : current_patch.items) {
+            if (item.location == agent.current_position && item.deletion_time == 0) {
+                /* there is an item at our new position */
+                bool collect = true;
+                for (unsigned int i = 0; i < config.item_types.length; i++) {
+                    if (agent.collected_items[i] < config.item_types[item.item_type].required_item_counts[i]) {
+                        collect = false; break;
+                    }
+                }
 
-        /* check for items that block movement */
-        array<position> occupied_positions(16);
-        for (auto entry : requested_moves) {
-            patch_type* neighborhood[4]; position patch_positions[4];
-            unsigned int index = world.get_fixed_neighborhood(
-                entry.key, neighborhood, patch_positions);
-            patch_type& current_patch = *neighborhood[index];
-            for (item& item : current_patch.items) {
-                if (item.location == entry.key && item.deletion_time == 0 && config.item_types[item.item_type].blocks_movement) {
-                    /* there is an item at our new position that blocks movement */
-                    array<agent_state*>& conflicts = entry.value;
-                    occupied_positions.add(conflicts[0]->current_position);
-                    conflicts[0] = NULL; /* prevent any agent from moving here */
+                if (collect) {
+                    /* collect this item */
+                    item.deletion_time = time;
+                    current_patch.last_modified = time;
+                    agent.collected_items[item.item_type]++;
+
+                    for (unsigned int i = 0; i < config.item_types.length; i++) {
+                        if (agent.collected_items[i] < config.item_types[item.item_type].required_item_costs[i])
+                            agent.collected_items[i] = 0;
+                        else agent.collected_items[i] -= config.item_types[item.item_type].required_item_costs[i];
+                    }
                 }
             }
         }
 
-        /* need to ensure agents don't move into positions where other agents failed to move */
-        if (config.collision_policy != movement_conflict_policy::NO_COLLISIONS) {
-            array<position> occupied_positions(16);
-            for (auto entry : requested_moves) {
-                array<agent_state*>& conflicts = entry.value;
-                for (unsigned int i = 1; i < conflicts.length; i++)
-                    occupied_positions.add(conflicts[i]->current_position);
-            }
+        if (old_patch_position != patch_positions[index]) {
+            patch_type& prev_patch = world.get_existing_patch(old_patch_position);
+            prev_patch.data.patch_lock.lock();
+            prev_patch.data.remove_agent(agent);
+            prev_patch.last_modified = time;
+            prev_patch.data.patch_lock.unlock();
+            current_patch.data.patch_lock.lock();
+            if (!current_patch.data.add_agent(agent))
+                fprintf(stderr, "simulator.apply_requested_move ERROR: Insufficient memory for patch_data.agents.\n");
+            current_patch.data.patch_lock.unlock();
         }
+    }
 
-        bool contains;
-        while (occupied_positions.length > 0) {
-            array<agent_state*>& conflicts = requested_moves.get(occupied_positions.pop(), contains);
-            if (!contains || conflicts[0] == NULL) {
-                continue;
-            }
-            else if (contains) {
-                for (unsigned int i = 0; i < conflicts.length; i++)
-                    occupied_positions.add(conflicts[i]->current_position);
-                conflicts[0] = NULL; /* prevent any agent from moving here */
-            }
+    /**
+     * Returns the index of the first request for `target` in the sorted
+     * `requested_moves` array, or the index at which such a request would be
+     * inserted, if there is none.
+     */
+    inline unsigned int first_requested_move(const position& target) const {
+        unsigned int min = 0, max = (unsigned int) requested_moves.length;
+        while (min < max) {
+            unsigned int mid = min + (max - min) / 2;
+            if (requested_moves[mid].target < target) min = mid + 1;
+            else max = mid;
         }
+        return min;
+    }
 
-        time++;
-        acted_agent_count = 0;
-        for (auto entry : agents) {
-            agent_state* agent = entry.value;
-            agent->lock.lock();
-            if (!agent->agent_acted) continue;
-
-            agent->current_direction = agent->requested_direction;
-
-            /* check if this agent moved, in accordance with the collision policy */
-            position old_patch_position;
-            world.world_to_patch_coordinates(agent->current_position, old_patch_position);
-            if (config.collision_policy == movement_conflict_policy::NO_COLLISIONS
-                || (agent == requested_moves.get(agent->requested_position)[0]))
-            {
-                agent->current_position = agent->requested_position;
+    inline bool is_move_allowed(direction dir, unsigned int num_steps) const {
+        return num_steps <= config.max_steps_per_movement
+            && config.allowed_movement_directions[(size_t) dir] != action_policy::DISALLOWED;
+    }
 
-                /* delete any items that are automatically picked up at this cell */
-                patch_type* neighborhood[4]; position patch_positions[4];
-                unsigned int index = world.get_fixed_neighborhood(
-                    agent->current_position, neighborhood, patch_positions);
-                patch_type& current_patch = *neighborhood[index];
-                for (item& item : current_patch.items) {
-                    if (item.location == agent->current_position && item.deletion_time == 0) {
-                        /* there is an item at our new position */
-                        bool collect = true;
-                        for (unsigned int i = 0; i < config.item_types.length; i++) {
-                            if (agent->collected_items[i] < config.item_types[item.item_type].required_item_counts[i]) {
-                                collect = false; break;
-                            }
-                        }
+    inline bool is_turn_allowed(direction dir) const {
+        return config.allowed_rotations[(size_t) dir] != action_policy::DISALLOWED;
+    }
 
-                        if (collect) {
-                            /* collect this item */
-                            item.deletion_time = time;
-                            agent->collected_items[item.item_type]++;
+    inline bool is_action_allowed(const action& a) const {
+        return jbw::is_action_allowed(a, config);
+    }
 
-                            for (unsigned int i = 0; i < config.item_types.length; i++) {
-                                if (agent->collected_items[i] < config.item_types[item.item_type].required_item_costs[i])
-                                    agent->collected_items[i] = 0;
-                                else agent->collected_items[i] -= config.item_types[item.item_type].required_item_costs[i];
-                            }
-                        }
-                    }
-                }
+    /* Precondition: The agent's lock is held. */
+    inline void set_requested_move(agent_state& agent, direction dir, unsigned int num_steps)
+    {
+        agent.requested_position = agent.current_position;
+        agent.requested_direction = agent.current_direction;
+        if (config.allowed_movement_directions[(size_t) dir] == action_policy::IGNORED)
+            return;
 
-                if (old_patch_position != patch_positions[index]) {
-                    patch_type& prev_patch = world.get_existing_patch(old_patch_position);
-                    prev_patch.data.patch_lock.lock();
-                    prev_patch.data.agents.remove(prev_patch.data.agents.index_of(agent));
-                    prev_patch.data.patch_lock.unlock();
-                    current_patch.data.patch_lock.lock();
-                    current_patch.data.agents.add(agent);
-                    current_patch.data.patch_lock.unlock();
-                }
-            }
-            agent->agent_acted = false;
+        position diff(0, 0);
+        switch (dir) {
+        case direction::UP   : diff.x = 0; diff.y = num_steps; break;
+        case direction::DOWN : diff.x = 0; diff.y = -((int64_t) num_steps); break;
+        case direction::LEFT : diff.x = -((int64_t) num_steps); diff.y = 0; break;
+        case direction::RIGHT: diff.x = num_steps; diff.y = 0; break;
+        case direction::COUNT: break;
         }
 
-#if !defined(NDEBUG)
-        /* check for collisions, if there aren't supposed to be any */
-        if (config.collision_policy != movement_conflict_policy::NO_COLLISIONS) {
-            for (unsigned int i = 0; i < agents.table.capacity; i++) {
-                if (is_empty(agents.table.keys[i])) continue;
-                for (unsigned int j = i + 1; j < agents.table.capacity; j++) {
-                    if (is_empty(agents.table.keys[j])) continue;
-                    if (agents.values[i]->current_position == agents.values[j]->current_position)
-                        fprintf(stderr, "simulator.step WARNING: Agents %u and %u are at the same position.\n", i, j);
-                }
-            }
+        switch (agent.current_direction) {
+        case direction::UP: break;
+        case direction::DOWN: diff.x *= -1; diff.y *= -1; break;
+        case direction::LEFT:
+            core::swap(diff.x, diff.y);
+            diff.x *= -1; break;
+        case direction::RIGHT:
+            core::swap(diff.x, diff.y);
+            diff.y *= -1; break;
+        case direction::COUNT: break;
         }
-#endif
-
-        /* compute new scent and vision for each agent */
-        update_agent_scent_and_vision();
-
-        /* reset the requested moves */
-        for (auto entry : requested_moves)
-            core::free(entry.value);
-        requested_moves.clear();
-        requested_move_lock.unlock();
 
-        /* reset all semaphores to their non-signaled state */
-        for (auto entry : semaphores)
-            entry.value = false;
+        agent.requested_position += diff;
+    }
 
-        /* Invoke the step callback function for each agent. */
-        on_step((simulator<SimulatorData>*) this, (const hash_map<uint64_t, agent_state*>&) agents, time);
+    /* Precondition: The agent's lock is held. */
+    inline void set_requested_action(agent_state& agent, const action& a)
+    {
+        switch (a.type) {
+        case action_type::MOVE: set_requested_move(agent, a.dir, a.num_steps); return;
+        case action_type::TURN: set_requested_turn(agent, a.dir); return;
+        case action_type::NO_OP:
+        case action_type::COUNT: break;
+        }
+        agent.requested_position = agent.current_position;
+        agent.requested_direction = agent.current_direction;
     }
 
-    /* Precondition: This thread has all agent locks, which it will release. */
-    inline void update_agent_scent_and_vision() {
-        for (auto entry : agents) {
-            agent_state* agent = entry.value;
-            patch_type* neighborhood[4]; position patch_positions[4];
-            world.get_fixed_neighborhood(
-                agent->current_position, neighborhood, patch_positions);
-            agent->update_state(neighborhood, scent_model, config, time);
-            agent->lock.unlock();
+    /* Precondition: The agent's lock is held. */
+    inline void set_requested_turn(agent_state& agent, direction dir)
+    {
+        agent.requested_position = agent.current_position;
+        agent.requested_direction = agent.current_direction;
+        if (config.allowed_rotations[(size_t) dir] == action_policy::IGNORED)
+            return;
+
+        switch (dir) {
+        case direction::UP: break;
+        case direction::DOWN:
+            if (agent.current_direction == direction::UP) agent.requested_direction = direction::DOWN;
+            else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::UP;
+            else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::RIGHT;
+            else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::LEFT;
+            break;
+        case direction::LEFT:
+            if (agent.current_direction == direction::UP) agent.requested_direction = direction::LEFT;
+            else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::RIGHT;
+            else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::DOWN;
+            else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::UP;
+            break;
+        case direction::RIGHT:
+            if (agent.current_direction == direction::UP) agent.requested_direction = direction::RIGHT;
+            else if (agent.current_direction == direction::DOWN) agent.requested_direction = direction::LEFT;
+            else if (agent.current_direction == direction::LEFT) agent.requested_direction = direction::UP;
+            else if (agent.current_direction == direction::RIGHT) agent.requested_direction = direction::DOWN;
+            break;
+        case direction::COUNT: break;
         }
     }
 
@@ -2198,18 +4849,15 @@ private:
         if (config.collision_policy == movement_conflict_policy::NO_COLLISIONS)
             return;
 
-        bool contains; unsigned int bucket;
         std::unique_lock<std::mutex> lock(requested_move_lock);
-        requested_moves.check_size(alloc_position_keys);
-        array<agent_state*>& agents = requested_moves.get(agent.requested_position, contains, bucket);
-        if (!contains) {
-            array_init(agents, 8);
-            requested_moves.table.keys[bucket] = agent.requested_position;
-            requested_moves.table.size++;
+        if (!requested_moves.ensure_capacity(requested_moves.length + 1)) {
+            fprintf(stderr, "simulator.request_position ERROR: Failed to expand requested_moves array.\n");
+            return;
         }
-        agents.add(&agent);
-        if (agent.current_position == agent.requested_position)
-            core::swap(agents[0], agents.last());
+        requested_move& request = requested_moves[requested_moves.length++];
+        request.target = agent.requested_position;
+        request.agent = &agent;
+        request.order = requested_move_count++;
     }
 
     inline void unrequest_position(agent_state& agent)
@@ -2217,18 +4865,23 @@ private:
         if (!agent.agent_acted || config.collision_policy == movement_conflict_policy::NO_COLLISIONS)
             return;
 
-        bool contains; unsigned int bucket;
         std::unique_lock<std::mutex> lock(requested_move_lock);
-        array<agent_state*>& agents = requested_moves.get(agent.requested_position, contains, bucket);
-        if (!contains) return;
-        unsigned int index = agents.index_of(&agent);
-        if (index != agents.length)
-            agents.remove(index);
+        for (unsigned int i = 0; i < requested_moves.length; i++) {
+            if (requested_moves[i].agent != &agent) continue;
+
+            /* the arrival order is kept in `order`, so the last request can fill the gap */
+            requested_moves.length--;
+            if (i < requested_moves.length)
+                requested_move::move(requested_moves[requested_moves.length], requested_moves[i]);
+            return;
+        }
     }
 
     inline void free_helper() {
-        for (auto entry : requested_moves)
-            core::free(entry.value);
+        stop_step_thread();
+        stop_notification_thread();
+        if (step_pool != nullptr)
+            delete step_pool;
         for (auto entry : agents) {
             core::free(*entry.value);
             core::free(entry.value);
@@ -2256,34 +4909,67 @@ status init(simulator<SimulatorData>& sim,
     sim.acted_agent_count = 0;
     sim.active_agent_count = 0;
     sim.id_counter = 1;
-    if (!init(sim.data, data)) {
+    sim.requested_move_count = 0;
+    if (!is_default_action_valid(config)) {
+        return status::PERMISSION_ERROR;
+    } else if (!init(sim.data, data)) {
         return status::OUT_OF_MEMORY;
     } else if (!hash_map_init(sim.agents, 32)) {
         free(sim.data); return status::OUT_OF_MEMORY;
     } else if (!hash_map_init(sim.semaphores, 8)) {
         free(sim.data); free(sim.agents); return status::OUT_OF_MEMORY;
-    } else if (!hash_map_init(sim.requested_moves, 32, alloc_position_keys)) {
+    } else if (!array_init(sim.requested_moves, 64)) {
         free(sim.data); free(sim.agents);
         free(sim.semaphores); return status::OUT_OF_MEMORY;
-    } else if (!init(sim.config, config)) {
+    } else if (!array_init(sim.blocked_positions, 16)) {
         free(sim.data); free(sim.agents); free(sim.semaphores);
         free(sim.requested_moves); return status::OUT_OF_MEMORY;
+    } else if (!init(sim.config, config)) {
+        free(sim.data); free(sim.agents); free(sim.semaphores);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        return status::OUT_OF_MEMORY;
     } else if (!init(sim.scent_model, (double) sim.config.diffusion_param,
             (double) sim.config.decay_param, sim.config.patch_size, sim.config.deleted_item_lifetime)) {
         free(sim.data); free(sim.config);
         free(sim.agents); free(sim.semaphores);
-        free(sim.requested_moves); return status::OUT_OF_MEMORY;
+        free(sim.requested_moves); free(sim.blocked_positions);
+        return status::OUT_OF_MEMORY;
     } else if (!init(sim.world, sim.config.patch_size,
             sim.config.mcmc_iterations,
             sim.config.item_types.data,
             (unsigned int) sim.config.item_types.length, seed)) {
         free(sim.config); free(sim.data);
         free(sim.agents); free(sim.semaphores);
-        free(sim.requested_moves); free(sim.scent_model);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.scent_model); return status::OUT_OF_MEMORY;
+    } else if (!init(sim.dense_agents, 32)) {
+        free(sim.config); free(sim.data);
+        free(sim.agents); free(sim.semaphores);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.scent_model); free(sim.world);
         return status::OUT_OF_MEMORY;
+    } else if (!array_init(sim.perception_patch_positions, 128)) {
+        free(sim.config); free(sim.data);
+        free(sim.agents); free(sim.semaphores);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.scent_model); free(sim.world);
+        free(sim.dense_agents); return status::OUT_OF_MEMORY;
     }
+    sim.world.modification_time = sim.time + 1;
+    sim.step_pool = simulator<SimulatorData>::make_step_pool(sim.config);
+    sim.perceive_kernel = simulator<SimulatorData>::select_perceive_kernel(sim.config);
+    sim.step_requested = false;
+    sim.step_thread_stopping = false;
+    sim.defaulted_agent_count = 0;
+    new (&sim.step_thread) std::thread();
+    new (&sim.step_cv) std::condition_variable();
+    new (&sim.snapshots) snapshot_pool();
     new (&sim.simulator_lock) std::mutex();
     new (&sim.requested_move_lock) std::mutex();
+    new (&sim.notification_thread) std::thread();
+    sim.notifications = simulator<SimulatorData>::make_notification_queue(sim.config);
+    sim.start_step_thread();
+    sim.start_notification_thread();
     return status::OK;
 }
 
@@ -2323,6 +5009,130 @@ inline bool write(const agent_state* agent, Stream& out,
     return write(agent_ids.get(agent), out);
 }
 
+template<typename Stream>
+inline bool read(requested_move& request, Stream& in,
+        const hash_map<uint64_t, agent_state*>& agents)
+{
+    return read(request.target, in)
+        && read(request.agent, in, agents)
+        && read(request.order, in);
+}
+
+template<typename Stream>
+inline bool write(const requested_move& request, Stream& out,
+        const hash_map<const agent_state*, uint64_t>& agent_ids)
+{
+    return write(request.target, out)
+        && write(request.agent, out, agent_ids)
+        && write(request.order, out);
+}
+
+inline void* alloc_position_keys(size_t n, size_t element_size) {
+    position* keys = (position*) malloc(sizeof(position) * n);
+    if (keys == NULL) return NULL;
+    for (unsigned int i = 0; i < n; i++)
+        position::set_empty(keys[i]);
+    return (void*) keys;
+}
+
+/**
+ * Reads the requested moves of a simulator saved before
+ * `SAVE_VERSION_REQUESTED_MOVE_ARRAY`, when they were stored as a hash_map from each target position to
+ * the agents that requested it, in arrival order.
+ */
+template<typename Stream>
+bool read_unversioned_requested_moves(array<requested_move>& requested_moves,
+        Stream& in, const hash_map<uint64_t, agent_state*>& agents)
+{
+    default_scribe scribe;
+    hash_map<position, array<agent_state*>>& requests =
+            *((hash_map<position, array<agent_state*>>*) alloca(sizeof(hash_map<position, array<agent_state*>>)));
+    if (!read(requests, in, alloc_position_keys, scribe, agents))
+        return false;
+
+    size_t request_count = 0;
+    for (const auto& entry : requests)
+        request_count += entry.value.length;
+    bool success = array_init(requested_moves, max((size_t) 64, request_count));
+    if (success) {
+        for (const auto& entry : requests) {
+            for (unsigned int i = 0; i < entry.value.length; i++) {
+                requested_move& request = requested_moves[requested_moves.length];
+                request.target = entry.key;
+                request.agent = entry.value[i];
+                request.order = (unsigned int) requested_moves.length++;
+            }
+        }
+    }
+    for (auto entry : requests)
+        free(entry.value);
+    free(requests);
+    return success;
+}
+
+/**
+ * Reads the action queues of the given `agents` from the input stream `in`,
+ * as written by `write_action_queues`.
+ */
+template<typename Stream>
+bool read_action_queues(hash_map<uint64_t, agent_state*>& agents, Stream& in)
+{
+    unsigned int queue_count;
+    if (!read(queue_count, in)) return false;
+    for (unsigned int i = 0; i < queue_count; i++) {
+        uint64_t id; unsigned int action_count;
+        if (!read(id, in) || !read(action_count, in))
+            return false;
+
+        bool contains;
+        agent_state& agent = *agents.get(id, contains);
+        if (!contains) {
+            fprintf(stderr, "read_action_queues ERROR: Action queue refers to an unknown agent.\n");
+            return false;
+        }
+        agent.queued_actions = (action*) malloc(max((size_t) 1, sizeof(action) * action_count));
+        if (agent.queued_actions == NULL) {
+            fprintf(stderr, "read_action_queues ERROR: Insufficient memory for agent_state.queued_actions.\n");
+            return false;
+        }
+        agent.queued_action_capacity = action_count;
+        for (unsigned int j = 0; j < action_count; j++)
+            if (!read(agent.queued_actions[j], in)) return false;
+        agent.queued_action_count = action_count;
+        if (!read(agent.notify_when_queue_drained, in))
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the action queues of the given `agents` to the output stream `out`.
+ * These are stored apart from the rest of the agent_state, since its
+ * representation is also sent to clients in every step response. Only agents
+ * with remaining queued actions are written.
+ */
+template<typename Stream>
+bool write_action_queues(const hash_map<uint64_t, agent_state*>& agents, Stream& out)
+{
+    unsigned int queue_count = 0;
+    for (const auto& entry : agents)
+        if (entry.value->has_queued_actions()) queue_count++;
+    if (!write(queue_count, out)) return false;
+
+    for (const auto& entry : agents) {
+        const agent_state& agent = *entry.value;
+        if (!agent.has_queued_actions()) continue;
+        if (!write(entry.key, out)
+         || !write(agent.queued_action_count - agent.next_queued_action, out))
+            return false;
+        for (unsigned int j = agent.next_queued_action; j < agent.queued_action_count; j++)
+            if (!write(agent.queued_actions[j], out)) return false;
+        if (!write(agent.notify_when_queue_drained, out))
+            return false;
+    }
+    return true;
+}
+
 /**
  * Reads the given simulator `sim` from the input stream `in`. The
  * SimulatorData of `sim` is not read from `in`. Rather, it is initialized by
@@ -2333,10 +5143,26 @@ inline bool write(const agent_state* agent, Stream& out,
 template<typename SimulatorData, typename Stream>
 bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
 {
+    uint32_t header, version = 0;
     if (!init(sim.data, data)) {
         return false;
-    } if (!read(sim.config, in)) {
+    } else if (!read(header, in)) {
         free(sim.data); return false;
+    } else if (header == SIMULATOR_SAVE_MAGIC) {
+        if (!read(version, in)) {
+            free(sim.data); return false;
+        } else if (version > SIMULATOR_SAVE_VERSION) {
+            fprintf(stderr, "read ERROR: Unsupported simulator save format version %u.\n", version);
+            free(sim.data); return false;
+        } else if (!read(sim.config, in, version)) {
+            free(sim.data); return false;
+        }
+    } else {
+        /* saves written before the format was versioned begin with the config */
+        sim.config.max_steps_per_movement = header;
+        if (!read_config_fields(sim.config, in, version)) {
+            free(sim.data); return false;
+        }
     }
 
     unsigned int agent_count;
@@ -2350,7 +5176,7 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
     for (unsigned int i = 0; i < agent_count; i++) {
         uint64_t id;
         agent_state* agent = (agent_state*) malloc(sizeof(agent_state));
-        if (agent == nullptr || !read(id, in) || !read(*agent, in, sim.config)) {
+        if (agent == nullptr || !read(id, in) || !read(*agent, in, sim.config, version)) {
             if (agent != nullptr) free(agent);
             for (auto entry : sim.agents) {
                 free(*entry.value); free(entry.value);
@@ -2369,7 +5195,7 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
         free(sim.config); return false;
     }
 
-    if (!read(sim.world, in, sim.config.item_types.data, (unsigned int) sim.config.item_types.length, sim.agents)) {
+    if (!read(sim.world, in, sim.config.item_types.data, (unsigned int) sim.config.item_types.length, sim.agents, version >= SAVE_VERSION_PATCH_MODIFICATION_TIMES)) {
         for (auto entry : sim.agents) {
             free(*entry.value); free(entry.value);
         }
@@ -2378,8 +5204,10 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
         free(sim.config); return false;
     }
 
-    default_scribe scribe;
-    if (!read(sim.requested_moves, in, alloc_position_keys, scribe, sim.agents)) {
+    if (version < SAVE_VERSION_REQUESTED_MOVE_ARRAY
+            ? !read_unversioned_requested_moves(sim.requested_moves, in, sim.agents)
+            : !read(sim.requested_moves, in, sim.agents))
+    {
         for (auto entry : sim.agents) {
             free(*entry.value); free(entry.value);
         }
@@ -2387,6 +5215,14 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
         free(sim.data); free(sim.agents);
         free(sim.config); free(sim.world);
         return false;
+    } else if (!array_init(sim.blocked_positions, 16)) {
+        for (auto entry : sim.agents) {
+            free(*entry.value); free(entry.value);
+        }
+        free(sim.semaphores); free(sim.requested_moves);
+        free(sim.data); free(sim.agents);
+        free(sim.config); free(sim.world);
+        return false;
     }
 
     /* reinitialize the scent model */
@@ -2394,6 +5230,7 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
      || !read(sim.acted_agent_count, in)
      || !read(sim.active_agent_count, in)
      || !read(sim.id_counter, in)
+     || (version >= SAVE_VERSION_ACTION_QUEUES && !read_action_queues(sim.agents, in))
      || !init(sim.scent_model, (double) sim.config.diffusion_param,
             (double) sim.config.decay_param, sim.config.patch_size,
             sim.config.deleted_item_lifetime))
@@ -2401,15 +5238,51 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
         for (auto entry : sim.agents) {
             free(*entry.value); free(entry.value);
         }
-        for (auto entry : sim.requested_moves)
-            free(entry.value);
         free(sim.semaphores);
         free(sim.data); free(sim.world); free(sim.agents);
-        free(sim.requested_moves); free(sim.config);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.config);
+        return false;
+    } else if (!init(sim.dense_agents, max((size_t) 32, (size_t) agent_count))) {
+        for (auto entry : sim.agents) {
+            free(*entry.value); free(entry.value);
+        }
+        free(sim.semaphores); free(sim.scent_model);
+        free(sim.data); free(sim.world); free(sim.agents);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.config);
+        return false;
+    } else if (!array_init(sim.perception_patch_positions, 128)) {
+        for (auto entry : sim.agents) {
+            free(*entry.value); free(entry.value);
+        }
+        free(sim.semaphores); free(sim.scent_model);
+        free(sim.data); free(sim.world); free(sim.agents);
+        free(sim.requested_moves); free(sim.blocked_positions);
+        free(sim.dense_agents); free(sim.config);
         return false;
     }
+    sim.world.modification_time = sim.time + 1;
+    sim.requested_move_count = 0;
+    for (const requested_move& request : sim.requested_moves)
+        sim.requested_move_count = max(sim.requested_move_count, request.order + 1);
+    for (auto entry : sim.agents)
+        sim.dense_agents.add(entry.key, entry.value);
+    sim.step_pool = simulator<SimulatorData>::make_step_pool(sim.config);
+    sim.perceive_kernel = simulator<SimulatorData>::select_perceive_kernel(sim.config);
+    sim.step_requested = false;
+    sim.step_thread_stopping = false;
+    sim.defaulted_agent_count = 0;
+    new (&sim.step_thread) std::thread();
+    new (&sim.step_cv) std::condition_variable();
+    new (&sim.snapshots) snapshot_pool();
     new (&sim.simulator_lock) std::mutex();
     new (&sim.requested_move_lock) std::mutex();
+    new (&sim.notification_thread) std::thread();
+    sim.notifications = simulator<SimulatorData>::make_notification_queue(sim.config);
+    sim.publish_snapshot();
+    sim.start_step_thread();
+    sim.start_notification_thread();
     return true;
 }
 
@@ -2424,7 +5297,9 @@ bool read(simulator<SimulatorData>& sim, Stream& in, const SimulatorData& data)
 template<typename SimulatorData, typename Stream>
 bool write(const simulator<SimulatorData>& sim, Stream& out)
 {
-    if (!write(sim.config, out))
+    if (!write(SIMULATOR_SAVE_MAGIC, out)
+     || !write(SIMULATOR_SAVE_VERSION, out)
+     || !write(sim.config, out))
         return false;
 
     hash_map<const agent_state*, uint64_t> agent_ids((unsigned int) sim.agents.table.size * RESIZE_THRESHOLD_INVERSE);
@@ -2437,14 +5312,14 @@ bool write(const simulator<SimulatorData>& sim, Stream& out)
         }
     }
 
-    default_scribe scribe;
     return write(sim.semaphores, out)
         && write(sim.world, out, agent_ids)
-        && write(sim.requested_moves, out, scribe, agent_ids)
+        && write(sim.requested_moves, out, agent_ids)
         && write(sim.time, out)
         && write(sim.acted_agent_count, out)
         && write(sim.active_agent_count, out)
-        && write(sim.id_counter, out);
+        && write(sim.id_counter, out)
+        && write_action_queues(sim.agents, out);
 }
 
 } /* namespace jbw */
@@ -33,7 +33,9 @@ enum class status : status_type {
   SERVER_PARSE_MESSAGE_ERROR,
   CLIENT_PARSE_MESSAGE_ERROR,
   SERVER_OUT_OF_MEMORY,
-  CLIENT_OUT_OF_MEMORY
+  CLIENT_OUT_OF_MEMORY,
+  SHARED_MEMORY_ERROR,
+  PROTOCOL_VERSION_MISMATCH
 };
 
 /**
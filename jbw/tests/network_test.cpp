@@ -34,19 +34,19 @@ struct test_server {
 	test_server() : client_connections(1024, alloc_socket_keys) { }
 };
 
-void process_test_server_message(socket_type& server,
+void process_test_server_message(socket_type& server, buffered_socket& in,
 		const hash_map<socket_type, empty_data>& connections,
 		std::mutex& connection_set_lock)
 {
 	bool is_string;
 	lock.lock();
-	if (!read(is_string, server)) {
+	if (!read(is_string, in)) {
 		fprintf(stderr, "Server failed to read is_string.\n");
 		lock.unlock(); return;
 	}
 	if (is_string) {
 		string s;
-		if (!read(s, server)) {
+		if (!read(s, in)) {
 			fprintf(stderr, "Server failed to read string.\n");
 			lock.unlock(); return;
 		}
@@ -54,7 +54,7 @@ void process_test_server_message(socket_type& server,
 		print(s, out); fprintf(out, "\".\n");
 	} else {
 		int64_t i;
-		if (!read(i, server)) {
+		if (!read(i, in)) {
 			fprintf(stderr, "Server failed to read int64_t.\n");
 			lock.unlock(); return;
 		}
@@ -63,17 +63,59 @@ void process_test_server_message(socket_type& server,
 	lock.unlock();
 }
 
+/* the number of values and calls to `recv` counted by `process_benchmark_message` */
+std::atomic<uint64_t> benchmark_value_count(0);
+std::atomic<uint64_t> benchmark_recv_count(0);
+
+void process_benchmark_message(socket_type& server, buffered_socket& in,
+		const hash_map<socket_type, empty_data>& connections,
+		std::mutex& connection_set_lock)
+{
+	size_t recv_count = in.recv_count;
+	uint32_t value_count;
+	if (!read(value_count, in)) {
+		fprintf(stderr, "Server failed to read value_count.\n");
+		return;
+	}
+	for (uint32_t i = 0; i < value_count; i++) {
+		int64_t value;
+		if (!read(value, in)) {
+			fprintf(stderr, "Server failed to read int64_t.\n");
+			return;
+		}
+	}
+	benchmark_recv_count += in.recv_count - recv_count;
+	benchmark_value_count += value_count + 1;
+}
+
+/* the sum of the values read by `process_local_message` */
+std::atomic<int64_t> local_value_sum(0);
+
+void process_local_message(socket_type& server, buffered_socket& in,
+		const hash_map<socket_type, empty_data>& connections,
+		std::mutex& connection_set_lock)
+{
+	int64_t value;
+	if (!read(value, in)) {
+		fprintf(stderr, "Server failed to read int64_t.\n");
+		return;
+	}
+	local_value_sum += value;
+}
+
 inline void new_connection_callback(socket_type& server, const empty_data& data) { }
 
+template<typename ProcessMessageCallback>
 bool init_server(test_server& new_server, uint16_t server_port,
-	unsigned int connection_queue_capacity, unsigned int worker_count)
+	unsigned int connection_queue_capacity, unsigned int worker_count,
+	ProcessMessageCallback process_message, const char* local_socket_path = nullptr)
 {
 	std::condition_variable cv; std::mutex lock;
 	auto dispatch = [&]() {
-		run_server(new_server.server_socket, server_port,
+		run_server(new_server.server_socket, server_port, local_socket_path,
 			connection_queue_capacity, worker_count, new_server.status, cv, lock,
 			new_server.client_connections, new_server.connection_set_lock,
-			process_test_server_message, new_connection_callback);
+			process_message, new_connection_callback);
 	};
 	new_server.status = server_status::STARTING;
 	new_server.server_thread = std::thread(dispatch);
@@ -128,7 +170,7 @@ void test_client_send(socket_type& client, const string& s) {
 
 void test_network() {
 	test_server new_server;
-	bool success = init_server(new_server, 54353, 16, 8);
+	bool success = init_server(new_server, 54353, 16, 8, process_test_server_message);
 	fprintf(out, "init_server returned %s.\n", success ? "true" : "false");
 	if (!success) return;
 
@@ -168,8 +210,184 @@ void test_network() {
 	stop_server(new_server);
 }
 
+/**
+ * Sends many small messages from a single client and counts the calls to
+ * `recv` that the server makes to read them. Without buffering, every value
+ * read from a message would require its own call.
+ */
+void test_buffered_reads() {
+	test_server new_server;
+	bool success = init_server(new_server, 54354, 16, 1, process_benchmark_message);
+	fprintf(out, "init_server returned %s.\n", success ? "true" : "false");
+	if (!success) return;
+
+	socket_type client;
+	if (!init_client(client, "localhost", "54354")) {
+		fprintf(out, "init_client returned false.\n");
+		stop_server(new_server); return;
+	}
+
+	constexpr uint32_t message_count = 10000;
+	constexpr uint32_t values_per_message = 32;
+	memory_stream message = memory_stream(sizeof(uint32_t) + sizeof(int64_t) * values_per_message);
+	auto start = std::chrono::high_resolution_clock::now();
+	for (uint32_t i = 0; i < message_count; i++) {
+		message.position = 0;
+		write(values_per_message, message);
+		for (uint32_t j = 0; j < values_per_message; j++)
+			write((int64_t) (i * values_per_message + j), message);
+		if (!send_message(client, message.buffer, message.position)) {
+			fprintf(stderr, "test_buffered_reads ERROR: Failed to send message to server.\n");
+			break;
+		}
+	}
+
+	uint64_t expected_value_count = (uint64_t) message_count * (values_per_message + 1);
+	for (unsigned int i = 0; i < 1000 && benchmark_value_count < expected_value_count; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	auto end = std::chrono::high_resolution_clock::now();
+
+	uint64_t value_count = benchmark_value_count;
+	uint64_t recv_count = benchmark_recv_count;
+	fprintf(out, "Server read %" PRIu64 " of %" PRIu64 " values with %" PRIu64 " calls to recv"
+			" (%.2f values per call) in %.3f seconds.\n", value_count, expected_value_count,
+			recv_count, (double) value_count / max((uint64_t) 1, recv_count),
+			std::chrono::duration<double>(end - start).count());
+
+	shutdown(client.handle, 2);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	stop_server(new_server);
+}
+
+#if !defined(_WIN32)
+inline bool is_socket_file(const char* path) {
+	struct stat file_status;
+	return lstat(path, &file_status) == 0 && S_ISSOCK(file_status.st_mode);
+}
+
+inline bool is_regular_file(const char* path) {
+	struct stat file_status;
+	return lstat(path, &file_status) == 0 && S_ISREG(file_status.st_mode);
+}
+
+/**
+ * Starts a server that also listens on a Unix domain socket, over a socket
+ * file left behind by a previous server, and checks that a client connected
+ * with a `unix:<path>` address reaches it, and that the socket file is
+ * removed when the server stops. Then checks that a server does not start
+ * over (or remove) a regular file at the socket path.
+ */
+bool test_local_socket() {
+	const char* path = "/tmp/jbw_network_test.sock";
+	unlink(path);
+
+	/* leave a stale socket file at `path` */
+	sockaddr_un address;
+	if (!init_local_address(address, path, "test_local_socket"))
+		return false;
+	int stale = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (stale == -1 || bind(stale, (sockaddr*) &address, sizeof(address)) != 0) {
+		fprintf(stderr, "test_local_socket ERROR: Unable to create a stale socket file.\n");
+		if (stale != -1) ::close(stale);
+		return false;
+	}
+	::close(stale);
+	if (!is_socket_file(path)) {
+		fprintf(stderr, "test_local_socket ERROR: The stale socket file does not exist.\n");
+		return false;
+	}
+
+	test_server new_server;
+	if (!init_server(new_server, 54355, 16, 1, process_local_message, path)) {
+		fprintf(stderr, "test_local_socket ERROR: Unable to start a server over a stale socket file.\n");
+		unlink(path); return false;
+	}
+
+	char local_address[128];
+	snprintf(local_address, sizeof(local_address), LOCAL_ADDRESS_PREFIX "%s", path);
+	socket_type client;
+	if (!init_client(client, local_address, "0")) {
+		fprintf(stderr, "test_local_socket ERROR: Unable to connect to '%s'.\n", local_address);
+		stop_server(new_server); return false;
+	}
+
+	constexpr int64_t value_count = 100;
+	local_value_sum = 0;
+	for (int64_t i = 1; i <= value_count; i++) {
+		memory_stream message = memory_stream(sizeof(int64_t));
+		if (!write(i, message) || !send_message(client, message.buffer, message.position)) {
+			fprintf(stderr, "test_local_socket ERROR: Failed to send message to server.\n");
+			break;
+		}
+	}
+	const int64_t expected_sum = value_count * (value_count + 1) / 2;
+	for (unsigned int i = 0; i < 500 && local_value_sum != expected_sum; i++)
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	/* a second server must not take over the socket of the running one */
+	test_server rival_server;
+	bool rival_started = init_server(rival_server, 54356, 16, 1, process_local_message, path);
+	if (rival_started) stop_server(rival_server);
+	socket_type second_client;
+	bool reachable = init_client(second_client, local_address, "0");
+	if (reachable) {
+		shutdown(second_client.handle, 2);
+		::close(second_client.handle);
+	}
+	shutdown(client.handle, 2);
+	::close(client.handle);
+	stop_server(new_server);
+
+	if (rival_started) {
+		fprintf(stderr, "test_local_socket ERROR: A server started at the path of a running server.\n");
+		return false;
+	} else if (!reachable) {
+		fprintf(stderr, "test_local_socket ERROR: The running server became unreachable when a second server tried to start.\n");
+		return false;
+	}
+
+	if (local_value_sum != expected_sum) {
+		fprintf(stderr, "test_local_socket ERROR: The server received values summing to %" PRId64
+				", but %" PRId64 " was expected.\n", local_value_sum.load(), expected_sum);
+		return false;
+	} else if (is_socket_file(path)) {
+		fprintf(stderr, "test_local_socket ERROR: The socket file was not removed when the server stopped.\n");
+		unlink(path); return false;
+	}
+
+	/* a regular file at `path` must be left alone, so the server cannot start */
+	FILE* file = fopen(path, "w");
+	if (file == nullptr) {
+		fprintf(stderr, "test_local_socket ERROR: Unable to create a regular file.\n");
+		return false;
+	}
+	fclose(file);
+	test_server blocked_server;
+	bool started = init_server(blocked_server, 54356, 16, 1, process_local_message, path);
+	if (started) stop_server(blocked_server);
+	bool kept = is_regular_file(path);
+	unlink(path);
+	if (started) {
+		fprintf(stderr, "test_local_socket ERROR: A server started over a regular file.\n");
+		return false;
+	} else if (!kept) {
+		fprintf(stderr, "test_local_socket ERROR: The regular file was removed.\n");
+		return false;
+	}
+	return true;
+}
+#endif
+
 int main(int argc, const char** argv) {
 	test_network();
+	test_buffered_reads();
+#if !defined(_WIN32)
+	if (!test_local_socket()) {
+		fflush(out);
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "test_local_socket passed.\n");
+#endif
 	fflush(out);
 	return EXIT_SUCCESS;
 }
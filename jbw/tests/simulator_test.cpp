@@ -17,6 +17,7 @@
 #define _USE_MATH_DEFINES
 #include <jbw/simulator.h>
 #include <jbw/mpi.h>
+#include <jbw/agent_executor.h>
 
 #include <core/timer.h>
 #include <cmath>
@@ -92,12 +93,21 @@ hash_map<uint64_t, local_agent_state*> agent_states(agent_count * RESIZE_THRESHO
 std::mutex print_lock;
 FILE* out = stderr;
 async_server server;
+agent_executor* executor = nullptr;
 
 //#define MULTITHREADED
 #define USE_MPI
 //#define TEST_SERIALIZATION
 //#define TEST_SERVER_CONNECTION_LOSS
 //#define TEST_CLIENT_CONNECTION_LOSS
+//#define TEST_SHARED_OBSERVATIONS
+//#define TEST_ACT_BATCH
+//#define TEST_ACTION_QUEUES
+//#define TEST_ADVANCE
+//#define TEST_BATCH_SPAWN
+//#define TEST_ASYNC_NOTIFICATIONS
+//#define TEST_EXECUTOR
+//#define TEST_MAP_BENCHMARK
 
 inline direction next_direction(position agent_position, double theta) {
 	if (theta == M_PI) {
@@ -196,6 +206,56 @@ inline bool try_move(
 	return true;
 }
 
+inline bool try_act_batch(simulator<empty_data>& sim)
+{
+	uint64_t agent_ids[agent_count];
+	action actions[agent_count];
+	status statuses[agent_count];
+	unsigned int i = 0;
+	for (const auto& entry : agent_states) {
+		bool is_move;
+		agent_ids[i] = entry.key;
+		get_next_move(entry.value->agent_position, entry.key,
+				entry.value->direction_flag, actions[i].dir, is_move);
+		actions[i].type = (is_move ? action_type::MOVE : action_type::TURN);
+		actions[i].num_steps = 1;
+		i++;
+	}
+
+	sim.act_batch(agent_ids, actions, i, statuses);
+	for (unsigned int j = 0; j < i; j++) {
+		if (statuses[j] != status::OK) {
+			print_lock.lock();
+			print("ERROR: Unable to perform batched action for agent ", out);
+			print(agent_ids[j], out); print(".\n", out);
+			print_lock.unlock();
+			return false;
+		}
+	}
+	return true;
+}
+
+inline bool try_enqueue_actions(simulator<empty_data>& sim)
+{
+	for (const auto& entry : agent_states) {
+		bool is_move; action a;
+		get_next_move(entry.value->agent_position, entry.key,
+				entry.value->direction_flag, a.dir, is_move);
+		a.type = (is_move ? action_type::MOVE : action_type::TURN);
+		a.num_steps = 1;
+
+		status result = sim.enqueue_actions(entry.key, &a, 1, true);
+		if (result != status::OK) {
+			print_lock.lock();
+			print("ERROR: Unable to enqueue action for agent ", out);
+			print(entry.key, out); print(".\n", out);
+			print_lock.unlock();
+			return false;
+		}
+	}
+	return true;
+}
+
 void run_agent(simulator<empty_data>& sim,
 	uint64_t agent_id, local_agent_state& agent,
 	std::atomic_uint& move_count,
@@ -215,12 +275,18 @@ void run_agent(simulator<empty_data>& sim,
 void on_step(const simulator<empty_data>* sim,
 		const hash_map<uint64_t, agent_state*>& agents, uint64_t time)
 {
-	sim_time++;
+	/* with asynchronous notifications, some time steps may have been coalesced */
+	sim_time = (unsigned int) time;
 
 	/* get agent states */
 	for (const auto& entry : agents)
 		agent_states.get(entry.key)->agent_position = entry.value->current_position;
 
+#if defined(TEST_EXECUTOR)
+	if (executor != nullptr)
+		executor->notify_step(agents, time);
+#endif
+
 #if defined(USE_MPI)
 	if (!send_step_response(server, agents, sim->get_config())) {
 		print_lock.lock();
@@ -239,6 +305,32 @@ void on_step(const simulator<empty_data>* sim,
 
 bool add_agents(simulator<empty_data>& sim)
 {
+#if defined(TEST_BATCH_SPAWN)
+	/* spread the agents over a region, rather than stacking them at (0,0) */
+	uint64_t new_agent_ids[agent_count]; agent_state* new_agents[agent_count];
+	agent_placement placement;
+	placement.policy = placement_policy::SPREAD;
+	placement.positions = nullptr;
+	placement.bottom_left = position(-16, -16);
+	placement.top_right = position(16, 16);
+	if (sim.add_agents(agent_count, placement, new_agent_ids, new_agents) != status::OK) {
+		fprintf(out, "add_agents ERROR: Unable to add new agents.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < agent_count; i++) {
+		local_agent_state* new_agent_state = (local_agent_state*) malloc(sizeof(local_agent_state));
+		if (new_agent_state == nullptr || !init(*new_agent_state)) {
+			fprintf(out, "add_agents ERROR: Unable to add new agent.\n");
+			if (new_agent_state != nullptr) free(new_agent_state);
+			return false;
+		}
+		new_agent_state->agent_position = new_agents[i]->current_position;
+		new_agent_state->direction_flag = (i <= agent_count / 2);
+		new_agent_state->waiting_for_server = false;
+		agent_states.put(new_agent_ids[i], new_agent_state);
+	}
+	return true;
+#else
 	for (unsigned int i = 0; i < agent_count; i++) {
 		uint64_t new_agent_id; agent_state* new_agent;
 		status result = sim.add_agent(new_agent_id, new_agent);
@@ -258,6 +350,7 @@ bool add_agents(simulator<empty_data>& sim)
 			try_move(sim, entry.key, entry.value->agent_position, entry.value->direction_flag);
 	}
 	return true;
+#endif
 }
 
 bool test_singlethreaded(const simulator_config& config)
@@ -272,6 +365,11 @@ bool test_singlethreaded(const simulator_config& config)
 		free(sim); return false;
 	}
 
+#if defined(TEST_ADVANCE)
+	/* burn in the world without computing the intermediate observations */
+	sim.advance(100, advance_policy::NO_OP);
+#endif
+
 	timer stopwatch;
 	std::atomic_uint move_count(0);
 	unsigned long long elapsed = 0;
@@ -298,8 +396,14 @@ bool test_singlethreaded(const simulator_config& config)
 		}
 #endif
 
+#if defined(TEST_ACT_BATCH)
+		try_act_batch(sim);
+#elif defined(TEST_ACTION_QUEUES)
+		try_enqueue_actions(sim);
+#else
 		for (const auto& entry : agent_states)
 			try_move(sim, entry.key, entry.value->agent_position, entry.value->direction_flag);
+#endif
 		move_count += agent_count;
 		if (stopwatch.milliseconds() >= 1000) {
 			elapsed += stopwatch.milliseconds();
@@ -309,10 +413,80 @@ bool test_singlethreaded(const simulator_config& config)
 	}
 	elapsed += stopwatch.milliseconds();
 	fprintf(out, "Completed %u moves: %lf simulation steps per second.\n", move_count.load(), ((double) sim_time / elapsed) * 1000);
+
+#if defined(TEST_MAP_BENCHMARK)
+	/* time scent map queries of a region of 8 x 8 patches around the origin */
+	constexpr unsigned int map_query_count = 20;
+	const int64_t half_width = 4 * (int64_t) config.patch_size;
+	stopwatch.start();
+	for (unsigned int i = 0; i < map_query_count; i++) {
+		array<array<patch_state>> patches(16);
+		if (sim.get_map<true, false>(position(-half_width), position(half_width - 1), patches) != status::OK) {
+			fprintf(stderr, "ERROR: get_map failed.\n");
+			free(sim); return false;
+		}
+		for (array<patch_state>& row : patches) {
+			for (patch_state& patch : row) free(patch);
+			free(row);
+		}
+	}
+	fprintf(out, "Scent map query: %lf ms per query.\n", (double) stopwatch.milliseconds() / map_query_count);
+#endif
+
 	free(sim);
 	return true;
 }
 
+void resume_agent(uint64_t agent_id, const agent_state& state, uint64_t time, void* data);
+
+inline bool act_next(simulator<empty_data>& sim, uint64_t id, local_agent_state& agent)
+{
+	direction dir; bool is_move;
+	get_next_move(agent.agent_position, id, agent.direction_flag, dir, is_move);
+
+	status result = is_move
+			? executor->move(sim, id, dir, 1, resume_agent, (void*) &sim)
+			: executor->turn(sim, id, dir, resume_agent, (void*) &sim);
+	if (result != status::OK) {
+		print_lock.lock();
+		print("ERROR: Unable to act with agent ", out);
+		print(id, out); print(" at ", out);
+		print(agent.agent_position, out); print(".\n", out);
+		print_lock.unlock();
+		return false;
+	}
+	return true;
+}
+
+void resume_agent(uint64_t agent_id, const agent_state& state, uint64_t time, void* data)
+{
+	if (time >= max_time) return;
+	local_agent_state& agent = *agent_states.get(agent_id);
+	agent.agent_position = state.current_position;
+	act_next(*((simulator<empty_data>*) data), agent_id, agent);
+}
+
+bool test_executor(const simulator_config& config)
+{
+	simulator<empty_data> sim(config, empty_data());
+
+	if (!add_agents(sim))
+		return false;
+
+	/* drive every agent from this thread, rather than one thread per agent */
+	agent_executor driver(sim.get_config(), sim.time);
+	executor = &driver;
+	timer stopwatch;
+	for (const auto& entry : agent_states)
+		act_next(sim, entry.key, *entry.value);
+	driver.run();
+	executor = nullptr;
+
+	unsigned long long elapsed = stopwatch.milliseconds();
+	fprintf(out, "Completed %u moves: %lf simulation steps per second.\n", sim_time * agent_count, ((double) sim_time / elapsed) * 1000);
+	return true;
+}
+
 bool test_multithreaded(const simulator_config& config)
 {
 	simulator<empty_data> sim(config, empty_data());
@@ -384,6 +558,10 @@ struct client_data {
 	bool action_result, waiting_for_step;
 	uint64_t agent_id;
 	position pos;
+
+	/* the statuses of the first actions in the last act_batch response */
+	status action_statuses[8];
+	size_t action_status_count;
 };
 
 void on_add_agent(
@@ -495,6 +673,19 @@ void on_get_map(
 	c.data.condition.notify_one();
 }
 
+void on_get_map_summary(
+		client<client_data>& c, status response,
+		array<array<patch_summary>>* blocks)
+{
+	fprintf(stderr, "WARNING: `on_get_map_summary` should not be called.\n");
+	if (blocks == nullptr) return;
+	for (array<patch_summary>& row : *blocks) {
+		for (patch_summary& block : row) free(block);
+		free(row);
+	}
+	free(*blocks); free(blocks);
+}
+
 void on_get_agent_ids(
 		client<client_data>& c, status response,
 		const uint64_t* agent_ids, size_t count)
@@ -532,6 +723,35 @@ void on_is_active(client<client_data>& c, uint64_t agent_id, status response, bo
 	c.data.condition.notify_one();
 }
 
+void on_enqueue_actions(client<client_data>& c, uint64_t agent_id, status response) {
+	std::unique_lock<std::mutex> lck(c.data.lock);
+	c.data.waiting_for_server = false;
+	c.data.action_result = (response == status::OK);
+	c.data.condition.notify_one();
+}
+
+void on_enable_shared_observations(client<client_data>& c, status response) {
+	std::unique_lock<std::mutex> lck(c.data.lock);
+	c.data.waiting_for_server = false;
+	c.data.action_result = (response == status::OK);
+	c.data.condition.notify_one();
+}
+
+void on_act_batch(client<client_data>& c, status response,
+		status* statuses, size_t count)
+{
+	std::unique_lock<std::mutex> lck(c.data.lock);
+	c.data.waiting_for_server = false;
+	c.data.action_result = (response == status::OK);
+	for (size_t i = 0; c.data.action_result && i < count; i++)
+		if (statuses[i] != status::OK) c.data.action_result = false;
+	c.data.action_status_count = min(count, (size_t) 8);
+	for (size_t i = 0; i < c.data.action_status_count; i++)
+		c.data.action_statuses[i] = statuses[i];
+	if (statuses != nullptr) free(statuses);
+	c.data.condition.notify_one();
+}
+
 void on_step(client<client_data>& c,
 		status response,
 		const array<uint64_t>& agent_ids,
@@ -542,6 +762,15 @@ void on_step(client<client_data>& c,
 	for (unsigned int i = 0; i < agent_ids.length; i++) {
 		local_agent_state& agent = *agent_states.get(agent_ids[i]);
 		agent.agent_position = agent_state_array[i].current_position;
+#if defined(TEST_SHARED_OBSERVATIONS)
+		if (!c.observations.contains(agent_state_array[i].current_scent)
+		 || !c.observations.contains(agent_state_array[i].current_vision))
+		{
+			print_lock.lock();
+			fprintf(out, "on_step ERROR: Observations were not received through shared memory.\n");
+			print_lock.unlock();
+		}
+#endif
 	}
 	c.data.condition.notify_one();
 }
@@ -630,7 +859,15 @@ void cleanup_mpi(client<client_data>* clients,
 bool test_mpi(const simulator_config& config)
 {
 	simulator<empty_data> sim(config, empty_data());
-	if (!init_server(server, sim, 54353, 16, 4, permissions::grant_all())) {
+#if defined(TEST_SHARED_OBSERVATIONS)
+	/* the server passes the shared memory over a Unix domain socket */
+	const char* local_socket_path = "/tmp/jbw_simulator_test.sock";
+	const char* server_address = "unix:/tmp/jbw_simulator_test.sock";
+#else
+	const char* local_socket_path = nullptr;
+	const char* server_address = "localhost";
+#endif
+	if (!init_server(server, sim, 54353, 16, 4, permissions::grant_all(), local_socket_path)) {
 		fprintf(out, "ERROR: init_server returned false.\n");
 		return false;
 	}
@@ -639,12 +876,26 @@ bool test_mpi(const simulator_config& config)
 	client<client_data> clients[agent_count];
 	uint64_t client_ids[agent_count];
 	for (unsigned int i = 0; i < agent_count; i++) {
-		uint64_t simulator_time = connect_client(clients[i], "localhost", "54353", client_ids[i]);
+		uint64_t simulator_time = connect_client(clients[i], server_address, "54353", client_ids[i]);
 		if (simulator_time == UINT64_MAX) {
 			fprintf(out, "ERROR: Unable to initialize client %u.\n", i);
 			cleanup_mpi(clients, i); return false;
 		}
 
+#if defined(TEST_SHARED_OBSERVATIONS)
+		/* receive the observations of the agent through shared memory */
+		clients[i].data.waiting_for_server = true;
+		if (!send_enable_shared_observations(clients[i], 4, 1)) {
+			fprintf(out, "ERROR: Unable to send enable_shared_observations request.\n");
+			cleanup_mpi(clients, i); return false;
+		}
+		wait_for_server(clients[i].data.condition, clients[i].data.lock, clients[i].data.waiting_for_server, clients[i].client_running);
+		if (!clients[i].data.action_result) {
+			fprintf(out, "ERROR: Server returned failure for enable_shared_observations request.\n");
+			cleanup_mpi(clients, i); return false;
+		}
+#endif
+
 		/* each client adds one agent to the simulation */
 		clients[i].data.waiting_for_server = true;
 		clients[i].data.client_id = client_ids[i];
@@ -725,117 +976,1643 @@ bool test_mpi(const simulator_config& config)
 	return true;
 }
 
-int main(int argc, const char** argv)
+/**
+ * The SimulatorData of the simulators in the tests below, which do not use
+ * `agent_states`. If `notification_delay` is nonzero, `on_step` checks that
+ * every agent is at y-coordinate `time`, waits `notification_delay`
+ * milliseconds, and checks again, to detect a notification that is
+ * overwritten while it is being delivered.
+ */
+struct test_data {
+	unsigned int notification_delay;
+
+	test_data(unsigned int notification_delay = 0) : notification_delay(notification_delay) { }
+
+	static inline void free(test_data& data) { }
+};
+
+inline bool init(test_data& data, const test_data& src) {
+	data.notification_delay = src.notification_delay;
+	return true;
+}
+
+/* the number of `on_step` calls for simulators in the tests below, the
+   number of agents that those calls reported as having drained their action
+   queues, and the number of agents whose notified positions were wrong */
+std::atomic_uint test_step_count(0);
+std::atomic_uint test_drained_count(0);
+std::atomic_uint test_notification_errors(0);
+
+inline void check_notified_positions(
+		const hash_map<uint64_t, agent_state*>& agents, uint64_t time)
 {
-	simulator_config config;
-	config.max_steps_per_movement = 1;
-	config.scent_dimension = 3;
-	config.color_dimension = 3;
-	config.vision_range = 5;
-	config.agent_field_of_view = 2.09f;
-	for (unsigned int i = 0; i < (size_t) direction::COUNT; i++)
-		config.allowed_movement_directions[i] = action_policy::ALLOWED;
-	for (unsigned int i = 0; i < (size_t) direction::COUNT; i++)
-		config.allowed_rotations[i] = action_policy::ALLOWED;
-	config.no_op_allowed = false;
-	config.patch_size = 32;
-	config.mcmc_iterations = 4000;
-	config.agent_color = (float*) calloc(config.color_dimension, sizeof(float));
-	config.agent_color[2] = 1.0f;
-	config.collision_policy = collision_policy;
-	config.decay_param = 0.4f;
-	config.diffusion_param = 0.14f;
-	config.deleted_item_lifetime = 2000;
+	for (const auto& entry : agents)
+		if (entry.value->current_position.y != (int64_t) time) test_notification_errors++;
+}
 
-	/* configure item types */
-	unsigned int item_type_count = 4;
-	config.item_types.ensure_capacity(item_type_count);
-	config.item_types[0].name = "banana";
-	config.item_types[0].scent = (float*) calloc(config.scent_dimension, sizeof(float));
-	config.item_types[0].color = (float*) calloc(config.color_dimension, sizeof(float));
-	config.item_types[0].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[0].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[0].scent[1] = 1.0f;
-	config.item_types[0].color[1] = 1.0f;
-	config.item_types[0].required_item_counts[0] = 1;
-	config.item_types[0].blocks_movement = false;
-	config.item_types[0].visual_occlusion = 0.0;
-	config.item_types[1].name = "onion";
-	config.item_types[1].scent = (float*) calloc(config.scent_dimension, sizeof(float));
-	config.item_types[1].color = (float*) calloc(config.color_dimension, sizeof(float));
-	config.item_types[1].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[1].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[1].scent[0] = 1.0f;
-	config.item_types[1].color[0] = 1.0f;
-	config.item_types[1].required_item_counts[1] = 1;
-	config.item_types[1].blocks_movement = false;
-	config.item_types[1].visual_occlusion = 0.0;
-	config.item_types[2].name = "jellybean";
-	config.item_types[2].scent = (float*) calloc(config.scent_dimension, sizeof(float));
-	config.item_types[2].color = (float*) calloc(config.color_dimension, sizeof(float));
-	config.item_types[2].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[2].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[2].scent[2] = 1.0f;
-	config.item_types[2].color[2] = 1.0f;
-	config.item_types[2].blocks_movement = false;
-	config.item_types[2].visual_occlusion = 0.0;
-	config.item_types[3].name = "wall";
-	config.item_types[3].scent = (float*) calloc(config.scent_dimension, sizeof(float));
-	config.item_types[3].color = (float*) calloc(config.color_dimension, sizeof(float));
-	config.item_types[3].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[3].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
-	config.item_types[3].color[0] = 0.5f;
-	config.item_types[3].color[1] = 0.5f;
-	config.item_types[3].color[2] = 0.5f;
-	config.item_types[3].required_item_counts[3] = 1;
-	config.item_types[3].blocks_movement = true;
-	config.item_types[3].visual_occlusion = 0.5;
-	config.item_types.length = item_type_count;
+void on_step(const simulator<test_data>* sim,
+		const hash_map<uint64_t, agent_state*>& agents, uint64_t time)
+{
+	for (const auto& entry : agents)
+		if (entry.value->action_queue_drained) test_drained_count++;
 
-	config.item_types[0].intensity_fn.fn = constant_intensity_fn;
-	config.item_types[0].intensity_fn.arg_count = 1;
-	config.item_types[0].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
-	config.item_types[0].intensity_fn.args[0] = -5.3f;
-	config.item_types[0].interaction_fns = (energy_function<interaction_function>*)
-			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
-	config.item_types[1].intensity_fn.fn = constant_intensity_fn;
-	config.item_types[1].intensity_fn.arg_count = 1;
-	config.item_types[1].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
-	config.item_types[1].intensity_fn.args[0] = -5.0f;
-	config.item_types[1].interaction_fns = (energy_function<interaction_function>*)
-			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
-	config.item_types[2].intensity_fn.fn = constant_intensity_fn;
-	config.item_types[2].intensity_fn.arg_count = 1;
-	config.item_types[2].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
-	config.item_types[2].intensity_fn.args[0] = -5.3f;
-	config.item_types[2].interaction_fns = (energy_function<interaction_function>*)
-			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
-	config.item_types[3].intensity_fn.fn = constant_intensity_fn;
-	config.item_types[3].intensity_fn.arg_count = 1;
-	config.item_types[3].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
-	config.item_types[3].intensity_fn.args[0] = 0.0f;
-	config.item_types[3].interaction_fns = (energy_function<interaction_function>*)
-			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
+	if (executor != nullptr)
+		executor->notify_step(agents, time);
 
-	set_interaction_args(config.item_types.data, 0, 0, piecewise_box_interaction_fn, {10.0f, 200.0f, 0.0f, -6.0f});
-	set_interaction_args(config.item_types.data, 0, 1, piecewise_box_interaction_fn, {200.0f, 0.0f, -6.0f, -6.0f});
-	set_interaction_args(config.item_types.data, 0, 2, piecewise_box_interaction_fn, {10.0f, 200.0f, 2.0f, -100.0f});
-	set_interaction_args(config.item_types.data, 0, 3, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 1, 0, piecewise_box_interaction_fn, {200.0f, 0.0f, -6.0f, -6.0f});
-	set_interaction_args(config.item_types.data, 1, 1, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 1, 2, piecewise_box_interaction_fn, {200.0f, 0.0f, -100.0f, -100.0f});
-	set_interaction_args(config.item_types.data, 1, 3, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 2, 0, piecewise_box_interaction_fn, {10.0f, 200.0f, 2.0f, -100.0f});
-	set_interaction_args(config.item_types.data, 2, 1, piecewise_box_interaction_fn, {200.0f, 0.0f, -100.0f, -100.0f});
-	set_interaction_args(config.item_types.data, 2, 2, piecewise_box_interaction_fn, {10.0f, 200.0f, 0.0f, -6.0f});
-	set_interaction_args(config.item_types.data, 2, 3, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 3, 0, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 3, 1, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 3, 2, zero_interaction_fn, {});
-	set_interaction_args(config.item_types.data, 3, 3, cross_interaction_fn, {10.0f, 15.0f, 20.0f, -200.0f, -20.0f, 1.0f});
+	unsigned int delay = sim->get_data().notification_delay;
+	if (delay > 0) {
+		check_notified_positions(agents, time);
+		std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+		check_notified_positions(agents, time);
+	}
+	test_step_count++;
+}
+
+/* Returns a copy of `config` in which no item blocks movement, so that every move succeeds. */
+inline simulator_config without_obstacles(const simulator_config& config) {
+	simulator_config open_config(config);
+	for (item_properties& properties : open_config.item_types)
+		properties.blocks_movement = false;
+	return open_config;
+}
+
+inline bool add_test_agents(simulator<test_data>& sim,
+		const position* positions, unsigned int count,
+		uint64_t* agent_ids, agent_state** agents)
+{
+	agent_placement placement;
+	placement.policy = placement_policy::EXPLICIT;
+	placement.positions = positions;
+	return sim.add_agents(count, placement, agent_ids, agents) == status::OK;
+}
+
+inline bool scents_match(const agent_state& first, const agent_state& second,
+		const simulator_config& config, float tolerance)
+{
+	for (unsigned int i = 0; i < config.scent_dimension; i++)
+		if (fabs(first.current_scent[i] - second.current_scent[i]) > tolerance) return false;
+	return true;
+}
+
+inline bool visions_match(const agent_state& first, const agent_state& second,
+		const simulator_config& config, float tolerance)
+{
+	unsigned int vision_size = (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension;
+	for (unsigned int i = 0; i < vision_size; i++)
+		if (fabs(first.current_vision[i] - second.current_vision[i]) > tolerance) return false;
+	return true;
+}
+
+inline bool statuses_match(const status* statuses,
+		std::initializer_list<status> expected)
+{
+	unsigned int i = 0;
+	for (status s : expected)
+		if (statuses[i++] != s) return false;
+	return true;
+}
+
+/**
+ * Checks that `act_batch` rejects unknown and repeated agent IDs, and that
+ * a batch in which every agent acts completes exactly one time step.
+ */
+bool test_act_batch(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	position positions[] = { position(0, 0), position(10, 0) };
+	uint64_t ids[2]; agent_state* agents[2];
+	if (!add_test_agents(sim, positions, 2, ids, agents)) {
+		fprintf(stderr, "test_act_batch ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	action actions[4];
+	for (action& a : actions) {
+		a.type = action_type::MOVE;
+		a.dir = direction::UP;
+		a.num_steps = 1;
+	}
+	uint64_t batch[] = { ids[0], ids[1] + 100, ids[0], ids[1] };
+	status statuses[4];
+	unsigned int step_count = test_step_count;
+	sim.act_batch(batch, actions, 4, statuses);
+	if (!statuses_match(statuses, {status::OK, status::INVALID_AGENT_ID, status::AGENT_ALREADY_ACTED, status::OK})) {
+		fprintf(stderr, "test_act_batch ERROR: Unexpected statuses for a batch with unknown and repeated IDs.\n");
+		return false;
+	} else if (sim.time != 1 || test_step_count != step_count + 1
+			|| agents[0]->current_position != position(0, 1)
+			|| agents[1]->current_position != position(10, 1))
+	{
+		fprintf(stderr, "test_act_batch ERROR: A full batch did not complete exactly one time step.\n");
+		return false;
+	}
+
+	/* the time step waits for the agents that are missing from a batch */
+	sim.act_batch(ids, actions, 1, statuses);
+	if (statuses[0] != status::OK || sim.time != 1) {
+		fprintf(stderr, "test_act_batch ERROR: A partial batch completed a time step.\n");
+		return false;
+	}
+	sim.act_batch(ids + 1, actions, 1, statuses);
+	if (statuses[0] != status::OK || sim.time != 2 || test_step_count != step_count + 2) {
+		fprintf(stderr, "test_act_batch ERROR: The rest of the batch did not complete the time step.\n");
+		return false;
+	}
+	return true;
+}
+
+inline bool mpi_act_batch(client<client_data>& c,
+		const uint64_t* agent_ids, const action* actions, size_t count)
+{
+	c.data.waiting_for_server = true;
+	if (!send_act_batch(c, agent_ids, actions, count)) {
+		fprintf(stderr, "mpi_act_batch ERROR: Unable to send act_batch request.\n");
+		return false;
+	}
+	wait_for_server(c.data.condition, c.data.lock, c.data.waiting_for_server, c.client_running);
+	return c.client_running && c.data.action_status_count == count;
+}
+
+/**
+ * Checks that a server only performs the actions in an act_batch message for
+ * the agents owned by the client that sent it.
+ */
+bool test_mpi_act_batch(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	async_server batch_server;
+	if (!init_server(batch_server, sim, 54354, 16, 2, permissions::grant_all())) {
+		fprintf(stderr, "test_mpi_act_batch ERROR: init_server returned false.\n");
+		return false;
+	}
+
+	/* each client adds one agent */
+	client<client_data> clients[2];
+	uint64_t agent_ids[2] = { 0, 0 };
+	unsigned int connected = 0;
+	bool success = true;
+	for (; connected < 2; connected++) {
+		uint64_t client_id;
+		if (connect_client(clients[connected], "localhost", "54354", client_id) == UINT64_MAX) {
+			fprintf(stderr, "test_mpi_act_batch ERROR: Unable to connect client %u.\n", connected);
+			success = false; break;
+		}
+		clients[connected].data.client_id = client_id;
+		clients[connected].data.agent_id = UINT64_MAX;
+		clients[connected].data.waiting_for_server = true;
+		if (!send_add_agent(clients[connected])) {
+			fprintf(stderr, "test_mpi_act_batch ERROR: Unable to send add_agent request.\n");
+			connected++; success = false; break;
+		}
+		wait_for_server(clients[connected].data.condition, clients[connected].data.lock,
+				clients[connected].data.waiting_for_server, clients[connected].client_running);
+		agent_ids[connected] = clients[connected].data.agent_id;
+		if (agent_ids[connected] == UINT64_MAX) {
+			fprintf(stderr, "test_mpi_act_batch ERROR: Server returned failure for add_agent request.\n");
+			connected++; success = false; break;
+		}
+	}
+
+	action actions[3];
+	for (action& a : actions) {
+		a.type = action_type::TURN;
+		a.dir = direction::LEFT;
+		a.num_steps = 1;
+	}
+	uint64_t batch[] = { agent_ids[0], agent_ids[1], agent_ids[1] + 100 };
+	if (success && (!mpi_act_batch(clients[0], batch, actions, 3)
+	 || !statuses_match(clients[0].data.action_statuses, {status::OK, status::INVALID_AGENT_ID, status::INVALID_AGENT_ID})
+	 || sim.time != 0))
+	{
+		fprintf(stderr, "test_mpi_act_batch ERROR: The server did not reject the agents that the client does not own.\n");
+		success = false;
+	}
+
+	/* the agent of the second client has not acted, so it completes the time step */
+	if (success && (!mpi_act_batch(clients[1], batch + 1, actions, 1)
+	 || clients[1].data.action_statuses[0] != status::OK || sim.time != 1))
+	{
+		fprintf(stderr, "test_mpi_act_batch ERROR: The agent of the second client was unable to act.\n");
+		success = false;
+	}
+
+	/* `on_add_agent` tracked the agents in `agent_states` for `test_mpi` */
+	for (unsigned int i = 0; i < connected; i++) {
+		stop_client(clients[i]);
+		bool contains; unsigned int bucket;
+		local_agent_state* agent = agent_states.get(clients[i].data.agent_id, contains, bucket);
+		if (contains) {
+			agent_states.remove_at(bucket);
+			free(*agent); free(agent);
+		}
+	}
+	stop_server(batch_server);
+	return success;
+}
+
+/**
+ * Checks that a server rejects a client that connects without the current
+ * protocol version, such as a client built before it was introduced.
+ */
+bool test_protocol_version(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	async_server version_server;
+	if (!init_server(version_server, sim, 54357, 16, 1, permissions::grant_all())) {
+		fprintf(stderr, "test_protocol_version ERROR: init_server returned false.\n");
+		return false;
+	}
+
+	auto check_handshake = [](uint32_t version, status expected) {
+		status response = status::OK;
+		bool received = false;
+		auto process_connection = [&](socket_type& connection) {
+			memory_stream mem_stream = memory_stream(2 * sizeof(uint32_t) + sizeof(uint64_t));
+			fixed_width_stream<memory_stream> out(mem_stream);
+			fixed_width_stream<socket_type> in(connection);
+			received = write(MPI_PROTOCOL_MAGIC, out)
+					&& write(version, out) && write(NEW_CLIENT_REQUEST, out)
+					&& send_message(connection, mem_stream.buffer, mem_stream.position)
+					&& read(response, in);
+			shutdown(connection.handle, 2);
+			return received;
+		};
+		return run_client("localhost", "54357", process_connection)
+			&& received && response == expected;
+	};
+
+	bool success = true;
+	if (!check_handshake(MPI_PROTOCOL_VERSION + 1, status::PROTOCOL_VERSION_MISMATCH)) {
+		fprintf(stderr, "test_protocol_version ERROR: The server accepted a client with a different protocol version.\n");
+		success = false;
+	} else if (!check_handshake(MPI_PROTOCOL_VERSION, status::OK)) {
+		fprintf(stderr, "test_protocol_version ERROR: The server rejected a client with the same protocol version.\n");
+		success = false;
+	}
+	stop_server(version_server);
+	return success;
+}
+
+/**
+ * Checks the positions of agents after a time step in which they move in a
+ * chain, a cycle, and a swap, in which two of them request the same cell,
+ * and in which they move towards an agent that stays in place. The agents
+ * that lose a conflict stay in place, and so do the agents behind them.
+ */
+bool test_movement_conflicts(const simulator_config& config)
+{
+	constexpr unsigned int count = 15;
+	const position positions[count] = {
+		/* a chain of agents that each move into the cell that the next one leaves */
+		position(0, 0), position(1, 0), position(2, 0),
+		/* a cycle of four agents around a square */
+		position(20, 0), position(21, 0), position(21, 1), position(20, 1),
+		/* two agents that swap cells */
+		position(40, 0), position(41, 0),
+		/* two agents that request the same cell, and one behind the second of them */
+		position(60, 0), position(62, 0), position(63, 0),
+		/* an agent that turns in place, and two agents behind each other that move towards it */
+		position(80, 0), position(79, 0), position(78, 0)
+	};
+	const direction directions[count] = {
+		direction::RIGHT, direction::RIGHT, direction::RIGHT,
+		direction::RIGHT, direction::UP, direction::LEFT, direction::DOWN,
+		direction::RIGHT, direction::LEFT,
+		direction::RIGHT, direction::LEFT, direction::LEFT,
+		direction::LEFT, direction::RIGHT, direction::RIGHT
+	};
+	position expected[count] = {
+		position(1, 0), position(2, 0), position(3, 0),
+		position(21, 0), position(21, 1), position(20, 1), position(20, 0),
+		position(41, 0), position(40, 0),
+		position(61, 0), position(62, 0), position(63, 0),
+		position(80, 0), position(79, 0), position(78, 0)
+	};
+	action actions[count];
+	for (unsigned int i = 0; i < count; i++) {
+		actions[i].type = (i == 12 ? action_type::TURN : action_type::MOVE);
+		actions[i].dir = directions[i];
+		actions[i].num_steps = 1;
+	}
+
+	for (movement_conflict_policy policy : {movement_conflict_policy::FIRST_COME_FIRST_SERVED, movement_conflict_policy::RANDOM}) {
+		simulator_config conflict_config = without_obstacles(config);
+		conflict_config.collision_policy = policy;
+		simulator<test_data> sim(conflict_config, test_data(), 0);
+		uint64_t ids[count]; agent_state* agents[count]; status statuses[count];
+		if (!add_test_agents(sim, positions, count, ids, agents)) {
+			fprintf(stderr, "test_movement_conflicts ERROR: Unable to add agents.\n");
+			return false;
+		}
+		sim.act_batch(ids, actions, count, statuses);
+		if (sim.time != 1) {
+			fprintf(stderr, "test_movement_conflicts ERROR: The batch did not complete a time step.\n");
+			return false;
+		}
+
+		/* under the RANDOM policy, the second agent may win the conflict
+		   instead, and then the agent behind it follows */
+		bool second_won = (agents[10]->current_position == position(61, 0));
+		if (policy == movement_conflict_policy::FIRST_COME_FIRST_SERVED && second_won) {
+			fprintf(stderr, "test_movement_conflicts ERROR: The agent that requested the cell first did not win it.\n");
+			return false;
+		}
+		expected[9] = second_won ? position(60, 0) : position(61, 0);
+		expected[10] = second_won ? position(61, 0) : position(62, 0);
+		expected[11] = second_won ? position(62, 0) : position(63, 0);
+		for (unsigned int i = 0; i < count; i++) {
+			if (statuses[i] != status::OK || agents[i]->current_position != expected[i]) {
+				fprintf(stderr, "test_movement_conflicts ERROR: Agent %u is at (%" PRId64 ", %" PRId64 "), but"
+						" (%" PRId64 ", %" PRId64 ") was expected with collision policy %u.\n", i,
+						agents[i]->current_position.x, agents[i]->current_position.y,
+						expected[i].x, expected[i].y, (unsigned int) policy);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Runs the same agents in two simulators that differ only in
+ * `step_thread_count`, and checks that their observations are identical.
+ */
+bool test_step_thread_count(const simulator_config& config)
+{
+	constexpr unsigned int count = 16;
+	position positions[count];
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = position(7 * (int64_t) i - 56, 3 * (int64_t) (i % 4));
+
+	simulator_config parallel_config(config);
+	parallel_config.step_thread_count = 4;
+	simulator<test_data> sequential(config, test_data(), 0);
+	simulator<test_data> parallel(parallel_config, test_data(), 0);
+	uint64_t sequential_ids[count], parallel_ids[count];
+	agent_state* sequential_agents[count]; agent_state* parallel_agents[count];
+	if (!add_test_agents(sequential, positions, count, sequential_ids, sequential_agents)
+	 || !add_test_agents(parallel, positions, count, parallel_ids, parallel_agents))
+	{
+		fprintf(stderr, "test_step_thread_count ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	for (unsigned int t = 0; t < 20; t++) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (t % 5 == 4) {
+				sequential.turn(sequential_ids[i], direction::LEFT);
+				parallel.turn(parallel_ids[i], direction::LEFT);
+			} else {
+				sequential.move(sequential_ids[i], direction::UP, 1);
+				parallel.move(parallel_ids[i], direction::UP, 1);
+			}
+		}
+
+		for (unsigned int i = 0; i < count; i++) {
+			if (sequential_agents[i]->current_position != parallel_agents[i]->current_position
+			 || sequential_agents[i]->current_direction != parallel_agents[i]->current_direction
+			 || !scents_match(*sequential_agents[i], *parallel_agents[i], config, 0.0f)
+			 || !visions_match(*sequential_agents[i], *parallel_agents[i], config, 0.0f))
+			{
+				fprintf(stderr, "test_step_thread_count ERROR: Agent %u differs at time %u"
+						" with step_thread_count = %u.\n", i, t + 1, parallel_config.step_thread_count);
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Checks that, with a dedicated step thread, an action that completes a time
+ * step returns before the step does, and that freeing the simulator waits
+ * for the pending step to complete.
+ */
+bool test_dedicated_step_thread(const simulator_config& config)
+{
+	simulator_config threaded_config = without_obstacles(config);
+	threaded_config.dedicated_step_thread = true;
+	unsigned int step_count = test_step_count;
+	unsigned int notification_errors = test_notification_errors;
+	{
+		/* `on_step` takes 200 milliseconds */
+		simulator<test_data> sim(threaded_config, test_data(200), 0);
+		position origin(0, 0); uint64_t agent_id; agent_state* agent;
+		if (!add_test_agents(sim, &origin, 1, &agent_id, &agent)) {
+			fprintf(stderr, "test_dedicated_step_thread ERROR: Unable to add agent.\n");
+			return false;
+		} else if (sim.move(agent_id, direction::UP, 1) != status::OK) {
+			fprintf(stderr, "test_dedicated_step_thread ERROR: Unable to move agent.\n");
+			return false;
+		} else if (test_step_count != step_count) {
+			fprintf(stderr, "test_dedicated_step_thread ERROR: The move waited for the time step to complete.\n");
+			return false;
+		}
+		/* `sim` is freed while the time step is still pending */
+	}
+	if (test_step_count != step_count + 1 || test_notification_errors != notification_errors) {
+		fprintf(stderr, "test_dedicated_step_thread ERROR: The pending time step did not complete when the simulator was freed.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Returns `true` if every agent in the given snapshot is in the row given by
+ * the time of the snapshot, as in `test_concurrent_snapshots`.
+ */
+inline bool snapshot_consistent(const observation_snapshot& snapshot, unsigned int agent_count) {
+	if (snapshot.agents.length != agent_count) return false;
+	for (const published_agent& agent : snapshot.agents)
+		if (agent.state->current_position.y != (int64_t) snapshot.time) return false;
+	return true;
+}
+
+/**
+ * Checks that readers of the agent state snapshots always see the agents as
+ * they were at the end of a single time step while the simulator steps, and
+ * that a reader holding on to a snapshot does not block the simulator.
+ */
+bool test_concurrent_snapshots(const simulator_config& config)
+{
+	constexpr unsigned int agent_count = 16;
+	constexpr unsigned int reader_count = 4;
+	constexpr unsigned int step_count = 200;
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	position positions[agent_count];
+	for (unsigned int i = 0; i < agent_count; i++)
+		positions[i] = position(2 * i, 0);
+	uint64_t ids[agent_count]; agent_state* agents[agent_count];
+	if (!add_test_agents(sim, positions, agent_count, ids, agents)) {
+		fprintf(stderr, "test_concurrent_snapshots ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	/* every agent moves up once per time step, so at the end of each time
+	   step, every agent is in the row given by the simulation time */
+	const observation_snapshot& held = sim.acquire_snapshot();
+	std::atomic_bool stepping(true);
+	std::atomic_uint inconsistent_count(0);
+	std::atomic_uint read_count(0);
+	std::thread readers[reader_count];
+	for (unsigned int i = 0; i < reader_count; i++) {
+		readers[i] = std::thread([&]() {
+			uint64_t last_time = 0;
+			while (stepping) {
+				const observation_snapshot& snapshot = sim.acquire_snapshot();
+				if (!snapshot_consistent(snapshot, agent_count) || snapshot.time < last_time)
+					inconsistent_count++;
+				last_time = snapshot.time;
+				sim.release_snapshot(snapshot);
+				read_count++;
+			}
+		});
+	}
+
+	action actions[agent_count];
+	for (action& a : actions) {
+		a.type = action_type::MOVE;
+		a.dir = direction::UP;
+		a.num_steps = 1;
+	}
+	status statuses[agent_count];
+	for (unsigned int t = 0; t < step_count; t++)
+		sim.act_batch(ids, actions, agent_count, statuses);
+	stepping = false;
+	for (std::thread& reader : readers)
+		reader.join();
+
+	bool success = true;
+	if (sim.time != step_count) {
+		fprintf(stderr, "test_concurrent_snapshots ERROR: The simulator did not complete every time step.\n");
+		success = false;
+	} else if (inconsistent_count > 0) {
+		fprintf(stderr, "test_concurrent_snapshots ERROR: %u of %u snapshots did not match a single time step.\n",
+				inconsistent_count.load(), read_count.load());
+		success = false;
+	} else if (held.time != 0 || !snapshot_consistent(held, agent_count)) {
+		fprintf(stderr, "test_concurrent_snapshots ERROR: A held snapshot changed while the simulator stepped.\n");
+		success = false;
+	}
+	sim.release_snapshot(held);
+
+	const observation_snapshot& latest = sim.acquire_snapshot();
+	if (success && (latest.time != step_count || !snapshot_consistent(latest, agent_count))) {
+		fprintf(stderr, "test_concurrent_snapshots ERROR: The last time step was not published.\n");
+		success = false;
+	}
+	sim.release_snapshot(latest);
+	return success;
+}
+
+/**
+ * Checks that a `default_action` that the config does not allow is rejected,
+ * and that the step deadline does not advance a simulator with no agents.
+ */
+bool test_step_deadline(const simulator_config& config)
+{
+	simulator_config deadline_config(config);
+	deadline_config.step_deadline = 5;
+	deadline_config.no_op_allowed = false;
+	deadline_config.default_action.type = action_type::NO_OP;
+	simulator_config& rejected = *((simulator_config*) alloca(sizeof(simulator_config)));
+	if (init(rejected, deadline_config)) {
+		fprintf(stderr, "test_step_deadline ERROR: A disallowed default_action was accepted.\n");
+		free(rejected); return false;
+	}
+
+	deadline_config.default_action.type = action_type::MOVE;
+	deadline_config.default_action.dir = direction::UP;
+	deadline_config.default_action.num_steps = 1;
+	simulator<test_data> sim(deadline_config, test_data(), 0);
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	if (sim.time != 0) {
+		fprintf(stderr, "test_step_deadline ERROR: The simulator advanced to time %" PRIu64 " without any agents.\n", sim.time);
+		return false;
+	}
+
+	/* once there is an agent, every deadline completes a time step */
+	position origin(0, 0); uint64_t agent_id; agent_state* agent;
+	if (!add_test_agents(sim, &origin, 1, &agent_id, &agent)) {
+		fprintf(stderr, "test_step_deadline ERROR: Unable to add agent.\n");
+		return false;
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	if (sim.time == 0) {
+		fprintf(stderr, "test_step_deadline ERROR: The deadline did not advance the simulator.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks that queued actions are performed one per time step, that the
+ * agent cannot act otherwise while its queue is not empty, and that the
+ * drained queue is reported exactly once.
+ */
+bool test_action_queues(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	position positions[] = { position(0, 0), position(10, 0) };
+	uint64_t ids[2]; agent_state* agents[2];
+	if (!add_test_agents(sim, positions, 2, ids, agents)) {
+		fprintf(stderr, "test_action_queues ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	action queued[3];
+	for (action& a : queued) {
+		a.type = action_type::MOVE;
+		a.dir = direction::UP;
+		a.num_steps = 1;
+	}
+	test_drained_count = 0;
+	if (sim.enqueue_actions(ids[0], queued, 3, true) != status::OK) {
+		fprintf(stderr, "test_action_queues ERROR: enqueue_actions failed.\n");
+		return false;
+	} else if (sim.move(ids[0], direction::UP, 1) != status::AGENT_ALREADY_ACTED) {
+		fprintf(stderr, "test_action_queues ERROR: An agent with queued actions was able to move.\n");
+		return false;
+	}
+
+	/* the first agent acts from its queue whenever the second agent acts */
+	for (unsigned int t = 0; t < 4; t++) {
+		if (sim.move(ids[1], direction::UP, 1) != status::OK) {
+			fprintf(stderr, "test_action_queues ERROR: Unable to move agent %" PRIu64 ".\n", ids[1]);
+			return false;
+		}
+	}
+	if (sim.time != 3 || agents[0]->current_position != position(0, 3)
+	 || agents[1]->current_position != position(10, 3) || test_drained_count != 1)
+	{
+		fprintf(stderr, "test_action_queues ERROR: Expected time 3 with the agents at (0, 3) and (10, 3)"
+				" and one drained queue, but the time is %" PRIu64 ", the agents are at (%" PRId64 ", %" PRId64 ")"
+				" and (%" PRId64 ", %" PRId64 "), and %u queues were drained.\n", sim.time,
+				agents[0]->current_position.x, agents[0]->current_position.y,
+				agents[1]->current_position.x, agents[1]->current_position.y, test_drained_count.load());
+		return false;
+	}
+
+	/* the queue is empty, so the time step waits for the first agent */
+	if (sim.move(ids[0], direction::UP, 1) != status::OK || sim.time != 4
+	 || agents[0]->current_position != position(0, 4))
+	{
+		fprintf(stderr, "test_action_queues ERROR: The first agent did not move after its queue was drained.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks that `advance` performs the expected number of time steps and
+ * queued actions, and that it only calls `on_step` for the last time step.
+ */
+bool test_advance(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	position positions[] = { position(0, 0), position(10, 0) };
+	uint64_t ids[2]; agent_state* agents[2];
+	if (!add_test_agents(sim, positions, 2, ids, agents)) {
+		fprintf(stderr, "test_advance ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	action queued[10];
+	for (action& a : queued) {
+		a.type = action_type::MOVE;
+		a.dir = direction::UP;
+		a.num_steps = 1;
+	}
+	if (sim.enqueue_actions(ids[0], queued, 10, false) != status::OK) {
+		fprintf(stderr, "test_advance ERROR: enqueue_actions failed.\n");
+		return false;
+	}
+
+	/* the first agent has already performed its next queued action when `advance` returns */
+	unsigned int step_count = test_step_count;
+	sim.advance(5, advance_policy::QUEUED_ACTIONS);
+	if (sim.time != 5 || test_step_count != step_count + 1
+	 || agents[0]->current_position != position(0, 5) || agents[1]->current_position != position(10, 0))
+	{
+		fprintf(stderr, "test_advance ERROR: Unexpected state after advancing with queued actions.\n");
+		return false;
+	}
+
+	sim.advance(3, advance_policy::NO_OP);
+	if (sim.time != 8 || test_step_count != step_count + 2
+	 || agents[0]->current_position != position(0, 6) || agents[1]->current_position != position(10, 0))
+	{
+		fprintf(stderr, "test_advance ERROR: Unexpected state after advancing without queued actions.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks the positions and IDs of agents added by `add_agents` under each
+ * placement policy, and that a batch with an occupied position is rejected
+ * as a whole.
+ */
+bool test_batch_spawn(const simulator_config& config)
+{
+	simulator<test_data> sim(config, test_data(), 0);
+	agent_placement placement;
+	placement.positions = nullptr;
+
+	/* nine agents on a 3 x 3 grid over a 30 x 30 region */
+	uint64_t spread_ids[9]; agent_state* spread_agents[9];
+	placement.policy = placement_policy::SPREAD;
+	placement.bottom_left = position(0, 0);
+	placement.top_right = position(29, 29);
+	if (sim.add_agents(9, placement, spread_ids, spread_agents) != status::OK) {
+		fprintf(stderr, "test_batch_spawn ERROR: Unable to spread agents.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < 9; i++) {
+		position expected(5 + 10 * (i % 3), 5 + 10 * (i / 3));
+		if (spread_ids[i] != spread_ids[0] + i || spread_agents[i]->current_position != expected) {
+			fprintf(stderr, "test_batch_spawn ERROR: Spread agent %u has ID %" PRIu64 " at (%" PRId64 ", %" PRId64 ")"
+					", but (%" PRId64 ", %" PRId64 ") was expected.\n", i, spread_ids[i],
+					spread_agents[i]->current_position.x, spread_agents[i]->current_position.y, expected.x, expected.y);
+			return false;
+		}
+	}
+
+	/* no agent is added if any of the positions is occupied */
+	position explicit_positions[] = { position(-40, -40), position(15, 15) };
+	uint64_t explicit_ids[2]; agent_state* explicit_agents[2];
+	array<uint64_t> agent_ids(16);
+	placement.policy = placement_policy::EXPLICIT;
+	placement.positions = explicit_positions;
+	if (sim.add_agents(2, placement, explicit_ids, explicit_agents) != status::AGENT_ALREADY_EXISTS
+	 || sim.get_agent_ids(agent_ids) != status::OK || agent_ids.length != 9)
+	{
+		fprintf(stderr, "test_batch_spawn ERROR: A batch with an occupied position was not rejected.\n");
+		return false;
+	}
+	explicit_positions[1] = position(-40, -39);
+	if (sim.add_agents(2, placement, explicit_ids, explicit_agents) != status::OK
+	 || explicit_agents[0]->current_position != explicit_positions[0]
+	 || explicit_agents[1]->current_position != explicit_positions[1])
+	{
+		fprintf(stderr, "test_batch_spawn ERROR: Agents were not added at the given positions.\n");
+		return false;
+	}
+
+	/* random positions are distinct and inside the region, which must have room for every agent */
+	uint64_t random_ids[17]; agent_state* random_agents[17];
+	placement.policy = placement_policy::RANDOM;
+	placement.positions = nullptr;
+	placement.bottom_left = position(100, 100);
+	placement.top_right = position(103, 103);
+	if (sim.add_agents(17, placement, random_ids, random_agents) != status::AGENT_ALREADY_EXISTS) {
+		fprintf(stderr, "test_batch_spawn ERROR: 17 agents were placed in a region with 16 cells.\n");
+		return false;
+	} else if (sim.add_agents(8, placement, random_ids, random_agents) != status::OK) {
+		fprintf(stderr, "test_batch_spawn ERROR: Unable to place agents randomly.\n");
+		return false;
+	}
+
+	/* the remaining eight cells of the region are found even though most random draws land on occupied cells */
+	if (sim.add_agents(8, placement, random_ids + 8, random_agents + 8) != status::OK) {
+		fprintf(stderr, "test_batch_spawn ERROR: Unable to fill the rest of the region randomly.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < 16; i++) {
+		const position& pos = random_agents[i]->current_position;
+		if (pos.x < 100 || pos.x > 103 || pos.y < 100 || pos.y > 103) {
+			fprintf(stderr, "test_batch_spawn ERROR: A random agent was placed outside the region.\n");
+			return false;
+		}
+		for (unsigned int j = 0; j < i; j++) {
+			if (random_agents[j]->current_position == pos) {
+				fprintf(stderr, "test_batch_spawn ERROR: Two random agents were placed at the same position.\n");
+				return false;
+			}
+		}
+	}
+	if (sim.add_agents(1, placement, random_ids + 16, random_agents + 16) != status::AGENT_ALREADY_EXISTS) {
+		fprintf(stderr, "test_batch_spawn ERROR: An agent was placed in a full region.\n");
+		return false;
+	}
+
+	/* a single batch fills an empty region exactly */
+	placement.bottom_left = position(200, 200);
+	placement.top_right = position(203, 203);
+	if (sim.add_agents(16, placement, random_ids, random_agents) != status::OK) {
+		fprintf(stderr, "test_batch_spawn ERROR: Unable to fill a region with a single batch.\n");
+		return false;
+	}
+	for (unsigned int i = 0; i < 16; i++) {
+		for (unsigned int j = 0; j < i; j++) {
+			if (random_agents[j]->current_position == random_agents[i]->current_position) {
+				fprintf(stderr, "test_batch_spawn ERROR: Two agents in a full batch were placed at the same position.\n");
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+/**
+ * Checks the clusters computed by `get_interaction_clusters` against those
+ * computed by comparing the positions of every pair of agents.
+ */
+bool test_interaction_clusters(const simulator_config& config)
+{
+	simulator<test_data> sim(config, test_data(), 0);
+	const int64_t radius = (int64_t) sim.interaction_radius();
+
+	/* agents exactly at the interaction radius from each other, and just beyond it */
+	constexpr unsigned int explicit_count = 4;
+	constexpr unsigned int random_count = 60;
+	constexpr unsigned int agent_count = explicit_count + random_count;
+	position explicit_positions[] = {
+		position(-1000, -1000), position(-1000 + radius, -1000 - radius),
+		position(-1000 + 2 * radius + 1, -1000), position(-1000 - radius, -1000 + radius + 1) };
+	uint64_t ids[agent_count]; agent_state* agents[agent_count];
+	if (!add_test_agents(sim, explicit_positions, explicit_count, ids, agents)) {
+		fprintf(stderr, "test_interaction_clusters ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	/* agents scattered sparsely enough to form clusters of various sizes */
+	agent_placement placement;
+	placement.policy = placement_policy::RANDOM;
+	placement.positions = nullptr;
+	placement.bottom_left = position(0, 0);
+	placement.top_right = position(15 * radius, 15 * radius);
+	if (sim.add_agents(random_count, placement, ids + explicit_count, agents + explicit_count) != status::OK) {
+		fprintf(stderr, "test_interaction_clusters ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	array<uint64_t> cluster_agent_ids(agent_count);
+	array<unsigned int> cluster_starts(agent_count + 1);
+	if (sim.get_interaction_clusters(cluster_agent_ids, cluster_starts) != status::OK
+	 || cluster_agent_ids.length != agent_count || cluster_starts.length < 2
+	 || cluster_starts[0] != 0 || cluster_starts.last() != agent_count)
+	{
+		fprintf(stderr, "test_interaction_clusters ERROR: get_interaction_clusters failed.\n");
+		return false;
+	}
+
+	/* find the cluster of each agent */
+	unsigned int clusters[agent_count];
+	for (unsigned int i = 0; i < agent_count; i++)
+		clusters[i] = agent_count;
+	for (unsigned int c = 0; c + 1 < cluster_starts.length; c++) {
+		if (cluster_starts[c] >= cluster_starts[c + 1]) {
+			fprintf(stderr, "test_interaction_clusters ERROR: Cluster %u is empty.\n", c);
+			return false;
+		}
+		for (unsigned int k = cluster_starts[c]; k < cluster_starts[c + 1]; k++) {
+			unsigned int i = 0;
+			while (i < agent_count && ids[i] != cluster_agent_ids[k]) i++;
+			if (i == agent_count || clusters[i] != agent_count) {
+				fprintf(stderr, "test_interaction_clusters ERROR: Agent %" PRIu64 " is unknown or in more than one cluster.\n", cluster_agent_ids[k]);
+				return false;
+			}
+			clusters[i] = c;
+		}
+	}
+
+	/* join every pair of agents within the interaction radius of each other */
+	unsigned int expected[agent_count];
+	for (unsigned int i = 0; i < agent_count; i++)
+		expected[i] = i;
+	auto root = [&](unsigned int i) {
+		while (expected[i] != i) i = expected[i];
+		return i;
+	};
+	for (unsigned int i = 0; i < agent_count; i++) {
+		for (unsigned int j = i + 1; j < agent_count; j++) {
+			const position& first = agents[i]->current_position;
+			const position& second = agents[j]->current_position;
+			if (std::abs(first.x - second.x) <= radius && std::abs(first.y - second.y) <= radius)
+				expected[root(j)] = root(i);
+		}
+	}
+
+	for (unsigned int i = 0; i < agent_count; i++) {
+		for (unsigned int j = i + 1; j < agent_count; j++) {
+			if ((clusters[i] == clusters[j]) != (root(i) == root(j))) {
+				fprintf(stderr, "test_interaction_clusters ERROR: Agents %" PRIu64 " and %" PRIu64 " should%s be in the same cluster.\n",
+						ids[i], ids[j], (root(i) == root(j)) ? "" : " not");
+				return false;
+			}
+		}
+	}
+	if (clusters[0] != clusters[1] || clusters[0] == clusters[2] || clusters[0] == clusters[3]) {
+		fprintf(stderr, "test_interaction_clusters ERROR: Unexpected clusters at the interaction radius.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks that the vision of an existing agent, which is updated
+ * incrementally when agents are added nearby or removed, matches the vision
+ * computed from scratch for the same set of agents.
+ */
+bool test_incremental_vision(const simulator_config& config)
+{
+	simulator_config open_config = without_obstacles(config);
+	position positions[] = { position(0, 0), position(1, 3), position(-2, 4) };
+	uint64_t ids[3]; agent_state* agents[3];
+
+	/* `incremental` adds its agents one at a time, whereas `full` and
+	   `pair` compute the vision of all their agents at once */
+	simulator<test_data> incremental(open_config, test_data(), 0);
+	simulator<test_data> full(open_config, test_data(), 0);
+	simulator<test_data> pair(open_config, test_data(), 0);
+	simulator<test_data> alone(open_config, test_data(), 0);
+	uint64_t full_ids[3], pair_ids[2], alone_id;
+	agent_state* full_agents[3]; agent_state* pair_agents[2]; agent_state* alone_agent;
+	if (!add_test_agents(incremental, positions, 1, ids, agents)
+	 || !add_test_agents(incremental, positions + 1, 1, ids + 1, agents + 1)
+	 || !add_test_agents(incremental, positions + 2, 1, ids + 2, agents + 2)
+	 || !add_test_agents(full, positions, 3, full_ids, full_agents)
+	 || !add_test_agents(pair, positions, 2, pair_ids, pair_agents)
+	 || !add_test_agents(alone, positions, 1, &alone_id, &alone_agent))
+	{
+		fprintf(stderr, "test_incremental_vision ERROR: Unable to add agents.
+");
+		return false;
+	}
+
+	if (visions_match(*full_agents[0], *alone_agent, config, 1.0e-3f)) {
+		fprintf(stderr, "test_incremental_vision ERROR: The added agents are not visible to the first agent.\n");
+		return false;
+	} else if (!visions_match(*agents[0], *full_agents[0], config, 1.0e-5f)) {
+		fprintf(stderr, "test_incremental_vision ERROR: The vision after adding agents differs from the full computation.\n");
+		return false;
+	}
+
+	if (incremental.remove_agent(ids[2]) != status::OK) {
+		fprintf(stderr, "test_incremental_vision ERROR: Unable to remove agent.\n");
+		return false;
+	} else if (!visions_match(*agents[0], *pair_agents[0], config, 1.0e-5f)
+			|| !visions_match(*agents[1], *pair_agents[1], config, 1.0e-5f))
+	{
+		fprintf(stderr, "test_incremental_vision ERROR: The vision after removing an agent differs from the full computation.\n");
+		return false;
+	}
+
+	if (incremental.remove_agent(ids[1]) != status::OK) {
+		fprintf(stderr, "test_incremental_vision ERROR: Unable to remove agent.\n");
+		return false;
+	} else if (!visions_match(*agents[0], *alone_agent, config, 1.0e-5f)) {
+		fprintf(stderr, "test_incremental_vision ERROR: The vision after removing every neighbor differs from the full computation.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Recomputes the perception of each agent with the generic kernel and with
+ * `Kernel`, and checks that the results agree.
+ */
+template<typename Kernel>
+bool kernels_match(simulator<test_data>& sim,
+		agent_state** agents, unsigned int count,
+		const simulator_config& config, float tolerance)
+{
+	if (!Kernel::supports(config)) {
+		fprintf(stderr, "test_specialized_kernels ERROR: The kernel does not support the test configuration.\n");
+		return false;
+	}
+
+	unsigned int vision_size = (2*config.vision_range + 1) * (2*config.vision_range + 1) * config.color_dimension;
+	float* scent = (float*) malloc(sizeof(float) * config.scent_dimension);
+	float* vision = (float*) malloc(sizeof(float) * vision_size);
+	if (scent == nullptr || vision == nullptr) {
+		fprintf(stderr, "test_specialized_kernels ERROR: Out of memory.\n");
+		if (scent != nullptr) free(scent);
+		return false;
+	}
+
+	bool success = true;
+	for (unsigned int i = 0; success && i < count; i++) {
+		agent_state& agent = *agents[i];
+		patch<patch_data>* neighborhood[4]; position patch_positions[4];
+		sim.get_world().get_fixed_neighborhood(agent.current_position, neighborhood, patch_positions);
+
+		agent.update_state<generic_observation_kernel>(neighborhood, sim.get_scent_model(), config, sim.time);
+		memcpy(scent, agent.current_scent, sizeof(float) * config.scent_dimension);
+		memcpy(vision, agent.current_vision, sizeof(float) * vision_size);
+		agent.update_state<Kernel>(neighborhood, sim.get_scent_model(), config, sim.time);
+		for (unsigned int j = 0; success && j < config.scent_dimension; j++)
+			if (fabs(scent[j] - agent.current_scent[j]) > tolerance) success = false;
+		for (unsigned int j = 0; success && j < vision_size; j++)
+			if (fabs(vision[j] - agent.current_vision[j]) > tolerance) success = false;
+		if (!success)
+			fprintf(stderr, "test_specialized_kernels ERROR: The perception of agent %u differs from the generic kernel.\n", i);
+	}
+	free(scent); free(vision);
+	return success;
+}
+
+/**
+ * Checks that the specialized perception kernels that support the test
+ * configuration compute the same observations as the generic kernel, after
+ * the agents have moved so that items have diffused scent.
+ */
+bool test_specialized_kernels(const simulator_config& config)
+{
+	constexpr unsigned int count = 8;
+	position positions[count];
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = position(9 * (int64_t) i - 36, -5 * (int64_t) (i % 3));
+
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	uint64_t ids[count]; agent_state* agents[count];
+	if (!add_test_agents(sim, positions, count, ids, agents)) {
+		fprintf(stderr, "test_specialized_kernels ERROR: Unable to add agents.\n");
+		return false;
+	}
+	for (unsigned int t = 0; t < 10; t++)
+		for (unsigned int i = 0; i < count; i++)
+			sim.move(ids[i], direction::UP, 1);
+
+	return kernels_match<observation_kernel<3, 3, 5>>(sim, agents, count, config, 1.0e-5f)
+		&& kernels_match<observation_kernel<3, 3, 0>>(sim, agents, count, config, 1.0e-5f);
+}
+
+/**
+ * Checks that a slow `on_step` always sees the notification it was given,
+ * even though the simulator discards queued notifications under `policy`
+ * while it is being delivered.
+ */
+bool test_slow_notifications(const simulator_config& config, notification_policy policy)
+{
+	simulator_config queue_config = without_obstacles(config);
+	queue_config.step_notification_capacity = 2;
+	queue_config.step_notification_policy = policy;
+
+	constexpr unsigned int step_count = 100;
+	unsigned int start_count = test_step_count;
+	test_notification_errors = 0;
+	{
+		simulator<test_data> sim(queue_config, test_data(2), 0);
+		position positions[] = { position(0, 0), position(10, 0) };
+		uint64_t ids[2]; agent_state* agents[2];
+		if (!add_test_agents(sim, positions, 2, ids, agents)) {
+			fprintf(stderr, "test_slow_notifications ERROR: Unable to add agents.\n");
+			return false;
+		}
+		for (unsigned int t = 0; t < step_count; t++) {
+			if (sim.move(ids[0], direction::UP, 1) != status::OK
+			 || sim.move(ids[1], direction::UP, 1) != status::OK)
+			{
+				fprintf(stderr, "test_slow_notifications ERROR: Unable to move agents.\n");
+				return false;
+			}
+		}
+		/* let the consumer claim a notification before the simulator stops */
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+
+	unsigned int delivered = test_step_count - start_count;
+	if (test_notification_errors != 0) {
+		fprintf(stderr, "test_slow_notifications ERROR: %u agent positions were overwritten during delivery.\n",
+				test_notification_errors.load());
+		return false;
+	} else if (delivered == 0 || delivered > step_count) {
+		fprintf(stderr, "test_slow_notifications ERROR: %u of %u notifications were delivered.\n", delivered, step_count);
+		return false;
+	}
+	return true;
+}
+
+/* The state shared by the continuations in `test_agent_executor`. */
+struct executor_test_state {
+	simulator<test_data>& sim;
+	uint64_t max_time;
+	unsigned int resume_counts[3];
+	uint64_t ids[3];
+	bool success;
+
+	executor_test_state(simulator<test_data>& sim, uint64_t max_time) :
+		sim(sim), max_time(max_time), resume_counts{0, 0, 0}, success(true) { }
+};
+
+void resume_test_agent(uint64_t agent_id, const agent_state& state, uint64_t time, void* data)
+{
+	executor_test_state& test = *((executor_test_state*) data);
+	unsigned int i = 0;
+	while (i < 3 && test.ids[i] != agent_id) i++;
+	if (i == 3) {
+		fprintf(stderr, "test_agent_executor ERROR: Resumed unknown agent %" PRIu64 ".\n", agent_id);
+		test.success = false; return;
+	}
+
+	/* each agent is resumed once per time step, with its state after that step */
+	test.resume_counts[i]++;
+	if (time != test.resume_counts[i] || state.current_position.y != (int64_t) time) {
+		fprintf(stderr, "test_agent_executor ERROR: Agent %u was resumed for the %u-th time at time %" PRIu64
+				" and y-coordinate %" PRId64 ".\n", i, test.resume_counts[i], time, state.current_position.y);
+		test.success = false; return;
+	}
+	if (time < test.max_time && executor->move(test.sim, agent_id, direction::UP, 1, resume_test_agent, data) != status::OK) {
+		fprintf(stderr, "test_agent_executor ERROR: Unable to move agent %u.\n", i);
+		test.success = false;
+	}
+}
+
+/**
+ * Drives three agents from this thread with an `agent_executor`, and checks
+ * that each agent is resumed exactly once per time step with its new state,
+ * and that `run` returns once no agent is waiting.
+ */
+bool test_agent_executor(const simulator_config& config)
+{
+	/* deliver `on_step` synchronously, so that no time step is coalesced */
+	simulator_config executor_config = without_obstacles(config);
+	executor_config.step_notification_capacity = 0;
+	simulator<test_data> sim(executor_config, test_data(), 0);
+	position positions[] = { position(0, 0), position(10, 0), position(20, 0) };
+	executor_test_state test(sim, 10);
+	agent_state* agents[3];
+	if (!add_test_agents(sim, positions, 3, test.ids, agents)) {
+		fprintf(stderr, "test_agent_executor ERROR: Unable to add agents.\n");
+		return false;
+	}
+
+	agent_executor driver(sim.get_config(), sim.time);
+	executor = &driver;
+	for (unsigned int i = 0; i < 3; i++) {
+		if (driver.move(sim, test.ids[i], direction::UP, 1, resume_test_agent, (void*) &test) != status::OK) {
+			fprintf(stderr, "test_agent_executor ERROR: Unable to move agent %u.\n", i);
+			executor = nullptr; return false;
+		}
+	}
+	driver.run();
+	executor = nullptr;
+
+	if (!test.success) return false;
+	for (unsigned int i = 0; i < 3; i++) {
+		if (test.resume_counts[i] != test.max_time || agents[i]->current_position.y != (int64_t) test.max_time) {
+			fprintf(stderr, "test_agent_executor ERROR: Agent %u was resumed %u times and is at y-coordinate %" PRId64
+					", but %" PRIu64 " was expected.\n", i, test.resume_counts[i], agents[i]->current_position.y, test.max_time);
+			return false;
+		}
+	}
+	if (sim.time != test.max_time) {
+		fprintf(stderr, "test_agent_executor ERROR: The simulator is at time %" PRIu64 ", but %" PRIu64 " was expected.\n",
+				sim.time, test.max_time);
+		return false;
+	}
+	return true;
+}
+
+inline void free_map(array<array<patch_state>>& patches) {
+	for (array<patch_state>& row : patches) {
+		for (patch_state& patch : row) free(patch);
+		free(row);
+	}
+}
+
+/**
+ * Checks that the scent maps returned by `get_map`, which are computed per
+ * patch quadrant, match the scent computed separately for every cell from
+ * all the items in its neighborhood, after agents have collected items so
+ * that some items are deleted.
+ */
+bool test_scent_map(const simulator_config& config)
+{
+	constexpr unsigned int count = 8;
+	position positions[count];
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = position(7 * (int64_t) i - 28, -20);
+
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	uint64_t ids[count]; agent_state* agents[count];
+	if (!add_test_agents(sim, positions, count, ids, agents)) {
+		fprintf(stderr, "test_scent_map ERROR: Unable to add agents.\n");
+		return false;
+	}
+	for (unsigned int t = 0; t < 40; t++)
+		for (unsigned int i = 0; i < count; i++)
+			sim.move(ids[i], direction::UP, 1);
+
+	const int64_t half_width = 2 * (int64_t) config.patch_size;
+	array<array<patch_state>> patches(4);
+	if (sim.get_map<true, false>(position(-half_width), position(half_width - 1), patches) != status::OK) {
+		fprintf(stderr, "test_scent_map ERROR: get_map failed.\n");
+		free_map(patches); return false;
+	}
+
+	float* expected = (float*) malloc(sizeof(float) * config.scent_dimension);
+	if (expected == nullptr) {
+		fprintf(stderr, "test_scent_map ERROR: Out of memory.\n");
+		free_map(patches); return false;
+	}
+	bool success = true;
+	for (const array<patch_state>& row : patches) {
+		for (const patch_state& state : row) {
+			position patch_world_position = state.patch_position * config.patch_size;
+			for (unsigned int a = 0; success && a < config.patch_size; a++) {
+				for (unsigned int b = 0; success && b < config.patch_size; b++) {
+					position cell = patch_world_position + position(a, b);
+					for (unsigned int i = 0; i < config.scent_dimension; i++)
+						expected[i] = 0.0f;
+
+					patch<patch_data>* neighborhood[4]; position patch_positions[4];
+					unsigned int patch_count = sim.get_world().get_neighborhood(cell, neighborhood, patch_positions);
+					for (unsigned int i = 0; i < patch_count; i++) {
+						for (const item& item : neighborhood[i]->items) {
+							if (item.deletion_time > 0 && sim.time >= item.deletion_time + config.deleted_item_lifetime)
+								continue;
+							compute_scent_contribution(sim.get_scent_model(), item, cell, sim.time, config, expected);
+						}
+					}
+
+					const float* actual = state.scent + (a*config.patch_size + b)*config.scent_dimension;
+					for (unsigned int i = 0; i < config.scent_dimension; i++) {
+						if (fabs(actual[i] - expected[i]) > 1.0e-5f) {
+							fprintf(stderr, "test_scent_map ERROR: The scent at (%" PRId64 ", %" PRId64 ") differs from"
+									" the per-cell computation.\n", cell.x, cell.y);
+							success = false; break;
+						}
+					}
+				}
+			}
+		}
+	}
+	free(expected);
+	free_map(patches);
+	return success;
+}
+
+/* Returns `a` divided by `b`, rounded toward negative infinity. */
+inline int64_t floored_div(int64_t a, int64_t b) {
+	int64_t quotient = a / b;
+	if (a % b < 0) quotient--;
+	return quotient;
+}
+
+/**
+ * Returns the number of agents in the patch at the origin in the patches
+ * returned by `get_map_since`, or -1 if that patch was not returned.
+ */
+inline int origin_patch_agent_count(simulator<test_data>& sim,
+		uint64_t since_time, int64_t patch_size)
+{
+	array<array<patch_state>> patches(4);
+	if (sim.get_map_since<false, false>(position(0, 0), position(patch_size - 1), since_time, patches) != status::OK) {
+		free_map(patches);
+		return -2;
+	}
+	int agent_count = -1;
+	for (const array<patch_state>& row : patches)
+		for (const patch_state& patch : row)
+			if (patch.patch_position == position(0, 0)) agent_count = (int) patch.agent_count;
+	free_map(patches);
+	return agent_count;
+}
+
+/**
+ * Checks that `get_map_since` returns a patch in which agents were added or
+ * removed after the map was retrieved, even if no time step has completed
+ * since, and that it returns nothing once the map is up to date.
+ */
+bool test_map_since(const simulator_config& config)
+{
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	const int64_t patch_size = (int64_t) config.patch_size;
+	position positions[] = { position(0, 0), position(1, 1) };
+	uint64_t ids[2]; agent_state* agents[2];
+	if (!add_test_agents(sim, positions, 1, ids, agents)
+	 || sim.move(ids[0], direction::UP, 1) != status::OK)
+	{
+		fprintf(stderr, "test_map_since ERROR: Unable to add and move an agent.\n");
+		return false;
+	}
+
+	/* a client retrieves the map at this time */
+	const uint64_t fetch_time = sim.time;
+	if (origin_patch_agent_count(sim, fetch_time, patch_size) != -1) {
+		fprintf(stderr, "test_map_since ERROR: A patch was returned even though nothing changed.\n");
+		return false;
+	}
+
+	if (!add_test_agents(sim, positions + 1, 1, ids + 1, agents + 1) || sim.time != fetch_time) {
+		fprintf(stderr, "test_map_since ERROR: Unable to add an agent.\n");
+		return false;
+	} else if (origin_patch_agent_count(sim, fetch_time, patch_size) != 2) {
+		fprintf(stderr, "test_map_since ERROR: The patch of an agent added at the current time was not returned.\n");
+		return false;
+	}
+
+	if (sim.remove_agent(ids[0]) != status::OK || sim.time != fetch_time) {
+		fprintf(stderr, "test_map_since ERROR: Unable to remove an agent.\n");
+		return false;
+	} else if (origin_patch_agent_count(sim, fetch_time, patch_size) != 1) {
+		fprintf(stderr, "test_map_since ERROR: The patch of an agent removed at the current time was not returned.\n");
+		return false;
+	}
+
+	/* the agent that remains completes a time step */
+	if (sim.move(ids[1], direction::UP, 1) != status::OK || sim.time != fetch_time + 1) {
+		fprintf(stderr, "test_map_since ERROR: Unable to move an agent.\n");
+		return false;
+	} else if (origin_patch_agent_count(sim, fetch_time, patch_size) != 1
+			|| origin_patch_agent_count(sim, sim.time, patch_size) != -1)
+	{
+		fprintf(stderr, "test_map_since ERROR: Unexpected patches after a time step.\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Checks that each block returned by `get_map_summary` has the patch count,
+ * item counts, agent count, and average color of the patches in it, as
+ * returned by `get_map`.
+ */
+bool test_map_summary(const simulator_config& config)
+{
+	constexpr unsigned int count = 8;
+	constexpr unsigned int block_size = 3;
+	position positions[count];
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = position(13 * (int64_t) i - 52, 11 * (int64_t) (i % 3) - 11);
+
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	uint64_t ids[count]; agent_state* agents[count];
+	if (!add_test_agents(sim, positions, count, ids, agents)) {
+		fprintf(stderr, "test_map_summary ERROR: Unable to add agents.\n");
+		return false;
+	}
+	for (unsigned int t = 0; t < 20; t++)
+		for (unsigned int i = 0; i < count; i++)
+			sim.move(ids[i], direction::UP, 1);
+
+	/* the region covers the patches from (-4, -4) to (3, 3) */
+	const int64_t half_width = 4 * (int64_t) config.patch_size;
+	array<array<patch_state>> patches(8);
+	array<array<patch_summary>> blocks(4);
+	if (sim.get_map<false, false>(position(-half_width), position(half_width - 1), patches) != status::OK
+	 || sim.get_map_summary(position(-half_width), position(half_width - 1), block_size, blocks) != status::OK)
+	{
+		fprintf(stderr, "test_map_summary ERROR: Unable to retrieve the map.\n");
+		free_map(patches);
+		for (array<patch_summary>& row : blocks) {
+			for (patch_summary& block : row) free(block);
+			free(row);
+		}
+		return false;
+	}
+
+	const unsigned int item_type_count = (unsigned int) config.item_types.length;
+	unsigned int* item_counts = (unsigned int*) malloc(sizeof(unsigned int) * item_type_count);
+	float* color = (float*) malloc(sizeof(float) * config.color_dimension);
+	bool success = (item_counts != nullptr && color != nullptr);
+	if (!success) fprintf(stderr, "test_map_summary ERROR: Out of memory.\n");
+	unsigned int summarized_patch_count = 0, region_patch_count = 0;
+	for (const array<patch_state>& row : patches)
+		for (const patch_state& state : row)
+			if (state.patch_position.x >= -4 && state.patch_position.x <= 3
+			 && state.patch_position.y >= -4 && state.patch_position.y <= 3) region_patch_count++;
+
+	for (const array<patch_summary>& row : blocks) {
+		for (const patch_summary& block : row) {
+			if (!success) break;
+			unsigned int patch_count = 0, agent_count = 0;
+			for (unsigned int i = 0; i < item_type_count; i++)
+				item_counts[i] = 0;
+			for (const array<patch_state>& patch_row : patches) {
+				for (const patch_state& state : patch_row) {
+					const position& p = state.patch_position;
+					if (p.x < -4 || p.x > 3 || p.y < -4 || p.y > 3
+					 || floored_div(p.x, block_size) != block.block_position.x
+					 || floored_div(p.y, block_size) != block.block_position.y)
+						continue;
+					patch_count++;
+					agent_count += state.agent_count;
+					for (unsigned int i = 0; i < state.item_count; i++)
+						item_counts[state.items[i].item_type]++;
+				}
+			}
+			summarized_patch_count += block.patch_count;
+
+			for (unsigned int j = 0; j < config.color_dimension; j++) {
+				color[j] = agent_count * config.agent_color[j];
+				for (unsigned int i = 0; i < item_type_count; i++)
+					color[j] += item_counts[i] * config.item_types[i].color[j];
+				color[j] /= patch_count * config.patch_size * config.patch_size;
+			}
+
+			if (block.patch_count != patch_count || block.agent_count != agent_count) {
+				success = false;
+			} else {
+				for (unsigned int i = 0; i < item_type_count; i++)
+					if (block.item_counts[i] != item_counts[i]) success = false;
+				for (unsigned int j = 0; j < config.color_dimension; j++)
+					if (fabs(block.color[j] - color[j]) > 1.0e-5f) success = false;
+			}
+			if (!success)
+				fprintf(stderr, "test_map_summary ERROR: The block at (%" PRId64 ", %" PRId64 ") does not summarize its patches.\n",
+						block.block_position.x, block.block_position.y);
+		}
+	}
+	if (success && summarized_patch_count != region_patch_count) {
+		fprintf(stderr, "test_map_summary ERROR: The blocks contain %u patches, but the region contains %u.\n",
+				summarized_patch_count, region_patch_count);
+		success = false;
+	}
+
+	if (item_counts != nullptr) free(item_counts);
+	if (color != nullptr) free(color);
+	free_map(patches);
+	for (array<patch_summary>& row : blocks) {
+		for (patch_summary& block : row) free(block);
+		free(row);
+	}
+	return success;
+}
+
+/**
+ * Checks every cell of the egocentric grids returned by `get_local_maps`
+ * against the items and agents returned by `get_map`, for agents facing
+ * both up and down, and that an unknown agent ID is rejected.
+ */
+bool test_local_maps(const simulator_config& config)
+{
+	constexpr unsigned int count = 8;
+	position positions[count];
+	for (unsigned int i = 0; i < count; i++)
+		positions[i] = position(6 * (int64_t) i - 24, 4 * (int64_t) (i % 2));
+
+	simulator<test_data> sim(without_obstacles(config), test_data(), 0);
+	uint64_t ids[count]; agent_state* agents[count];
+	if (!add_test_agents(sim, positions, count, ids, agents)) {
+		fprintf(stderr, "test_local_maps ERROR: Unable to add agents.\n");
+		return false;
+	}
+	/* the odd agents turn around, and the others move forward */
+	for (unsigned int t = 0; t < 3; t++) {
+		for (unsigned int i = 0; i < count; i++) {
+			if (i % 2 == 1) sim.turn(ids[i], (t == 0) ? direction::DOWN : direction::UP);
+			else sim.move(ids[i], direction::UP, 1);
+		}
+	}
+
+	const unsigned int radius = 2 * config.vision_range;
+	const unsigned int width = 2 * radius + 1;
+	const size_t grid_size = (size_t) width * width * 2;
+	uint64_t unknown_id = ids[count - 1] + 1;
+	int32_t* grids = (int32_t*) malloc(sizeof(int32_t) * grid_size * (count + 1));
+	if (grids == nullptr) {
+		fprintf(stderr, "test_local_maps ERROR: Out of memory.\n");
+		return false;
+	} else if (sim.get_local_maps(&unknown_id, 1, radius, true, grids) != status::INVALID_AGENT_ID) {
+		fprintf(stderr, "test_local_maps ERROR: get_local_maps accepted an unknown agent ID.\n");
+		free(grids); return false;
+	}
+
+	const int64_t half_width = 2 * (int64_t) config.patch_size;
+	array<array<patch_state>> patches(4);
+	if (sim.get_local_maps(ids, count, radius, true, grids) != status::OK
+	 || sim.get_map<false, false>(position(-half_width), position(half_width - 1), patches) != status::OK)
+	{
+		fprintf(stderr, "test_local_maps ERROR: Unable to retrieve the maps.\n");
+		free(grids); free_map(patches); return false;
+	}
+
+	/* build the expected grid of each agent in the last slot of `grids` */
+	bool success = true;
+	int32_t* expected = grids + grid_size * count;
+	for (unsigned int i = 0; success && i < count; i++) {
+		const agent_state& agent = *agents[i];
+		if (agent.current_direction != ((i % 2 == 1) ? direction::DOWN : direction::UP)) {
+			fprintf(stderr, "test_local_maps ERROR: Agent %u is facing the wrong direction.\n", i);
+			success = false; break;
+		}
+		auto get_cell = [&](const position& location) -> int32_t* {
+			position offset = location - agent.current_position;
+			if (agent.current_direction == direction::DOWN)
+				offset = position(-offset.x, -offset.y);
+			if (offset.x < -(int64_t) radius || offset.x > (int64_t) radius
+			 || offset.y < -(int64_t) radius || offset.y > (int64_t) radius)
+				return nullptr;
+			return expected + ((offset.x + radius) * width + offset.y + radius) * 2;
+		};
+
+		for (unsigned int j = 0; j < width * width; j++) {
+			expected[2*j] = -1;
+			expected[2*j + 1] = 0;
+		}
+		for (const array<patch_state>& row : patches) {
+			for (const patch_state& state : row) {
+				for (unsigned int j = 0; j < state.item_count; j++) {
+					int32_t* cell = get_cell(state.items[j].location);
+					if (cell != nullptr) cell[0] = (int32_t) state.items[j].item_type;
+				}
+				for (unsigned int j = 0; j < state.agent_count; j++) {
+					int32_t* cell = get_cell(state.agent_positions[j]);
+					if (cell != nullptr) cell[1]++;
+				}
+			}
+		}
+
+		const int32_t* actual = grids + grid_size * i;
+		for (size_t j = 0; j < grid_size; j++) {
+			if (actual[j] != expected[j]) {
+				fprintf(stderr, "test_local_maps ERROR: Cell %zu of the grid of agent %u is %d, but %d was expected.\n",
+						j / 2, i, actual[j], expected[j]);
+				success = false; break;
+			}
+		}
+	}
+	free(grids);
+	free_map(patches);
+	return success;
+}
+
+int main(int argc, const char** argv)
+{
+	simulator_config config;
+	config.max_steps_per_movement = 1;
+	config.scent_dimension = 3;
+	config.color_dimension = 3;
+	config.vision_range = 5;
+	config.agent_field_of_view = 2.09f;
+	for (unsigned int i = 0; i < (size_t) direction::COUNT; i++)
+		config.allowed_movement_directions[i] = action_policy::ALLOWED;
+	for (unsigned int i = 0; i < (size_t) direction::COUNT; i++)
+		config.allowed_rotations[i] = action_policy::ALLOWED;
+	config.no_op_allowed = false;
+	config.patch_size = 32;
+	config.mcmc_iterations = 4000;
+	config.agent_color = (float*) calloc(config.color_dimension, sizeof(float));
+	config.agent_color[2] = 1.0f;
+	config.collision_policy = collision_policy;
+	config.decay_param = 0.4f;
+	config.diffusion_param = 0.14f;
+	config.deleted_item_lifetime = 2000;
+#if defined(TEST_ASYNC_NOTIFICATIONS)
+	/* deliver `on_step` on a separate thread, keeping only the latest step */
+	config.step_notification_capacity = 4;
+	config.step_notification_policy = notification_policy::COALESCE;
+#endif
+
+	/* configure item types */
+	unsigned int item_type_count = 4;
+	config.item_types.ensure_capacity(item_type_count);
+	config.item_types[0].name = "banana";
+	config.item_types[0].scent = (float*) calloc(config.scent_dimension, sizeof(float));
+	config.item_types[0].color = (float*) calloc(config.color_dimension, sizeof(float));
+	config.item_types[0].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[0].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[0].scent[1] = 1.0f;
+	config.item_types[0].color[1] = 1.0f;
+	config.item_types[0].required_item_counts[0] = 1;
+	config.item_types[0].blocks_movement = false;
+	config.item_types[0].visual_occlusion = 0.0;
+	config.item_types[1].name = "onion";
+	config.item_types[1].scent = (float*) calloc(config.scent_dimension, sizeof(float));
+	config.item_types[1].color = (float*) calloc(config.color_dimension, sizeof(float));
+	config.item_types[1].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[1].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[1].scent[0] = 1.0f;
+	config.item_types[1].color[0] = 1.0f;
+	config.item_types[1].required_item_counts[1] = 1;
+	config.item_types[1].blocks_movement = false;
+	config.item_types[1].visual_occlusion = 0.0;
+	config.item_types[2].name = "jellybean";
+	config.item_types[2].scent = (float*) calloc(config.scent_dimension, sizeof(float));
+	config.item_types[2].color = (float*) calloc(config.color_dimension, sizeof(float));
+	config.item_types[2].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[2].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[2].scent[2] = 1.0f;
+	config.item_types[2].color[2] = 1.0f;
+	config.item_types[2].blocks_movement = false;
+	config.item_types[2].visual_occlusion = 0.0;
+	config.item_types[3].name = "wall";
+	config.item_types[3].scent = (float*) calloc(config.scent_dimension, sizeof(float));
+	config.item_types[3].color = (float*) calloc(config.color_dimension, sizeof(float));
+	config.item_types[3].required_item_counts = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[3].required_item_costs = (unsigned int*) calloc(item_type_count, sizeof(unsigned int));
+	config.item_types[3].color[0] = 0.5f;
+	config.item_types[3].color[1] = 0.5f;
+	config.item_types[3].color[2] = 0.5f;
+	config.item_types[3].required_item_counts[3] = 1;
+	config.item_types[3].blocks_movement = true;
+	config.item_types[3].visual_occlusion = 0.5;
+	config.item_types.length = item_type_count;
+
+	config.item_types[0].intensity_fn.fn = constant_intensity_fn;
+	config.item_types[0].intensity_fn.arg_count = 1;
+	config.item_types[0].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
+	config.item_types[0].intensity_fn.args[0] = -5.3f;
+	config.item_types[0].interaction_fns = (energy_function<interaction_function>*)
+			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
+	config.item_types[1].intensity_fn.fn = constant_intensity_fn;
+	config.item_types[1].intensity_fn.arg_count = 1;
+	config.item_types[1].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
+	config.item_types[1].intensity_fn.args[0] = -5.0f;
+	config.item_types[1].interaction_fns = (energy_function<interaction_function>*)
+			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
+	config.item_types[2].intensity_fn.fn = constant_intensity_fn;
+	config.item_types[2].intensity_fn.arg_count = 1;
+	config.item_types[2].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
+	config.item_types[2].intensity_fn.args[0] = -5.3f;
+	config.item_types[2].interaction_fns = (energy_function<interaction_function>*)
+			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
+	config.item_types[3].intensity_fn.fn = constant_intensity_fn;
+	config.item_types[3].intensity_fn.arg_count = 1;
+	config.item_types[3].intensity_fn.args = (float*) malloc(sizeof(float) * 1);
+	config.item_types[3].intensity_fn.args[0] = 0.0f;
+	config.item_types[3].interaction_fns = (energy_function<interaction_function>*)
+			malloc(sizeof(energy_function<interaction_function>) * config.item_types.length);
+
+	set_interaction_args(config.item_types.data, 0, 0, piecewise_box_interaction_fn, {10.0f, 200.0f, 0.0f, -6.0f});
+	set_interaction_args(config.item_types.data, 0, 1, piecewise_box_interaction_fn, {200.0f, 0.0f, -6.0f, -6.0f});
+	set_interaction_args(config.item_types.data, 0, 2, piecewise_box_interaction_fn, {10.0f, 200.0f, 2.0f, -100.0f});
+	set_interaction_args(config.item_types.data, 0, 3, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 1, 0, piecewise_box_interaction_fn, {200.0f, 0.0f, -6.0f, -6.0f});
+	set_interaction_args(config.item_types.data, 1, 1, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 1, 2, piecewise_box_interaction_fn, {200.0f, 0.0f, -100.0f, -100.0f});
+	set_interaction_args(config.item_types.data, 1, 3, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 2, 0, piecewise_box_interaction_fn, {10.0f, 200.0f, 2.0f, -100.0f});
+	set_interaction_args(config.item_types.data, 2, 1, piecewise_box_interaction_fn, {200.0f, 0.0f, -100.0f, -100.0f});
+	set_interaction_args(config.item_types.data, 2, 2, piecewise_box_interaction_fn, {10.0f, 200.0f, 0.0f, -6.0f});
+	set_interaction_args(config.item_types.data, 2, 3, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 3, 0, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 3, 1, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 3, 2, zero_interaction_fn, {});
+	set_interaction_args(config.item_types.data, 3, 3, cross_interaction_fn, {10.0f, 15.0f, 20.0f, -200.0f, -20.0f, 1.0f});
+
+	/* check the simulator against its reference implementations before running the benchmark */
+	if (!test_act_batch(config)
+	 || !test_mpi_act_batch(config)
+	 || !test_protocol_version(config)
+	 || !test_movement_conflicts(config)
+	 || !test_step_thread_count(config)
+	 || !test_dedicated_step_thread(config)
+	 || !test_concurrent_snapshots(config)
+	 || !test_step_deadline(config)
+	 || !test_action_queues(config)
+	 || !test_advance(config)
+	 || !test_batch_spawn(config)
+	 || !test_interaction_clusters(config)
+	 || !test_incremental_vision(config)
+	 || !test_specialized_kernels(config)
+	 || !test_slow_notifications(config, notification_policy::DROP_OLDEST)
+	 || !test_slow_notifications(config, notification_policy::COALESCE)
+	 || !test_agent_executor(config)
+	 || !test_scent_map(config)
+	 || !test_map_since(config)
+	 || !test_map_summary(config)
+	 || !test_local_maps(config))
+		return EXIT_FAILURE;
 
 #if defined(USE_MPI)
 	test_mpi(config);
+#elif defined(TEST_EXECUTOR)
+	test_executor(config);
 #elif defined(MULTITHREADED)
 	test_multithreaded(config);
 #else
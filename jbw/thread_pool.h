@@ -0,0 +1,149 @@
+/**
+ * Copyright 2019, The Jelly Bean World Authors. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License"); you may not
+ * use this file except in compliance with the License. You may obtain a copy of
+ * the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS, WITHOUT
+ * WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied. See the
+ * License for the specific language governing permissions and limitations under
+ * the License.
+ */
+
+#ifndef JBW_THREAD_POOL_H_
+#define JBW_THREAD_POOL_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace jbw {
+
+/**
+ * A fixed set of worker threads that execute data-parallel loops. The threads
+ * are started once and reused for every call to `parallel_for`, where the
+ * iteration range is divided into chunks that idle threads claim from a
+ * shared counter, so that faster threads take on more of the work.
+ */
+class thread_pool {
+	std::thread* workers;
+	unsigned int worker_count;
+
+	std::mutex lock;
+	std::condition_variable work_cv;
+	std::condition_variable done_cv;
+
+	/* incremented each time a new loop is submitted to the workers */
+	uint64_t generation;
+	unsigned int running_workers;
+	bool stopping;
+
+	/* the loop currently being executed */
+	void (*task)(void*, size_t, size_t);
+	void* task_data;
+	size_t task_size;
+	size_t chunk_size;
+	std::atomic<size_t> next_index;
+
+public:
+	/**
+	 * Constructs a pool that executes loops on `thread_count` threads,
+	 * including the thread that calls `parallel_for`.
+	 */
+	thread_pool(unsigned int thread_count) :
+		worker_count(thread_count > 1 ? thread_count - 1 : 0),
+		generation(0), running_workers(0), stopping(false)
+	{
+		workers = new std::thread[worker_count];
+		for (unsigned int i = 0; i < worker_count; i++)
+			workers[i] = std::thread(&thread_pool::run_worker, this);
+	}
+
+	~thread_pool() {
+		std::unique_lock<std::mutex> guard(lock);
+		stopping = true;
+		work_cv.notify_all();
+		guard.unlock();
+		for (unsigned int i = 0; i < worker_count; i++) {
+			if (workers[i].joinable())
+				workers[i].join();
+		}
+		delete[] workers;
+	}
+
+	inline unsigned int thread_count() const {
+		return worker_count + 1;
+	}
+
+	/**
+	 * Calls `function(start, end)` for disjoint ranges [start, end) that
+	 * together cover [0, `count`), each of length at most `chunk`. The calling
+	 * thread participates in the loop, and this function returns once every
+	 * range has been processed.
+	 */
+	template<typename Function>
+	void parallel_for(size_t count, size_t chunk, Function& function)
+	{
+		if (count == 0) return;
+		if (worker_count == 0 || count <= chunk) {
+			function((size_t) 0, count);
+			return;
+		}
+
+		std::unique_lock<std::mutex> guard(lock);
+		task = [](void* data, size_t start, size_t end) {
+			(*((Function*) data))(start, end);
+		};
+		task_data = (void*) &function;
+		task_size = count;
+		chunk_size = chunk;
+		next_index = 0;
+		running_workers = worker_count;
+		generation++;
+		work_cv.notify_all();
+		guard.unlock();
+
+		run_chunks();
+
+		guard.lock();
+		while (running_workers > 0)
+			done_cv.wait(guard);
+	}
+
+private:
+	inline void run_chunks() {
+		while (true) {
+			size_t start = next_index.fetch_add(chunk_size);
+			if (start >= task_size) return;
+			size_t end = (task_size - start < chunk_size) ? task_size : (start + chunk_size);
+			task(task_data, start, end);
+		}
+	}
+
+	void run_worker() {
+		uint64_t last_generation = 0;
+		std::unique_lock<std::mutex> guard(lock);
+		while (true) {
+			while (!stopping && generation == last_generation)
+				work_cv.wait(guard);
+			if (stopping) return;
+			last_generation = generation;
+
+			guard.unlock();
+			run_chunks();
+			guard.lock();
+			if (--running_workers == 0)
+				done_cv.notify_one();
+		}
+	}
+};
+
+} /* namespace jbw */
+
+#endif /* JBW_THREAD_POOL_H_ */
@@ -62,12 +62,24 @@ bool parse_address(
 	if (address != nullptr || (arg[0] == '-' && arg[1] == '-'))
 		return false;
 
+	if (is_local_address(arg)) {
+		/* a Unix domain socket path, for which the port is ignored */
+		address = (char*) malloc(sizeof(char) * (strlen(arg) + 1));
+		if (address == nullptr) {
+			fprintf(stderr, "parse_address ERROR: Out of memory.\n");
+			fail = true; return true;
+		}
+		strcpy(address, arg);
+		port = "0";
+		return true;
+	}
+
 	unsigned int colon_index = 0;
 	while (arg[colon_index] != ':' && arg[colon_index] != '\0')
 		colon_index++;
 
 	if (arg[colon_index] == '\0') {
-		fprintf(stderr, "ERROR: The server address must be of the form <address>:<port>.\n");
+		fprintf(stderr, "ERROR: The server address must be of the form <address>:<port> or unix:<path>.\n");
 		fail = true; return true;
 	}
 
@@ -130,6 +142,7 @@ inline bool parse_option(
 template<typename Stream>
 void print_usage(Stream&& out) {
 	fprintf(out, "Usage: jbw_visualizer <address>:<port> [options]\n"
+		"       jbw_visualizer unix:<path> [options]\n"
 		"Connects to the JBW server at the given address visualizes the simulated environment.\n"
 		"\n"
 		"Available options:\n"
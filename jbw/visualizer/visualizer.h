@@ -1743,8 +1743,8 @@ private:
 		bool render_path = render_agent_path;
 		unsigned int render_path_length = 0;
 		if (track_agent_id != 0) {
-			agent_state* agent;
-			sim.get_agent_states(&agent, &track_agent_id, 1);
+			const agent_state* agent;
+			const observation_snapshot& snapshot = sim.get_agent_states(&agent, &track_agent_id, 1);
 			if (agent != nullptr) {
 				agent_position = agent->current_position;
 				agent_direction = agent->current_direction;
@@ -1759,7 +1759,7 @@ private:
 #if defined(RECORD)
 				record_collected_items(agent->collected_items, sim.get_config().item_types.length);
 #endif
-				agent->lock.unlock();
+				sim.release_snapshot(snapshot);
 
 				if (render_path) {
 					agent_path_lock.lock();
@@ -1784,6 +1784,7 @@ private:
 					tracking_animating = true;
 				}
 			} else {
+				sim.release_snapshot(snapshot);
 				fprintf(stderr, "Agent with ID %" PRIu64 " does not exist in the simulation.\n", track_agent_id);
 				track_agent(0);
 			}
@@ -2480,6 +2481,18 @@ void on_get_map(client<visualizer_client_data>& c,
 	c.data.waiting_for_get_map = false;
 }
 
+void on_get_map_summary(client<visualizer_client_data>& c,
+		status response, array<array<patch_summary>>* blocks)
+{
+	fprintf(stderr, "WARNING: `on_get_map_summary` should not be called.\n");
+	if (blocks == nullptr) return;
+	for (array<patch_summary>& row : *blocks) {
+		for (patch_summary& block : row) free(block);
+		free(row);
+	}
+	free(*blocks); free(blocks);
+}
+
 void on_get_agent_ids(
 		client<visualizer_client_data>& c, status response,
 		const uint64_t* agent_ids, size_t count)
@@ -2508,6 +2521,23 @@ void on_is_active(client<visualizer_client_data>& c, uint64_t agent_id, status r
 	fprintf(stderr, "WARNING: `on_is_active` should not be called.\n");
 }
 
+void on_enqueue_actions(client<visualizer_client_data>& c, uint64_t agent_id, status response)
+{
+	fprintf(stderr, "WARNING: `on_enqueue_actions` should not be called.\n");
+}
+
+void on_enable_shared_observations(client<visualizer_client_data>& c, status response)
+{
+	fprintf(stderr, "WARNING: `on_enable_shared_observations` should not be called.\n");
+}
+
+void on_act_batch(client<visualizer_client_data>& c,
+		status response, status* statuses, size_t count)
+{
+	fprintf(stderr, "WARNING: `on_act_batch` should not be called.\n");
+	if (statuses != nullptr) free(statuses);
+}
+
 inline void on_step(
 		client<visualizer_client_data>& c,
 		status response,